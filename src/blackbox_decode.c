@@ -12,11 +12,14 @@
 
 #ifdef WIN32
     #include <io.h>
+#else
+    #include <unistd.h>
 #endif
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #ifdef WIN32
     #include "getopt.h"
@@ -32,16 +35,29 @@
 #include "battery.h"
 #include "units.h"
 #include "stats.h"
+#include "csvwriter.h"
+#include "logindex.h"
+#include "serial.h"
 
 #define MIN_GPS_SATELLITES 5
 
+// How many decoded logs per worker can be waiting for the logs before them to finish before we stop submitting more
+#define MAX_PENDING_JOBS_PER_WORKER 4
+
 typedef struct decodeOptions_t {
     int help, raw, limits, debug, toStdout;
     int logNumber;
     int simulateIMU, imuIgnoreMag;
     int simulateCurrentMeter;
     int mergeGPS;
+    int threads;
+    int jobs;
+    int noIndex, saveIndex;
+    int baud;
+    int follow, followTimeout;
+    int64_t timeStart, timeEnd;
     const char *outputPrefix;
+    const char *teeFilename;
 
     bool overrideSimCurrentMeterOffset, overrideSimCurrentMeterScale;
     int16_t simCurrentMeterOffset, simCurrentMeterScale;
@@ -55,6 +71,12 @@ decodeOptions_t options = {
     .simulateIMU = false, .imuIgnoreMag = 0,
     .simulateCurrentMeter = false,
     .mergeGPS = 0,
+    .threads = 1,
+    .jobs = 1,
+    .noIndex = 0, .saveIndex = 0,
+    .baud = 0,
+    .follow = 0, .followTimeout = 30,
+    .timeStart = 0, .timeEnd = -1,
 
     .overrideSimCurrentMeterOffset = false,
     .overrideSimCurrentMeterScale = false,
@@ -62,6 +84,7 @@ decodeOptions_t options = {
     .simCurrentMeterOffset = 0, .simCurrentMeterScale = 0,
 
     .outputPrefix = NULL,
+    .teeFilename = NULL,
 
     .unitGPSSpeed = UNIT_METERS_PER_SECOND,
     .unitFrameTime = UNIT_MICROSECONDS,
@@ -82,34 +105,95 @@ typedef enum {
     GPS_FIELD_TYPE_METERS
 } GPSFieldType;
 
-static GPSFieldType gpsFieldTypes[FLIGHT_LOG_MAX_FIELDS];
+/**
+ * Everything we need to keep track of while decoding one log to CSV. Logs can be decoded concurrently (see the -j
+ * option), so each decode has its own context, which the callbacks find through the flight log's userData.
+ */
+typedef struct decodeContext_t {
+    const char *filename;
+    int logIndex;
+
+    // Where messages about this decode (like its statistics) are printed
+    FILE *messages;
+
+    // Cleared if the log doesn't have the sensors that the IMU simulation needs
+    bool simulateIMU;
+
+    // These arrays have an element for each field of their frame type (see allocateFieldArrays())
+    GPSFieldType *gpsFieldTypes;
 
-static int64_t lastFrameTime;
-static uint32_t lastFrameIteration;
+    int64_t lastFrameTime;
+    uint32_t lastFrameIteration;
 
-static FILE *csvFile = 0, *eventFile = 0, *gpsCsvFile = 0;
-static char *eventFilename = 0, *gpsCsvFilename = 0;
-static gpxWriter_t *gpx = 0;
+    FILE *csvFile, *eventFile, *gpsCsvFile;
+    csvWriter_t *csv, *gpsCsv;
+    char *eventFilename, *gpsCsvFilename;
+    gpxWriter_t *gpx;
 
-// Computed states:
-static currentMeterState_t currentMeterMeasured;
-static currentMeterState_t currentMeterVirtual;
-static attitude_t attitude;
+    // Computed states:
+    imuState_t imu;
+    currentMeterState_t currentMeterMeasured;
+    currentMeterState_t currentMeterVirtual;
+    attitude_t attitude;
 
-static Unit mainFieldUnit[FLIGHT_LOG_MAX_FIELDS];
-static Unit gpsGFieldUnit[FLIGHT_LOG_MAX_FIELDS];
-static Unit slowFieldUnit[FLIGHT_LOG_MAX_FIELDS];
+    Unit *mainFieldUnit;
+    Unit *gpsGFieldUnit;
+    Unit *slowFieldUnit;
 
-static int64_t bufferedSlowFrame[FLIGHT_LOG_MAX_FIELDS];
-static int64_t bufferedMainFrame[FLIGHT_LOG_MAX_FIELDS];
-static bool haveBufferedMainFrame;
+    int64_t *bufferedSlowFrame;
+    int64_t *bufferedMainFrame;
+    bool haveBufferedMainFrame;
 
-static int64_t bufferedFrameTime;
-static uint32_t bufferedFrameIteration;
+    int64_t bufferedFrameTime;
+    uint32_t bufferedFrameIteration;
 
-static int64_t bufferedGPSFrame[FLIGHT_LOG_MAX_FIELDS];
+    int64_t *bufferedGPSFrame;
 
-static seriesStats_t looptimeStats;
+    seriesStats_t looptimeStats;
+} decodeContext_t;
+
+/**
+ * A log file that's open for decoding, which is kept open until all of its logs have been decoded.
+ */
+typedef struct decodeFile_t {
+    const char *filename;
+    int fd;
+    flightLog_t *log;
+
+    flightLogIndex_t *index;
+    char *indexFilename;
+
+    // When the log is being read from a serial port as it arrives, this is what's reading it
+    serialInput_t *serialInput;
+
+    int jobsRemaining;
+} decodeFile_t;
+
+/**
+ * The decoding of one log from a file, which runs on a worker thread when we're decoding several logs at once (-j).
+ */
+typedef struct decodeJob_t {
+    decodeFile_t *file;
+    int logIndex;
+
+    // True to decode using the file's own parser, otherwise the job opens the file again to get a parser of its own
+    bool useFileLog;
+
+    // Where the job's messages are collected until the jobs before it have printed theirs
+    FILE *messages;
+
+    semaphore_t done;
+} decodeJob_t;
+
+/**
+ * Jobs that have been submitted to the worker pool (NULL when decoding on the main thread), oldest first.
+ */
+typedef struct decodeJobQueue_t {
+    workerPool_t *pool;
+
+    decodeJob_t **jobs;
+    int head, count, capacity;
+} decodeJobQueue_t;
 
 #define ADJUSTMENT_FUNCTION_COUNT 21
 static char *INFLIGHT_ADJUSTMENT_FUNCTIONS[ADJUSTMENT_FUNCTION_COUNT] = {
@@ -135,42 +219,45 @@ static char *INFLIGHT_ADJUSTMENT_FUNCTIONS[ADJUSTMENT_FUNCTION_COUNT] = {
         "ROLL_I",
         "ROLL_D"};
 
-static void fprintfMilliampsInUnit(FILE *file, int32_t milliamps, Unit unit)
+static void writeMilliampsInUnit(csvWriter_t *writer, int32_t milliamps, Unit unit)
 {
     switch (unit) {
         case UNIT_AMPS:
-            fprintf(file, "%.3f", milliamps / 1000.0);
+            csvWriterWriteFixedPoint(writer, milliamps, 3);
         break;
         case UNIT_MILLIAMPS:
-            fprintf(file, "%d", milliamps);
+            csvWriterWriteInt(writer, milliamps, 0);
         break;
         default:
+            // Keep what has already been decoded, like the unbuffered output used to
+            csvWriterFlush(writer);
             fprintf(stderr, "Bad amperage unit %d\n", (int) unit);
             exit(-1);
         break;
     }
 }
 
-static void fprintfMicrosecondsInUnit(FILE *file, int64_t microseconds, Unit unit)
+static void writeMicrosecondsInUnit(csvWriter_t *writer, int64_t microseconds, Unit unit)
 {
     switch (unit) {
         case UNIT_MICROSECONDS:
-            fprintf(file, "%" PRId64, microseconds);
+            csvWriterWriteInt(writer, microseconds, 0);
         break;
         case UNIT_MILLISECONDS:
-            fprintf(file, "%.3f", microseconds / 1000.0);
+            csvWriterWriteFixedPoint(writer, microseconds, 3);
         break;
         case UNIT_SECONDS:
-            fprintf(file, "%.6f", microseconds / 1000000.0);
+            csvWriterWriteFixedPoint(writer, microseconds, 6);
         break;
         default:
+            csvWriterFlush(writer);
             fprintf(stderr, "Bad time unit %d\n", (int) unit);
             exit(-1);
         break;
     }
 }
 
-static bool fprintfMainFieldInUnit(flightLog_t *log, FILE *file, int fieldIndex, int64_t fieldValue, Unit unit)
+static bool writeMainFieldInUnit(flightLog_t *log, csvWriter_t *writer, int fieldIndex, int64_t fieldValue, Unit unit)
 {
     /* Convert the fieldValue to the given unit based on the original unit of the field (that we decide on by looking
      * for a well-known field that corresponds to the given fieldIndex.)
@@ -178,60 +265,60 @@ static bool fprintfMainFieldInUnit(flightLog_t *log, FILE *file, int fieldIndex,
     switch (unit) {
         case UNIT_MILLIVOLTS:
             // Betaflight already does the ADC conversion
-            fprintf(file, "%3u", (int32_t) fieldValue * 100);
+            csvWriterWriteUnsigned(writer, (uint32_t) (int32_t) fieldValue * 100, 3);
             return true;
         case UNIT_VOLTS:
             // Betaflight already does the ADC conversion
-            fprintf(file, "%.1f", (double) fieldValue / 10);
+            csvWriterWriteFixedPoint(writer, fieldValue, 1);
             return true;
         case UNIT_MILLIAMPS:
             // Betaflight already does the ADC conversion
-            fprintf(file, "%3u", (int32_t) fieldValue * 10);
+            csvWriterWriteUnsigned(writer, (uint32_t) (int32_t) fieldValue * 10, 3);
             return true;
         case UNIT_AMPS:
             // Betaflight already does the ADC conversion
-            fprintf(file, "%.2f", (double) fieldValue / 100);
+            csvWriterWriteFixedPoint(writer, fieldValue, 2);
             return true;
         break;
         case UNIT_CENTIMETERS:
             if (fieldIndex == log->mainFieldIndexes.BaroAlt) {
-                fprintf(file, "%" PRId64, fieldValue);
+                csvWriterWriteInt(writer, fieldValue, 0);
                 return true;
             }
         break;
         case UNIT_METERS:
             if (fieldIndex == log->mainFieldIndexes.BaroAlt) {
-                fprintf(file, "%.2f", (double) fieldValue / 100);
+                csvWriterWriteFixedPoint(writer, fieldValue, 2);
                 return true;
             }
         break;
         case UNIT_FEET:
             if (fieldIndex == log->mainFieldIndexes.BaroAlt) {
-                fprintf(file, "%.2f", (double) fieldValue / 100 * FEET_PER_METER);
+                csvWriterWriteDouble(writer, (double) fieldValue / 100 * FEET_PER_METER, 2);
                 return true;
             }
         break;
         case UNIT_DEGREES_PER_SECOND:
             if (fieldIndex >= log->mainFieldIndexes.gyroADC[0] && fieldIndex <= log->mainFieldIndexes.gyroADC[2]) {
-                fprintf(file, "%.2f", flightlogGyroToRadiansPerSecond(log, fieldValue) * (180 / M_PI));
+                csvWriterWriteDouble(writer, flightlogGyroToRadiansPerSecond(log, fieldValue) * (180 / M_PI), 2);
                 return true;
             }
         break;
         case UNIT_RADIANS_PER_SECOND:
             if (fieldIndex >= log->mainFieldIndexes.gyroADC[0] && fieldIndex <= log->mainFieldIndexes.gyroADC[2]) {
-                fprintf(file, "%.2f", flightlogGyroToRadiansPerSecond(log, fieldValue));
+                csvWriterWriteDouble(writer, flightlogGyroToRadiansPerSecond(log, fieldValue), 2);
                 return true;
             }
         break;
         case UNIT_METERS_PER_SECOND_SQUARED:
             if (fieldIndex >= log->mainFieldIndexes.accSmooth[0] && fieldIndex <= log->mainFieldIndexes.accSmooth[2]) {
-                fprintf(file, "%.2f", flightlogAccelerationRawToGs(log, fieldValue) * ACCELERATION_DUE_TO_GRAVITY);
+                csvWriterWriteDouble(writer, flightlogAccelerationRawToGs(log, fieldValue) * ACCELERATION_DUE_TO_GRAVITY, 2);
                 return true;
             }
         break;
         case UNIT_GS:
             if (fieldIndex >= log->mainFieldIndexes.accSmooth[0] && fieldIndex <= log->mainFieldIndexes.accSmooth[2]) {
-                fprintf(file, "%.2f", flightlogAccelerationRawToGs(log, fieldValue));
+                csvWriterWriteDouble(writer, flightlogAccelerationRawToGs(log, fieldValue), 2);
                 return true;
             }
         break;
@@ -239,15 +326,15 @@ static bool fprintfMainFieldInUnit(flightLog_t *log, FILE *file, int fieldIndex,
         case UNIT_MILLISECONDS:
         case UNIT_SECONDS:
             if (fieldIndex == log->mainFieldIndexes.time) {
-                fprintfMicrosecondsInUnit(file, fieldValue, unit);
+                writeMicrosecondsInUnit(writer, fieldValue, unit);
                 return true;
             }
         break;
         case UNIT_RAW:
             if (log->frameDefs['I'].fieldSigned[fieldIndex] || options.raw) {
-                fprintf(file, "%3d", (int32_t) fieldValue);
+                csvWriterWriteInt(writer, (int32_t) fieldValue, 3);
             } else {
-                fprintf(file, "%3u", (uint32_t) fieldValue);
+                csvWriterWriteUnsigned(writer, (uint32_t) fieldValue, 3);
             }
             return true;
         break;
@@ -261,15 +348,15 @@ static bool fprintfMainFieldInUnit(flightLog_t *log, FILE *file, int fieldIndex,
 
 void onEvent(flightLog_t *log, flightLogEvent_t *event)
 {
-    (void) log;
+    decodeContext_t *context = log->userData;
 
     // Open the event log if it wasn't open already
-    if (!eventFile) {
-        if (eventFilename) {
-            eventFile = fopen(eventFilename, "wb");
+    if (!context->eventFile) {
+        if (context->eventFilename) {
+            context->eventFile = fopen(context->eventFilename, "wb");
 
-            if (!eventFile) {
-                fprintf(stderr, "Failed to create event log file %s\n", eventFilename);
+            if (!context->eventFile) {
+                fprintf(context->messages, "Failed to create event log file %s\n", context->eventFilename);
                 return;
             }
         } else {
@@ -280,27 +367,27 @@ void onEvent(flightLog_t *log, flightLogEvent_t *event)
 
     switch (event->event) {
         case FLIGHT_LOG_EVENT_SYNC_BEEP:
-            fprintf(eventFile, "{\"name\":\"Sync beep\", \"time\":%" PRId64 "}\n", event->data.syncBeep.time);
+            fprintf(context->eventFile, "{\"name\":\"Sync beep\", \"time\":%" PRId64 "}\n", event->data.syncBeep.time);
         break;
         case FLIGHT_LOG_EVENT_INFLIGHT_ADJUSTMENT:
-            fprintf(eventFile, "{\"name\":\"Inflight adjustment\", \"time\":%" PRId64 ", \"data\":{\"adjustmentFunction\":\"%s\",\"value\":", lastFrameTime,
+            fprintf(context->eventFile, "{\"name\":\"Inflight adjustment\", \"time\":%" PRId64 ", \"data\":{\"adjustmentFunction\":\"%s\",\"value\":", context->lastFrameTime,
                     INFLIGHT_ADJUSTMENT_FUNCTIONS[event->data.inflightAdjustment.adjustmentFunction & 127]);
             if (event->data.inflightAdjustment.adjustmentFunction > 127) {
-                fprintf(eventFile, "%g", event->data.inflightAdjustment.newFloatValue);
+                fprintf(context->eventFile, "%g", event->data.inflightAdjustment.newFloatValue);
             } else {
-                fprintf(eventFile, "%d", event->data.inflightAdjustment.newValue);
+                fprintf(context->eventFile, "%d", event->data.inflightAdjustment.newValue);
             }
-            fprintf(eventFile, "}}\n");
+            fprintf(context->eventFile, "}}\n");
         break;
         case FLIGHT_LOG_EVENT_LOGGING_RESUME:
-            fprintf(eventFile, "{\"name\":\"Logging resume\", \"time\":%" PRId64 ", \"data\":{\"logIteration\":%d}}\n", event->data.loggingResume.currentTime,
+            fprintf(context->eventFile, "{\"name\":\"Logging resume\", \"time\":%" PRId64 ", \"data\":{\"logIteration\":%d}}\n", event->data.loggingResume.currentTime,
                     event->data.loggingResume.logIteration);
         break;
         case FLIGHT_LOG_EVENT_LOG_END:
-            fprintf(eventFile, "{\"name\":\"Log clean end\", \"time\":%" PRId64 "}\n", lastFrameTime);
+            fprintf(context->eventFile, "{\"name\":\"Log clean end\", \"time\":%" PRId64 "}\n", context->lastFrameTime);
         break;
         default:
-            fprintf(eventFile, "{\"name\":\"Unknown event\", \"time\":%" PRId64 ", \"data\":{\"eventID\":%d}}\n", lastFrameTime, event->event);
+            fprintf(context->eventFile, "{\"name\":\"Unknown event\", \"time\":%" PRId64 ", \"data\":{\"eventID\":%d}}\n", context->lastFrameTime, event->event);
         break;
     }
 }
@@ -309,7 +396,7 @@ void onEvent(flightLog_t *log, flightLogEvent_t *event)
  * Print out a comma separated list of field names for the given frame (and field units if not raw),
  * minus the "time" field if `skipTime` is set.
  */
-void outputFieldNamesHeader(FILE *file, flightLogFrameDef_t *frame, Unit *fieldUnit, bool skipTime)
+void outputFieldNamesHeader(csvWriter_t *writer, flightLogFrameDef_t *frame, Unit *fieldUnit, bool skipTime)
 {
     bool needComma = false;
 
@@ -318,40 +405,45 @@ void outputFieldNamesHeader(FILE *file, flightLogFrameDef_t *frame, Unit *fieldU
             continue;
 
         if (needComma) {
-            fprintf(file, ", ");
+            csvWriterWriteString(writer, ", ");
         } else {
             needComma = true;
         }
 
-        fprintf(file, "%s", frame->fieldName[i]);
+        csvWriterWriteString(writer, frame->fieldName[i]);
 
         if (fieldUnit && fieldUnit[i] != UNIT_RAW) {
-            fprintf(file, " (%s)", UNIT_NAME[fieldUnit[i]]);
+            csvWriterPrintf(writer, " (%s)", UNIT_NAME[fieldUnit[i]]);
         }
     }
 }
 
 /**
- * Attempt to create a file to log GPS data in CSV format. On success, gpsCsvFile is non-NULL.
+ * Attempt to create a file to log GPS data in CSV format. On success, context->gpsCsvFile is non-NULL.
  */
 void createGPSCSVFile(flightLog_t *log)
 {
-    if (!gpsCsvFile && gpsCsvFilename) {
-        gpsCsvFile = fopen(gpsCsvFilename, "wb");
+    decodeContext_t *context = log->userData;
+
+    if (!context->gpsCsvFile && context->gpsCsvFilename) {
+        context->gpsCsvFile = fopen(context->gpsCsvFilename, "wb");
+
+        if (context->gpsCsvFile) {
+            context->gpsCsv = csvWriterCreate(context->gpsCsvFile);
 
-        if (gpsCsvFile) {
             // Since the GPS frame itself may or may not include a timestamp field, skip it and print our own:
-            fprintf(gpsCsvFile, "time (%s), ", UNIT_NAME[options.unitFrameTime]);
+            csvWriterPrintf(context->gpsCsv, "time (%s), ", UNIT_NAME[options.unitFrameTime]);
 
-            outputFieldNamesHeader(gpsCsvFile, &log->frameDefs['G'], gpsGFieldUnit, true);
+            outputFieldNamesHeader(context->gpsCsv, &log->frameDefs['G'], context->gpsGFieldUnit, true);
 
-            fprintf(gpsCsvFile, "\n");
+            csvWriterWriteChar(context->gpsCsv, '\n');
         }
     }
 }
 
 static void updateSimulations(flightLog_t *log, int64_t *frame, int64_t currentTime)
 {
+    decodeContext_t *context = log->userData;
     int16_t gyroADC[3];
     int16_t accSmooth[3];
     int16_t magADC[3];
@@ -362,7 +454,7 @@ static void updateSimulations(flightLog_t *log, int64_t *frame, int64_t currentT
 
     int i;
 
-    if (options.simulateIMU) {
+    if (context->simulateIMU) {
         for (i = 0; i < 3; i++) {
             gyroADC[i] = (int16_t) frame[log->mainFieldIndexes.gyroADC[i]];
             accSmooth[i] = (int16_t) frame[log->mainFieldIndexes.accSmooth[i]];
@@ -374,13 +466,13 @@ static void updateSimulations(flightLog_t *log, int64_t *frame, int64_t currentT
             }
         }
 
-        updateEstimatedAttitude(gyroADC, accSmooth, hasMag && !options.imuIgnoreMag ? magADC : NULL,
-            currentTime, log->sysConfig.acc_1G, log->sysConfig.gyroScale, &attitude);
+        updateEstimatedAttitude(&context->imu, gyroADC, accSmooth, hasMag && !options.imuIgnoreMag ? magADC : NULL,
+            currentTime, log->sysConfig.acc_1G, log->sysConfig.gyroScale, &context->attitude);
     }
 
     if (hasAmperageADC) {
         currentMeterUpdateMeasured(
-            &currentMeterMeasured,
+            &context->currentMeterMeasured,
             flightLogAmperageADCToMilliamps(log, frame[log->mainFieldIndexes.amperageLatest]),
             currentTime
         );
@@ -390,7 +482,7 @@ static void updateSimulations(flightLog_t *log, int64_t *frame, int64_t currentT
         int16_t throttle = frame[log->mainFieldIndexes.rcCommand[3]];
 
         currentMeterUpdateVirtual(
-            &currentMeterVirtual,
+            &context->currentMeterVirtual,
             options.overrideSimCurrentMeterOffset ? options.simCurrentMeterOffset : log->sysConfig.currentMeterOffset,
             options.overrideSimCurrentMeterScale ? options.simCurrentMeterScale : log->sysConfig.currentMeterScale,
             throttle,
@@ -402,8 +494,9 @@ static void updateSimulations(flightLog_t *log, int64_t *frame, int64_t currentT
 /**
  * Print the GPS fields from the given GPS frame as comma-separated values (the GPS frame time is not printed).
  */
-void outputGPSFields(flightLog_t *log, FILE *file, int64_t *frame)
+void outputGPSFields(flightLog_t *log, csvWriter_t *writer, int64_t *frame)
 {
+    decodeContext_t *context = log->userData;
     char negSign[] = "-";
     char noSign[] = "";
 
@@ -418,42 +511,50 @@ void outputGPSFields(flightLog_t *log, FILE *file, int64_t *frame)
             continue;
 
         if (needComma)
-            fprintf(file, ", ");
+            csvWriterWriteString(writer, ", ");
         else
             needComma = true;
 
-        switch (gpsFieldTypes[i]) {
+        switch (context->gpsFieldTypes[i]) {
             case GPS_FIELD_TYPE_COORDINATE_DEGREES_TIMES_10000000:
                 degrees = frame[i] / 10000000;
                 fracDegrees = llabs(frame[i]) % 10000000;
 
 		        char *sign = ((frame[i] < 0) && (degrees == 0)) ? negSign : noSign;
-                fprintf(file, "%s%d.%07u", sign, degrees, fracDegrees);
+                csvWriterWriteString(writer, sign);
+                csvWriterWriteInt(writer, degrees, 0);
+                csvWriterWriteChar(writer, '.');
+                csvWriterWriteZeroPadded(writer, fracDegrees, 7);
             break;
             case GPS_FIELD_TYPE_DEGREES_TIMES_10:
-                fprintf(file, "%" PRId64 ".%01u", frame[i] / 10, (unsigned) (llabs(frame[i]) % 10));
+                csvWriterWriteInt(writer, frame[i] / 10, 0);
+                csvWriterWriteChar(writer, '.');
+                csvWriterWriteZeroPadded(writer, llabs(frame[i]) % 10, 1);
             break;
             case GPS_FIELD_TYPE_METERS_PER_SECOND_TIMES_100:
                 if (options.unitGPSSpeed == UNIT_RAW) {
-                    fprintf(file, "%" PRId64, frame[i]);
+                    csvWriterWriteInt(writer, frame[i], 0);
                 } else if (options.unitGPSSpeed == UNIT_METERS_PER_SECOND) {
-                    fprintf(file, "%" PRId64 ".%02u", frame[i] / 100, (unsigned) (llabs(frame[i]) % 100));
+                    csvWriterWriteInt(writer, frame[i] / 100, 0);
+                    csvWriterWriteChar(writer, '.');
+                    csvWriterWriteZeroPadded(writer, llabs(frame[i]) % 100, 2);
                 } else {
-                    fprintf(file, "%.2f", convertMetersPerSecondToUnit(frame[i] / 100.0, options.unitGPSSpeed));
+                    csvWriterWriteDouble(writer, convertMetersPerSecondToUnit(frame[i] / 100.0, options.unitGPSSpeed), 2);
                 }
             break;
             case GPS_FIELD_TYPE_METERS:
-                fprintf(file, "%" PRId64, frame[i]);
+                csvWriterWriteInt(writer, frame[i], 0);
             break;
             case GPS_FIELD_TYPE_INTEGER:
             default:
-                fprintf(file, "%" PRId64, frame[i]);
+                csvWriterWriteInt(writer, frame[i], 0);
         }
     }
 }
 
 void outputGPSFrame(flightLog_t *log, int64_t *frame)
 {
+    decodeContext_t *context = log->userData;
     int64_t gpsFrameTime;
 
     // If we're not logging every loop iteration, we include a timestamp field in the GPS frame:
@@ -461,30 +562,31 @@ void outputGPSFrame(flightLog_t *log, int64_t *frame)
         gpsFrameTime = frame[log->gpsFieldIndexes.time];
     } else {
         // Otherwise this GPS frame was recorded at the same time as the main stream frame we read before the GPS frame:
-        gpsFrameTime = lastFrameTime;
+        gpsFrameTime = context->lastFrameTime;
     }
 
 	bool haveRequiredFields = log->gpsFieldIndexes.GPS_coord[0] != -1 && log->gpsFieldIndexes.GPS_coord[1] != -1 && log->gpsFieldIndexes.GPS_altitude != -1;
 	bool haveRequiredPrecision = log->gpsFieldIndexes.GPS_numSat == -1 || frame[log->gpsFieldIndexes.GPS_numSat] >= MIN_GPS_SATELLITES;
 
     if (haveRequiredFields && haveRequiredPrecision) {
-		gpxWriterAddPoint(gpx, gpsFrameTime, frame[log->gpsFieldIndexes.GPS_coord[0]], frame[log->gpsFieldIndexes.GPS_coord[1]], frame[log->gpsFieldIndexes.GPS_altitude]);
+		gpxWriterAddPoint(context->gpx, gpsFrameTime, frame[log->gpsFieldIndexes.GPS_coord[0]], frame[log->gpsFieldIndexes.GPS_coord[1]], frame[log->gpsFieldIndexes.GPS_altitude]);
     }
 
     createGPSCSVFile(log);
 
-    if (gpsCsvFile) {
-        fprintfMicrosecondsInUnit(gpsCsvFile, gpsFrameTime, options.unitFrameTime);
-        fprintf(gpsCsvFile, ", ");
+    if (context->gpsCsv) {
+        writeMicrosecondsInUnit(context->gpsCsv, gpsFrameTime, options.unitFrameTime);
+        csvWriterWriteString(context->gpsCsv, ", ");
 
-        outputGPSFields(log, gpsCsvFile, frame);
+        outputGPSFields(log, context->gpsCsv, frame);
 
-        fprintf(gpsCsvFile, "\n");
+        csvWriterWriteChar(context->gpsCsv, '\n');
     }
 }
 
 void outputSlowFrameFields(flightLog_t *log, int64_t *frame)
 {
+    decodeContext_t *context = log->userData;
     enum {
         BUFFER_LEN = 1024
     };
@@ -494,7 +596,7 @@ void outputSlowFrameFields(flightLog_t *log, int64_t *frame)
 
     for (int i = 0; i < log->frameDefs['S'].fieldCount; i++) {
         if (needComma) {
-            fprintf(csvFile, ", ");
+            csvWriterWriteString(context->csv, ", ");
         } else {
             needComma = true;
         }
@@ -508,14 +610,14 @@ void outputSlowFrameFields(flightLog_t *log, int64_t *frame)
                 flightlogFlightStateToString(frame[i], buffer, BUFFER_LEN);
             }
 
-            fprintf(csvFile, "%s", buffer);
+            csvWriterWriteString(context->csv, buffer);
         } else if (i == log->slowFieldIndexes.failsafePhase && options.unitFlags == UNIT_FLAGS) {
             flightlogFailsafePhaseToString(frame[i], buffer, BUFFER_LEN);
 
-            fprintf(csvFile, "%s", buffer);
+            csvWriterWriteString(context->csv, buffer);
         } else {
             //Print raw
-            fprintf(csvFile, "%" PRIu64, (uint64_t) frame[i]);
+            csvWriterWriteUnsigned(context->csv, (uint64_t) frame[i], 0);
         }
     }
 }
@@ -527,12 +629,13 @@ void outputSlowFrameFields(flightLog_t *log, int64_t *frame)
  */
 void outputMainFrameFields(flightLog_t *log, int64_t frameTime, int64_t *frame)
 {
+    decodeContext_t *context = log->userData;
     int i;
     bool needComma = false;
 
     for (i = 0; i < log->frameDefs['I'].fieldCount; i++) {
         if (needComma) {
-            fprintf(csvFile, ", ");
+            csvWriterWriteString(context->csv, ", ");
         } else {
             needComma = true;
         }
@@ -540,60 +643,81 @@ void outputMainFrameFields(flightLog_t *log, int64_t frameTime, int64_t *frame)
         if (i == FLIGHT_LOG_FIELD_INDEX_TIME) {
             // Use the time the caller provided instead of the time in the frame
             if (frameTime == -1) {
-                fprintf(csvFile, "X");
-            } else if (!fprintfMainFieldInUnit(log, csvFile, i, frameTime, mainFieldUnit[i])) {
+                csvWriterWriteChar(context->csv, 'X');
+            } else if (!writeMainFieldInUnit(log, context->csv, i, frameTime, context->mainFieldUnit[i])) {
+                csvWriterFlush(context->csv);
                 fprintf(stderr, "Bad unit for field %d\n", i);
                 exit(-1);
             }
-        } else if (!fprintfMainFieldInUnit(log, csvFile, i, frame[i], mainFieldUnit[i])) {
+        } else if (!writeMainFieldInUnit(log, context->csv, i, frame[i], context->mainFieldUnit[i])) {
+            csvWriterFlush(context->csv);
             fprintf(stderr, "Bad unit for field %d\n", i);
             exit(-1);
         }
     }
 
-    if (options.simulateIMU) {
-        fprintf(csvFile, ", %.2f, %.2f, %.2f", attitude.roll * 180 / M_PI, attitude.pitch * 180 / M_PI, attitude.heading * 180 / M_PI);
+    if (context->simulateIMU) {
+        csvWriterWriteString(context->csv, ", ");
+        csvWriterWriteDouble(context->csv, context->attitude.roll * 180 / M_PI, 2);
+        csvWriterWriteString(context->csv, ", ");
+        csvWriterWriteDouble(context->csv, context->attitude.pitch * 180 / M_PI, 2);
+        csvWriterWriteString(context->csv, ", ");
+        csvWriterWriteDouble(context->csv, context->attitude.heading * 180 / M_PI, 2);
     }
 
+    /*
+     * Energy is integrated from the first frame we decoded, so when --start skipped the frames before it we don't know
+     * the total and leave those columns empty instead.
+     */
     if (log->mainFieldIndexes.amperageLatest != -1) {
         // Integrate the ADC's current measurements to get cumulative energy usage
-        fprintf(csvFile, ", %d", (int) round(currentMeterMeasured.energyMilliampHours));
+        csvWriterWriteString(context->csv, ", ");
+
+        if (options.timeStart == 0) {
+            csvWriterWriteInt(context->csv, (int) round(context->currentMeterMeasured.energyMilliampHours), 0);
+        }
     }
 
     if (options.simulateCurrentMeter) {
-        fprintf(csvFile, ", ");
+        csvWriterWriteString(context->csv, ", ");
+
+        writeMilliampsInUnit(context->csv, context->currentMeterVirtual.currentMilliamps, options.unitAmperage);
 
-        fprintfMilliampsInUnit(csvFile, currentMeterVirtual.currentMilliamps, options.unitAmperage);
+        csvWriterWriteString(context->csv, ", ");
 
-        fprintf(csvFile, ", %d", (int) round(currentMeterVirtual.energyMilliampHours));
+        if (options.timeStart == 0) {
+            csvWriterWriteInt(context->csv, (int) round(context->currentMeterVirtual.energyMilliampHours), 0);
+        }
     }
 
     // Do we have a slow frame to print out too?
     if (log->frameDefs['S'].fieldCount > 0) {
-        fprintf(csvFile, ", ");
+        csvWriterWriteString(context->csv, ", ");
 
-        outputSlowFrameFields(log, bufferedSlowFrame);
+        outputSlowFrameFields(log, context->bufferedSlowFrame);
     }
 }
 
 void outputMergeFrame(flightLog_t *log)
 {
-    outputMainFrameFields(log, bufferedFrameTime, bufferedMainFrame);
-    fprintf(csvFile, ", ");
-    outputGPSFields(log, csvFile, bufferedGPSFrame);
-    fprintf(csvFile, "\n");
+    decodeContext_t *context = log->userData;
+
+    outputMainFrameFields(log, context->bufferedFrameTime, context->bufferedMainFrame);
+    csvWriterWriteString(context->csv, ", ");
+    outputGPSFields(log, context->csv, context->bufferedGPSFrame);
+    csvWriterWriteChar(context->csv, '\n');
 
-    haveBufferedMainFrame = false;
+    context->haveBufferedMainFrame = false;
 }
 
 void updateFrameStatistics(flightLog_t *log, int64_t *frame)
 {
-    (void) log;
+    decodeContext_t *context = log->userData;
 
-    if (lastFrameIteration != (uint32_t) -1 && (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] > lastFrameIteration) {
-        uint32_t looptime = (frame[FLIGHT_LOG_FIELD_INDEX_TIME] - lastFrameTime) / (frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] - lastFrameIteration);
+    if (context->lastFrameIteration != (uint32_t) -1 && (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] > context->lastFrameIteration) {
+        uint32_t looptime = (frame[FLIGHT_LOG_FIELD_INDEX_TIME] - context->lastFrameTime) / (frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] - context->lastFrameIteration);
 
-        seriesStats_append(&looptimeStats, looptime);
+        seriesStats_append(&context->looptimeStats, looptime);
     }
 }
 
@@ -604,8 +728,9 @@ void updateFrameStatistics(flightLog_t *log, int64_t *frame)
  * We also keep a copy of the GPS frame data so we can print it out multiple times if multiple main frames arrive
  * between GPS updates.
  */
-void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize)
+void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
 {
+    decodeContext_t *context = log->userData;
     int64_t gpsFrameTime;
 
     (void) frameOffset;
@@ -614,9 +739,9 @@ void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_
     switch (frameType) {
         case 'G':
             if (frameValid) {
-                if (log->gpsFieldIndexes.time == -1 || (int64_t) frame[log->gpsFieldIndexes.time] == lastFrameTime) {
+                if (log->gpsFieldIndexes.time == -1 || (int64_t) frame[log->gpsFieldIndexes.time] == context->lastFrameTime) {
                     //This GPS frame was logged in the same iteration as the main frame that preceded it
-                    gpsFrameTime = lastFrameTime;
+                    gpsFrameTime = context->lastFrameTime;
                 } else {
                     gpsFrameTime = frame[log->gpsFieldIndexes.time];
 
@@ -624,7 +749,7 @@ void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_
                      * This GPS frame happened some time after the main frame that preceded it, so print out that main
                      * frame with its older timestamp first if we didn't print it already.
                      */
-                    if (haveBufferedMainFrame) {
+                    if (context->haveBufferedMainFrame) {
                         outputMergeFrame(log);
                     }
                 }
@@ -633,8 +758,8 @@ void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_
                  * Copy this GPS data for later since we may need to duplicate it if there is another main frame before
                  * we get another GPS update.
                  */
-                memcpy(bufferedGPSFrame, frame, sizeof(*bufferedGPSFrame) * fieldCount);
-                bufferedFrameTime = gpsFrameTime;
+                memcpy(context->bufferedGPSFrame, frame, sizeof(*context->bufferedGPSFrame) * fieldCount);
+                context->bufferedFrameTime = gpsFrameTime;
 
                 outputMergeFrame(log);
 
@@ -643,56 +768,58 @@ void onFrameReadyMerge(flightLog_t *log, bool frameValid, int64_t *frame, uint8_
 				bool haveRequiredPrecision = log->gpsFieldIndexes.GPS_numSat == -1 || frame[log->gpsFieldIndexes.GPS_numSat] >= MIN_GPS_SATELLITES;
 
                 if (haveRequiredFields && haveRequiredPrecision) {
-                    gpxWriterAddPoint(gpx, gpsFrameTime, frame[log->gpsFieldIndexes.GPS_coord[0]], frame[log->gpsFieldIndexes.GPS_coord[1]], frame[log->gpsFieldIndexes.GPS_altitude]);
+                    gpxWriterAddPoint(context->gpx, gpsFrameTime, frame[log->gpsFieldIndexes.GPS_coord[0]], frame[log->gpsFieldIndexes.GPS_coord[1]], frame[log->gpsFieldIndexes.GPS_altitude]);
                 }
             }
         break;
         case 'S':
             if (frameValid) {
-                if (haveBufferedMainFrame) {
+                if (context->haveBufferedMainFrame) {
                     outputMergeFrame(log);
                 }
 
-                memcpy(bufferedSlowFrame, frame, sizeof(bufferedSlowFrame));
+                memcpy(context->bufferedSlowFrame, frame, sizeof(*context->bufferedSlowFrame) * fieldCount);
             }
         break;
         case 'P':
         case 'I':
             if (frameValid || (frame && options.raw)) {
-                if (haveBufferedMainFrame) {
+                if (context->haveBufferedMainFrame) {
                     outputMergeFrame(log);
                 }
 
                 if (frameValid) {
                     updateFrameStatistics(log, frame);
 
-                    lastFrameIteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
-                    lastFrameTime = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+                    context->lastFrameIteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+                    context->lastFrameTime = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
 
-                    updateSimulations(log, frame, lastFrameTime);
+                    updateSimulations(log, frame, context->lastFrameTime);
 
                     /*
                      * Store this frame to print out later since we don't know if a GPS frame follows it yet.
                      */
-                    memcpy(bufferedMainFrame, frame, sizeof(*bufferedMainFrame) * fieldCount);
+                    memcpy(context->bufferedMainFrame, frame, sizeof(*context->bufferedMainFrame) * fieldCount);
 
-                    haveBufferedMainFrame = true;
+                    context->haveBufferedMainFrame = true;
 
-                    bufferedFrameIteration = lastFrameIteration;
-                    bufferedFrameTime = lastFrameTime;
+                    context->bufferedFrameIteration = context->lastFrameIteration;
+                    context->bufferedFrameTime = context->lastFrameTime;
                 } else {
-                    haveBufferedMainFrame = false;
+                    context->haveBufferedMainFrame = false;
 
-                    bufferedFrameIteration = -1;
-                    bufferedFrameTime = -1;
+                    context->bufferedFrameIteration = -1;
+                    context->bufferedFrameTime = -1;
                 }
             }
         break;
     }
 }
 
-void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize)
+void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
 {
+    decodeContext_t *context = log->userData;
+
     if (options.mergeGPS && log->frameDefs['G'].fieldCount > 0) {
         //Use the alternate frame processing routine which merges main stream data and GPS data together
         onFrameReadyMerge(log, frameValid, frame, frameType, fieldCount, frameOffset, frameSize);
@@ -707,12 +834,12 @@ void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t fra
         break;
         case 'S':
             if (frameValid) {
-                memcpy(bufferedSlowFrame, frame, sizeof(bufferedSlowFrame));
+                memcpy(context->bufferedSlowFrame, frame, sizeof(*context->bufferedSlowFrame) * fieldCount);
 
                 if (options.debug) {
-                    fprintf(csvFile, "S frame: ");
-                    outputSlowFrameFields(log, bufferedSlowFrame);
-                    fprintf(csvFile, "\n");
+                    csvWriterWriteString(context->csv, "S frame: ");
+                    outputSlowFrameFields(log, context->bufferedSlowFrame);
+                    csvWriterWriteChar(context->csv, '\n');
                 }
             }
         break;
@@ -722,18 +849,18 @@ void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t fra
                 if (frameValid) {
                     updateFrameStatistics(log, frame);
 
-                    updateSimulations(log, frame, lastFrameTime);
+                    updateSimulations(log, frame, context->lastFrameTime);
 
-                    lastFrameIteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
-                    lastFrameTime = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+                    context->lastFrameIteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+                    context->lastFrameTime = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
                 }
 
                 outputMainFrameFields(log, frameValid ? frame[FLIGHT_LOG_FIELD_INDEX_TIME] : -1, frame);
 
                 if (options.debug) {
-                    fprintf(csvFile, ", %c, offset %d, size %d\n", (char) frameType, frameOffset, frameSize);
+                    csvWriterPrintf(context->csv, ", %c, offset %" PRId64 ", size %d\n", (char) frameType, frameOffset, frameSize);
                 } else {
-                    fprintf(csvFile, "\n");
+                    csvWriterWriteChar(context->csv, '\n');
 				}
             } else if (options.debug) {
                 // Print to stdout so that these messages line up with our other output on stdout (stderr isn't synchronised to it)
@@ -742,158 +869,207 @@ void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t fra
                      * We'll assume that the frame's iteration count is still fairly sensible (if an earlier frame was corrupt,
                      * the frame index will be smaller than it should be)
                      */
-                    fprintf(csvFile, "%c Frame unusuable due to prior corruption, offset %d, size %d\n", (char) frameType, frameOffset, frameSize);
+                    csvWriterPrintf(context->csv, "%c Frame unusuable due to prior corruption, offset %" PRId64 ", size %d\n", (char) frameType, frameOffset, frameSize);
                 } else {
-                    fprintf(csvFile, "Failed to decode %c frame, offset %d, size %d\n", (char) frameType, frameOffset, frameSize);
+                    csvWriterPrintf(context->csv, "Failed to decode %c frame, offset %" PRId64 ", size %d\n", (char) frameType, frameOffset, frameSize);
                 }
             }
         break;
     }
 }
 
-void resetGPSFieldIdents()
-{
-    for (int i = 0; i < FLIGHT_LOG_MAX_FIELDS; i++) {
-        gpsFieldTypes[i] = GPS_FIELD_TYPE_INTEGER;
-    }
-}
-
 /**
- * Sets the units/display format we should use for each GPS field into the global `gpsFieldTypes`.
+ * Sets the units/display format we should use for each GPS field into the context's `gpsFieldTypes`.
  */
 void identifyGPSFields(flightLog_t *log)
 {
+    decodeContext_t *context = log->userData;
     int i;
 
     for (i = 0; i < log->frameDefs['G'].fieldCount; i++) {
         const char *fieldName = log->frameDefs['G'].fieldName[i];
 
         if (strcmp(fieldName, "GPS_coord[0]") == 0) {
-            gpsFieldTypes[i] = GPS_FIELD_TYPE_COORDINATE_DEGREES_TIMES_10000000;
+            context->gpsFieldTypes[i] = GPS_FIELD_TYPE_COORDINATE_DEGREES_TIMES_10000000;
         } else if (strcmp(fieldName, "GPS_coord[1]") == 0) {
-            gpsFieldTypes[i] = GPS_FIELD_TYPE_COORDINATE_DEGREES_TIMES_10000000;
+            context->gpsFieldTypes[i] = GPS_FIELD_TYPE_COORDINATE_DEGREES_TIMES_10000000;
         } else if (strcmp(fieldName, "GPS_altitude") == 0) {
-            gpsFieldTypes[i] = GPS_FIELD_TYPE_METERS;
+            context->gpsFieldTypes[i] = GPS_FIELD_TYPE_METERS;
         } else if (strcmp(fieldName, "GPS_speed") == 0) {
-            gpsFieldTypes[i] = GPS_FIELD_TYPE_METERS_PER_SECOND_TIMES_100;
+            context->gpsFieldTypes[i] = GPS_FIELD_TYPE_METERS_PER_SECOND_TIMES_100;
         } else if (strcmp(fieldName, "GPS_ground_course") == 0) {
-            gpsFieldTypes[i] = GPS_FIELD_TYPE_DEGREES_TIMES_10;
+            context->gpsFieldTypes[i] = GPS_FIELD_TYPE_DEGREES_TIMES_10;
         } else {
-            gpsFieldTypes[i] = GPS_FIELD_TYPE_INTEGER;
+            context->gpsFieldTypes[i] = GPS_FIELD_TYPE_INTEGER;
         }
     }
 }
 
 /**
  * After reading in what fields are present, this routine is called in order to apply the user's
- * commandline choices for field units to the global "mainFieldUnit" and "gpsGFieldUnit" arrays.
+ * commandline choices for field units to the context's "mainFieldUnit" and "gpsGFieldUnit" arrays.
  */
 void applyFieldUnits(flightLog_t *log)
 {
+    decodeContext_t *context = log->userData;
+
+    // The arrays begin zeroed
     if (options.raw) {
-        for (int i = 0; i < FLIGHT_LOG_MAX_FIELDS; i++) {
-            mainFieldUnit[i] = UNIT_RAW;
-            gpsGFieldUnit[i] = UNIT_RAW;
-            slowFieldUnit[i] = UNIT_RAW;
+        for (int i = 0; i < log->frameDefs['I'].fieldCount; i++) {
+            context->mainFieldUnit[i] = UNIT_RAW;
+        }
+        for (int i = 0; i < log->frameDefs['G'].fieldCount; i++) {
+            context->gpsGFieldUnit[i] = UNIT_RAW;
+        }
+        for (int i = 0; i < log->frameDefs['S'].fieldCount; i++) {
+            context->slowFieldUnit[i] = UNIT_RAW;
         }
     } else {
-        memset(mainFieldUnit, 0, sizeof(mainFieldUnit));
-        memset(gpsGFieldUnit, 0, sizeof(gpsGFieldUnit));
-        memset(slowFieldUnit, 0, sizeof(slowFieldUnit));
-    
         if (log->mainFieldIndexes.vbatLatest > -1) {
-            mainFieldUnit[log->mainFieldIndexes.vbatLatest] = options.unitVbat;
+            context->mainFieldUnit[log->mainFieldIndexes.vbatLatest] = options.unitVbat;
         }
 
         if (log->mainFieldIndexes.amperageLatest > -1) {
-            mainFieldUnit[log->mainFieldIndexes.amperageLatest] = options.unitAmperage;
+            context->mainFieldUnit[log->mainFieldIndexes.amperageLatest] = options.unitAmperage;
         }
 
         if (log->mainFieldIndexes.BaroAlt > -1) {
-            mainFieldUnit[log->mainFieldIndexes.BaroAlt] = options.unitHeight;
+            context->mainFieldUnit[log->mainFieldIndexes.BaroAlt] = options.unitHeight;
         }
 
         if (log->mainFieldIndexes.time > -1) {
-            mainFieldUnit[log->mainFieldIndexes.time] = options.unitFrameTime;
+            context->mainFieldUnit[log->mainFieldIndexes.time] = options.unitFrameTime;
         }
 
         if (log->gpsFieldIndexes.GPS_speed > -1) {
-            gpsGFieldUnit[log->gpsFieldIndexes.GPS_speed] = options.unitGPSSpeed;
+            context->gpsGFieldUnit[log->gpsFieldIndexes.GPS_speed] = options.unitGPSSpeed;
         }
 
         for (int i = 0; i < 3; i++) {
             if (log->mainFieldIndexes.accSmooth[i] > -1) {
-                mainFieldUnit[log->mainFieldIndexes.accSmooth[i]] = options.unitAcceleration;
+                context->mainFieldUnit[log->mainFieldIndexes.accSmooth[i]] = options.unitAcceleration;
             }
 
             if (log->mainFieldIndexes.gyroADC[i] > -1) {
-                mainFieldUnit[log->mainFieldIndexes.gyroADC[i]] = options.unitRotation;
+                context->mainFieldUnit[log->mainFieldIndexes.gyroADC[i]] = options.unitRotation;
             }
         }
 
         // Slow frame fields:
         if (log->slowFieldIndexes.flightModeFlags > -1) {
-            slowFieldUnit[log->slowFieldIndexes.flightModeFlags] = options.unitFlags;
+            context->slowFieldUnit[log->slowFieldIndexes.flightModeFlags] = options.unitFlags;
         }
         if (log->slowFieldIndexes.stateFlags > -1) {
-            slowFieldUnit[log->slowFieldIndexes.stateFlags] = options.unitFlags;
+            context->slowFieldUnit[log->slowFieldIndexes.stateFlags] = options.unitFlags;
         }
         if (log->slowFieldIndexes.failsafePhase > -1) {
-            slowFieldUnit[log->slowFieldIndexes.failsafePhase] = options.unitFlags;
+            context->slowFieldUnit[log->slowFieldIndexes.failsafePhase] = options.unitFlags;
         }
     }
 }
 
 void writeMainCSVHeader(flightLog_t *log)
 {
+    decodeContext_t *context = log->userData;
     int i;
 
     for (i = 0; i < log->frameDefs['I'].fieldCount; i++) {
         if (i > 0)
-            fprintf(csvFile, ", ");
+            csvWriterWriteString(context->csv, ", ");
 
-        fprintf(csvFile, "%s", log->frameDefs['I'].fieldName[i]);
+        csvWriterWriteString(context->csv, log->frameDefs['I'].fieldName[i]);
 
-        if (mainFieldUnit[i] != UNIT_RAW) {
-            fprintf(csvFile, " (%s)", UNIT_NAME[mainFieldUnit[i]]);
+        if (context->mainFieldUnit[i] != UNIT_RAW) {
+            csvWriterPrintf(context->csv, " (%s)", UNIT_NAME[context->mainFieldUnit[i]]);
         }
     }
 
-    if (options.simulateIMU) {
-        fprintf(csvFile, ", roll, pitch, heading");
+    if (context->simulateIMU) {
+        csvWriterWriteString(context->csv, ", roll, pitch, heading");
     }
 
     if (log->mainFieldIndexes.amperageLatest != -1) {
-        fprintf(csvFile, ", energyCumulative (mAh)");
+        csvWriterWriteString(context->csv, ", energyCumulative (mAh)");
     }
 
     if (options.simulateCurrentMeter) {
-        fprintf(csvFile, ", currentVirtual (%s), energyCumulativeVirtual (mAh)", UNIT_NAME[options.unitAmperage]);
+        csvWriterPrintf(context->csv, ", currentVirtual (%s), energyCumulativeVirtual (mAh)", UNIT_NAME[options.unitAmperage]);
+    }
+
+    if (options.timeStart > 0 && (log->mainFieldIndexes.amperageLatest != -1 || options.simulateCurrentMeter)) {
+        fprintf(context->messages, "Warning: Energy used before --start isn't known, so the energyCumulative columns will be empty.\n");
     }
 
     if (log->frameDefs['S'].fieldCount > 0) {
-        fprintf(csvFile, ", ");
+        csvWriterWriteString(context->csv, ", ");
 
-        outputFieldNamesHeader(csvFile, &log->frameDefs['S'], slowFieldUnit, false);
+        outputFieldNamesHeader(context->csv, &log->frameDefs['S'], context->slowFieldUnit, false);
     }
 
     if (options.mergeGPS && log->frameDefs['G'].fieldCount > 0) {
-        fprintf(csvFile, ", ");
+        csvWriterWriteString(context->csv, ", ");
+
+        outputFieldNamesHeader(context->csv, &log->frameDefs['G'], context->gpsGFieldUnit, true);
+    }
+
+    csvWriterWriteChar(context->csv, '\n');
+}
+
+static void* allocateFieldArray(int fieldCount, size_t elementSize)
+{
+    // Leave room for at least one element so that we always get a pointer
+    void *array = calloc(fieldCount + 1, elementSize);
 
-        outputFieldNamesHeader(csvFile, &log->frameDefs['G'], gpsGFieldUnit, true);
+    if (!array) {
+        fprintf(stderr, "Failed to allocate memory for decoding\n");
+        exit(-1);
     }
 
-    fprintf(csvFile, "\n");
+    return array;
+}
+
+static void freeFieldArrays(decodeContext_t *context)
+{
+    free(context->gpsFieldTypes);
+    free(context->mainFieldUnit);
+    free(context->gpsGFieldUnit);
+    free(context->slowFieldUnit);
+    free(context->bufferedSlowFrame);
+    free(context->bufferedMainFrame);
+    free(context->bufferedGPSFrame);
+}
+
+/**
+ * Size the context's per-field arrays for the frames that the log defines, zeroing them.
+ */
+static void allocateFieldArrays(flightLog_t *log)
+{
+    decodeContext_t *context = log->userData;
+    int mainFieldCount = log->frameDefs['I'].fieldCount, gpsFieldCount = log->frameDefs['G'].fieldCount, slowFieldCount = log->frameDefs['S'].fieldCount;
+
+    freeFieldArrays(context);
+
+    context->gpsFieldTypes = allocateFieldArray(gpsFieldCount, sizeof(*context->gpsFieldTypes));
+    context->mainFieldUnit = allocateFieldArray(mainFieldCount, sizeof(*context->mainFieldUnit));
+    context->gpsGFieldUnit = allocateFieldArray(gpsFieldCount, sizeof(*context->gpsGFieldUnit));
+    context->slowFieldUnit = allocateFieldArray(slowFieldCount, sizeof(*context->slowFieldUnit));
+    context->bufferedSlowFrame = allocateFieldArray(slowFieldCount, sizeof(*context->bufferedSlowFrame));
+    context->bufferedMainFrame = allocateFieldArray(mainFieldCount, sizeof(*context->bufferedMainFrame));
+    context->bufferedGPSFrame = allocateFieldArray(gpsFieldCount, sizeof(*context->bufferedGPSFrame));
 }
 
 void onMetadataReady(flightLog_t *log)
 {
+    decodeContext_t *context = log->userData;
+
+    allocateFieldArrays(log);
+
     if (log->frameDefs['I'].fieldCount == 0) {
-        fprintf(stderr, "No fields found in log, is it missing its header?\n");
+        fprintf(context->messages, "No fields found in log, is it missing its header?\n");
         return;
-    } else if (options.simulateIMU && (log->mainFieldIndexes.accSmooth[0] == -1 || log->mainFieldIndexes.gyroADC[0] == -1)){
-        fprintf(stderr, "Can't simulate the IMU because accelerometer or gyroscope data is missing\n");
-        options.simulateIMU = false;
+    } else if (context->simulateIMU && (log->mainFieldIndexes.accSmooth[0] == -1 || log->mainFieldIndexes.gyroADC[0] == -1)){
+        fprintf(context->messages, "Can't simulate the IMU because accelerometer or gyroscope data is missing\n");
+        context->simulateIMU = false;
     }
 
     identifyGPSFields(log);
@@ -904,10 +1080,11 @@ void onMetadataReady(flightLog_t *log)
 
 void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
 {
+    decodeContext_t *context = log->userData;
     flightLogStatistics_t *stats = &log->stats;
     uint32_t intervalMS = (uint32_t) ((stats->field[FLIGHT_LOG_FIELD_INDEX_TIME].max - stats->field[FLIGHT_LOG_FIELD_INDEX_TIME].min) / 1000);
 
-    uint32_t goodBytes = stats->frame['I'].bytes + stats->frame['P'].bytes;
+    uint64_t goodBytes = stats->frame['I'].bytes + stats->frame['P'].bytes;
     uint32_t goodFrames = stats->frame['I'].validCount + stats->frame['P'].validCount;
     uint32_t totalFrames = (uint32_t) (stats->field[FLIGHT_LOG_FIELD_INDEX_ITERATION].max - stats->field[FLIGHT_LOG_FIELD_INDEX_ITERATION].min + 1);
     int32_t missingFrames = totalFrames - goodFrames - stats->intentionallyAbsentIterations;
@@ -941,75 +1118,84 @@ void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
     endTimeMins = endTimeSecs / 60;
     endTimeSecs %= 60;
 
-    fprintf(stderr, "\nLog %d of %d", logIndex + 1, log->logCount);
+    if (log->private->stream->source) {
+        // We don't know how many logs there are until we've read them all
+        fprintf(context->messages, "\nLog %d", logIndex + 1);
+    } else {
+        fprintf(context->messages, "\nLog %d of %d", logIndex + 1, log->logCount);
+    }
 
     if (intervalMS > 0 && !raw) {
-        fprintf(stderr, ", start %02d:%02d.%03d, end %02d:%02d.%03d, duration %02d:%02d.%03d\n\n",
+        fprintf(context->messages, ", start %02d:%02d.%03d, end %02d:%02d.%03d, duration %02d:%02d.%03d\n\n",
             startTimeMins, startTimeSecs, startTimeMS,
             endTimeMins, endTimeSecs, endTimeMS,
             runningTimeMins, runningTimeSecs, runningTimeMS
         );
     }
 
-    fprintf(stderr, "Statistics\n");
+    fprintf(context->messages, "Statistics\n");
 
-    if (seriesStats_getCount(&looptimeStats) > 0) {
-        fprintf(stderr, "Looptime %14d avg %14.1f std dev (%.1f%%)\n", (int) seriesStats_getMean(&looptimeStats),
-            seriesStats_getStandardDeviation(&looptimeStats), seriesStats_getStandardDeviation(&looptimeStats) / seriesStats_getMean(&looptimeStats) * 100);
+    if (seriesStats_getCount(&context->looptimeStats) > 0) {
+        fprintf(context->messages, "Looptime %14d avg %14.1f std dev (%.1f%%)\n", (int) seriesStats_getMean(&context->looptimeStats),
+            seriesStats_getStandardDeviation(&context->looptimeStats), seriesStats_getStandardDeviation(&context->looptimeStats) / seriesStats_getMean(&context->looptimeStats) * 100);
     }
 
     for (i = 0; i < (int) sizeof(frameTypes); i++) {
         uint8_t frameType = frameTypes[i];
 
         if (stats->frame[frameType].validCount ) {
-            fprintf(stderr, "%c frames %7d %6.1f bytes avg %8d bytes total\n", (char) frameType, stats->frame[frameType].validCount,
+            fprintf(context->messages, "%c frames %7d %6.1f bytes avg %8" PRIu64 " bytes total\n", (char) frameType, stats->frame[frameType].validCount,
                 (float) stats->frame[frameType].bytes / stats->frame[frameType].validCount, stats->frame[frameType].bytes);
         }
     }
 
     if (goodFrames) {
-        fprintf(stderr, "Frames %9d %6.1f bytes avg %8d bytes total\n", goodFrames, (float) goodBytes / goodFrames, goodBytes);
+        fprintf(context->messages, "Frames %9d %6.1f bytes avg %8" PRIu64 " bytes total\n", goodFrames, (float) goodBytes / goodFrames, goodBytes);
     } else {
-        fprintf(stderr, "Frames %8d\n", 0);
+        fprintf(context->messages, "Frames %8d\n", 0);
     }
 
     if (intervalMS > 0 && !raw) {
-        fprintf(stderr, "Data rate %4uHz %6u bytes/s %10u baud\n",
+        fprintf(context->messages, "Data rate %4uHz %6" PRIu64 " bytes/s %10" PRIu64 " baud\n",
             (unsigned int) (((int64_t) goodFrames * 1000) / intervalMS),
-            (unsigned int) (((int64_t) stats->totalBytes * 1000) / intervalMS),
-            (unsigned int) ((((int64_t) stats->totalBytes * 1000 * (8 + 1 + 1)) / intervalMS + 100 - 1) / 100 * 100)); /* Round baud rate up to nearest 100 */
+            (stats->totalBytes * 1000) / intervalMS,
+            ((stats->totalBytes * 1000 * (8 + 1 + 1)) / intervalMS + 100 - 1) / 100 * 100); /* Round baud rate up to nearest 100 */
     } else {
-        fprintf(stderr, "Data rate: Unknown, no timing information available.\n");
+        fprintf(context->messages, "Data rate: Unknown, no timing information available.\n");
     }
 
-    if (totalFrames && (stats->totalCorruptFrames || missingFrames || stats->intentionallyAbsentIterations)) {
-        fprintf(stderr, "\n");
+    if (totalFrames && (stats->totalCorruptFrames || missingFrames || stats->intentionallyAbsentIterations || stats->resyncCount)) {
+        fprintf(context->messages, "\n");
 
         if (stats->totalCorruptFrames || stats->frame['P'].desyncCount || stats->frame['I'].desyncCount) {
-            fprintf(stderr, "%d frames failed to decode, rendering %d loop iterations unreadable. ", stats->totalCorruptFrames, stats->frame['P'].desyncCount + stats->frame['P'].corruptCount + stats->frame['I'].desyncCount + stats->frame['I'].corruptCount);
+            fprintf(context->messages, "%d frames failed to decode, rendering %d loop iterations unreadable. ", stats->totalCorruptFrames, stats->frame['P'].desyncCount + stats->frame['P'].corruptCount + stats->frame['I'].desyncCount + stats->frame['I'].corruptCount);
             if (!missingFrames)
-                fprintf(stderr, "\n");
+                fprintf(context->messages, "\n");
         }
         if (missingFrames) {
-            fprintf(stderr, "%d iterations are missing in total (%ums, %.2f%%)\n",
+            fprintf(context->messages, "%d iterations are missing in total (%ums, %.2f%%)\n",
                 missingFrames,
                 (unsigned int) (((int64_t) missingFrames * intervalMS) / totalFrames),
                 (double) missingFrames / totalFrames * 100);
         }
         if (stats->intentionallyAbsentIterations) {
-            fprintf(stderr, "%d loop iterations weren't logged because of your blackbox_rate settings (%ums, %.2f%%)\n",
+            fprintf(context->messages, "%d loop iterations weren't logged because of your blackbox_rate settings (%ums, %.2f%%)\n",
                 stats->intentionallyAbsentIterations,
                 (unsigned int) (((int64_t)stats->intentionallyAbsentIterations * intervalMS) / totalFrames),
                 (double) stats->intentionallyAbsentIterations / totalFrames * 100);
         }
+        if (stats->resyncCount) {
+            fprintf(context->messages, "Lost track of the frames %u times, skipped %" PRIu64 " bytes to resynchronise (%u candidate I-frames rejected)\n",
+                stats->resyncCount, stats->resyncSkippedBytes, stats->resyncRejectedCandidates);
+        }
     }
 
     if (limits) {
-        fprintf(stderr, "\n\n    Field name          Min          Max        Range\n");
-        fprintf(stderr,     "-----------------------------------------------------\n");
+        fprintf(context->messages, "\n\n    Field name          Min          Max        Range\n");
+        fprintf(context->messages,     "-----------------------------------------------------\n");
 
         for (i = 0; i < log->frameDefs['I'].fieldCount; i++) {
-            fprintf(stderr, "%14s %12" PRId64 " %12" PRId64 " %12" PRId64 "\n",
+            fprintf(context->messages, "%14s %12" PRId64 " %12" PRId64 " %12" PRId64 "\n",
                 log->frameDefs['I'].fieldName[i],
                 stats->field[i].min,
                 stats->field[i].max,
@@ -1018,43 +1204,67 @@ void printStats(flightLog_t *log, int logIndex, bool raw, bool limits)
         }
     }
 
-    fprintf(stderr, "\n");
+    fprintf(context->messages, "\n");
 }
 
-void resetParseState() {
-    if (options.simulateIMU) {
-        imuInit();
-    }
+void resetParseState(decodeContext_t *context) {
+    imuInit(&context->imu);
 
     if (options.mergeGPS) {
-        haveBufferedMainFrame = false;
-        bufferedFrameTime = -1;
-        bufferedFrameIteration = (uint32_t) -1;
-        memset(bufferedGPSFrame, 0, sizeof(bufferedGPSFrame));
-        memset(bufferedMainFrame, 0, sizeof(bufferedMainFrame));
+        context->haveBufferedMainFrame = false;
+        context->bufferedFrameTime = -1;
+        context->bufferedFrameIteration = (uint32_t) -1;
     }
 
-    memset(bufferedSlowFrame, 0, sizeof(bufferedSlowFrame));
+    context->lastFrameIteration = (uint32_t) -1;
+    context->lastFrameTime = -1;
+
+    seriesStats_init(&context->looptimeStats);
+}
 
-    lastFrameIteration = (uint32_t) -1;
-    lastFrameTime = -1;
+/**
+ * Is this (e.g. ".gz") the extension of a file compressed in a format we can decompress?
+ */
+static bool isCompressedLogExtension(const char *extension)
+{
+    static const char *COMPRESSED_EXTENSIONS[] = {".gz", ".zst", ".xz"};
+
+    for (unsigned int i = 0; i < ARRAY_LENGTH(COMPRESSED_EXTENSIONS); i++) {
+        const char *expected = COMPRESSED_EXTENSIONS[i];
+        const char *actual = extension;
+
+        while (*expected && tolower((unsigned char) *actual) == *expected) {
+            expected++;
+            actual++;
+        }
 
-    seriesStats_init(&looptimeStats);
+        if (!*expected && !*actual) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
+/**
+ * Decode the log with the given index to CSV (plus the GPS and event files that go alongside), printing messages about
+ * it to `messages`.
+ */
+int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex, FILE *messages)
 {
-    // Organise output files/streams
-    gpx = NULL;
+    decodeContext_t *context = calloc(1, sizeof(*context));
 
-    gpsCsvFile = NULL;
-    gpsCsvFilename = NULL;
+    context->filename = filename;
+    context->logIndex = logIndex;
+    context->messages = messages;
+    context->simulateIMU = options.simulateIMU;
 
-    eventFile = NULL;
-    eventFilename = NULL;
+    log->userData = context;
+    log->messages = messages;
 
+    // Organise output files/streams
     if (options.toStdout) {
-        csvFile = stdout;
+        context->csvFile = stdout;
     } else {
         char *csvFilename = 0, *gpxFilename = 0;
         int filenameLen;
@@ -1071,6 +1281,19 @@ int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
 
             if (fileExtensionPeriod) {
                 logNameEnd = fileExtensionPeriod;
+
+                // For compressed logs like "LOG00001.BFL.gz", drop the log's own extension too
+                if (isCompressedLogExtension(fileExtensionPeriod)) {
+                    const char *innerPeriod = fileExtensionPeriod;
+
+                    while (innerPeriod > filename && *(innerPeriod - 1) != '.' && *(innerPeriod - 1) != '/' && *(innerPeriod - 1) != '\\') {
+                        innerPeriod--;
+                    }
+
+                    if (innerPeriod > filename && *(innerPeriod - 1) == '.') {
+                        logNameEnd = innerPeriod - 1;
+                    }
+                }
             } else {
                 logNameEnd = filename + strlen(filename);
             }
@@ -1090,59 +1313,80 @@ int decodeFlightLog(flightLog_t *log, const char *filename, int logIndex)
         snprintf(gpxFilename, filenameLen, "%.*s.%02d.gps.gpx", outputPrefixLen, outputPrefix, logIndex + 1);
 
         filenameLen = outputPrefixLen + strlen(".00.gps.csv") + 1;
-        gpsCsvFilename = malloc(filenameLen * sizeof(char));
+        context->gpsCsvFilename = malloc(filenameLen * sizeof(char));
 
-        snprintf(gpsCsvFilename, filenameLen, "%.*s.%02d.gps.csv", outputPrefixLen, outputPrefix, logIndex + 1);
+        snprintf(context->gpsCsvFilename, filenameLen, "%.*s.%02d.gps.csv", outputPrefixLen, outputPrefix, logIndex + 1);
 
         filenameLen = outputPrefixLen + strlen(".00.event") + 1;
-        eventFilename = malloc(filenameLen * sizeof(char));
+        context->eventFilename = malloc(filenameLen * sizeof(char));
 
-        snprintf(eventFilename, filenameLen, "%.*s.%02d.event", outputPrefixLen, outputPrefix, logIndex + 1);
+        snprintf(context->eventFilename, filenameLen, "%.*s.%02d.event", outputPrefixLen, outputPrefix, logIndex + 1);
 
-        csvFile = fopen(csvFilename, "wb");
+        context->csvFile = fopen(csvFilename, "wb");
 
-        if (!csvFile) {
-            fprintf(stderr, "Failed to create output file %s\n", csvFilename);
+        if (!context->csvFile) {
+            fprintf(messages, "Failed to create output file %s\n", csvFilename);
 
             free(csvFilename);
+            free(gpxFilename);
+            free(context->gpsCsvFilename);
+            free(context->eventFilename);
+            free(context);
+            log->userData = NULL;
+            log->messages = stderr;
+
             return -1;
         }
 
-        fprintf(stderr, "Decoding log '%s' to '%s'...\n", filename, csvFilename);
+        fprintf(messages, "Decoding log '%s' to '%s'...\n", filename, csvFilename);
         free(csvFilename);
 
-        gpx = gpxWriterCreate(gpxFilename);
+        context->gpx = gpxWriterCreate(gpxFilename);
         free(gpxFilename);
     }
 
-    resetParseState();
+    context->csv = csvWriterCreate(context->csvFile);
 
-    if ((log->private->stream->mapping.stats.st_mode & S_IFMT) == S_IFCHR) { //prime data buffer with data
-        fillSerialBuffer(log->private->stream, FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH, NULL);
-    }
+    resetParseState(context);
+
+    int success;
 
-    int success = flightLogParse(log, logIndex, onMetadataReady, onFrameReady, onEvent, options.raw);
+    if (options.timeStart > 0 || options.timeEnd != -1) {
+        success = flightLogParseTimeRange(log, logIndex, options.timeStart, options.timeEnd, onMetadataReady, onFrameReady, onEvent, options.raw, options.threads);
+    } else {
+        success = flightLogParseParallel(log, logIndex, onMetadataReady, onFrameReady, onEvent, options.raw, options.threads);
+    }
 
-    if (options.mergeGPS && haveBufferedMainFrame) {
+    if (options.mergeGPS && context->haveBufferedMainFrame) {
         // Print out last log entry that wasn't already printed
         outputMergeFrame(log);
     }
 
+    // Write out the rest of the buffered CSV before the stats are printed
+    csvWriterDestroy(context->csv);
+    context->csv = NULL;
+
     if (success)
         printStats(log, logIndex, options.raw, options.limits);
 
     if (!options.toStdout)
-        fclose(csvFile);
+        fclose(context->csvFile);
 
-    free(eventFilename);
-    if (eventFile)
-        fclose(eventFile);
+    free(context->eventFilename);
+    if (context->eventFile)
+        fclose(context->eventFile);
 
-    free(gpsCsvFilename);
-    if (gpsCsvFile)
-        fclose(gpsCsvFile);
+    free(context->gpsCsvFilename);
+    csvWriterDestroy(context->gpsCsv);
+    if (context->gpsCsvFile)
+        fclose(context->gpsCsvFile);
 
-    gpxWriterDestroy(gpx);
+    gpxWriterDestroy(context->gpx);
+
+    freeFieldArrays(context);
+    free(context);
+    log->userData = NULL;
+    log->messages = stderr;
 
     return success ? 0 : -1;
 }
@@ -1165,13 +1409,249 @@ int validateLogIndex(flightLog_t *log)
 
         fprintf(stderr, "Index  Start offset  Size (bytes)\n");
         for (int i = 0; i < log->logCount; i++) {
-            fprintf(stderr, "%5d %13d %13d\n", i + 1, (int) (log->logBegin[i] - log->logBegin[0]), (int) (log->logBegin[i + 1] - log->logBegin[i]));
+            fprintf(stderr, "%5d %13" PRId64 " %13" PRId64 "\n", i + 1, (int64_t) (log->logBegin[i] - log->logBegin[0]), (int64_t) (log->logBegin[i + 1] - log->logBegin[i]));
         }
 
         return -1;
     }
 }
 
+/**
+ * Open the log with a new parser, which is needed to decode another log from the same file at the same time.
+ *
+ * Returns NULL if the file couldn't be opened, with the file descriptor closed again.
+ */
+static flightLog_t* openLogCopy(const char *filename, int *fd)
+{
+    flightLog_t *log;
+
+    *fd = open(filename, O_RDONLY);
+
+    if (*fd < 0)
+        return NULL;
+
+    log = flightLogCreate(*fd);
+
+    if (!log) {
+        close(*fd);
+    }
+
+    return log;
+}
+
+static void runDecodeJob(void *workerData, void *data)
+{
+    decodeJob_t *job = (decodeJob_t *) data;
+    flightLog_t *log = job->file->log;
+    int fd = -1;
+
+    (void) workerData;
+
+    if (!job->useFileLog) {
+        log = openLogCopy(job->file->filename, &fd);
+
+        if (!log) {
+            fprintf(job->messages, "Failed to open log file '%s' to decode log %d\n\n", job->file->filename, job->logIndex + 1);
+            semaphore_signal(&job->done);
+            return;
+        }
+
+        flightLogAttachIndex(log, job->file->index);
+    }
+
+    decodeFlightLog(log, job->file->filename, job->logIndex, job->messages);
+
+    if (!job->useFileLog) {
+        flightLogDestroy(log);
+        close(fd);
+    }
+
+    semaphore_signal(&job->done);
+}
+
+/**
+ * Save the file's index if we were asked to and added anything to it, then close the file.
+ */
+static void closeDecodeFile(decodeFile_t *file)
+{
+    if (options.saveIndex && file->index && flightLogIndexModified(file->index)) {
+        // Not being able to write the index (e.g. the log is on read-only media) doesn't stop us from decoding
+        flightLogIndexSave(file->index, file->indexFilename);
+    }
+
+    flightLogIndexDestroy(file->index);
+    free(file->indexFilename);
+
+    if (file->serialInput && options.debug) {
+        serialInputStats_t stats;
+
+        serialInputGetStats(file->serialInput, &stats);
+
+        fprintf(stderr, "Serial input: %" PRIu64 " bytes read, up to %zu bytes were waiting to be decoded, the buffer filled %" PRIu32 " times\n",
+            stats.bytesRead, stats.peakBuffered, stats.overflows);
+    }
+
+    flightLogDestroy(file->log);
+    close(file->fd);
+
+    free(file);
+}
+
+/**
+ * Wait for the job to complete, then print its messages and release it (along with its file if it was the last job
+ * for that file).
+ */
+static void finishDecodeJob(decodeJob_t *job)
+{
+    decodeFile_t *file = job->file;
+
+    semaphore_wait(&job->done);
+    semaphore_destroy(&job->done);
+
+    if (job->messages != stderr) {
+        char buffer[4096];
+        size_t length;
+
+        rewind(job->messages);
+
+        while ((length = fread(buffer, 1, sizeof(buffer), job->messages)) > 0) {
+            fwrite(buffer, 1, length, stderr);
+        }
+
+        fclose(job->messages);
+    }
+
+    free(job);
+
+    file->jobsRemaining--;
+
+    if (file->jobsRemaining == 0) {
+        closeDecodeFile(file);
+    }
+}
+
+/**
+ * Decode the logs of a file, either right here or by handing them to the worker pool. Jobs are added to the queue of
+ * pending jobs in order so that their messages can be printed in order.
+ */
+static void submitDecodeJobs(decodeJobQueue_t *queue, decodeFile_t *file, int firstLog, int lastLog)
+{
+    file->jobsRemaining = lastLog - firstLog + 1;
+
+    for (int logIndex = firstLog; logIndex <= lastLog; logIndex++) {
+        decodeJob_t *job = (decodeJob_t *) malloc(sizeof(*job));
+
+        job->file = file;
+        job->logIndex = logIndex;
+        // With a single worker the logs are decoded one after the other, so they can share the parser we opened
+        job->useFileLog = !queue->pool || logIndex == firstLog;
+
+        semaphore_create(&job->done, 0);
+
+        if (!queue->pool) {
+            job->messages = stderr;
+
+            runDecodeJob(NULL, job);
+            finishDecodeJob(job);
+
+            continue;
+        }
+
+        if (queue->count == queue->capacity) {
+            finishDecodeJob(queue->jobs[queue->head]);
+
+            queue->head = (queue->head + 1) % queue->capacity;
+            queue->count--;
+        }
+
+        // Hold onto the messages until the jobs before this one have printed theirs
+        job->messages = tmpfile();
+
+        if (!job->messages) {
+            job->messages = stderr;
+        }
+
+        queue->jobs[(queue->head + queue->count) % queue->capacity] = job;
+        queue->count++;
+
+        workerpool_submit(queue->pool, job);
+    }
+}
+
+/**
+ * Called when a log that's still being recorded (see --follow) has been decoded as far as it's been written, so that
+ * everything decoded so far can be seen in the output files while we wait for more.
+ */
+static void flushDecodeOutput(void *data)
+{
+    flightLog_t *log = (flightLog_t *) data;
+    decodeContext_t *context = (decodeContext_t *) log->userData;
+
+    if (!context) {
+        return;
+    }
+
+    if (context->csv) {
+        csvWriterFlush(context->csv);
+        fflush(context->csvFile);
+    }
+
+    if (context->gpsCsv) {
+        csvWriterFlush(context->gpsCsv);
+        fflush(context->gpsCsvFile);
+    }
+
+    if (context->eventFile) {
+        fflush(context->eventFile);
+    }
+
+    if (context->gpx && context->gpx->file) {
+        fflush(context->gpx->file);
+    }
+}
+
+/**
+ * Decode the logs of a file that's read as it arrives (from a pipe, standard input, a serial port, or a file that's
+ * still being recorded with --follow). We only find each log once we've read the one before it, so they're decoded one
+ * after the other right here.
+ */
+static void decodeStreamedLogs(decodeFile_t *file)
+{
+    flightLog_t *log = file->log;
+    int logIndex = 0;
+
+    do {
+        if (options.logNumber > 0 && logIndex != options.logNumber - 1) {
+            // Read past the logs before the one that the user chose
+            flightLogParse(log, logIndex, NULL, NULL, NULL, false);
+        } else {
+            decodeFlightLog(log, file->filename, logIndex, stderr);
+
+            if (options.logNumber > 0) {
+                break;
+            }
+        }
+
+        logIndex++;
+    } while (flightLogBeginNextLog(log));
+
+    if (options.logNumber > log->logCount) {
+        fprintf(stderr, "Couldn't load log #%d from this file, because there are only %d logs in total.\n", options.logNumber, log->logCount);
+    }
+
+    closeDecodeFile(file);
+}
+
+static void finishAllDecodeJobs(decodeJobQueue_t *queue)
+{
+    while (queue->count > 0) {
+        finishDecodeJob(queue->jobs[queue->head]);
+
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+}
+
 void printUsage(const char *argv0)
 {
     fprintf(stderr,
@@ -1182,10 +1662,14 @@ void printUsage(const char *argv0)
             __DATE__ " " __TIME__ ")\n\n"
         "Usage:\n"
         "     %s [options] <input logs>\n\n"
+        "Use - as the name of an input log to read it from standard input.\n"
+        "Logs compressed with gzip, zstd or xz are decompressed automatically.\n\n"
         "Options:\n"
         "   --help                   This page\n"
         "   --index <num>            Choose the log from the file that should be decoded (or omit to decode all)\n"
         "   --limits                 Print the limits and range of each field\n"
+        "   --start <time>           Only decode the log from this time onwards (seconds or mm:ss, from the start of the log)\n"
+        "   --end <time>             Only decode the log up until this time\n"
         "   --stdout                 Write log to stdout instead of to a file\n"
         "   --unit-amperage <unit>   Current meter unit (raw|mA|A), default is A (amps)\n"
         "   --unit-flags <unit>      State flags unit (raw|flags), default is flags\n"
@@ -1203,6 +1687,17 @@ void printUsage(const char *argv0)
         "   --imu-ignore-mag         Ignore magnetometer data when computing heading\n"
         "   --declination <val>      Set magnetic declination in degrees.minutes format (e.g. -12.58 for New York)\n"
         "   --declination-dec <val>  Set magnetic declination in decimal degrees (e.g. -12.97 for New York)\n"
+        "   --threads <num>          Decode each log using this many threads, default is 1 (also used to\n"
+        "                            decompress zstd logs that are made of several frames)\n"
+        "   -j, --jobs <num>         Decode this many logs (from the same file or different files) at once, default is 1\n"
+        "   --save-index             Save where the log's I-frames are to a seek index next to the log (<file>.idx),\n"
+        "                            which --start and --end use to skip straight to the right place next time\n"
+        "   --no-index               Don't use the seek index next to the log, even if there is one\n"
+        "   --baud <rate>            When reading a log from a serial port, set the port to this baud rate\n"
+        "   --tee <file>             When reading a log from a serial port, also save the bytes received to this file\n"
+        "   --follow                 Keep decoding the log as it grows, for logs that are still being recorded to the file\n"
+        "   --follow-timeout <secs>  With --follow, finish once the file hasn't grown for this long, default is 30 (0 to\n"
+        "                            keep waiting until interrupted)\n"
         "   --debug                  Show extra debugging information\n"
         "   --raw                    Don't apply predictions to fields (show raw field deltas)\n"
         "\n", argv0
@@ -1219,6 +1714,42 @@ double parseDegreesMinutes(const char *s)
     return degrees + (double) minutes / 60;
 }
 
+/**
+ * Parse a time given in seconds, or in minutes and seconds like "2:30", with an optional fraction of a second. The
+ * result is in microseconds.
+ */
+bool parseTimeOffset(const char *text, int64_t *microseconds)
+{
+    const char *colon = strchr(text, ':');
+    char *end;
+    long minutes = 0;
+    double seconds;
+
+    if (colon) {
+        if (!isdigit((unsigned char) *text))
+            return false;
+
+        minutes = strtol(text, &end, 10);
+
+        if (end != colon)
+            return false;
+
+        text = colon + 1;
+    }
+
+    if (!isdigit((unsigned char) *text) && *text != '.')
+        return false;
+
+    seconds = strtod(text, &end);
+
+    if (end == text || *end != '\0' || (colon && seconds >= 60))
+        return false;
+
+    *microseconds = (int64_t) llround((minutes * 60 + seconds) * 1000000);
+
+    return true;
+}
+
 void parseCommandlineOptions(int argc, char **argv)
 {
     int c;
@@ -1238,6 +1769,13 @@ void parseCommandlineOptions(int argc, char **argv)
         SETTING_UNIT_ACCELERATION,
         SETTING_UNIT_FRAME_TIME,
         SETTING_UNIT_FLAGS,
+        SETTING_THREADS,
+        SETTING_START,
+        SETTING_END,
+        SETTING_BAUD,
+        SETTING_TEE,
+        SETTING_FOLLOW_TIMEOUT,
+        SETTING_JOBS = 'j', // Also has a short option
     };
 
     while (1)
@@ -1252,6 +1790,8 @@ void parseCommandlineOptions(int argc, char **argv)
             {"simulate-imu", no_argument, &options.simulateIMU, 1},
             {"simulate-current-meter", no_argument, &options.simulateCurrentMeter, 1},
             {"imu-ignore-mag", no_argument, &options.imuIgnoreMag, 1},
+            {"no-index", no_argument, &options.noIndex, 1},
+            {"save-index", no_argument, &options.saveIndex, 1},
             {"sim-current-meter-scale", required_argument, 0, SETTING_CURRENT_METER_SCALE},
             {"sim-current-meter-offset", required_argument, 0, SETTING_CURRENT_METER_OFFSET},
             {"declination", required_argument, 0, SETTING_DECLINATION},
@@ -1266,6 +1806,14 @@ void parseCommandlineOptions(int argc, char **argv)
             {"unit-acceleration", required_argument, 0, SETTING_UNIT_ACCELERATION},
             {"unit-frame-time", required_argument, 0, SETTING_UNIT_FRAME_TIME},
             {"unit-flags", required_argument, 0, SETTING_UNIT_FLAGS},
+            {"threads", required_argument, 0, SETTING_THREADS},
+            {"jobs", required_argument, 0, SETTING_JOBS},
+            {"start", required_argument, 0, SETTING_START},
+            {"end", required_argument, 0, SETTING_END},
+            {"baud", required_argument, 0, SETTING_BAUD},
+            {"tee", required_argument, 0, SETTING_TEE},
+            {"follow", no_argument, &options.follow, 1},
+            {"follow-timeout", required_argument, 0, SETTING_FOLLOW_TIMEOUT},
             {0, 0, 0, 0}
         };
 
@@ -1273,7 +1821,7 @@ void parseCommandlineOptions(int argc, char **argv)
 
         opterr = 0;
 
-        c = getopt_long (argc, argv, "", long_options, &option_index);
+        c = getopt_long (argc, argv, ":j:", long_options, &option_index);
 
         if (c == -1)
             break;
@@ -1333,6 +1881,53 @@ void parseCommandlineOptions(int argc, char **argv)
                     exit(-1);
                 }
             break;
+            case SETTING_THREADS:
+                options.threads = atoi(optarg);
+
+                if (options.threads < 1) {
+                    fprintf(stderr, "Bad number of threads\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_JOBS:
+                options.jobs = atoi(optarg);
+
+                if (options.jobs < 1) {
+                    fprintf(stderr, "Bad number of jobs\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_START:
+                if (!parseTimeOffset(optarg, &options.timeStart)) {
+                    fprintf(stderr, "Bad --start time value\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_END:
+                if (!parseTimeOffset(optarg, &options.timeEnd)) {
+                    fprintf(stderr, "Bad --end time value\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_BAUD:
+                options.baud = atoi(optarg);
+
+                if (options.baud < 1) {
+                    fprintf(stderr, "Bad baud rate\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_TEE:
+                options.teeFilename = optarg;
+            break;
+            case SETTING_FOLLOW_TIMEOUT:
+                options.followTimeout = atoi(optarg);
+
+                if (options.followTimeout < 0 || !isdigit((unsigned char) optarg[0])) {
+                    fprintf(stderr, "Bad --follow-timeout value\n");
+                    exit(-1);
+                }
+            break;
             case SETTING_DECLINATION:
                 imuSetMagneticDeclination(parseDegreesMinutes(optarg));
             break;
@@ -1369,8 +1964,13 @@ void parseCommandlineOptions(int argc, char **argv)
 int main(int argc, char **argv)
 {
     flightLog_t *log;
+    decodeFile_t *file;
+    decodeJobQueue_t queue = {0};
     int fd;
     int logIndex;
+    struct stat stats;
+    serialInput_t *serialInput;
+    FILE *teeFile = NULL;
 
     platform_init();
 
@@ -1381,46 +1981,143 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (options.timeEnd != -1 && options.timeEnd <= options.timeStart) {
+        fprintf(stderr, "Error: The --end time must come after the --start time\n");
+        return -1;
+    }
+
     if (options.toStdout && argc - optind > 1) {
         fprintf(stderr, "You can only decode one log at a time if you're printing to stdout\n");
         return -1;
     }
 
+    if (options.teeFilename) {
+        teeFile = fopen(options.teeFilename, "wb");
+
+        if (!teeFile) {
+            fprintf(stderr, "Failed to create tee file '%s': %s\n", options.teeFilename, strerror(errno));
+            return -1;
+        }
+    }
+
+    if (options.jobs > 1) {
+        queue.pool = workerpool_create(options.jobs, runDecodeJob, NULL);
+        queue.capacity = options.jobs * MAX_PENDING_JOBS_PER_WORKER;
+        queue.jobs = (decodeJob_t **) malloc(queue.capacity * sizeof(*queue.jobs));
+    }
+
     for (int i = optind; i < argc; i++) {
         const char *filename = argv[i];
 
-        fd = open(filename, O_RDONLY);
+        if (strcmp(filename, "-") == 0) {
+            filename = "stdin";
+            fd = dup(fileno(stdin));
+        } else {
+            fd = open(filename, O_RDONLY);
+        }
+
         if (fd < 0) {
-            fprintf(stderr, "Failed to open log file '%s': %s\n\n", filename, strerror(errno));
+            int error = errno;
+
+            // Print this after the messages about the files before it
+            finishAllDecodeJobs(&queue);
+
+            fprintf(stderr, "Failed to open log file '%s': %s\n\n", filename, strerror(error));
             continue;
         }
 
-        log = flightLogCreate(fd);
+        serialInput = NULL;
+
+        if (fstat(fd, &stats) == 0 && (stats.st_mode & S_IFMT) == S_IFCHR) {
+            // Collect the log from the serial port on a thread of its own, so we don't miss bytes while we're writing the CSV
+            serialInput = serialInputCreate(fd, options.baud, teeFile);
+
+            log = serialInput ? flightLogCreateFromSource(serialInputSource(serialInput)) : NULL;
+        } else if (options.follow && (stats.st_mode & S_IFMT) == S_IFREG) {
+            // Read the file as it's written rather than mapping however much of it has been written so far
+            log = flightLogCreateFromSource(streamSourceCreateFollowingFile(fd, options.followTimeout * 1000));
+
+            if (log) {
+                log->private->stream->source->onWait = flushDecodeOutput;
+                log->private->stream->source->onWaitData = log;
+            }
+        } else {
+            log = flightLogCreateWithThreads(fd, options.threads);
+        }
 
         if (!log) {
+            finishAllDecodeJobs(&queue);
+
             fprintf(stderr, "Failed to read log file '%s'\n\n", filename);
+            close(fd);
             continue;
         }
 
         if (log->logCount == 0) {
+            finishAllDecodeJobs(&queue);
+
             fprintf(stderr, "Couldn't find the header of a flight log in the file '%s', is this the right kind of file?\n\n", filename);
+            flightLogDestroy(log);
+            close(fd);
             continue;
         }
 
+        file = (decodeFile_t *) calloc(1, sizeof(*file));
+
+        file->filename = filename;
+        file->fd = fd;
+        file->log = log;
+        file->serialInput = serialInput;
+
+        if (log->private->stream->source) {
+            // Print this after the messages about the files before it
+            finishAllDecodeJobs(&queue);
+
+            decodeStreamedLogs(file);
+            continue;
+        }
+
+        /*
+         * Use the index next to the log if there is one. Decoding a log from start to finish records where its I-frames
+         * are, so if we were asked to, keep that in the index for the next time we open the log.
+         */
+        if (!options.noIndex && (log->private->stream->mapping.stats.st_mode & S_IFMT) == S_IFREG) {
+            file->indexFilename = flightLogIndexFilename(filename);
+            file->index = flightLogIndexLoad(log, file->indexFilename);
+
+            if (!file->index && options.saveIndex) {
+                file->index = flightLogIndexCreate(log);
+            }
+
+            flightLogAttachIndex(log, file->index);
+        }
+
         if (options.logNumber > 0 || options.toStdout) {
             logIndex = validateLogIndex(log);
 
-            if (logIndex == -1)
+            if (logIndex == -1) {
+                finishAllDecodeJobs(&queue);
+                closeDecodeFile(file);
+
                 return -1;
+            }
 
-            decodeFlightLog(log, filename, logIndex);
+            submitDecodeJobs(&queue, file, logIndex, logIndex);
         } else {
             //Decode all the logs
-            for (logIndex = 0; logIndex < log->logCount; logIndex++)
-                decodeFlightLog(log, filename, logIndex);
+            submitDecodeJobs(&queue, file, 0, log->logCount - 1);
         }
+    }
 
-        flightLogDestroy(log);
+    if (queue.pool) {
+        finishAllDecodeJobs(&queue);
+
+        workerpool_destroy(queue.pool);
+        free(queue.jobs);
+    }
+
+    if (teeFile) {
+        fclose(teeFile);
     }
 
     return 0;
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 //For msvcrt to define M_PI:
 #define _USE_MATH_DEFINES
@@ -32,6 +33,7 @@
 #include "datapoints.h"
 #include "expo.h"
 #include "imu.h"
+#include "videowriter.h"
 
 #define STR_HELPER(x) #x
 #define STR(x) STR_HELPER(x)
@@ -50,6 +52,12 @@
 #define X_POS_LABEL 8
 #define X_POS_VALUE 145
 
+//Change how much data is displayed at one time
+#define WINDOW_WIDTH_MICROS (1000 * 1000)
+
+// Pixel columns with more frames than this are drawn using only the extremes of the frames in them
+#define PLOT_LINE_MAX_POINTS_PER_COLUMN 4
+
 #define DATAPOINTS_EXTRA_COMPUTED_FIELDS 6
 
 typedef enum Unit {
@@ -67,6 +75,12 @@ typedef enum PropStyle {
     PROP_STYLE_PIE_CHART = 1
 } PropStyle;
 
+static const char* const VIDEO_FORMAT_NAME[] = {
+    "png",
+    "y4m",
+    "rgba"
+};
+
 static const char* const PROP_STYLE_NAME[] = {
     "blades",
     "pie"
@@ -80,11 +94,6 @@ typedef struct colorAlpha_t {
     double r, g, b, a;
 } colorAlpha_t;
 
-typedef struct pngRenderingTask_t {
-    cairo_surface_t *surface;
-    int outputLogIndex, outputFrameIndex;
-} pngRenderingTask_t;
-
 typedef struct craftDrawingParameters_t {
     int numBlades, numMotors;
     int bladeLength;
@@ -98,6 +107,42 @@ typedef struct craftDrawingParameters_t {
     color_t propColor[MAX_MOTORS];
 } craft_parameters_t;
 
+// Readings in the bottom-left corner, smoothed over the frames of the video
+typedef struct smoothedReadings_t {
+    double accel, voltage, current;
+    int alt;
+} smoothedReadings_t;
+
+// Each rendering thread draws into its own surface with its own font, so they never have to wait on each other
+typedef struct renderWorker_t {
+    FT_Face ftFace;
+    cairo_font_face_t *fontFace;
+
+    cairo_surface_t *surface;
+    cairo_t *cr;
+} renderWorker_t;
+
+/*
+ * Everything needed to draw one frame of the video. The state that carries over from one output frame to the next
+ * (the smoothed readings and prop positions) is computed in order before the frame is handed to a worker.
+ */
+typedef struct renderFrameJob_t {
+    uint32_t outputFrameIndex;
+    int64_t windowCenterTime, timeElapsedMicros;
+
+    bool haveCenterFrame;
+    int64_t *centerFrame; // With room for all of the datapoints' fields
+
+    double propAngles[MAX_MOTORS];
+    smoothedReadings_t readings;
+
+    // When streaming video, the worker converts the rendered frame into here for the main thread to write in order
+    uint8_t *videoFrame;
+
+    // Signalled by the worker once the frame has been saved
+    semaphore_t done;
+} renderFrameJob_t;
+
 typedef struct renderOptions_t {
     int logNumber;
     int imageWidth, imageHeight;
@@ -123,6 +168,9 @@ typedef struct renderOptions_t {
     uint32_t timeStart, timeEnd;
 
     char *filename, *outputPrefix;
+
+    VideoFormat outputFormat;
+    char *outputFilename;
 } renderOptions_t;
 
 const double DASHED_LINE[] = {
@@ -201,6 +249,7 @@ static const renderOptions_t defaultOptions = {
     .drawCraft = true, .drawPidTable = true, .drawSticks = true, .drawTime = true,
     .gyroUnit = UNIT_RAW,
     .filename = 0,
+    .outputFormat = VIDEO_FORMAT_PNG, .outputFilename = 0,
     .timeStart = 0, .timeEnd = 0,
     .logNumber = 0,
     .gapless = 0,
@@ -213,8 +262,7 @@ extern cairo_font_face_t* cairo_ft_font_face_create_for_ft_face(FT_Face face, in
 static renderOptions_t options;
 static expoCurve_t *pitchStickCurve, *pidCurve, *gyroCurve, *accCurve, *motorCurve, *servoCurve;
 
-static semaphore_t pngRenderingSem;
-static bool pngRenderingSemCreated = false;
+static cairo_user_data_key_t ftFaceKey;
 
 static flightLog_t *flightLog;
 static datapoints_t *points;
@@ -227,19 +275,85 @@ static FT_Library freetypeLibrary;
 
 static uint32_t syncBeepTime = -1;
 
-void loadFrameIntoPoints(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize)
+static craft_parameters_t craftParameters;
+
+// Only used when streaming video instead of writing PNG files
+static videoWriter_t *videoWriter;
+
+/**
+ * Called once the log's headers have been read, to create the datapoints that its frames will be loaded into. They grow
+ * as the frames arrive, so we don't need to know how many frames there will be.
+ */
+void createPoints(flightLog_t *log)
+{
+    char **fieldNames;
+
+    // Assign field indexes to the fields we'll add
+    int newFieldIndex = log->frameDefs['I'].fieldCount, combinedFieldCount;
+
+    fieldMeta.roll = newFieldIndex++;
+    fieldMeta.pitch = newFieldIndex++;
+    fieldMeta.heading = newFieldIndex++;
+
+    fieldMeta.axisPIDSum[0] = newFieldIndex++;
+    fieldMeta.axisPIDSum[1] = newFieldIndex++;
+    fieldMeta.axisPIDSum[2] = newFieldIndex++;
+
+    if (log->mainFieldIndexes.amperageLatest > -1) {
+        fieldMeta.cumulativeCurrent = newFieldIndex++;
+    } else {
+        fieldMeta.cumulativeCurrent = -1;
+    }
+
+    combinedFieldCount = newFieldIndex;
+
+    // Create a copy of the array of field names so we can add our custom fields to it
+    fieldNames = malloc(sizeof(*fieldNames) * combinedFieldCount);
+
+    for (int i = 0; i < log->frameDefs['I'].fieldCount; i++) {
+        fieldNames[i] = strdup(log->frameDefs['I'].fieldName[i]);
+    }
+
+    // And add our synthetic field names
+    fieldNames[fieldMeta.roll] = strdup("roll");
+    fieldNames[fieldMeta.pitch] = strdup("pitch");
+    fieldNames[fieldMeta.heading] = strdup("heading");
+    fieldNames[fieldMeta.axisPIDSum[0]] = strdup("axisPID[0]");
+    fieldNames[fieldMeta.axisPIDSum[1]] = strdup("axisPID[1]");
+    fieldNames[fieldMeta.axisPIDSum[2]] = strdup("axisPID[2]");
+
+    if (fieldMeta.cumulativeCurrent > -1) {
+        fieldNames[fieldMeta.cumulativeCurrent] = strdup("cumulativeCurrent");
+    }
+
+    points = datapointsCreate(combinedFieldCount, fieldNames, INT_MAX);
+}
+
+void loadFrameBlockIntoPoints(flightLog_t *log, const flightLogFrameBlock_t *block)
 {
+    int runStart = 0;
+
     (void) log;
-    (void) frameSize;
-    (void) frameOffset;
-    (void) frameType;
-    (void) fieldCount;
-
-    if (frameType == 'P' || frameType == 'I') {
-        if (frameValid) {
-            datapointsAddFrame(points, frame[FLIGHT_LOG_FIELD_INDEX_TIME], frame);
-        } else {
-            datapointsAddGap(points);
+
+    // Add each run of valid frames in one go, the run ends at a frame which is invalid or that follows a gap
+    for (int i = 0; i <= block->frameCount; i++) {
+        if (i == block->frameCount || block->flags[i] != FLIGHT_LOG_FRAME_BLOCK_VALID) {
+            if (i > runStart) {
+                datapointsAddFrames(points, i - runStart, block->time + runStart, block->fieldCount, block->values + runStart, block->fieldStride);
+            }
+
+            if (i < block->frameCount) {
+                if (block->flags[i] & FLIGHT_LOG_FRAME_BLOCK_GAP) {
+                    datapointsAddGap(points);
+                }
+
+                if (block->flags[i] & FLIGHT_LOG_FRAME_BLOCK_VALID) {
+                    runStart = i;
+                } else {
+                    datapointsAddGap(points);
+                    runStart = i + 1;
+                }
+            }
         }
     }
 }
@@ -430,13 +544,35 @@ void drawPropeller(cairo_t *cr, craft_parameters_t *parameters)
 }
 
 /**
- * Draw a craft with spinning blades at the origin
+ * Work out how far each prop turns during the given time at the motor speeds in the frame.
  */
-void drawCraft(cairo_t *cr, int64_t *frame, int64_t timeElapsedMicros, craft_parameters_t *parameters)
+void computePropRotation(int64_t *frame, int64_t timeElapsedMicros, craft_parameters_t *parameters, double *rotationThisFrame)
 {
-    static double propAngles[MAX_MOTORS] = {0};
+    double angularSpeed;
+
+    for (int motorIndex = 0; motorIndex < parameters->numMotors; motorIndex++) {
+        if (flightLog->mainFieldIndexes.motor[motorIndex] > -1) {
+            double scaled = doubleMax(frame[flightLog->mainFieldIndexes.motor[motorIndex]] - (int32_t) flightLog->sysConfig.motorOutputLow, 0) / (flightLog->sysConfig.motorOutputHigh - flightLog->sysConfig.motorOutputLow);
 
-    double angularSpeed[MAX_MOTORS];
+            //If motors are armed (above minthrottle), keep them spinning at least a bit
+            if (scaled > 0)
+                scaled = scaled * 0.9 + 0.1;
+
+            angularSpeed = scaled * M_PI * 2 * MOTOR_MAX_RPS;
+
+            rotationThisFrame[motorIndex] = angularSpeed * timeElapsedMicros / 1000000;
+        } else {
+            rotationThisFrame[motorIndex] = 0;
+        }
+    }
+}
+
+/**
+ * Draw a craft with spinning blades at the origin. propAngles gives the position of each prop at the start of the
+ * frame.
+ */
+void drawCraft(cairo_t *cr, int64_t *frame, int64_t timeElapsedMicros, craft_parameters_t *parameters, const double *propAngles)
+{
     double rotationThisFrame[MAX_MOTORS];
     int onionLayers[MAX_MOTORS];
     int motorIndex, onion;
@@ -472,23 +608,13 @@ void drawCraft(cairo_t *cr, int64_t *frame, int64_t timeElapsedMicros, craft_par
     cairo_fill(cr);
 
     //Compute prop speed and position
-    for (motorIndex = 0; motorIndex < parameters->numMotors; motorIndex++) {
-        if (flightLog->mainFieldIndexes.motor[motorIndex] > -1) {
-            double scaled = doubleMax(frame[flightLog->mainFieldIndexes.motor[motorIndex]] - (int32_t) flightLog->sysConfig.motorOutputLow, 0) / (flightLog->sysConfig.motorOutputHigh - flightLog->sysConfig.motorOutputLow);
-
-            //If motors are armed (above minthrottle), keep them spinning at least a bit
-            if (scaled > 0)
-                scaled = scaled * 0.9 + 0.1;
-
-            angularSpeed[motorIndex] = scaled * M_PI * 2 * MOTOR_MAX_RPS;
+    computePropRotation(frame, timeElapsedMicros, parameters, rotationThisFrame);
 
-            rotationThisFrame[motorIndex] = angularSpeed[motorIndex] * timeElapsedMicros / 1000000;
-
-            // Don't need to draw as many onion layers if we aren't rotating very far
-            onionLayers[motorIndex] = (int) (doubleAbs(rotationThisFrame[motorIndex]) * 10);
-            if (onionLayers[motorIndex] < 1)
-                onionLayers[motorIndex] = 1;
-        }
+    for (motorIndex = 0; motorIndex < parameters->numMotors; motorIndex++) {
+        // Don't need to draw as many onion layers if we aren't rotating very far
+        onionLayers[motorIndex] = (int) (doubleAbs(rotationThisFrame[motorIndex]) * 10);
+        if (onionLayers[motorIndex] < 1)
+            onionLayers[motorIndex] = 1;
     }
 
     cairo_set_font_size(cr, FONTSIZE_CURRENT_VALUE_LABEL);
@@ -579,9 +705,6 @@ void drawCraft(cairo_t *cr, int64_t *frame, int64_t timeElapsedMicros, craft_par
         }
         cairo_restore(cr);
     }
-
-    for (motorIndex = 0; motorIndex < parameters->numMotors; motorIndex++)
-        propAngles[motorIndex] += rotationThisFrame[motorIndex];
 }
 
 void decideCraftParameters(craft_parameters_t *parameters, int imageWidth, int imageHeight)
@@ -631,51 +754,135 @@ void decideCraftParameters(craft_parameters_t *parameters, int imageWidth, int i
         parameters->propColor[i] = fieldMeta.motorColors[i];
 }
 
+typedef struct plotLineState_t {
+    int64_t windowStartTime;
+    uint32_t windowWidthMicros;
+
+    int fieldIndex;
+    expoCurve_t *curve;
+    int plotHeight;
+
+    bool drawingLine;
+    double lastX, lastY;
+} plotLineState_t;
+
+static double plotLineX(plotLineState_t *plot, int64_t frameTime)
+{
+    return (double)(frameTime - plot->windowStartTime) / plot->windowWidthMicros * options.imageWidth;
+}
+
+/**
+ * Extend the line to the value of the field in the frame with the given index.
+ */
+static void plotLinePoint(cairo_t *cr, plotLineState_t *plot, int frameIndex)
+{
+    static const int GAP_WARNING_BOX_RADIUS = 4;
+    int64_t fieldValue;
+    int64_t frameTime;
+
+    datapointsGetFieldAtIndex(points, frameIndex, plot->fieldIndex, &fieldValue);
+    datapointsGetTimeAtIndex(points, frameIndex, &frameTime);
+
+    double nextX, nextY;
+
+    nextY = (double) -expoCurveLookup(plot->curve, fieldValue) * plot->plotHeight;
+    nextX = plotLineX(plot, frameTime);
+
+    if (plot->drawingLine) {
+        if (!options.gapless && datapointsGetGapStartsAtIndex(points, frameIndex - 1)) {
+            //Draw a warning box at the beginning and end of the gap to mark it
+            cairo_rectangle(cr, plot->lastX - GAP_WARNING_BOX_RADIUS, plot->lastY - GAP_WARNING_BOX_RADIUS, GAP_WARNING_BOX_RADIUS * 2, GAP_WARNING_BOX_RADIUS * 2);
+            cairo_rectangle(cr, nextX - GAP_WARNING_BOX_RADIUS, nextY - GAP_WARNING_BOX_RADIUS, GAP_WARNING_BOX_RADIUS * 2, GAP_WARNING_BOX_RADIUS * 2);
+
+            cairo_move_to(cr, nextX, nextY);
+        } else {
+            cairo_line_to(cr, nextX, nextY);
+        }
+    } else {
+        cairo_move_to(cr, nextX, nextY);
+    }
+
+    plot->drawingLine = true;
+    plot->lastX = nextX;
+    plot->lastY = nextY;
+}
+
 /**
  * Plot the given field within the specified time period. When the output from the curve applied to a field
  * value reaches 1.0 it'll be drawn plotHeight pixels away from the origin.
+ *
+ * If the field has a min/max summary, pixel columns that hold many frames are drawn using only the first, smallest,
+ * largest and last values in the column, which covers the same pixels as drawing every frame. Dashed lines need
+ * every frame, since the dash pattern follows the length of the path.
  */
 void plotLine(cairo_t *cr, color_t color, int64_t windowStartTime, int64_t windowEndTime, int firstFrameIndex,
         int fieldIndex, expoCurve_t *curve, int plotHeight)
 {
-    static const int GAP_WARNING_BOX_RADIUS = 4;
-    uint32_t windowWidthMicros = (uint32_t) (windowEndTime - windowStartTime);
-    int64_t fieldValue;
+    plotLineState_t plot = {
+        .windowStartTime = windowStartTime,
+        .windowWidthMicros = (uint32_t) (windowEndTime - windowStartTime),
+        .fieldIndex = fieldIndex,
+        .curve = curve,
+        .plotHeight = plotHeight,
+        .drawingLine = false
+    };
+    bool useSummary = datapointsHasFieldSummary(points, fieldIndex) && cairo_get_dash_count(cr) == 0;
     int64_t frameTime;
 
-    bool drawingLine = false;
-    double lastX, lastY;
-
     //Draw points from this line until we leave the window
-    for (int frameIndex = firstFrameIndex; frameIndex < points->frameCount; frameIndex++) {
-        datapointsGetFieldAtIndex(points, frameIndex, fieldIndex, &fieldValue);
+    for (int frameIndex = firstFrameIndex; frameIndex < points->frameCount; ) {
+        int lastFrameIndex = frameIndex;
+
         datapointsGetTimeAtIndex(points, frameIndex, &frameTime);
 
-        double nextX, nextY;
+        if (useSummary && frameTime < windowEndTime) {
+            // Find the rest of the frames that land in the same pixel column as this one
+            double column = floor(plotLineX(&plot, frameTime));
 
-        nextY = (double) -expoCurveLookup(curve, fieldValue) * plotHeight;
-        nextX = (double)(frameTime - windowStartTime) / windowWidthMicros * options.imageWidth;
+            while (lastFrameIndex + 1 < points->frameCount) {
+                datapointsGetTimeAtIndex(points, lastFrameIndex + 1, &frameTime);
 
-        if (drawingLine) {
-            if (!options.gapless && datapointsGetGapStartsAtIndex(points, frameIndex - 1)) {
-                //Draw a warning box at the beginning and end of the gap to mark it
-                cairo_rectangle(cr, lastX - GAP_WARNING_BOX_RADIUS, lastY - GAP_WARNING_BOX_RADIUS, GAP_WARNING_BOX_RADIUS * 2, GAP_WARNING_BOX_RADIUS * 2);
-                cairo_rectangle(cr, nextX - GAP_WARNING_BOX_RADIUS, nextY - GAP_WARNING_BOX_RADIUS, GAP_WARNING_BOX_RADIUS * 2, GAP_WARNING_BOX_RADIUS * 2);
+                if (floor(plotLineX(&plot, frameTime)) != column)
+                    break;
 
-                cairo_move_to(cr, nextX, nextY);
-            } else {
-                cairo_line_to(cr, nextX, nextY);
+                lastFrameIndex++;
+
+                if (frameTime >= windowEndTime)
+                    break;
+            }
+        }
+
+        if (lastFrameIndex - frameIndex + 1 > PLOT_LINE_MAX_POINTS_PER_COLUMN && !datapointsHasGapInRange(points, frameIndex, lastFrameIndex)) {
+            int minFrame, maxFrame;
+            int column[3];
+            int lastDrawn = frameIndex;
+
+            datapointsGetFieldExtremesInRange(points, fieldIndex, frameIndex, lastFrameIndex, &minFrame, &maxFrame);
+
+            column[0] = minFrame < maxFrame ? minFrame : maxFrame;
+            column[1] = minFrame < maxFrame ? maxFrame : minFrame;
+            column[2] = lastFrameIndex;
+
+            plotLinePoint(cr, &plot, frameIndex);
+
+            for (int i = 0; i < 3; i++) {
+                if (column[i] > lastDrawn) {
+                    plotLinePoint(cr, &plot, column[i]);
+                    lastDrawn = column[i];
+                }
             }
         } else {
-            cairo_move_to(cr, nextX, nextY);
+            for (int i = frameIndex; i <= lastFrameIndex; i++) {
+                plotLinePoint(cr, &plot, i);
+            }
         }
 
-        drawingLine = true;
-        lastX = nextX;
-        lastY = nextY;
+        datapointsGetTimeAtIndex(points, lastFrameIndex, &frameTime);
 
         if (frameTime >= windowEndTime)
             break;
+
+        frameIndex = lastFrameIndex + 1;
     }
 
     cairo_set_source_rgb(cr, color.r, color.g, color.b);
@@ -887,22 +1094,15 @@ void drawFrameLabel(cairo_t *cr, uint32_t frameIndex, uint32_t frameTimeMsec)
     cairo_show_text(cr, frameNumberBuf);
 }
 
-void drawAccelerometerData(cairo_t *cr, int64_t *frame)
+/**
+ * Fold the values from the frame at the center of this output frame into the smoothed readings.
+ */
+void updateSmoothedReadings(smoothedReadings_t *readings, int64_t *frame)
 {
     int16_t accSmooth[3];
     attitude_t attitude;
     t_fp_vector acceleration;
     double magnitude;
-    static double lastAccel = 0, lastVoltage = 0, lastCurrent = 0;
-    static int lastAlt = 0;
-    cairo_text_extents_t extent;
-
-    char labelBuf[32];
-
-    cairo_set_font_size(cr, FONTSIZE_FRAME_LABEL);
-    cairo_set_source_rgba(cr, 1, 1, 1, 0.65);
-
-    cairo_text_extents(cr, "Acceleration 0.0G", &extent);
 
     if (flightLog->sysConfig.acc_1G && fieldMeta.hasAccs) {
         for (int axis = 0; axis < 3; axis++)
@@ -923,47 +1123,68 @@ void drawAccelerometerData(cairo_t *cr, int64_t *frame)
         magnitude = sqrt(acceleration.V.X * acceleration.V.X + acceleration.V.Y * acceleration.V.Y + acceleration.V.Z * acceleration.V.Z);
 
         //Weighted moving average with the recent history to smooth out noise
-        lastAccel = (lastAccel * 2 + magnitude) / 3;
+        readings->accel = (readings->accel * 2 + magnitude) / 3;
+    }
 
+    if (flightLog->mainFieldIndexes.vbatLatest > -1) {
+        readings->voltage = (readings->voltage * 2 + frame[flightLog->mainFieldIndexes.vbatLatest]) / 3;
+    }
+
+    if (flightLog->mainFieldIndexes.BaroAlt > -1) {
+        readings->alt = (readings->alt * 2 + frame[flightLog->mainFieldIndexes.BaroAlt]) / 3;
+    }
+
+    if (flightLog->mainFieldIndexes.amperageLatest > -1) {
+        readings->current = (readings->current * 2 + flightLogAmperageADCToMilliamps(flightLog, frame[flightLog->mainFieldIndexes.amperageLatest]) / 1000.0) / 3;
+    }
+}
+
+void drawAccelerometerData(cairo_t *cr, int64_t *frame, const smoothedReadings_t *readings)
+{
+    cairo_text_extents_t extent;
+
+    char labelBuf[32];
+
+    cairo_set_font_size(cr, FONTSIZE_FRAME_LABEL);
+    cairo_set_source_rgba(cr, 1, 1, 1, 0.65);
+
+    cairo_text_extents(cr, "Acceleration 0.0G", &extent);
+
+    if (flightLog->sysConfig.acc_1G && fieldMeta.hasAccs) {
         cairo_move_to(cr, X_POS_LABEL, options.imageHeight - 8);
         cairo_show_text(cr, "Accel.");
 
-        snprintf(labelBuf, sizeof(labelBuf), "%.2f G", lastAccel);
+        snprintf(labelBuf, sizeof(labelBuf), "%.2f G", readings->accel);
 
         cairo_move_to(cr, X_POS_VALUE, options.imageHeight - 8);
         cairo_show_text(cr, labelBuf);
     }
 
     if (flightLog->mainFieldIndexes.vbatLatest > -1) {
-        lastVoltage = (lastVoltage * 2 + frame[flightLog->mainFieldIndexes.vbatLatest]) / 3;
-
         cairo_move_to(cr, X_POS_LABEL, options.imageHeight - 8 - (extent.height + 8));
         cairo_show_text(cr, "Batt.");
 
-        snprintf(labelBuf, sizeof(labelBuf), "%.2f V", lastVoltage / 10);
+        snprintf(labelBuf, sizeof(labelBuf), "%.2f V", readings->voltage / 10);
 
         cairo_move_to(cr, X_POS_VALUE, options.imageHeight - 8 - (extent.height + 8));
         cairo_show_text(cr, labelBuf);
     }
 
     if (flightLog->mainFieldIndexes.BaroAlt > -1) {
-        lastAlt = (lastAlt * 2 + frame[flightLog->mainFieldIndexes.BaroAlt]) / 3;
-
         cairo_move_to(cr, X_POS_LABEL, options.imageHeight - 8 - (extent.height + 8) * 2);
         cairo_show_text(cr, "Altitude");
 
-        snprintf(labelBuf, sizeof(labelBuf), "%.1f m", lastAlt / 100.0);
+        snprintf(labelBuf, sizeof(labelBuf), "%.1f m", readings->alt / 100.0);
 
         cairo_move_to(cr, X_POS_VALUE, options.imageHeight - 8 - (extent.height + 8) * 2);
         cairo_show_text(cr, labelBuf);
     }
 
     if (flightLog->mainFieldIndexes.amperageLatest > -1) {
-        lastCurrent = (lastCurrent * 2 + flightLogAmperageADCToMilliamps(flightLog, frame[flightLog->mainFieldIndexes.amperageLatest]) / 1000.0) / 3;
         cairo_move_to(cr, X_POS_LABEL, options.imageHeight - 8 - (extent.height + 8) * 3);
         cairo_show_text(cr, "Current");
 
-        snprintf(labelBuf, sizeof(labelBuf), "%.2f A", lastCurrent);
+        snprintf(labelBuf, sizeof(labelBuf), "%.2f A", readings->current);
         cairo_move_to(cr, X_POS_VALUE, options.imageHeight - 8 - (extent.height + 8) * 3);
         cairo_show_text(cr, labelBuf);
 
@@ -985,82 +1206,345 @@ void drawAccelerometerData(cairo_t *cr, int64_t *frame)
     }
 }
 
-void* pngRenderThread(void *arg)
+/**
+ * Draw one frame of the video into the worker's surface and save it as a PNG. This runs on the rendering threads, so
+ * it only reads the log data (which doesn't change after smoothing) and the state handed over in the job.
+ */
+void renderFrame(void *workerData, void *jobData)
 {
+    renderWorker_t *worker = (renderWorker_t *) workerData;
+    renderFrameJob_t *job = (renderFrameJob_t *) jobData;
+    cairo_t *cr = worker->cr;
     char filename[256];
-    pngRenderingTask_t *task = (pngRenderingTask_t *) arg;
+    int i;
 
-    snprintf(filename, sizeof(filename), "%s.%02d.%06d.png", options.outputPrefix, task->outputLogIndex + 1, task->outputFrameIndex);
-    cairo_surface_write_to_png (task->surface, filename);
-    cairo_surface_destroy (task->surface);
+    //Bring the current time into the center of the plot
+    const int startXTimeOffset = WINDOW_WIDTH_MICROS / 2;
 
-    //Release our slot in the rendering pool, we're done
-    semaphore_signal(&pngRenderingSem);
+    int64_t windowCenterTime = job->windowCenterTime;
+    int64_t windowStartTime = windowCenterTime - startXTimeOffset;
+    int64_t windowEndTime = windowStartTime + WINDOW_WIDTH_MICROS;
+    int64_t *frameValues = job->centerFrame;
 
-    free(task);
+    // Every frame starts out with a transparent background and a fresh drawing state
+    cairo_save(cr);
 
-    return 0;
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    // Find the frame just to the left of the first pixel so we can start drawing lines from there
+    int firstFrameIndex = datapointsFindFrameAtTime(points, windowStartTime - 1);
+
+    if (firstFrameIndex == -1) {
+        firstFrameIndex = 0;
+    }
+
+    //Plot the upper motor graph
+    if (options.plotMotors) {
+        int motorGraphHeight = (int) (options.imageHeight * (options.plotPids ? 0.15 : 0.20));
+
+        cairo_save(cr);
+        {
+            if (options.plotPids) {
+                //Move up a little bit to make room for the pid graphs
+                cairo_translate(cr, 0, options.imageHeight * 0.15);
+            } else {
+                cairo_translate(cr, 0, options.imageHeight * 0.25);
+            }
+
+            drawAxisLine(cr);
+
+            cairo_set_line_width(cr, 2.5);
+
+            for (i = 0; i < fieldMeta.numMotors; i++) {
+                plotLine(cr, fieldMeta.motorColors[i], windowStartTime, windowEndTime, firstFrameIndex,
+                        flightLog->mainFieldIndexes.motor[i], motorCurve, motorGraphHeight);
+            }
+
+            if (fieldMeta.numServos) {
+                for (i = 0; i < MAX_SERVOS; i++) {
+                    if (flightLog->mainFieldIndexes.servo[i] > -1) {
+                        plotLine(cr, fieldMeta.servoColors[i], windowStartTime, windowEndTime, firstFrameIndex,
+                            flightLog->mainFieldIndexes.servo[i], motorCurve, motorGraphHeight);
+                    }
+                }
+            }
+
+            drawAxisLabel(cr, "Motors");
+        }
+        cairo_restore(cr);
+    }
+
+    //Plot the lower PID graphs
+    cairo_save(cr);
+    {
+        if (options.plotPids) {
+            //Plot three axes as different graphs
+            cairo_translate(cr, 0, options.imageHeight * 0.60);
+            for (int axis = 0; axis < 3; axis++) {
+                cairo_save(cr);
+
+                cairo_translate(cr, 0, options.imageHeight * 0.2 * (axis - 1));
+
+                drawAxisLine(cr);
+
+                for (int pidType = PID_D; pidType >= PID_P; pidType--) {
+                    if (flightLog->mainFieldIndexes.pid[pidType][axis] > -1) {
+                        switch (pidType) {
+                            case PID_P:
+                                cairo_set_line_width(cr, 2);
+                            break;
+                            case PID_I:
+                                cairo_set_dash(cr, DASHED_LINE, DASHED_LINE_NUM_POINTS, 0);
+                                cairo_set_line_width(cr, 2);
+                            break;
+                            case PID_D:
+                                cairo_set_dash(cr, DOTTED_LINE, DOTTED_LINE_NUM_POINTS, 0);
+                                cairo_set_line_width(cr, 2);
+                        }
+
+                        plotLine(cr, fieldMeta.PIDAxisColors[pidType][axis], windowStartTime, windowEndTime, firstFrameIndex,
+                                flightLog->mainFieldIndexes.pid[pidType][axis], pidCurve, (int) (options.imageHeight * 0.15));
+
+                        cairo_set_dash(cr, 0, 0, 0);
+                    }
+                }
+
+                if (options.plotGyros) {
+                    cairo_set_line_width(cr, 3);
+
+                    plotLine(cr, fieldMeta.gyroColors[axis], windowStartTime, windowEndTime, firstFrameIndex,
+                        flightLog->mainFieldIndexes.gyroADC[axis], gyroCurve, (int) (options.imageHeight * 0.15));
+                }
+
+                const char *axisLabel;
+                if (options.plotGyros) {
+                    switch (axis) {
+                        case 0:
+                            axisLabel = "Gyro + PID roll";
+                        break;
+                        case 1:
+                            axisLabel = "Gyro + PID pitch";
+                        break;
+                        case 2:
+                            axisLabel = "Gyro + PID yaw";
+                        break;
+                        default:
+                            axisLabel = "Unknown";
+                    }
+                } else {
+                    switch (axis) {
+                        case 0:
+                            axisLabel = "Roll PIDs";
+                        break;
+                        case 1:
+                            axisLabel = "Pitch PIDs";
+                        break;
+                        case 2:
+                            axisLabel = "Yaw PIDs";
+                        break;
+                        default:
+                            axisLabel = "Unknown";
+                    }
+                }
+
+                drawAxisLabel(cr, axisLabel);
+
+                cairo_restore(cr);
+            }
+        } else if (options.plotGyros) {
+            //Plot three gyro axes on one graph
+            cairo_translate(cr, 0, options.imageHeight * 0.70);
+
+            drawAxisLine(cr);
+
+            for (int axis = 0; axis < 3; axis++) {
+                plotLine(cr, fieldMeta.gyroColors[axis], windowStartTime, windowEndTime, firstFrameIndex,
+                        flightLog->mainFieldIndexes.gyroADC[axis], gyroCurve, (int) (options.imageHeight * 0.25));
+            }
+
+            drawAxisLabel(cr, "Gyro");
+        }
+    }
+    cairo_restore(cr);
+
+    //Draw a bar highlighting the current time if we are drawing any graphs
+    if (options.plotGyros || options.plotMotors || options.plotPids || options.plotPidSum) {
+        double centerX = options.imageWidth / 2.0;
+
+        cairo_set_source_rgba(cr, 1, 0.25, 0.25, 0.2);
+        cairo_set_line_width(cr, 20);
+
+        cairo_move_to(cr, centerX, 0);
+        cairo_line_to(cr, centerX, options.imageHeight);
+        cairo_stroke(cr);
+    }
+
+    //Draw the command stick positions from the centered frame
+    if (job->haveCenterFrame) {
+        if (options.drawSticks) {
+            cairo_save(cr);
+            {
+                cairo_translate(cr, 0.75 * options.imageWidth, 0.20 * options.imageHeight);
+
+                drawCommandSticks(frameValues, options.imageWidth, options.imageHeight, cr);
+            }
+            cairo_restore(cr);
+        }
+
+        if (options.drawPidTable) {
+            cairo_save(cr);
+            {
+                cairo_translate(cr, 0.25 * options.imageWidth, 0.75 * options.imageHeight);
+                drawPIDTable(cr, frameValues);
+            }
+            cairo_restore(cr);
+        }
+
+        if (options.drawCraft) {
+            cairo_save(cr);
+            {
+                cairo_translate(cr, 0.25 * options.imageWidth, 0.20 * options.imageHeight);
+                drawCraft(cr, frameValues, job->timeElapsedMicros, &craftParameters, job->propAngles);
+            }
+            cairo_restore(cr);
+        }
+
+        drawAccelerometerData(cr, frameValues, &job->readings);
+
+        if (options.drawTime)
+            drawFrameLabel(cr, frameValues[FLIGHT_LOG_FIELD_INDEX_ITERATION], (uint32_t) ((windowCenterTime - flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_TIME].min) / 1000));
+    }
+
+    // Draw a synchronisation line
+    if (syncBeepTime >= windowStartTime && syncBeepTime < windowEndTime) {
+        double lineX = (double) ((int64_t) options.imageWidth * (syncBeepTime - windowStartTime) / WINDOW_WIDTH_MICROS);
+
+        cairo_set_source_rgba(cr, 0.25, 0.25, 1, 0.2);
+        cairo_set_line_width(cr, 20);
+
+        cairo_move_to(cr, lineX, 0);
+        cairo_line_to(cr, lineX, options.imageHeight);
+        cairo_stroke(cr);
+    }
+
+    cairo_new_path(cr);
+    cairo_restore(cr);
+
+    cairo_surface_flush(worker->surface);
+
+    if (videoWriter) {
+        videoWriterConvertFrame(videoWriter, cairo_image_surface_get_data(worker->surface), cairo_image_surface_get_stride(worker->surface), job->videoFrame);
+    } else {
+        snprintf(filename, sizeof(filename), "%s.%02d.%06d.png", options.outputPrefix, selectedLogIndex + 1, job->outputFrameIndex);
+        cairo_surface_write_to_png(worker->surface, filename);
+    }
+
+    semaphore_signal(&job->done);
 }
 
-/**
- * PNG encoding is so slow and so easily run in parallel, so save the frames using this function
- * (which'll use extra threads to do the work). Be sure to call waitForFramesToSave() before
- * the program ends.
- */
-void saveSurfaceAsync(cairo_surface_t *surface, int logIndex, int outputFrameIndex)
+static void destroyFreetypeFace(void *face)
 {
-    if (!pngRenderingSemCreated) {
-        semaphore_create(&pngRenderingSem, options.threads);
-        pngRenderingSemCreated = true;
+    FT_Done_Face((FT_Face) face);
+}
+
+void createRenderWorker(renderWorker_t *worker)
+{
+    if (FT_New_Memory_Face(freetypeLibrary, (const FT_Byte*)SourceSansPro_Regular_otf, SourceSansPro_Regular_otf_len, 0, &worker->ftFace)) {
+        fprintf(stderr, "Failed to load font file\n");
+        exit(-1);
     }
+    worker->fontFace = cairo_ft_font_face_create_for_ft_face(worker->ftFace, 0);
 
-    pngRenderingTask_t *task = (pngRenderingTask_t*) malloc(sizeof(*task));
+    // Cairo may hang on to the font face after we're done with it, so have it free the FreeType face when it's finished
+    cairo_font_face_set_user_data(worker->fontFace, &ftFaceKey, worker->ftFace, destroyFreetypeFace);
 
-    task->surface = surface;
-    task->outputLogIndex = logIndex;
-    task->outputFrameIndex = outputFrameIndex;
+    worker->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, options.imageWidth, options.imageHeight);
+    worker->cr = cairo_create(worker->surface);
 
-    // Reserve a slot in the rendering pool...
-    semaphore_wait(&pngRenderingSem);
+    cairo_set_font_face(worker->cr, worker->fontFace);
+}
 
-    thread_create_detached(pngRenderThread, task);
+void destroyRenderWorker(renderWorker_t *worker)
+{
+    cairo_destroy(worker->cr);
+    cairo_surface_destroy(worker->surface);
+    cairo_font_face_destroy(worker->fontFace);
 }
 
-void waitForFramesToSave()
+void reportRenderProgress(uint32_t frameWrittenCount, uint32_t outputFrames)
 {
-    int i;
+    if (frameWrittenCount % 500 == 0 || frameWrittenCount == outputFrames) {
+        fprintf(stderr, "Rendered %d frames (%.1f%%)%s\n",
+            frameWrittenCount, (double)frameWrittenCount / outputFrames * 100,
+            frameWrittenCount < outputFrames ? "..." : ".");
+    }
+}
 
-    if (pngRenderingSemCreated) {
-        for (i = 0; i < options.threads; i++) {
-            semaphore_wait(&pngRenderingSem);
-        }
+/**
+ * Called in frame order once the worker has finished the job, so streamed video frames can be written out.
+ */
+static void finishRenderJob(renderFrameJob_t *job, uint32_t frameWrittenCount, uint32_t outputFrames)
+{
+    if (videoWriter && !videoWriterWriteFrame(videoWriter, job->videoFrame)) {
+        fprintf(stderr, "Failed to write video frame: %s\n", strerror(errno));
+        exit(-1);
     }
+
+    reportRenderProgress(frameWrittenCount, outputFrames);
 }
 
-void renderAnimation(uint32_t startFrame, uint32_t endFrame)
+/**
+ * Open the file that streamed video should be written to ("-" or no filename means stdout).
+ */
+static FILE* openVideoOutput(void)
 {
-    //Change how much data is displayed at one time
-    const int windowWidthMicros = 1000 * 1000;
+    FILE *file;
 
-    //Bring the current time into the center of the plot
-    const int startXTimeOffset = windowWidthMicros / 2;
+    if (!options.outputFilename || strcmp(options.outputFilename, "-") == 0) {
+#ifdef WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        return stdout;
+    }
 
-    int i;
+    // This might be a FIFO that an encoder is reading from, in which case this blocks until it's opened for reading
+    file = fopen(options.outputFilename, "wb");
 
+    if (!file) {
+        fprintf(stderr, "Failed to open video output '%s': %s\n", options.outputFilename, strerror(errno));
+        exit(-1);
+    }
+
+    return file;
+}
+
+/**
+ * Render the frames of the video in parallel using options.threads rendering threads. The frames are finished (and
+ * progress is reported) in order.
+ */
+void renderAnimation(uint32_t startFrame, uint32_t endFrame)
+{
     int64_t logStartTime = flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_TIME].min;
     int64_t logEndTime = flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_TIME].max;
     int64_t logDurationMicro;
 
     uint32_t outputFrames;
 
-    int64_t frameValues[FLIGHT_LOG_MAX_FIELDS];
-    uint64_t lastCenterTime;
     int64_t frameTime;
+    int64_t lastCenterTime = 0;
 
-    FT_Face ft_face;
-    cairo_font_face_t *cairo_face;
+    double propAngles[MAX_MOTORS] = {0};
+    smoothedReadings_t readings = {0};
 
-    struct craftDrawingParameters_t craftParameters;
+    renderWorker_t *workers;
+    void **workerData;
+    workerPool_t *pool;
+
+    // Enough frames in flight to keep every worker busy while we wait for the oldest one to finish
+    int jobCount = options.threads * 2;
+    renderFrameJob_t *jobs;
 
     //If sync beep time looks reasonable, start the log there instead of at the first frame
     if (abs((int) ((int64_t)syncBeepTime - logStartTime)) < 1000000) //Expected to be well within 1 second of the start
@@ -1073,12 +1557,6 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
     }
     outputFrames = endFrame - startFrame;
 
-    if (FT_New_Memory_Face(freetypeLibrary, (const FT_Byte*)SourceSansPro_Regular_otf, SourceSansPro_Regular_otf_len, 0, &ft_face)) {
-        fprintf(stderr, "Failed to load font file\n");
-        exit(-1);
-    }
-    cairo_face = cairo_ft_font_face_create_for_ft_face(ft_face, 0);
-
     decideCraftParameters(&craftParameters, options.imageWidth, options.imageHeight);
 
     //Exaggerate values around the origin and compress values near the edges:
@@ -1101,229 +1579,99 @@ void renderAnimation(uint32_t startFrame, uint32_t endFrame)
     fprintf(stderr, "%d frames to be rendered at %d FPS [%d:%02d]\n", outputFrames, options.fps, durationMins, durationSecs);
     fprintf(stderr, "\n");
 
-    for (uint32_t outputFrameIndex = startFrame; outputFrameIndex < endFrame; outputFrameIndex++) {
-        int64_t windowCenterTime = logStartTime + ((int64_t) outputFrameIndex * 1000000) / options.fps;
-        int64_t windowStartTime = windowCenterTime - startXTimeOffset;
-        int64_t windowEndTime = windowStartTime + windowWidthMicros;
-
-        cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, options.imageWidth, options.imageHeight);
-        cairo_t *cr = cairo_create(surface);
-
-        // Find the frame just to the left of the first pixel so we can start drawing lines from there
-        int firstFrameIndex = datapointsFindFrameAtTime(points, windowStartTime - 1);
-
-        if (firstFrameIndex == -1) {
-            firstFrameIndex = 0;
-        }
-
-        cairo_set_font_face(cr, cairo_face);
-
-        //Plot the upper motor graph
-        if (options.plotMotors) {
-            int motorGraphHeight = (int) (options.imageHeight * (options.plotPids ? 0.15 : 0.20));
-
-            cairo_save(cr);
-            {
-                if (options.plotPids) {
-                    //Move up a little bit to make room for the pid graphs
-                    cairo_translate(cr, 0, options.imageHeight * 0.15);
-                } else {
-                    cairo_translate(cr, 0, options.imageHeight * 0.25);
-                }
-
-                drawAxisLine(cr);
-
-                cairo_set_line_width(cr, 2.5);
-
-                for (i = 0; i < fieldMeta.numMotors; i++) {
-                    plotLine(cr, fieldMeta.motorColors[i], windowStartTime, windowEndTime, firstFrameIndex,
-                            flightLog->mainFieldIndexes.motor[i], motorCurve, motorGraphHeight);
-                }
-
-                if (fieldMeta.numServos) {
-                    for (i = 0; i < MAX_SERVOS; i++) {
-                        if (flightLog->mainFieldIndexes.servo[i] > -1) {
-                            plotLine(cr, fieldMeta.servoColors[i], windowStartTime, windowEndTime, firstFrameIndex,
-                                flightLog->mainFieldIndexes.servo[i], motorCurve, motorGraphHeight);
-                        }
-                    }
-                }
-
-                drawAxisLabel(cr, "Motors");
-            }
-            cairo_restore(cr);
-        }
-
-        //Plot the lower PID graphs
-        cairo_save(cr);
-        {
-            if (options.plotPids) {
-                //Plot three axes as different graphs
-                cairo_translate(cr, 0, options.imageHeight * 0.60);
-                for (int axis = 0; axis < 3; axis++) {
-                    cairo_save(cr);
-
-                    cairo_translate(cr, 0, options.imageHeight * 0.2 * (axis - 1));
-
-                    drawAxisLine(cr);
-
-                    for (int pidType = PID_D; pidType >= PID_P; pidType--) {
-                        if (flightLog->mainFieldIndexes.pid[pidType][axis] > -1) {
-                            switch (pidType) {
-                                case PID_P:
-                                    cairo_set_line_width(cr, 2);
-                                break;
-                                case PID_I:
-                                    cairo_set_dash(cr, DASHED_LINE, DASHED_LINE_NUM_POINTS, 0);
-                                    cairo_set_line_width(cr, 2);
-                                break;
-                                case PID_D:
-                                    cairo_set_dash(cr, DOTTED_LINE, DOTTED_LINE_NUM_POINTS, 0);
-                                    cairo_set_line_width(cr, 2);
-                            }
-
-                            plotLine(cr, fieldMeta.PIDAxisColors[pidType][axis], windowStartTime, windowEndTime, firstFrameIndex,
-                                    flightLog->mainFieldIndexes.pid[pidType][axis], pidCurve, (int) (options.imageHeight * 0.15));
-
-                            cairo_set_dash(cr, 0, 0, 0);
-                        }
-                    }
+    workers = malloc(options.threads * sizeof(*workers));
+    workerData = malloc(options.threads * sizeof(*workerData));
 
-                    if (options.plotGyros) {
-                        cairo_set_line_width(cr, 3);
+    for (int i = 0; i < options.threads; i++) {
+        createRenderWorker(&workers[i]);
+        workerData[i] = &workers[i];
+    }
 
-                        plotLine(cr, fieldMeta.gyroColors[axis], windowStartTime, windowEndTime, firstFrameIndex,
-                            flightLog->mainFieldIndexes.gyroADC[axis], gyroCurve, (int) (options.imageHeight * 0.15));
-                    }
+    if (options.outputFormat != VIDEO_FORMAT_PNG) {
+        videoWriter = videoWriterCreate(openVideoOutput(), options.outputFormat, options.imageWidth, options.imageHeight, options.fps);
+    }
 
-                    const char *axisLabel;
-                    if (options.plotGyros) {
-                        switch (axis) {
-                            case 0:
-                                axisLabel = "Gyro + PID roll";
-                            break;
-                            case 1:
-                                axisLabel = "Gyro + PID pitch";
-                            break;
-                            case 2:
-                                axisLabel = "Gyro + PID yaw";
-                            break;
-                            default:
-                                axisLabel = "Unknown";
-                        }
-                    } else {
-                        switch (axis) {
-                            case 0:
-                                axisLabel = "Roll PIDs";
-                            break;
-                            case 1:
-                                axisLabel = "Pitch PIDs";
-                            break;
-                            case 2:
-                                axisLabel = "Yaw PIDs";
-                            break;
-                            default:
-                                axisLabel = "Unknown";
-                        }
-                    }
+    jobs = malloc(jobCount * sizeof(*jobs));
 
-                    drawAxisLabel(cr, axisLabel);
+    for (int i = 0; i < jobCount; i++) {
+        semaphore_create(&jobs[i].done, 0);
 
-                    cairo_restore(cr);
-                }
-            } else if (options.plotGyros) {
-                //Plot three gyro axes on one graph
-                cairo_translate(cr, 0, options.imageHeight * 0.70);
+        jobs[i].videoFrame = videoWriter ? malloc(videoWriter->frameSize) : NULL;
+        jobs[i].centerFrame = malloc(points->fieldCount * sizeof(*jobs[i].centerFrame));
+    }
 
-                drawAxisLine(cr);
+    pool = workerpool_create(options.threads, renderFrame, workerData);
 
-                for (int axis = 0; axis < 3; axis++) {
-                    plotLine(cr, fieldMeta.gyroColors[axis], windowStartTime, windowEndTime, firstFrameIndex,
-                            flightLog->mainFieldIndexes.gyroADC[axis], gyroCurve, (int) (options.imageHeight * 0.25));
-                }
+    for (uint32_t outputFrameIndex = startFrame; outputFrameIndex < endFrame; outputFrameIndex++) {
+        uint32_t jobIndex = outputFrameIndex - startFrame;
+        renderFrameJob_t *job = &jobs[jobIndex % jobCount];
+        int64_t windowCenterTime = logStartTime + ((int64_t) outputFrameIndex * 1000000) / options.fps;
 
-                drawAxisLabel(cr, "Gyro");
-            }
+        // Wait for the frame that last used this job to be saved
+        if (jobIndex >= (uint32_t) jobCount) {
+            semaphore_wait(&job->done);
+            finishRenderJob(job, jobIndex - jobCount + 1, outputFrames);
         }
-        cairo_restore(cr);
 
-        //Draw a bar highlighting the current time if we are drawing any graphs
-        if (options.plotGyros || options.plotMotors || options.plotPids || options.plotPidSum) {
-            double centerX = options.imageWidth / 2.0;
+        job->outputFrameIndex = outputFrameIndex;
+        job->windowCenterTime = windowCenterTime;
+        job->timeElapsedMicros = outputFrameIndex > startFrame ? windowCenterTime - lastCenterTime : 0;
 
-            cairo_set_source_rgba(cr, 1, 0.25, 0.25, 0.2);
-            cairo_set_line_width(cr, 20);
+        job->haveCenterFrame = datapointsGetFrameAtIndex(points, datapointsFindFrameAtTime(points, windowCenterTime), &frameTime, job->centerFrame);
 
-            cairo_move_to(cr, centerX, 0);
-            cairo_line_to(cr, centerX, options.imageHeight);
-            cairo_stroke(cr);
+        // The smoothed readings and the prop positions depend on all of the frames before this one
+        if (job->haveCenterFrame) {
+            updateSmoothedReadings(&readings, job->centerFrame);
         }
 
-        int centerFrameIndex = datapointsFindFrameAtTime(points, windowCenterTime);
+        job->readings = readings;
+        memcpy(job->propAngles, propAngles, sizeof(propAngles));
 
-        //Draw the command stick positions from the centered frame
-        if (datapointsGetFrameAtIndex(points, centerFrameIndex, &frameTime, frameValues)) {
-            if (options.drawSticks) {
-                cairo_save(cr);
-                {
-                    cairo_translate(cr, 0.75 * options.imageWidth, 0.20 * options.imageHeight);
+        if (job->haveCenterFrame && options.drawCraft) {
+            double rotationThisFrame[MAX_MOTORS];
 
-                    drawCommandSticks(frameValues, options.imageWidth, options.imageHeight, cr);
-                }
-                cairo_restore(cr);
-            }
-
-            if (options.drawPidTable) {
-                cairo_save(cr);
-                {
-                    cairo_translate(cr, 0.25 * options.imageWidth, 0.75 * options.imageHeight);
-                    drawPIDTable(cr, frameValues);
-                }
-                cairo_restore(cr);
-            }
+            computePropRotation(job->centerFrame, job->timeElapsedMicros, &craftParameters, rotationThisFrame);
 
-            if (options.drawCraft) {
-                cairo_save(cr);
-                {
-                    cairo_translate(cr, 0.25 * options.imageWidth, 0.20 * options.imageHeight);
-                    drawCraft(cr, frameValues, outputFrameIndex > 0 ? windowCenterTime - lastCenterTime : 0, &craftParameters);
-                }
-                cairo_restore(cr);
-            }
-
-            drawAccelerometerData(cr, frameValues);
-
-            if (options.drawTime)
-                drawFrameLabel(cr, frameValues[FLIGHT_LOG_FIELD_INDEX_ITERATION], (uint32_t) ((windowCenterTime - flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_TIME].min) / 1000));
+            for (int i = 0; i < craftParameters.numMotors; i++)
+                propAngles[i] += rotationThisFrame[i];
         }
 
-        // Draw a synchronisation line
-        if (syncBeepTime >= windowStartTime && syncBeepTime < windowEndTime) {
-            double lineX = (double) ((int64_t) options.imageWidth * (syncBeepTime - windowStartTime) / windowWidthMicros);
+        lastCenterTime = windowCenterTime;
 
-            cairo_set_source_rgba(cr, 0.25, 0.25, 1, 0.2);
-            cairo_set_line_width(cr, 20);
+        workerpool_submit(pool, job);
+    }
 
-            cairo_move_to(cr, lineX, 0);
-            cairo_line_to(cr, lineX, options.imageHeight);
-            cairo_stroke(cr);
-        }
+    // Wait for the rest of the frames in the order they were submitted
+    for (uint32_t jobIndex = outputFrames > (uint32_t) jobCount ? outputFrames - jobCount : 0; jobIndex < outputFrames; jobIndex++) {
+        semaphore_wait(&jobs[jobIndex % jobCount].done);
+        finishRenderJob(&jobs[jobIndex % jobCount], jobIndex + 1, outputFrames);
+    }
 
-        cairo_destroy(cr);
+    workerpool_destroy(pool);
 
-        lastCenterTime = windowCenterTime;
+    for (int i = 0; i < jobCount; i++) {
+        semaphore_destroy(&jobs[i].done);
+        free(jobs[i].videoFrame);
+        free(jobs[i].centerFrame);
+    }
+    free(jobs);
+
+    if (videoWriter) {
+        FILE *file = videoWriter->file;
 
-        saveSurfaceAsync(surface, selectedLogIndex, outputFrameIndex);
+        videoWriterDestroy(videoWriter);
+        videoWriter = NULL;
 
-        uint32_t frameWrittenCount = outputFrameIndex - startFrame + 1;
-        if (frameWrittenCount % 500 == 0 || frameWrittenCount == outputFrames) {
-            fprintf(stderr, "Rendered %d frames (%.1f%%)%s\n",
-                frameWrittenCount, (double)frameWrittenCount / outputFrames * 100,
-                frameWrittenCount < outputFrames ? "..." : ".");
+        if (file != stdout) {
+            fclose(file);
         }
     }
 
-    waitForFramesToSave();
+    for (int i = 0; i < options.threads; i++) {
+        destroyRenderWorker(&workers[i]);
+    }
+    free(workers);
+    free(workerData);
 }
 
 void printUsage(const char *argv0)
@@ -1344,6 +1692,8 @@ void printUsage(const char *argv0)
         "   --fps                  FPS of the resulting video (default %d)\n"
         "   --threads              Number of threads to use to render frames (default %d)\n"
         "   --prefix <filename>    Set the prefix of the output frame filenames\n"
+        "   --format <name>        Output format: png files, or a y4m or raw rgba video stream (default %s)\n"
+        "   --output <filename>    Write the video stream here instead of to stdout (e.g. a FIFO)\n"
         "   --start <x:xx>         Begin the log at this time offset (default 0:00)\n"
         "   --end <x:xx>           End the log at this time offset\n"
         "   --[no-]draw-pid-table  Show table with PIDs and gyros (default on)\n"
@@ -1361,6 +1711,7 @@ void printUsage(const char *argv0)
         "   --gapless              Fill in gaps in the log with straight lines\n"
         "   --raw-amperage         Print the current sensor ADC value along with computed amperage\n"
         "\n", argv0, defaultOptions.imageWidth, defaultOptions.imageHeight, defaultOptions.fps, defaultOptions.threads,
+            VIDEO_FORMAT_NAME[defaultOptions.outputFormat],
             defaultOptions.pidSmoothing, defaultOptions.gyroSmoothing, defaultOptions.motorSmoothing,
             UNIT_NAME[defaultOptions.gyroUnit], PROP_STYLE_NAME[defaultOptions.propStyle]
     );
@@ -1428,7 +1779,9 @@ void parseCommandlineOptions(int argc, char **argv)
         SETTING_SMOOTHING_MOTOR,
         SETTING_UNIT_GYRO,
         SETTING_PROP_STYLE,
-        SETTING_THREADS
+        SETTING_THREADS,
+        SETTING_FORMAT,
+        SETTING_OUTPUT
     };
 
     memcpy(&options, &defaultOptions, sizeof(options));
@@ -1442,6 +1795,8 @@ void parseCommandlineOptions(int argc, char **argv)
             {"height", required_argument, 0, SETTING_HEIGHT},
             {"fps", required_argument, 0, SETTING_FPS},
             {"prefix", required_argument, 0, SETTING_PREFIX},
+            {"format", required_argument, 0, SETTING_FORMAT},
+            {"output", required_argument, 0, SETTING_OUTPUT},
             {"start", required_argument, 0, SETTING_START},
             {"end", required_argument, 0, SETTING_END},
             {"plot-pid", no_argument, &options.plotPids, 1},
@@ -1501,6 +1856,21 @@ void parseCommandlineOptions(int argc, char **argv)
             case SETTING_PREFIX:
                 options.outputPrefix = optarg;
             break;
+            case SETTING_FORMAT:
+                if (strcmp(optarg, "png") == 0) {
+                    options.outputFormat = VIDEO_FORMAT_PNG;
+                } else if (strcmp(optarg, "y4m") == 0) {
+                    options.outputFormat = VIDEO_FORMAT_Y4M;
+                } else if (strcmp(optarg, "rgba") == 0) {
+                    options.outputFormat = VIDEO_FORMAT_RGBA;
+                } else {
+                    fprintf(stderr, "Bad --format value (expected png, y4m or rgba)\n");
+                    exit(-1);
+                }
+            break;
+            case SETTING_OUTPUT:
+                options.outputFilename = optarg;
+            break;
             case SETTING_SMOOTHING_PID:
                 options.pidSmoothing = atoi(optarg);
             break;
@@ -1575,16 +1945,43 @@ static void applySmoothing() {
     }
 }
 
+/**
+ * Summarise the fields that we'll be plotting, so that plotLine() can draw them without visiting every frame.
+ */
+static void buildPlotSummaries() {
+    if (options.plotMotors) {
+        for (int motor = 0; motor < fieldMeta.numMotors; motor++)
+            datapointsBuildFieldSummary(points, flightLog->mainFieldIndexes.motor[motor]);
+
+        for (int servo = 0; servo < MAX_SERVOS; servo++)
+            if (flightLog->mainFieldIndexes.servo[servo] > -1)
+                datapointsBuildFieldSummary(points, flightLog->mainFieldIndexes.servo[servo]);
+    }
+
+    if (options.plotPids) {
+        for (int pid = PID_P; pid <= PID_D; pid++)
+            for (int axis = 0; axis < 3; axis++)
+                if (flightLog->mainFieldIndexes.pid[pid][axis] > -1)
+                    datapointsBuildFieldSummary(points, flightLog->mainFieldIndexes.pid[pid][axis]);
+    }
+
+    if (options.plotGyros && fieldMeta.hasGyros) {
+        for (int axis = 0; axis < 3; axis++)
+            datapointsBuildFieldSummary(points, flightLog->mainFieldIndexes.gyroADC[axis]);
+    }
+}
+
 void computeExtraFields(void) {
     int16_t accSmooth[3], gyroADC[3], magADC[3];
     int64_t frameTime, lastFrameTime = 0;
     int32_t frameIndex;
-    int64_t frame[FLIGHT_LOG_MAX_FIELDS];
+    int64_t *frame = malloc(points->fieldCount * sizeof(*frame));
     double cumulativeCurrent = 0.0; // in milliamp-hours
     attitude_t attitude;
+    imuState_t imu;
     bool calculateAttitude = fieldMeta.hasGyros && fieldMeta.hasAccs && flightLog->sysConfig.acc_1G;
 
-    imuInit();
+    imuInit(&imu);
 
     for (frameIndex = 0; frameIndex < points->frameCount; frameIndex++) {
         if (datapointsGetFrameAtIndex(points, frameIndex, &frameTime, frame)) {
@@ -1600,7 +1997,7 @@ void computeExtraFields(void) {
                     }
                 }
 
-                updateEstimatedAttitude(gyroADC, accSmooth, fieldMeta.hasMagADC ? magADC : 0, (uint32_t) frameTime, flightLog->sysConfig.acc_1G, flightLog->sysConfig.gyroScale, &attitude);
+                updateEstimatedAttitude(&imu, gyroADC, accSmooth, fieldMeta.hasMagADC ? magADC : 0, (uint32_t) frameTime, flightLog->sysConfig.acc_1G, flightLog->sysConfig.gyroScale, &attitude);
 
                 //Pack those floats into signed ints to store into the datapoints array:
                 datapointsSetFieldAtIndex(points, frameIndex, fieldMeta.roll, floatToInt(attitude.roll));
@@ -1628,6 +2025,8 @@ void computeExtraFields(void) {
             lastFrameTime = frameTime;
         }
     }
+
+    free(frame);
 }
 
 int chooseLog(flightLog_t *log)
@@ -1637,6 +2036,27 @@ int chooseLog(flightLog_t *log)
         return -1;
     }
 
+    /*
+     * Logs that are decompressed as they're read are read in order, so we only find each log once we've read past the
+     * one before it.
+     */
+    if (log->private->stream->source) {
+        int logIndex = 0;
+
+        while (logIndex < options.logNumber - 1) {
+            flightLogParse(log, logIndex, NULL, NULL, NULL, false);
+
+            if (!flightLogBeginNextLog(log)) {
+                fprintf(stderr, "Couldn't load log #%d from this file, because there are only %d logs in total.\n", options.logNumber, log->logCount);
+                return -1;
+            }
+
+            logIndex++;
+        }
+
+        return logIndex;
+    }
+
     //Did the user pick a log to render?
     if (options.logNumber > 0) {
         if (options.logNumber > log->logCount) {
@@ -1653,7 +2073,7 @@ int chooseLog(flightLog_t *log)
 
         fprintf(stderr, "Index  Start offset  Size (bytes)\n");
         for (int i = 0; i < log->logCount; i++) {
-            fprintf(stderr, "%5d %13d %13d\n", i + 1, (int) (log->logBegin[i] - log->logBegin[0]), (int) (log->logBegin[i + 1] - log->logBegin[i]));
+            fprintf(stderr, "%5d %13" PRId64 " %13" PRId64 "\n", i + 1, (int64_t) (log->logBegin[i] - log->logBegin[0]), (int64_t) (log->logBegin[i + 1] - log->logBegin[i]));
         }
 
         return -1;
@@ -1664,7 +2084,6 @@ int main(int argc, char **argv)
 {
     struct stat directoryStat;
     char outputDirectory[256];
-    char **fieldNames;
     uint32_t frameStart, frameEnd;
     int fd;
 
@@ -1695,7 +2114,7 @@ int main(int argc, char **argv)
         return -1;
 
     //If the user didn't supply an output filename prefix, create our own based on the input filename
-    if (!options.outputPrefix) {
+    if (options.outputFormat == VIDEO_FORMAT_PNG && !options.outputPrefix) {
         char *fileExtensionPeriod = strrchr(options.filename, '.');
         char *fileSlash = strrchr(options.filename, '/');
         char *logNameStart, *logNameEnd;
@@ -1725,59 +2144,27 @@ int main(int argc, char **argv)
         snprintf(options.outputPrefix, 256, "%s/%.*s", outputDirectory, (int) (logNameEnd - logNameStart), logNameStart);
     }
 
-    //First check out how many frames we need to store so we can pre-allocate (parsing will update the flightlog stats which contain that info)
-    flightLogParse(flightLog, selectedLogIndex, NULL, NULL, NULL, false);
-
-    // Assign field indexes to the fields we'll add
-    int newFieldIndex = flightLog->frameDefs['I'].fieldCount, combinedFieldCount;
-
-    fieldMeta.roll = newFieldIndex++;
-    fieldMeta.pitch = newFieldIndex++;
-    fieldMeta.heading = newFieldIndex++;
-
-    fieldMeta.axisPIDSum[0] = newFieldIndex++;
-    fieldMeta.axisPIDSum[1] = newFieldIndex++;
-    fieldMeta.axisPIDSum[2] = newFieldIndex++;
-
-    if (flightLog->mainFieldIndexes.amperageLatest > -1) {
-        fieldMeta.cumulativeCurrent = newFieldIndex++;
-    } else {
-        fieldMeta.cumulativeCurrent = -1;
-    }
-
-    combinedFieldCount = newFieldIndex;
-
-    // Create a copy of the array of field names so we can add our custom fields to it
-    fieldNames = malloc(sizeof(*fieldNames) * combinedFieldCount);
-
-    for (int i = 0; i < flightLog->frameDefs['I'].fieldCount; i++) {
-        fieldNames[i] = strdup(flightLog->frameDefs['I'].fieldName[i]);
-    }
+    /*
+     * Now decode the flight log into the points array, which is created once we've read the log's headers. This always
+     * decodes the whole log even with --start, because the attitude and the current drawn that computeExtraFields()
+     * works out are accumulated from the first frame onwards (so the seek index can't help us here).
+     */
+    flightLogSetFrameBlockHandler(flightLog, FLIGHT_LOG_FRAME_BLOCK_LENGTH, loadFrameBlockIntoPoints);
+    flightLogParse(flightLog, selectedLogIndex, createPoints, NULL, onLogEvent, false);
 
-    // And add our synthetic field names
-    fieldNames[fieldMeta.roll] = strdup("roll");
-    fieldNames[fieldMeta.pitch] = strdup("pitch");
-    fieldNames[fieldMeta.heading] = strdup("heading");
-    fieldNames[fieldMeta.axisPIDSum[0]] = strdup("axisPID[0]");
-    fieldNames[fieldMeta.axisPIDSum[1]] = strdup("axisPID[1]");
-    fieldNames[fieldMeta.axisPIDSum[2]] = strdup("axisPID[2]");
-
-    if (fieldMeta.cumulativeCurrent > -1) {
-        fieldNames[fieldMeta.cumulativeCurrent] = strdup("cumulativeCurrent");
+    if (!points) {
+        fprintf(stderr, "Error: Couldn't read the headers of this log.\n");
+        return -1;
     }
 
-    // Create the pre-allocated array of frames that we'll decode into
-    points = datapointsCreate(combinedFieldCount, fieldNames, (int) (flightLog->stats.field[FLIGHT_LOG_FIELD_INDEX_ITERATION].max + 1));
-
-    //Now decode the flight log into the points array
-    flightLogParse(flightLog, selectedLogIndex, 0, loadFrameIntoPoints, onLogEvent, false);
-
     updateFieldMetadata();
 
     computeExtraFields();
 
     applySmoothing();
 
+    buildPlotSummaries();
+
     frameStart = options.timeStart * options.fps;
 
     if (options.timeEnd == 0)
@@ -0,0 +1,269 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "csvwriter.h"
+
+#define CSV_WRITER_BUFFER_SIZE (256 * 1024)
+
+// Room for the longest integer we format (a 64-bit value with sign) plus its padding
+#define CSV_WRITER_MAX_INTEGER_LENGTH 32
+
+/*
+ * Fixed point values smaller in magnitude than this are exactly representable as a double to better than their
+ * number of decimal places, so printf("%.Nf", value / 10^N) always prints them exactly.
+ */
+#define CSV_WRITER_MAX_EXACT_FIXED_POINT (INT64_C(1) << 52)
+
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint32_t POWERS_OF_TEN[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/**
+ * Format the decimal digits of value so that they end just before `end`, returning a pointer to the first digit.
+ */
+static char* formatDigits(char *end, uint64_t value)
+{
+    char *pos = end;
+
+    while (value >= 100) {
+        unsigned pair = (unsigned) (value % 100) * 2;
+
+        value /= 100;
+        pos -= 2;
+        memcpy(pos, DIGIT_PAIRS + pair, 2);
+    }
+
+    if (value >= 10) {
+        pos -= 2;
+        memcpy(pos, DIGIT_PAIRS + value * 2, 2);
+    } else {
+        *--pos = '0' + value;
+    }
+
+    return pos;
+}
+
+/**
+ * Make sure that there's room for `length` more bytes in the buffer and return a pointer to where they should go.
+ */
+static char* csvWriterReserve(csvWriter_t *writer, size_t length)
+{
+    if (writer->length + length > writer->capacity) {
+        csvWriterFlush(writer);
+    }
+
+    return writer->buffer + writer->length;
+}
+
+void csvWriterWriteChar(csvWriter_t *writer, char c)
+{
+    *csvWriterReserve(writer, 1) = c;
+    writer->length++;
+}
+
+void csvWriterWriteString(csvWriter_t *writer, const char *s)
+{
+    size_t length = strlen(s);
+
+    if (writer->length + length > writer->capacity) {
+        csvWriterFlush(writer);
+
+        if (length > writer->capacity) {
+            fwrite(s, 1, length, writer->file);
+            return;
+        }
+    }
+
+    memcpy(writer->buffer + writer->length, s, length);
+    writer->length += length;
+}
+
+static void csvWriterWriteDigits(csvWriter_t *writer, bool negative, uint64_t magnitude, int width)
+{
+    char digits[CSV_WRITER_MAX_INTEGER_LENGTH];
+    char *end = digits + sizeof(digits);
+    char *start = formatDigits(end, magnitude);
+    int length = (end - start) + (negative ? 1 : 0);
+    char *dest;
+
+    if (width > CSV_WRITER_MAX_INTEGER_LENGTH) {
+        width = CSV_WRITER_MAX_INTEGER_LENGTH;
+    }
+
+    dest = csvWriterReserve(writer, CSV_WRITER_MAX_INTEGER_LENGTH);
+
+    // Right-align in the field like printf's minimum width does
+    for (; length < width; width--) {
+        *dest++ = ' ';
+    }
+
+    if (negative) {
+        *dest++ = '-';
+    }
+
+    memcpy(dest, start, end - start);
+    dest += end - start;
+
+    writer->length = dest - writer->buffer;
+}
+
+/**
+ * Equivalent to printf("%*" PRId64, width, value).
+ */
+void csvWriterWriteInt(csvWriter_t *writer, int64_t value, int width)
+{
+    // Negate in unsigned arithmetic so that INT64_MIN doesn't overflow
+    csvWriterWriteDigits(writer, value < 0, value < 0 ? -(uint64_t) value : (uint64_t) value, width);
+}
+
+/**
+ * Equivalent to printf("%*" PRIu64, width, value).
+ */
+void csvWriterWriteUnsigned(csvWriter_t *writer, uint64_t value, int width)
+{
+    csvWriterWriteDigits(writer, false, value, width);
+}
+
+/**
+ * Equivalent to printf("%0*u", digits, value).
+ */
+void csvWriterWriteZeroPadded(csvWriter_t *writer, uint32_t value, int digits)
+{
+    char formatted[CSV_WRITER_MAX_INTEGER_LENGTH];
+    char *end = formatted + sizeof(formatted);
+    char *start = formatDigits(end, value);
+    char *dest = csvWriterReserve(writer, CSV_WRITER_MAX_INTEGER_LENGTH);
+
+    if (digits > CSV_WRITER_MAX_INTEGER_LENGTH) {
+        digits = CSV_WRITER_MAX_INTEGER_LENGTH;
+    }
+
+    for (int length = end - start; length < digits; length++) {
+        *dest++ = '0';
+    }
+
+    memcpy(dest, start, end - start);
+    dest += end - start;
+
+    writer->length = dest - writer->buffer;
+}
+
+/**
+ * Equivalent to printf("%.*f", decimals, (double) value / 10^decimals), for decimals in 1..9.
+ */
+void csvWriterWriteFixedPoint(csvWriter_t *writer, int64_t value, int decimals)
+{
+    uint32_t divisor = POWERS_OF_TEN[decimals];
+    uint64_t magnitude;
+
+    if (value <= -CSV_WRITER_MAX_EXACT_FIXED_POINT || value >= CSV_WRITER_MAX_EXACT_FIXED_POINT) {
+        // Rounding of the double might come into play, so let printf handle it
+        csvWriterWriteDouble(writer, (double) value / divisor, decimals);
+        return;
+    }
+
+    magnitude = value < 0 ? -(uint64_t) value : (uint64_t) value;
+
+    csvWriterWriteDigits(writer, value < 0, magnitude / divisor, 0);
+    csvWriterWriteChar(writer, '.');
+    csvWriterWriteZeroPadded(writer, magnitude % divisor, decimals);
+}
+
+/**
+ * Equivalent to printf("%.*f", decimals, value).
+ */
+void csvWriterWriteDouble(csvWriter_t *writer, double value, int decimals)
+{
+    csvWriterPrintf(writer, "%.*f", decimals, value);
+}
+
+void csvWriterPrintf(csvWriter_t *writer, const char *format, ...)
+{
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(writer->buffer + writer->length, writer->capacity - writer->length, format, args);
+    va_end(args);
+
+    if (length < 0) {
+        return;
+    }
+
+    if ((size_t) length >= writer->capacity - writer->length) {
+        // Didn't fit, so make room and try again
+        csvWriterFlush(writer);
+
+        if ((size_t) length >= writer->capacity) {
+            char *formatted = malloc(length + 1);
+
+            va_start(args, format);
+            vsnprintf(formatted, length + 1, format, args);
+            va_end(args);
+
+            fwrite(formatted, 1, length, writer->file);
+            free(formatted);
+
+            return;
+        }
+
+        va_start(args, format);
+        vsnprintf(writer->buffer, writer->capacity, format, args);
+        va_end(args);
+    }
+
+    writer->length += length;
+}
+
+void csvWriterFlush(csvWriter_t *writer)
+{
+    if (writer->length > 0) {
+        fwrite(writer->buffer, 1, writer->length, writer->file);
+        writer->length = 0;
+    }
+}
+
+csvWriter_t* csvWriterCreate(FILE *file)
+{
+    csvWriter_t *result = malloc(sizeof(*result));
+
+    result->file = file;
+    result->length = 0;
+    result->capacity = CSV_WRITER_BUFFER_SIZE;
+    result->buffer = malloc(result->capacity);
+
+    if (!result->buffer) {
+        fprintf(stderr, "Failed to allocate output buffer\n");
+        exit(-1);
+    }
+
+    return result;
+}
+
+/**
+ * Write out anything that's still buffered and free the writer. The file is left open.
+ */
+void csvWriterDestroy(csvWriter_t *writer)
+{
+    if (!writer)
+        return;
+
+    csvWriterFlush(writer);
+
+    free(writer->buffer);
+    free(writer);
+}
@@ -0,0 +1,33 @@
+#ifndef CSVWRITER_H_
+#define CSVWRITER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Buffers formatted text in memory and writes it to the file in large chunks. Numbers are formatted without going
+ * through printf, but produce exactly the same text as the printf formats noted on each routine.
+ */
+typedef struct csvWriter_t {
+    FILE *file;
+
+    char *buffer;
+    size_t length, capacity;
+} csvWriter_t;
+
+csvWriter_t* csvWriterCreate(FILE *file);
+void csvWriterFlush(csvWriter_t *writer);
+void csvWriterDestroy(csvWriter_t *writer);
+
+void csvWriterWriteChar(csvWriter_t *writer, char c);
+void csvWriterWriteString(csvWriter_t *writer, const char *s);
+
+void csvWriterWriteInt(csvWriter_t *writer, int64_t value, int width);
+void csvWriterWriteUnsigned(csvWriter_t *writer, uint64_t value, int width);
+void csvWriterWriteZeroPadded(csvWriter_t *writer, uint32_t value, int digits);
+void csvWriterWriteFixedPoint(csvWriter_t *writer, int64_t value, int decimals);
+void csvWriterWriteDouble(csvWriter_t *writer, double value, int decimals);
+
+void csvWriterPrintf(csvWriter_t *writer, const char *format, ...);
+
+#endif
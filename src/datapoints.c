@@ -6,31 +6,243 @@
 #include "datapoints.h"
 #include "parser.h"
 
-datapoints_t *datapointsCreate(int fieldCount, char **fieldNames, int frameCapacity)
+// The finest level of the min/max summary pyramid, blocks smaller than this are cheap enough to scan directly
+#define DATAPOINTS_SUMMARY_MIN_LEVEL 3
+
+/**
+ * Get the number of bytes needed to store every value in the range [min...max].
+ */
+static int datapointsWidthForRange(int64_t min, int64_t max)
+{
+    if (min >= INT16_MIN && max <= INT16_MAX)
+        return sizeof(int16_t);
+
+    if (min >= INT32_MIN && max <= INT32_MAX)
+        return sizeof(int32_t);
+
+    return sizeof(int64_t);
+}
+
+#define DATAPOINTS_CHUNK_MASK (DATAPOINTS_CHUNK_FRAMES - 1)
+
+static void* datapointsReallocate(void *data, size_t size)
+{
+    void *result = realloc(data, size);
+
+    if (!result) {
+        fprintf(stderr, "Failed to allocate memory for datapoints\n");
+        exit(-1);
+    }
+
+    return result;
+}
+
+static inline int64_t datapointsChunkGet(const void *chunk, int width, int offset)
+{
+    switch (width) {
+        case sizeof(int16_t):
+            return ((const int16_t*) chunk)[offset];
+        case sizeof(int32_t):
+            return ((const int32_t*) chunk)[offset];
+        default:
+            return ((const int64_t*) chunk)[offset];
+    }
+}
+
+/**
+ * Store `count` values into the chunk beginning at `offset`, truncating them to the chunk's width. If `values` is NULL
+ * the frames are set to zero instead.
+ */
+static void datapointsChunkStore(void *chunk, int width, int offset, const int64_t *values, int count)
+{
+    if (!values) {
+        memset((char*) chunk + (size_t) offset * width, 0, (size_t) count * width);
+        return;
+    }
+
+    switch (width) {
+        case sizeof(int16_t):
+            for (int i = 0; i < count; i++) {
+                ((int16_t*) chunk)[offset + i] = (int16_t) values[i];
+            }
+        break;
+        case sizeof(int32_t):
+            for (int i = 0; i < count; i++) {
+                ((int32_t*) chunk)[offset + i] = (int32_t) values[i];
+            }
+        break;
+        default:
+            memcpy((int64_t*) chunk + offset, values, count * sizeof(*values));
+    }
+}
+
+static inline int64_t datapointsColumnGet(const datapointsColumn_t *column, int frameIndex)
+{
+    return datapointsChunkGet(column->chunks[frameIndex >> DATAPOINTS_CHUNK_SHIFT], column->width, frameIndex & DATAPOINTS_CHUNK_MASK);
+}
+
+static inline int64_t datapointsFrameTime(const datapoints_t *points, int frameIndex)
+{
+    return points->frameTime[frameIndex >> DATAPOINTS_CHUNK_SHIFT][frameIndex & DATAPOINTS_CHUNK_MASK];
+}
+
+static inline uint8_t datapointsFrameGap(const datapoints_t *points, int frameIndex)
+{
+    return points->frameGap[frameIndex >> DATAPOINTS_CHUNK_SHIFT][frameIndex & DATAPOINTS_CHUNK_MASK];
+}
+
+/**
+ * Reallocate the column's chunks with values of the given width, converting the values for the frames we already have.
+ */
+static void datapointsColumnResize(datapoints_t *points, datapointsColumn_t *column, int width)
+{
+    for (int chunk = 0; chunk < points->chunkCount; chunk++) {
+        int64_t values[256];
+        int chunkFrames = points->frameCount - chunk * DATAPOINTS_CHUNK_FRAMES;
+        void *resized = datapointsReallocate(NULL, (size_t) width * DATAPOINTS_CHUNK_FRAMES);
+
+        if (chunkFrames > DATAPOINTS_CHUNK_FRAMES) {
+            chunkFrames = DATAPOINTS_CHUNK_FRAMES;
+        }
+
+        for (int i = 0; i < chunkFrames; i += 256) {
+            int count = chunkFrames - i < 256 ? chunkFrames - i : 256;
+
+            for (int j = 0; j < count; j++) {
+                values[j] = datapointsChunkGet(column->chunks[chunk], column->width, i + j);
+            }
+
+            datapointsChunkStore(resized, width, i, values, count);
+        }
+
+        free(column->chunks[chunk]);
+        column->chunks[chunk] = resized;
+    }
+
+    column->width = width;
+}
+
+static void datapointsFreeSummary(datapointsColumn_t *column)
+{
+    for (int i = 0; i < column->summaryLevelCount; i++) {
+        free(column->summary[i].minFrame);
+        free(column->summary[i].maxFrame);
+    }
+
+    free(column->summary);
+
+    column->summary = NULL;
+    column->summaryLevelCount = 0;
+}
+
+static inline void datapointsColumnSet(datapoints_t *points, datapointsColumn_t *column, int frameIndex, int64_t value)
+{
+    // Any summary of the old values is now out of date
+    if (column->summary) {
+        datapointsFreeSummary(column);
+    }
+
+    // Widen the column first if the value doesn't fit in it
+    if (datapointsWidthForRange(value, value) > column->width) {
+        datapointsColumnResize(points, column, datapointsWidthForRange(value, value));
+    }
+
+    datapointsChunkStore(column->chunks[frameIndex >> DATAPOINTS_CHUNK_SHIFT], column->width, frameIndex & DATAPOINTS_CHUNK_MASK, &value, 1);
+}
+
+/**
+ * Allocate chunks until there's room for `frameCount` frames.
+ */
+static void datapointsReserve(datapoints_t *points, int frameCount)
+{
+    while (points->chunkCount * (int64_t) DATAPOINTS_CHUNK_FRAMES < frameCount) {
+        int chunk = points->chunkCount;
+
+        // Only the lists of chunks are moved when they grow, never the frames themselves
+        if (chunk == points->chunkListCapacity) {
+            points->chunkListCapacity = points->chunkListCapacity > 0 ? points->chunkListCapacity * 2 : 8;
+
+            points->frameTime = datapointsReallocate(points->frameTime, sizeof(*points->frameTime) * points->chunkListCapacity);
+            points->frameGap = datapointsReallocate(points->frameGap, sizeof(*points->frameGap) * points->chunkListCapacity);
+
+            for (int i = 0; i < points->fieldCount; i++) {
+                points->fields[i].chunks = datapointsReallocate(points->fields[i].chunks, sizeof(*points->fields[i].chunks) * points->chunkListCapacity);
+            }
+        }
+
+        points->frameTime[chunk] = datapointsReallocate(NULL, sizeof(**points->frameTime) * DATAPOINTS_CHUNK_FRAMES);
+        points->frameGap[chunk] = datapointsReallocate(NULL, sizeof(**points->frameGap) * DATAPOINTS_CHUNK_FRAMES);
+        memset(points->frameGap[chunk], 0, sizeof(**points->frameGap) * DATAPOINTS_CHUNK_FRAMES);
+
+        for (int i = 0; i < points->fieldCount; i++) {
+            points->fields[i].chunks[chunk] = datapointsReallocate(NULL, (size_t) points->fields[i].width * DATAPOINTS_CHUNK_FRAMES);
+        }
+
+        points->chunkCount++;
+    }
+}
+
+/**
+ * Create an empty set of datapoints, which can hold up to `frameLimit` frames. Storage is allocated a chunk at a time
+ * as frames are added, so the limit doesn't need to be known in advance (INT_MAX is fine).
+ */
+datapoints_t *datapointsCreate(int fieldCount, char **fieldNames, int frameLimit)
 {
-    datapoints_t *result = (datapoints_t*) malloc(sizeof(datapoints_t));
+    datapoints_t *result = (datapoints_t*) calloc(1, sizeof(datapoints_t));
 
     result->fieldCount = fieldCount;
     result->fieldNames = fieldNames;
 
     result->frameCount = 0;
-    result->frameCapacity = frameCapacity;
+    result->frameLimit = frameLimit;
 
-    result->frames = malloc(sizeof(*result->frames) * fieldCount * frameCapacity);
-    result->frameTime = calloc(1, sizeof(*result->frameTime) * frameCapacity);
-    result->frameGap = calloc(1, sizeof(*result->frameGap) * frameCapacity);
+    result->fields = calloc(fieldCount, sizeof(*result->fields));
+
+    // Start every field out at the narrowest width, it'll be widened as needed when values are added
+    for (int i = 0; i < fieldCount; i++) {
+        result->fields[i].width = sizeof(int16_t);
+    }
 
     return result;
 }
 
 void datapointsDestroy(datapoints_t *points)
 {
-    free(points->frames);
+    for (int i = 0; i < points->fieldCount; i++) {
+        datapointsFreeSummary(&points->fields[i]);
+
+        for (int chunk = 0; chunk < points->chunkCount; chunk++) {
+            free(points->fields[i].chunks[chunk]);
+        }
+
+        free(points->fields[i].chunks);
+    }
+
+    for (int chunk = 0; chunk < points->chunkCount; chunk++) {
+        free(points->frameTime[chunk]);
+        free(points->frameGap[chunk]);
+    }
+
+    free(points->fields);
     free(points->frameTime);
     free(points->frameGap);
     free(points);
 }
 
+/**
+ * Let the datapoints know the range of values that the field will hold, so that its storage can be sized to suit
+ * up-front instead of being widened as frames are added. This must be called before any frames are added.
+ */
+bool datapointsSetFieldRange(datapoints_t *points, int fieldIndex, int64_t min, int64_t max)
+{
+    if (fieldIndex < 0 || fieldIndex >= points->fieldCount || points->frameCount > 0)
+        return false;
+
+    datapointsColumnResize(points, &points->fields[fieldIndex], datapointsWidthForRange(min, max));
+
+    return true;
+}
+
 /**
  * Smooth the values for the field with the given index by replacing each value with an
  * average over the a window of width (windowRadius*2+1) centered at the point.
@@ -42,12 +254,15 @@ void datapointsSmoothField(datapoints_t *points, int fieldIndex, int windowRadiu
     int valuesInHistory = 0;
 
     int64_t accumulator;
+    datapointsColumn_t *column;
 
     if (fieldIndex < 0 || fieldIndex >= points->fieldCount) {
         fprintf(stderr, "Attempt to smooth field that doesn't exist %d\n", fieldIndex);
         exit(-1);
     }
 
+    column = &points->fields[fieldIndex];
+
     // Field values so that we know what they were originally before we overwrote them
     int64_t *history = (int64_t*) malloc(sizeof(*history) * windowSize);
     int historyHead = 0; //Points to the next location to insert into
@@ -90,7 +305,7 @@ void datapointsSmoothField(datapoints_t *points, int fieldIndex, int windowRadiu
 
             //New value is added to the window
             if (windowRightIndex < partitionRight) {
-                int64_t fieldValue = points->frames[points->fieldCount * windowRightIndex + fieldIndex];
+                int64_t fieldValue = datapointsColumnGet(column, windowRightIndex);
 
                 accumulator += fieldValue;
 
@@ -100,13 +315,13 @@ void datapointsSmoothField(datapoints_t *points, int fieldIndex, int windowRadiu
                 valuesInHistory++;
 
                 //If there is a discontinuity after this point, adjust the right edge of the partition so we stop looking further
-                if (points->frameGap[windowRightIndex])
+                if (datapointsFrameGap(points, windowRightIndex))
                     partitionRight = windowRightIndex + 1;
             }
 
             // Store the average of the history window into the frame in the center of the window
             if (windowCenterIndex >= partitionLeft) {
-                points->frames[points->fieldCount * windowCenterIndex + fieldIndex] = accumulator / valuesInHistory;
+                datapointsColumnSet(points, column, windowCenterIndex, accumulator / valuesInHistory);
             }
         }
     }
@@ -114,6 +329,167 @@ void datapointsSmoothField(datapoints_t *points, int fieldIndex, int windowRadiu
     free(history);
 }
 
+/**
+ * Build a pyramid of the smallest and largest values of the field over aligned blocks of frames, which lets
+ * datapointsGetFieldExtremesInRange() answer queries without visiting every frame in the range. The summary is
+ * discarded if any value of the field is changed afterwards.
+ */
+void datapointsBuildFieldSummary(datapoints_t *points, int fieldIndex)
+{
+    datapointsColumn_t *column;
+    int levelCount = 0;
+
+    if (fieldIndex < 0 || fieldIndex >= points->fieldCount) {
+        fprintf(stderr, "Attempt to summarise field that doesn't exist %d\n", fieldIndex);
+        exit(-1);
+    }
+
+    column = &points->fields[fieldIndex];
+
+    datapointsFreeSummary(column);
+
+    while ((points->frameCount >> (DATAPOINTS_SUMMARY_MIN_LEVEL + levelCount)) > 0) {
+        levelCount++;
+    }
+
+    if (levelCount == 0)
+        return;
+
+    column->summary = calloc(levelCount, sizeof(*column->summary));
+    column->summaryLevelCount = levelCount;
+
+    for (int level = 0; level < levelCount; level++) {
+        datapointsSummaryLevel_t *summary = &column->summary[level];
+        int blockCount = points->frameCount >> (DATAPOINTS_SUMMARY_MIN_LEVEL + level);
+
+        summary->minFrame = malloc(sizeof(*summary->minFrame) * blockCount);
+        summary->maxFrame = malloc(sizeof(*summary->maxFrame) * blockCount);
+
+        if (!summary->minFrame || !summary->maxFrame) {
+            fprintf(stderr, "Failed to allocate memory for datapoints summary\n");
+            exit(-1);
+        }
+
+        for (int block = 0; block < blockCount; block++) {
+            int minFrame, maxFrame;
+
+            if (level == 0) {
+                int blockStart = block << DATAPOINTS_SUMMARY_MIN_LEVEL;
+
+                minFrame = maxFrame = blockStart;
+
+                for (int i = blockStart + 1; i < blockStart + (1 << DATAPOINTS_SUMMARY_MIN_LEVEL); i++) {
+                    int64_t value = datapointsColumnGet(column, i);
+
+                    if (value < datapointsColumnGet(column, minFrame))
+                        minFrame = i;
+                    if (value > datapointsColumnGet(column, maxFrame))
+                        maxFrame = i;
+                }
+            } else {
+                // Combine the two blocks from the level below, preferring the earlier frame on ties
+                datapointsSummaryLevel_t *children = &column->summary[level - 1];
+                int left = block * 2, right = block * 2 + 1;
+
+                minFrame = datapointsColumnGet(column, children->minFrame[right]) < datapointsColumnGet(column, children->minFrame[left])
+                    ? children->minFrame[right] : children->minFrame[left];
+                maxFrame = datapointsColumnGet(column, children->maxFrame[right]) > datapointsColumnGet(column, children->maxFrame[left])
+                    ? children->maxFrame[right] : children->maxFrame[left];
+            }
+
+            summary->minFrame[block] = minFrame;
+            summary->maxFrame[block] = maxFrame;
+        }
+    }
+}
+
+bool datapointsHasFieldSummary(datapoints_t *points, int fieldIndex)
+{
+    return fieldIndex >= 0 && fieldIndex < points->fieldCount && points->fields[fieldIndex].summary != NULL;
+}
+
+/**
+ * Check if the log has a gap between any two consecutive frames in [firstFrame...lastFrame].
+ */
+bool datapointsHasGapInRange(datapoints_t *points, int firstFrame, int lastFrame)
+{
+    if (firstFrame < 0)
+        firstFrame = 0;
+    if (lastFrame > points->frameCount)
+        lastFrame = points->frameCount;
+
+    // Search each chunk's part of the range in turn
+    while (firstFrame < lastFrame) {
+        int offset = firstFrame & DATAPOINTS_CHUNK_MASK;
+        int length = lastFrame - firstFrame < DATAPOINTS_CHUNK_FRAMES - offset ? lastFrame - firstFrame : DATAPOINTS_CHUNK_FRAMES - offset;
+
+        if (memchr(points->frameGap[firstFrame >> DATAPOINTS_CHUNK_SHIFT] + offset, 1, length)) {
+            return true;
+        }
+
+        firstFrame += length;
+    }
+
+    return false;
+}
+
+/**
+ * Find the frames with the smallest and largest values of the field in [firstFrame...lastFrame]. When the field has
+ * several frames with the same extreme value, the earliest one is returned.
+ */
+bool datapointsGetFieldExtremesInRange(datapoints_t *points, int fieldIndex, int firstFrame, int lastFrame, int *minFrame, int *maxFrame)
+{
+    datapointsColumn_t *column;
+    int64_t minValue, maxValue;
+
+    if (fieldIndex < 0 || fieldIndex >= points->fieldCount || firstFrame < 0 || lastFrame >= points->frameCount
+            || firstFrame > lastFrame)
+        return false;
+
+    column = &points->fields[fieldIndex];
+
+    *minFrame = *maxFrame = firstFrame;
+    minValue = maxValue = datapointsColumnGet(column, firstFrame);
+
+    for (int frameIndex = firstFrame + 1; frameIndex <= lastFrame; ) {
+        int blockMin = frameIndex, blockMax = frameIndex;
+        int level = -1;
+        int64_t value;
+
+        // Use the largest block of the summary that starts here and doesn't extend past the end of the range
+        while (level + 1 < column->summaryLevelCount) {
+            int blockSize = 1 << (DATAPOINTS_SUMMARY_MIN_LEVEL + level + 1);
+
+            if ((frameIndex & (blockSize - 1)) != 0 || frameIndex + blockSize - 1 > lastFrame)
+                break;
+
+            level++;
+        }
+
+        if (level >= 0) {
+            blockMin = column->summary[level].minFrame[frameIndex >> (DATAPOINTS_SUMMARY_MIN_LEVEL + level)];
+            blockMax = column->summary[level].maxFrame[frameIndex >> (DATAPOINTS_SUMMARY_MIN_LEVEL + level)];
+            frameIndex += 1 << (DATAPOINTS_SUMMARY_MIN_LEVEL + level);
+        } else {
+            frameIndex++;
+        }
+
+        value = datapointsColumnGet(column, blockMin);
+        if (value < minValue) {
+            minValue = value;
+            *minFrame = blockMin;
+        }
+
+        value = datapointsColumnGet(column, blockMax);
+        if (value > maxValue) {
+            maxValue = value;
+            *maxFrame = blockMax;
+        }
+    }
+
+    return true;
+}
+
 /**
  * Find the index of the latest frame whose time is equal to or later than 'time'.
  *
@@ -125,7 +501,7 @@ int datapointsFindFrameAtTime(datapoints_t *points, int64_t time)
 
     //TODO make me a binary search
     for (i = 0; i < points->frameCount; i++) {
-        if (time < points->frameTime[i]) {
+        if (time < datapointsFrameTime(points, i)) {
             return lastGoodFrame;
         }
         lastGoodFrame = i;
@@ -139,8 +515,11 @@ bool datapointsGetFrameAtIndex(datapoints_t *points, int frameIndex, int64_t *fr
     if (frameIndex < 0 || frameIndex >= points->frameCount)
         return false;
 
-    memcpy(frame, points->frames + frameIndex * points->fieldCount, points->fieldCount * sizeof(*points->frames));
-    *frameTime = points->frameTime[frameIndex];
+    for (int i = 0; i < points->fieldCount; i++) {
+        frame[i] = datapointsColumnGet(&points->fields[i], frameIndex);
+    }
+
+    *frameTime = datapointsFrameTime(points, frameIndex);
 
     return true;
 }
@@ -150,7 +529,7 @@ bool datapointsGetFieldAtIndex(datapoints_t *points, int frameIndex, int fieldIn
     if (frameIndex < 0 || frameIndex >= points->frameCount)
         return false;
 
-    *frameValue = points->frames[frameIndex * points->fieldCount + fieldIndex];
+    *frameValue = datapointsColumnGet(&points->fields[fieldIndex], frameIndex);
 
     return true;
 }
@@ -160,7 +539,7 @@ bool datapointsSetFieldAtIndex(datapoints_t *points, int frameIndex, int fieldIn
     if (frameIndex < 0 || frameIndex >= points->frameCount)
         return false;
 
-    points->frames[frameIndex * points->fieldCount + fieldIndex] = frameValue;
+    datapointsColumnSet(points, &points->fields[fieldIndex], frameIndex, frameValue);
 
     return true;
 }
@@ -170,14 +549,14 @@ bool datapointsGetTimeAtIndex(datapoints_t *points, int frameIndex, int64_t *fra
     if (frameIndex < 0 || frameIndex >= points->frameCount)
         return false;
 
-    *frameTime = points->frameTime[frameIndex];
+    *frameTime = datapointsFrameTime(points, frameIndex);
 
     return true;
 }
 
 bool datapointsGetGapStartsAtIndex(datapoints_t *points, int frameIndex)
 {
-    return frameIndex >= 0 && frameIndex < points->frameCount && points->frameGap[frameIndex];
+    return frameIndex >= 0 && frameIndex < points->frameCount && datapointsFrameGap(points, frameIndex);
 }
 
 /**
@@ -186,22 +565,88 @@ bool datapointsGetGapStartsAtIndex(datapoints_t *points, int frameIndex)
  */
 bool datapointsAddFrame(datapoints_t *points, int64_t frameTime, const int64_t *frame)
 {
-    if (points->frameCount >= points->frameCapacity)
+    int frameIndex = points->frameCount;
+
+    if (frameIndex >= points->frameLimit)
         return false;
 
-    points->frameTime[points->frameCount] = frameTime;
-    memcpy(points->frames + points->frameCount * points->fieldCount, frame, points->fieldCount * sizeof(*points->frames));
+    datapointsReserve(points, frameIndex + 1);
+
+    points->frameTime[frameIndex >> DATAPOINTS_CHUNK_SHIFT][frameIndex & DATAPOINTS_CHUNK_MASK] = frameTime;
+
+    for (int i = 0; i < points->fieldCount; i++) {
+        datapointsColumnSet(points, &points->fields[i], frameIndex, frame[i]);
+    }
 
     points->frameCount++;
 
     return true;
 }
 
+/**
+ * Add a run of frames to the end of the datapoints, given one field at a time: the value of field f for frame n is
+ * values[f * fieldStride + n]. Values are supplied for the first `fieldCount` fields, the rest are set to zero. Returns
+ * false if the datapoints' frame limit didn't leave room for every frame (as many as fit are added).
+ */
+bool datapointsAddFrames(datapoints_t *points, int frameCount, const int64_t *frameTime, int fieldCount, const int64_t *values, int fieldStride)
+{
+    int first = points->frameCount;
+    int count = frameCount < points->frameLimit - first ? frameCount : points->frameLimit - first;
+
+    if (count <= 0)
+        return frameCount <= 0;
+
+    datapointsReserve(points, first + count);
+
+    // Widen each column once for the whole run if any of its values don't fit
+    for (int i = 0; i < points->fieldCount && i < fieldCount; i++) {
+        datapointsColumn_t *column = &points->fields[i];
+        const int64_t *fieldValues = values + (size_t) i * fieldStride;
+        int64_t min = 0, max = 0;
+
+        for (int j = 0; j < count; j++) {
+            min = fieldValues[j] < min ? fieldValues[j] : min;
+            max = fieldValues[j] > max ? fieldValues[j] : max;
+        }
+
+        if (datapointsWidthForRange(min, max) > column->width) {
+            datapointsColumnResize(points, column, datapointsWidthForRange(min, max));
+        }
+    }
+
+    // Then store the run a chunk at a time
+    for (int done = 0; done < count; ) {
+        int frameIndex = first + done;
+        int chunk = frameIndex >> DATAPOINTS_CHUNK_SHIFT, offset = frameIndex & DATAPOINTS_CHUNK_MASK;
+        int length = count - done < DATAPOINTS_CHUNK_FRAMES - offset ? count - done : DATAPOINTS_CHUNK_FRAMES - offset;
+
+        memcpy(points->frameTime[chunk] + offset, frameTime + done, length * sizeof(*frameTime));
+
+        for (int i = 0; i < points->fieldCount; i++) {
+            datapointsColumn_t *column = &points->fields[i];
+
+            datapointsChunkStore(column->chunks[chunk], column->width, offset, i < fieldCount ? values + (size_t) i * fieldStride + done : NULL, length);
+        }
+
+        done += length;
+    }
+
+    for (int i = 0; i < points->fieldCount; i++) {
+        if (points->fields[i].summary) {
+            datapointsFreeSummary(&points->fields[i]);
+        }
+    }
+
+    points->frameCount += count;
+
+    return count == frameCount;
+}
+
 /**
  * Mark that a gap in the log begins after the last frame added.
  */
 void datapointsAddGap(datapoints_t *points)
 {
     if (points->frameCount > 0)
-        points->frameGap[points->frameCount - 1] = 1;
+        points->frameGap[(points->frameCount - 1) >> DATAPOINTS_CHUNK_SHIFT][(points->frameCount - 1) & DATAPOINTS_CHUNK_MASK] = 1;
 }
@@ -4,19 +4,53 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/**
+ * The frames holding the smallest and largest values of a field within each aligned block of 2^level frames.
+ */
+typedef struct datapointsSummaryLevel_t {
+    int32_t *minFrame, *maxFrame;
+} datapointsSummaryLevel_t;
+
+/*
+ * Frames are stored in chunks of this many, so that the datapoints can grow as frames are added without moving the
+ * frames that are already stored.
+ */
+#define DATAPOINTS_CHUNK_SHIFT 14
+#define DATAPOINTS_CHUNK_FRAMES (1 << DATAPOINTS_CHUNK_SHIFT)
+
+/**
+ * The values of one field for every frame, stored using the narrowest integer type that we've needed so far (the
+ * column is widened automatically when a value arrives that doesn't fit).
+ */
+typedef struct datapointsColumn_t {
+    int width; // Bytes per value: 2, 4 or 8
+
+    // An array of DATAPOINTS_CHUNK_FRAMES values of the column's width for each chunk
+    void **chunks;
+
+    // Optional min/max pyramid over the values (see datapointsBuildFieldSummary()), NULL if not built
+    datapointsSummaryLevel_t *summary;
+    int summaryLevelCount;
+} datapointsColumn_t;
+
 typedef struct datapoints_t {
     int fieldCount, frameCount;
-    int frameCapacity;
+    int frameLimit;
     char **fieldNames;
 
-    int64_t *frames;
-    int64_t *frameTime;
-    uint8_t *frameGap;
+    // The number of chunks allocated so far, and how many the lists of chunks have room for
+    int chunkCount, chunkListCapacity;
+
+    datapointsColumn_t *fields;
+    int64_t **frameTime;
+    uint8_t **frameGap;
 } datapoints_t;
 
-datapoints_t *datapointsCreate(int fieldCount, char **fieldNames, int frameCapacity);
+datapoints_t *datapointsCreate(int fieldCount, char **fieldNames, int frameLimit);
 void datapointsDestroy(datapoints_t *points);
 
+bool datapointsSetFieldRange(datapoints_t *points, int fieldIndex, int64_t min, int64_t max);
+
 bool datapointsGetFrameAtIndex(datapoints_t *points, int frameIndex, int64_t *frameTime, int64_t *frame);
 
 bool datapointsGetFieldAtIndex(datapoints_t *points, int frameIndex, int fieldIndex, int64_t *frameValue);
@@ -27,8 +61,14 @@ bool datapointsGetTimeAtIndex(datapoints_t *points, int frameIndex, int64_t *fra
 int datapointsFindFrameAtTime(datapoints_t *points, int64_t time);
 
 bool datapointsAddFrame(datapoints_t *points, int64_t frameTime, const int64_t *frame);
+bool datapointsAddFrames(datapoints_t *points, int frameCount, const int64_t *frameTime, int fieldCount, const int64_t *values, int fieldStride);
 void datapointsAddGap(datapoints_t *points);
 
 void datapointsSmoothField(datapoints_t *points, int fieldIndex, int windowSize);
 
+void datapointsBuildFieldSummary(datapoints_t *points, int fieldIndex);
+bool datapointsHasFieldSummary(datapoints_t *points, int fieldIndex);
+bool datapointsHasGapInRange(datapoints_t *points, int firstFrame, int lastFrame);
+bool datapointsGetFieldExtremesInRange(datapoints_t *points, int fieldIndex, int firstFrame, int lastFrame, int *minFrame, int *maxFrame);
+
 #endif
@@ -1,7 +1,121 @@
 #include "decoders.h"
 #include "tools.h"
 
-void streamReadTag2_3S32(mmapStream_t *stream, int64_t *values)
+/*
+ * Corrupt Elias codes can ask for a shift of 32 (or -1), so wrap the shift count around just like x86 does. This keeps
+ * the decoded values of corrupt frames the same as they have always been.
+ */
+#define BIT(n) ((uint32_t) 1 << ((n) & 31))
+
+/*
+ * The group decoders look up the layout of each group from its selector byte in a table that's built by the
+ * preprocessor (with REPEAT_256()), so that the fields can be extracted with shifts instead of a branch per field.
+ */
+
+// The longest groups, including their selector bytes
+#define TAG2_3S32_MAX_LENGTH (1 + 3 * 4)
+#define TAG8_4S16_MAX_LENGTH (1 + 4 * 2)
+
+typedef struct tag2_3S32Layout_t {
+    // Bytes in the group including the lead byte
+    uint8_t length;
+
+    /*
+     * For the 2, 4 and 6-bit layouts, each field is extracted from the group read as a big-endian word by shifting it
+     * to the top and then arithmetic shifting it back down. For the layout of whole bytes, each field is read as a
+     * little-endian 32-bit word at `offset`, and then sign-extended from its length by shifting up and back down.
+     */
+    uint8_t offset[3];
+    uint8_t shiftLeft[3], shiftRight[3];
+} tag2_3S32Layout_t;
+
+#define TAG2_3S32_SELECTOR(lead) ((lead) >> 6)
+#define TAG2_3S32_FIELD_BYTES(lead, field) ((((lead) >> ((field) * 2)) & 0x03) + 1)
+// Offset of a whole-byte field from the lead byte (the offset of "field 3" is the length of the group)
+#define TAG2_3S32_FIELD_OFFSET(lead, field) (1 \
+    + ((field) > 0 ? TAG2_3S32_FIELD_BYTES(lead, 0) : 0) \
+    + ((field) > 1 ? TAG2_3S32_FIELD_BYTES(lead, 1) : 0) \
+    + ((field) > 2 ? TAG2_3S32_FIELD_BYTES(lead, 2) : 0))
+
+// Where a 2, 4 or 6-bit field begins in the big-endian word, counting from the top bit
+#define TAG2_3S32_FIELD_START(lead, field) ( \
+    TAG2_3S32_SELECTOR(lead) == 0 ? 2 + 2 * (field) : \
+    TAG2_3S32_SELECTOR(lead) == 1 ? 4 + 4 * (field) : \
+                                    2 + 8 * (field))
+
+#define TAG2_3S32_FIELD_SHIFT_LEFT(lead, field) (TAG2_3S32_SELECTOR(lead) == 3 \
+    ? 32 - 8 * TAG2_3S32_FIELD_BYTES(lead, field) : TAG2_3S32_FIELD_START(lead, field))
+
+#define TAG2_3S32_FIELD_SHIFT_RIGHT(lead, field) (TAG2_3S32_SELECTOR(lead) == 3 \
+    ? 32 - 8 * TAG2_3S32_FIELD_BYTES(lead, field) : 64 - 2 * (TAG2_3S32_SELECTOR(lead) + 1))
+
+#define TAG2_3S32_LAYOUT(lead) { \
+    TAG2_3S32_SELECTOR(lead) == 3 ? TAG2_3S32_FIELD_OFFSET(lead, 3) : TAG2_3S32_SELECTOR(lead) + 1, \
+    {TAG2_3S32_FIELD_OFFSET(lead, 0), TAG2_3S32_FIELD_OFFSET(lead, 1), TAG2_3S32_FIELD_OFFSET(lead, 2)}, \
+    {TAG2_3S32_FIELD_SHIFT_LEFT(lead, 0), TAG2_3S32_FIELD_SHIFT_LEFT(lead, 1), TAG2_3S32_FIELD_SHIFT_LEFT(lead, 2)}, \
+    {TAG2_3S32_FIELD_SHIFT_RIGHT(lead, 0), TAG2_3S32_FIELD_SHIFT_RIGHT(lead, 1), TAG2_3S32_FIELD_SHIFT_RIGHT(lead, 2)} \
+},
+
+static const tag2_3S32Layout_t tag2_3S32Layouts[256] = {
+    REPEAT_256(TAG2_3S32_LAYOUT)
+};
+
+typedef struct tag8_4S16Layout_t {
+    // Bytes in the group including the selector byte
+    uint8_t length;
+
+    /*
+     * The fields are packed into nibbles after the selector, so each one is extracted from the 8 bytes that follow the
+     * selector (read as a big-endian word) by shifting it to the top and then arithmetic shifting it back down. Fields
+     * that aren't stored are cleared by their mask.
+     */
+    uint8_t shiftLeft[4], shiftRight[4];
+    int8_t mask[4];
+} tag8_4S16Layout_t;
+
+// Fields are 0, 1, 2 or 4 nibbles long
+#define TAG8_4S16_FIELD_NIBBLES(selector, field) \
+    ((((selector) >> ((field) * 2)) & 0x03) == 3 ? 4 : (((selector) >> ((field) * 2)) & 0x03))
+
+#define TAG8_4S16_FIELD_OFFSET(selector, field) ( \
+    ((field) > 0 ? TAG8_4S16_FIELD_NIBBLES(selector, 0) : 0) \
+    + ((field) > 1 ? TAG8_4S16_FIELD_NIBBLES(selector, 1) : 0) \
+    + ((field) > 2 ? TAG8_4S16_FIELD_NIBBLES(selector, 2) : 0))
+
+#define TAG8_4S16_FIELD_SHIFT_RIGHT(selector, field) \
+    (TAG8_4S16_FIELD_NIBBLES(selector, field) == 0 ? 63 : 64 - 4 * TAG8_4S16_FIELD_NIBBLES(selector, field))
+
+#define TAG8_4S16_FIELD_MASK(selector, field) (TAG8_4S16_FIELD_NIBBLES(selector, field) == 0 ? 0 : -1)
+
+#define TAG8_4S16_LAYOUT(selector) { \
+    1 + (TAG8_4S16_FIELD_OFFSET(selector, 3) + TAG8_4S16_FIELD_NIBBLES(selector, 3) + 1) / 2, \
+    {4 * TAG8_4S16_FIELD_OFFSET(selector, 0), 4 * TAG8_4S16_FIELD_OFFSET(selector, 1), \
+        4 * TAG8_4S16_FIELD_OFFSET(selector, 2), 4 * TAG8_4S16_FIELD_OFFSET(selector, 3)}, \
+    {TAG8_4S16_FIELD_SHIFT_RIGHT(selector, 0), TAG8_4S16_FIELD_SHIFT_RIGHT(selector, 1), \
+        TAG8_4S16_FIELD_SHIFT_RIGHT(selector, 2), TAG8_4S16_FIELD_SHIFT_RIGHT(selector, 3)}, \
+    {TAG8_4S16_FIELD_MASK(selector, 0), TAG8_4S16_FIELD_MASK(selector, 1), \
+        TAG8_4S16_FIELD_MASK(selector, 2), TAG8_4S16_FIELD_MASK(selector, 3)} \
+},
+
+static const tag8_4S16Layout_t tag8_4S16Layouts[256] = {
+    REPEAT_256(TAG8_4S16_LAYOUT)
+};
+
+static uint64_t readBigEndian64(const uint8_t *bytes)
+{
+    return ((uint64_t) bytes[0] << 56) | ((uint64_t) bytes[1] << 48) | ((uint64_t) bytes[2] << 40) | ((uint64_t) bytes[3] << 32)
+        | ((uint64_t) bytes[4] << 24) | ((uint64_t) bytes[5] << 16) | ((uint64_t) bytes[6] << 8) | bytes[7];
+}
+
+static uint32_t readLittleEndian32(const uint8_t *bytes)
+{
+    return bytes[0] | ((uint32_t) bytes[1] << 8) | ((uint32_t) bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+/**
+ * Decode a Tag2_3S32 group one byte at a time, checking for the end of the stream as we go.
+ */
+static void streamReadTag2_3S32Bytewise(mmapStream_t *stream, int64_t *values)
 {
     uint8_t leadByte;
     uint8_t byte1, byte2, byte3, byte4;
@@ -78,6 +192,34 @@ void streamReadTag2_3S32(mmapStream_t *stream, int64_t *values)
     }
 }
 
+void streamReadTag2_3S32(mmapStream_t *stream, int64_t *values)
+{
+    const uint8_t *bytes = (const uint8_t *) stream->pos;
+    const tag2_3S32Layout_t *layout;
+
+    if (stream->end - stream->pos < TAG2_3S32_MAX_LENGTH) {
+        // The group might run off the end of the stream
+        streamReadTag2_3S32Bytewise(stream, values);
+        return;
+    }
+
+    layout = &tag2_3S32Layouts[bytes[0]];
+
+    if (TAG2_3S32_SELECTOR(bytes[0]) == 3) {
+        for (int i = 0; i < 3; i++) {
+            values[i] = (int32_t) (readLittleEndian32(bytes + layout->offset[i]) << layout->shiftLeft[i]) >> layout->shiftRight[i];
+        }
+    } else {
+        uint64_t bits = readBigEndian64(bytes);
+
+        for (int i = 0; i < 3; i++) {
+            values[i] = (int64_t) (bits << layout->shiftLeft[i]) >> layout->shiftRight[i];
+        }
+    }
+
+    stream->pos += layout->length;
+}
+
 void streamReadTag8_4S16_v1(mmapStream_t *stream, int64_t *values)
 {
     uint8_t selector, combinedChar;
@@ -126,7 +268,10 @@ void streamReadTag8_4S16_v1(mmapStream_t *stream, int64_t *values)
     }
 }
 
-void streamReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
+/**
+ * Decode a Tag8_4S16 (version 2) group one byte at a time, checking for the end of the stream as we go.
+ */
+static void streamReadTag8_4S16_v2Bytewise(mmapStream_t *stream, int64_t *values)
 {
     uint8_t selector;
     uint8_t char1, char2;
@@ -199,17 +344,50 @@ void streamReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
     }
 }
 
+void streamReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
+{
+    const uint8_t *bytes = (const uint8_t *) stream->pos;
+    const tag8_4S16Layout_t *layout;
+    uint64_t bits;
+
+    if (stream->end - stream->pos < TAG8_4S16_MAX_LENGTH) {
+        // The group might run off the end of the stream
+        streamReadTag8_4S16_v2Bytewise(stream, values);
+        return;
+    }
+
+    layout = &tag8_4S16Layouts[bytes[0]];
+    bits = readBigEndian64(bytes + 1);
+
+    for (int i = 0; i < 4; i++) {
+        values[i] = ((int64_t) (bits << layout->shiftLeft[i]) >> layout->shiftRight[i]) & layout->mask[i];
+    }
+
+    stream->pos += layout->length;
+}
+
 void streamReadTag8_8SVB(mmapStream_t *stream, int64_t *values, int valueCount)
 {
     uint8_t header;
+    uint32_t encoded[8];
+    int encodedCount = 0;
 
     if (valueCount == 1) {
         values[0] = streamReadSignedVB(stream);
     } else {
         header = (uint8_t) streamReadByte(stream);
 
+        for (int i = 0; i < 8; i++)
+            if (header & (1 << i))
+                encodedCount++;
+
+        // The fields that are present are stored back to back, so read them all together
+        streamReadUnsignedVBs(stream, encoded, encodedCount);
+
+        encodedCount = 0;
+
         for (int i = 0; i < 8; i++, header >>= 1)
-            values[i] = (header & 0x01) ? streamReadSignedVB(stream) : 0;
+            values[i] = (header & 0x01) ? zigzagDecode(encoded[encodedCount++]) : 0;
     }
 }
 
@@ -232,6 +410,19 @@ int16_t streamReadS16(mmapStream_t *stream)
     return streamReadByte(stream) | (streamReadByte(stream) << 8);
 }
 
+/**
+ * Extract `numBits` bits (at most 32) beginning `offset` bits from the top of a bit accumulator loaded by
+ * streamPeekBits64().
+ */
+static uint32_t accumulatorBits(uint64_t bits, int offset, int numBits)
+{
+    if (numBits <= 0) {
+        return 0;
+    }
+
+    return (uint32_t) ((bits << offset) >> (64 - numBits));
+}
+
 /**
  * Read an Elias-Delta encoded 32-bit unsigned integer from the bitstream and return it. If EOF is encountered during
  * reading, 0 is returned and the stream's EOF flag is set.
@@ -246,16 +437,64 @@ uint32_t streamReadEliasDeltaU32(mmapStream_t *stream)
      */
     const int MAX_BIT_READ_SIZE = 32;
 
-    int lengthValBits = 0;
+    int lengthValBits, bitsAvailable, bitIndex;
     uint8_t length;
     uint32_t lengthLowBits, resultLowBits;
     uint32_t result;
+    uint64_t bits;
+
+    bits = streamPeekBits64(stream, &bitsAvailable);
+
+    // The number of leading zeros gives us the length of the field used to store the length of the encoded value
+    lengthValBits = countLeadingZeros64(bits);
 
-    while (lengthValBits <= MAX_BIT_READ_SIZE && streamReadBit(stream) == 0) {
-        lengthValBits++;
+    if (lengthValBits > MAX_BIT_READ_SIZE) {
+        // Corrupt value, or we ran out of stream before finding the terminating 1 bit (which sets EOF)
+        streamSkipBits(stream, MAX_BIT_READ_SIZE + 1);
+        return 0;
     }
 
-    if (stream->eof || lengthValBits > MAX_BIT_READ_SIZE) {
+    bitIndex = lengthValBits + 1;
+
+    /*
+     * Valid values are short enough that the whole code is almost always already sitting in the accumulator, so decode
+     * it directly from there if we can:
+     */
+    if (bitIndex + lengthValBits <= bitsAvailable) {
+        lengthLowBits = accumulatorBits(bits, bitIndex, lengthValBits);
+        bitIndex += lengthValBits;
+
+        length = (BIT(lengthValBits) | lengthLowBits) - 1;
+
+        if (length > MAX_BIT_READ_SIZE) {
+            //Corrupt value
+            streamSkipBits(stream, bitIndex);
+            return 0;
+        }
+
+        if (bitIndex + length < bitsAvailable) {
+            resultLowBits = accumulatorBits(bits, bitIndex, length);
+            bitIndex += length;
+
+            result = BIT(length) | resultLowBits;
+
+            if (result == 0xFFFFFFFF) {
+                // The escape bit follows (we know it's in the accumulator already)
+                streamSkipBits(stream, bitIndex + 1);
+
+                return accumulatorBits(bits, bitIndex, 1) ? 0xFFFFFFFF : 0xFFFFFFFF - 1;
+            }
+
+            streamSkipBits(stream, bitIndex);
+
+            return result - 1;
+        }
+    }
+
+    // Otherwise we're close to the end of the stream, so take the remaining fields one at a time
+    streamSkipBits(stream, lengthValBits + 1);
+
+    if (stream->eof) {
         return 0;
     }
 
@@ -266,7 +505,7 @@ uint32_t streamReadEliasDeltaU32(mmapStream_t *stream)
         return 0;
     }
 
-    length = ((1 << lengthValBits) | lengthLowBits) - 1;
+    length = (BIT(lengthValBits) | lengthLowBits) - 1;
 
     if (length > MAX_BIT_READ_SIZE) {
         //Corrupt value
@@ -280,7 +519,7 @@ uint32_t streamReadEliasDeltaU32(mmapStream_t *stream)
         return 0;
     }
 
-    result = (1 << length) | resultLowBits;
+    result = BIT(length) | resultLowBits;
 
     // The highest value is an escape code that means either MAXINT - 1 or MAXINT depending on the following bit
     if (result == 0xFFFFFFFF) {
@@ -319,15 +558,50 @@ uint32_t streamReadEliasGammaU32(mmapStream_t *stream)
      */
     const int MAX_BIT_READ_SIZE = 32;
 
-    int valBits = 0;
+    int valBits, bitsAvailable, bitIndex;
     uint32_t valueLowBits;
     uint32_t result;
+    uint64_t bits;
+
+    bits = streamPeekBits64(stream, &bitsAvailable);
+
+    // The number of leading zeros gives us the length of the encoded value
+    valBits = countLeadingZeros64(bits);
 
-    while (valBits <= MAX_BIT_READ_SIZE && streamReadBit(stream) == 0) {
-        valBits++;
+    if (valBits > MAX_BIT_READ_SIZE) {
+        // Corrupt value, or we ran out of stream before finding the first 1 bit of the value (which sets EOF)
+        streamSkipBits(stream, MAX_BIT_READ_SIZE + 1);
+        return 0;
     }
 
-    if (stream->eof || valBits > MAX_BIT_READ_SIZE) {
+    // Decode straight from the accumulator if the value (and its possible escape bit) is already in there
+    if (2 * valBits < bitsAvailable) {
+        bitIndex = valBits + 1;
+
+        if (valBits > 1) {
+            valueLowBits = accumulatorBits(bits, bitIndex, valBits - 1);
+            bitIndex += valBits - 1;
+        } else {
+            valueLowBits = 0;
+        }
+
+        result = BIT(valBits - 1) | valueLowBits;
+
+        if (result == 0xFFFFFFFF) {
+            streamSkipBits(stream, bitIndex + 1);
+
+            return accumulatorBits(bits, bitIndex, 1) ? 0xFFFFFFFF : 0xFFFFFFFF - 1;
+        }
+
+        streamSkipBits(stream, bitIndex);
+
+        return result - 1;
+    }
+
+    // Otherwise we're close to the end of the stream, so take the remaining bits the slow way
+    streamSkipBits(stream, valBits + 1);
+
+    if (stream->eof) {
         return 0;
     }
 
@@ -338,7 +612,7 @@ uint32_t streamReadEliasGammaU32(mmapStream_t *stream)
         return 0;
     }
 
-    result = (1 << (valBits - 1)) | valueLowBits;
+    result = BIT(valBits - 1) | valueLowBits;
 
     // The highest value is an escape code that means either MAXINT - 1 or MAXINT depending on the following bit
     if (result == 0xFFFFFFFF) {
@@ -0,0 +1,633 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef USE_ZLIB
+    #include <zlib.h>
+#endif
+
+#ifdef USE_LZMA
+    #include <lzma.h>
+#endif
+
+#ifdef USE_ZSTD
+    #include <zstd.h>
+#endif
+
+#include "platform.h"
+#include "decompress.h"
+
+// How many compressed bytes we read from the input at a time
+#define DECOMPRESS_INPUT_BUFFER_SIZE (256 * 1024)
+
+// When zstd frames are decompressed in parallel, how many frames per worker can be decompressed ahead of the reader
+#define DECOMPRESS_FRAMES_PER_WORKER 2
+
+static const uint8_t GZIP_MAGIC[] = {0x1F, 0x8B};
+static const uint8_t ZSTD_MAGIC[] = {0x28, 0xB5, 0x2F, 0xFD};
+static const uint8_t XZ_MAGIC[] = {0xFD, '7', 'z', 'X', 'Z', 0x00};
+
+#ifdef USE_ZSTD
+/**
+ * One zstd frame of the input, which is decompressed on a worker thread.
+ */
+typedef struct decompressFrameJob_t {
+    uint8_t *compressed;
+    size_t compressedLength;
+
+    char *output;
+    size_t outputLength, outputCapacity;
+
+    // How much of the output has been passed on to the reader so far
+    size_t delivered;
+
+    bool failed, collected;
+    semaphore_t done;
+} decompressFrameJob_t;
+#endif
+
+typedef struct decompressSource_t {
+    // This comes first so that the source callbacks can find the decompressor they belong to
+    streamSource_t source;
+
+    streamSource_t *input;
+    CompressionFormat format;
+
+    // The bytes that have been read from the input but not consumed yet lie between inputStart and inputEnd
+    uint8_t *inputBuffer;
+    size_t inputCapacity, inputStart, inputEnd;
+    bool inputEnded;
+
+    // True when the decompressor is between two complete streams/frames, where it's fine for the input to end
+    bool atBoundary;
+
+    // Set when there's nothing more to decompress (because the data ended or was corrupt)
+    bool finished;
+
+#ifdef USE_ZLIB
+    z_stream zlib;
+#endif
+#ifdef USE_LZMA
+    lzma_stream lzma;
+#endif
+#ifdef USE_ZSTD
+    ZSTD_DCtx *zstd;
+
+    // When zstd frames are decompressed by a pool of workers, the frames they've been given, in the input's order
+    workerPool_t *pool;
+    ZSTD_DCtx **workerContexts;
+    int workers;
+
+    decompressFrameJob_t **frames;
+    int frameCapacity, frameHead, frameCount;
+#endif
+} decompressSource_t;
+
+static bool hasMagic(const char *data, size_t length, const uint8_t *magic, size_t magicLength)
+{
+    return length >= magicLength && memcmp(data, magic, magicLength) == 0;
+}
+
+/**
+ * Recognise a compressed file from its first bytes (`length` can be less than COMPRESSION_MAGIC_LENGTH if the file is
+ * shorter than that).
+ */
+CompressionFormat compressionDetectFormat(const char *data, size_t length)
+{
+    if (hasMagic(data, length, GZIP_MAGIC, sizeof(GZIP_MAGIC)))
+        return COMPRESSION_GZIP;
+
+    if (hasMagic(data, length, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)))
+        return COMPRESSION_ZSTD;
+
+    if (hasMagic(data, length, XZ_MAGIC, sizeof(XZ_MAGIC)))
+        return COMPRESSION_XZ;
+
+    return COMPRESSION_NONE;
+}
+
+const char* compressionFormatName(CompressionFormat format)
+{
+    switch (format) {
+        case COMPRESSION_GZIP:
+            return "gzip";
+        case COMPRESSION_ZSTD:
+            return "zstd";
+        case COMPRESSION_XZ:
+            return "xz";
+        default:
+            return "none";
+    }
+}
+
+/**
+ * Was this build of the tools compiled with the library needed to decompress the given format?
+ */
+bool compressionFormatSupported(CompressionFormat format)
+{
+    switch (format) {
+        case COMPRESSION_NONE:
+            return true;
+#ifdef USE_ZLIB
+        case COMPRESSION_GZIP:
+            return true;
+#endif
+#ifdef USE_ZSTD
+        case COMPRESSION_ZSTD:
+            return true;
+#endif
+#ifdef USE_LZMA
+        case COMPRESSION_XZ:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+/**
+ * Move the unconsumed input to the front of the input buffer and read more after it, waiting until at least one byte
+ * arrives. If the buffer is full of unconsumed input, it's enlarged first.
+ *
+ * Returns false if the input has ended.
+ */
+static bool decompressReadInput(decompressSource_t *source)
+{
+    size_t bytesRead;
+
+    if (source->inputEnded) {
+        return false;
+    }
+
+    if (source->inputStart > 0) {
+        memmove(source->inputBuffer, source->inputBuffer + source->inputStart, source->inputEnd - source->inputStart);
+
+        source->inputEnd -= source->inputStart;
+        source->inputStart = 0;
+    }
+
+    if (source->inputEnd == source->inputCapacity) {
+        // We need to see a whole zstd frame at once to hand it to a worker, and this one is bigger than the buffer
+        source->inputCapacity *= 2;
+        source->inputBuffer = realloc(source->inputBuffer, source->inputCapacity);
+    }
+
+    bytesRead = source->input->read(source->input, (char *) source->inputBuffer + source->inputEnd, 1, source->inputCapacity - source->inputEnd);
+
+    if (bytesRead == 0) {
+        source->inputEnded = true;
+        return false;
+    }
+
+    source->inputEnd += bytesRead;
+
+    return true;
+}
+
+/**
+ * For input that isn't compressed at all: hand over what's left in the input buffer, then read straight into the
+ * caller's buffer.
+ */
+static size_t passThroughDecompress(decompressSource_t *source, char *output, size_t length, bool *progress)
+{
+    size_t count = source->inputEnd - source->inputStart;
+
+    if (count > 0) {
+        if (count > length) {
+            count = length;
+        }
+
+        memcpy(output, source->inputBuffer + source->inputStart, count);
+        source->inputStart += count;
+    } else if (!source->inputEnded) {
+        count = source->input->read(source->input, output, 1, length);
+
+        if (count == 0) {
+            source->inputEnded = true;
+        }
+    }
+
+    *progress = count > 0;
+
+    return count;
+}
+
+#ifdef USE_ZLIB
+static size_t zlibDecompress(decompressSource_t *source, char *output, size_t length, bool *progress)
+{
+    z_stream *zlib = &source->zlib;
+    size_t available = source->inputEnd - source->inputStart;
+    size_t consumed, produced;
+    uInt outputAvailable = length > UINT_MAX ? UINT_MAX : (uInt) length;
+    int result;
+
+    zlib->next_in = source->inputBuffer + source->inputStart;
+    zlib->avail_in = (uInt) available;
+    zlib->next_out = (Bytef *) output;
+    zlib->avail_out = outputAvailable;
+
+    result = inflate(zlib, Z_NO_FLUSH);
+
+    consumed = available - zlib->avail_in;
+    produced = outputAvailable - zlib->avail_out;
+
+    source->inputStart += consumed;
+    *progress = consumed > 0 || produced > 0;
+
+    if (consumed > 0) {
+        source->atBoundary = false;
+    }
+
+    if (result == Z_STREAM_END) {
+        // Files can be made of several gzip members one after the other, so be ready for another one
+        inflateReset(zlib);
+        source->atBoundary = true;
+    } else if (result != Z_OK && result != Z_BUF_ERROR) {
+        fprintf(stderr, "Error decompressing gzip log: %s\n", zlib->msg ? zlib->msg : "bad data");
+        source->finished = true;
+    }
+
+    return produced;
+}
+#endif
+
+#ifdef USE_LZMA
+static size_t lzmaDecompress(decompressSource_t *source, char *output, size_t length, bool *progress)
+{
+    lzma_stream *lzma = &source->lzma;
+    size_t available = source->inputEnd - source->inputStart;
+    size_t consumed, produced;
+    lzma_ret result;
+
+    lzma->next_in = source->inputBuffer + source->inputStart;
+    lzma->avail_in = available;
+    lzma->next_out = (uint8_t *) output;
+    lzma->avail_out = length;
+
+    // The decoder needs to be told when the input has ended so it can check that the last stream was complete
+    result = lzma_code(lzma, source->inputEnded ? LZMA_FINISH : LZMA_RUN);
+
+    consumed = available - lzma->avail_in;
+    produced = length - lzma->avail_out;
+
+    source->inputStart += consumed;
+    *progress = consumed > 0 || produced > 0;
+    source->atBoundary = false;
+
+    if (result == LZMA_STREAM_END) {
+        source->atBoundary = true;
+        source->finished = true;
+    } else if (result != LZMA_OK && result != LZMA_BUF_ERROR) {
+        fprintf(stderr, "Error decompressing xz log (error %d)\n", (int) result);
+        source->finished = true;
+    }
+
+    return produced;
+}
+#endif
+
+#ifdef USE_ZSTD
+static size_t zstdDecompress(decompressSource_t *source, char *output, size_t length, bool *progress)
+{
+    ZSTD_inBuffer in = {source->inputBuffer + source->inputStart, source->inputEnd - source->inputStart, 0};
+    ZSTD_outBuffer out = {output, length, 0};
+    size_t result = ZSTD_decompressStream(source->zstd, &out, &in);
+
+    source->inputStart += in.pos;
+    *progress = in.pos > 0 || out.pos > 0;
+
+    if (ZSTD_isError(result)) {
+        fprintf(stderr, "Error decompressing zstd log: %s\n", ZSTD_getErrorName(result));
+        source->finished = true;
+    } else if (*progress) {
+        // Zero means that a frame was just completed and all of its output has been handed over
+        source->atBoundary = result == 0;
+    }
+
+    return out.pos;
+}
+
+static void zstdDecompressFrame(void *workerData, void *data)
+{
+    ZSTD_DCtx *context = (ZSTD_DCtx *) workerData;
+    decompressFrameJob_t *frame = (decompressFrameJob_t *) data;
+    unsigned long long contentSize = ZSTD_getFrameContentSize(frame->compressed, frame->compressedLength);
+    ZSTD_inBuffer in = {frame->compressed, frame->compressedLength, 0};
+    size_t result;
+
+    // The frame header usually tells us how big the output will be, otherwise we guess and grow the buffer if needed
+    if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR && contentSize > 0) {
+        frame->outputCapacity = contentSize;
+    } else {
+        frame->outputCapacity = frame->compressedLength * 4 + 1;
+    }
+
+    frame->output = malloc(frame->outputCapacity);
+
+    ZSTD_DCtx_reset(context, ZSTD_reset_session_only);
+
+    do {
+        ZSTD_outBuffer out;
+
+        if (frame->outputLength == frame->outputCapacity) {
+            frame->outputCapacity *= 2;
+            frame->output = realloc(frame->output, frame->outputCapacity);
+        }
+
+        out.dst = frame->output + frame->outputLength;
+        out.size = frame->outputCapacity - frame->outputLength;
+        out.pos = 0;
+
+        result = ZSTD_decompressStream(context, &out, &in);
+
+        if (ZSTD_isError(result)) {
+            frame->failed = true;
+            break;
+        }
+
+        frame->outputLength += out.pos;
+
+        if (result != 0 && in.pos == in.size && out.pos < out.size) {
+            // The frame must be incomplete
+            frame->failed = true;
+            break;
+        }
+    } while (result != 0);
+
+    semaphore_signal(&frame->done);
+}
+
+/**
+ * Hand the complete frames at the start of the input buffer to the workers, until they have as many as we allow.
+ */
+static void zstdSubmitFrames(decompressSource_t *source)
+{
+    while (source->frameCount < source->frameCapacity && source->inputStart < source->inputEnd) {
+        size_t frameLength = ZSTD_findFrameCompressedSize(source->inputBuffer + source->inputStart, source->inputEnd - source->inputStart);
+        decompressFrameJob_t *frame;
+
+        if (ZSTD_isError(frameLength)) {
+            // We don't have the whole frame yet (or it's corrupt, which we'll find out when the input ends)
+            break;
+        }
+
+        frame = calloc(1, sizeof(*frame));
+
+        frame->compressed = malloc(frameLength);
+        frame->compressedLength = frameLength;
+        memcpy(frame->compressed, source->inputBuffer + source->inputStart, frameLength);
+
+        semaphore_create(&frame->done, 0);
+
+        source->inputStart += frameLength;
+
+        source->frames[(source->frameHead + source->frameCount) % source->frameCapacity] = frame;
+        source->frameCount++;
+
+        workerpool_submit(source->pool, frame);
+    }
+}
+
+static void zstdFreeFrame(decompressFrameJob_t *frame)
+{
+    if (!frame->collected) {
+        semaphore_wait(&frame->done);
+    }
+
+    semaphore_destroy(&frame->done);
+
+    free(frame->compressed);
+    free(frame->output);
+    free(frame);
+}
+
+static size_t zstdParallelDecompress(decompressSource_t *source, char *output, size_t length, bool *progress)
+{
+    decompressFrameJob_t *frame;
+    size_t count;
+
+    zstdSubmitFrames(source);
+
+    if (source->frameCount == 0) {
+        // We need more input before we can find the next frame
+        source->atBoundary = source->inputStart == source->inputEnd;
+        *progress = false;
+
+        return 0;
+    }
+
+    frame = source->frames[source->frameHead];
+
+    if (!frame->collected) {
+        semaphore_wait(&frame->done);
+        frame->collected = true;
+    }
+
+    if (frame->failed) {
+        fprintf(stderr, "Error decompressing zstd log: a frame is corrupt\n");
+        source->finished = true;
+    }
+
+    count = frame->outputLength - frame->delivered;
+
+    if (count > length) {
+        count = length;
+    }
+
+    memcpy(output, frame->output + frame->delivered, count);
+    frame->delivered += count;
+
+    if (frame->delivered == frame->outputLength) {
+        source->frameHead = (source->frameHead + 1) % source->frameCapacity;
+        source->frameCount--;
+
+        zstdFreeFrame(frame);
+
+        // Keep the workers busy while the caller deals with this output
+        zstdSubmitFrames(source);
+    }
+
+    source->atBoundary = false;
+    *progress = true;
+
+    return count;
+}
+#endif
+
+static size_t decompressSome(decompressSource_t *source, char *output, size_t length, bool *progress)
+{
+    switch (source->format) {
+#ifdef USE_ZLIB
+        case COMPRESSION_GZIP:
+            return zlibDecompress(source, output, length, progress);
+#endif
+#ifdef USE_LZMA
+        case COMPRESSION_XZ:
+            return lzmaDecompress(source, output, length, progress);
+#endif
+#ifdef USE_ZSTD
+        case COMPRESSION_ZSTD:
+            if (source->pool) {
+                return zstdParallelDecompress(source, output, length, progress);
+            }
+
+            return zstdDecompress(source, output, length, progress);
+#endif
+        default:
+            return passThroughDecompress(source, output, length, progress);
+    }
+}
+
+static size_t decompressSourceRead(streamSource_t *streamSource, char *buffer, size_t minimum, size_t length)
+{
+    decompressSource_t *source = (decompressSource_t *) streamSource;
+    size_t total = 0;
+
+    while (total < minimum && !source->finished) {
+        bool progress;
+
+        total += decompressSome(source, buffer + total, length - total, &progress);
+
+        if (progress) {
+            continue;
+        }
+
+        if (source->inputEnded) {
+            if (!source->atBoundary) {
+                fprintf(stderr, "Warning: The compressed log ended unexpectedly, it may be truncated\n");
+            }
+
+            source->finished = true;
+        } else {
+            decompressReadInput(source);
+        }
+    }
+
+    return total;
+}
+
+static void decompressSourceDestroy(streamSource_t *streamSource)
+{
+    decompressSource_t *source = (decompressSource_t *) streamSource;
+
+    switch (source->format) {
+#ifdef USE_ZLIB
+        case COMPRESSION_GZIP:
+            inflateEnd(&source->zlib);
+        break;
+#endif
+#ifdef USE_LZMA
+        case COMPRESSION_XZ:
+            lzma_end(&source->lzma);
+        break;
+#endif
+#ifdef USE_ZSTD
+        case COMPRESSION_ZSTD:
+            if (source->pool) {
+                for (int i = 0; i < source->frameCount; i++) {
+                    zstdFreeFrame(source->frames[(source->frameHead + i) % source->frameCapacity]);
+                }
+
+                workerpool_destroy(source->pool);
+
+                for (int i = 0; i < source->workers; i++) {
+                    ZSTD_freeDCtx(source->workerContexts[i]);
+                }
+
+                free(source->workerContexts);
+                free(source->frames);
+            } else {
+                ZSTD_freeDCtx(source->zstd);
+            }
+        break;
+#endif
+        default:
+            ;
+    }
+
+    source->input->destroy(source->input);
+
+    free(source->inputBuffer);
+    free(source);
+}
+
+/**
+ * Create a source which decompresses the data read from `input`, which it takes ownership of. The format is recognised
+ * from the first bytes of the input, and input that isn't compressed is passed through unchanged.
+ *
+ * zstd data made up of several frames (e.g. from pzstd) is decompressed by a pool of `threads` threads if that's more
+ * than one. The other formats can only be decompressed in order, so they always use the caller's thread.
+ *
+ * Returns NULL (having destroyed the input) if the input is compressed in a format that this build can't decompress.
+ */
+streamSource_t* decompressSourceCreate(streamSource_t *input, int threads)
+{
+    decompressSource_t *source = calloc(1, sizeof(*source));
+    bool initialised = true;
+
+    source->source.read = decompressSourceRead;
+    source->source.destroy = decompressSourceDestroy;
+
+    source->input = input;
+    source->inputCapacity = DECOMPRESS_INPUT_BUFFER_SIZE;
+    source->inputBuffer = malloc(source->inputCapacity);
+    source->atBoundary = true;
+
+    while (source->inputEnd < COMPRESSION_MAGIC_LENGTH && decompressReadInput(source)) {
+    }
+
+    source->format = compressionDetectFormat((const char *) source->inputBuffer, source->inputEnd);
+
+    switch (source->format) {
+        case COMPRESSION_NONE:
+        break;
+#ifdef USE_ZLIB
+        case COMPRESSION_GZIP:
+            // Adding 32 to the window size accepts either a gzip or a zlib header
+            initialised = inflateInit2(&source->zlib, 15 + 32) == Z_OK;
+        break;
+#endif
+#ifdef USE_LZMA
+        case COMPRESSION_XZ:
+            initialised = lzma_stream_decoder(&source->lzma, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+        break;
+#endif
+#ifdef USE_ZSTD
+        case COMPRESSION_ZSTD:
+            if (threads > 1) {
+                source->workers = threads;
+                source->workerContexts = malloc(threads * sizeof(*source->workerContexts));
+
+                for (int i = 0; i < threads; i++) {
+                    source->workerContexts[i] = ZSTD_createDCtx();
+                }
+
+                source->frameCapacity = threads * DECOMPRESS_FRAMES_PER_WORKER;
+                source->frames = malloc(source->frameCapacity * sizeof(*source->frames));
+
+                source->pool = workerpool_create(threads, zstdDecompressFrame, (void **) source->workerContexts);
+            } else {
+                source->zstd = ZSTD_createDCtx();
+                initialised = source->zstd != NULL;
+            }
+        break;
+#endif
+        default:
+            fprintf(stderr, "This log is compressed with %s, which this build can't decompress\n", compressionFormatName(source->format));
+            initialised = false;
+    }
+
+    (void) threads; // Only zstd decompression uses it
+
+    if (!initialised) {
+        input->destroy(input);
+
+        free(source->inputBuffer);
+        free(source);
+
+        return NULL;
+    }
+
+    return &source->source;
+}
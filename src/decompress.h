@@ -0,0 +1,25 @@
+#ifndef DECOMPRESS_H_
+#define DECOMPRESS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stream.h"
+
+typedef enum {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD,
+    COMPRESSION_XZ
+} CompressionFormat;
+
+// The number of bytes at the start of a file that's enough to recognise any of the formats
+#define COMPRESSION_MAGIC_LENGTH 6
+
+CompressionFormat compressionDetectFormat(const char *data, size_t length);
+const char* compressionFormatName(CompressionFormat format);
+bool compressionFormatSupported(CompressionFormat format);
+
+streamSource_t* decompressSourceCreate(streamSource_t *input, int threads);
+
+#endif
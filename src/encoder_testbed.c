@@ -5,6 +5,7 @@
  */
 
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdbool.h>
 
 #include <stdio.h>
@@ -662,9 +663,9 @@ static void loadMainState(int64_t *frame)
  * Treat each decoded frame as if it were a set of freshly read flight data ready to be
  * encoded.
  */
-void onFrameReady(flightLog_t *fl, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize)
+void onFrameReady(flightLog_t *fl, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
 {
-    uint32_t start = blackboxWrittenBytes;
+    uint64_t start = blackboxWrittenBytes;
     unsigned int encodedFrameSize;
 
     (void) fl;
@@ -792,33 +793,33 @@ void printFrameSizeComparison(flightLogStatistics_t *oldStats, flightLogStatisti
 void printStats(flightLogStatistics_t *stats)
 {
     uint32_t intervalMS = (uint32_t) ((stats->field[FLIGHT_LOG_FIELD_INDEX_TIME].max - stats->field[FLIGHT_LOG_FIELD_INDEX_TIME].min) / 1000);
-    uint32_t totalBytes = stats->totalBytes;
+    uint64_t totalBytes = stats->totalBytes;
     uint32_t totalFrames = stats->frame['I'].validCount + stats->frame['P'].validCount;
 
     for (int i = 0; i < 256; i++) {
         uint8_t frameType = (uint8_t) i;
 
         if (stats->frame[frameType].validCount) {
-            fprintf(stderr, "%c frames %7d %6.1f bytes avg %8d bytes total\n", (char) frameType, stats->frame[frameType].validCount,
+            fprintf(stderr, "%c frames %7d %6.1f bytes avg %8" PRIu64 " bytes total\n", (char) frameType, stats->frame[frameType].validCount,
                 (float) stats->frame[frameType].bytes / stats->frame[frameType].validCount, stats->frame[frameType].bytes);
         }
     }
 
     if (totalFrames)
-        fprintf(stderr, "Frames %9d %6.1f bytes avg %8d bytes total\n", totalFrames, (double) totalBytes / totalFrames, totalBytes);
+        fprintf(stderr, "Frames %9d %6.1f bytes avg %8" PRIu64 " bytes total\n", totalFrames, (double) totalBytes / totalFrames, totalBytes);
     else
         fprintf(stderr, "Frames %8d\n", 0);
 
     if (stats->totalCorruptFrames)
         fprintf(stderr, "%d frames failed to decode (%.2f%%)\n", stats->totalCorruptFrames, (double) stats->totalCorruptFrames / (stats->totalCorruptFrames + stats->frame['I'].validCount + stats->frame['P'].validCount) * 100);
 
-    fprintf(stderr, "IntervalMS %u Total bytes %u\n", intervalMS, stats->totalBytes);
+    fprintf(stderr, "IntervalMS %u Total bytes %" PRIu64 "\n", intervalMS, stats->totalBytes);
 
     if (intervalMS > 0) {
-        fprintf(stderr, "Data rate %4uHz %6u bytes/s %10u baud\n",
+        fprintf(stderr, "Data rate %4uHz %6" PRIu64 " bytes/s %10" PRIu64 " baud\n",
                 (unsigned int) (((int64_t) totalFrames * 1000) / intervalMS),
-                (unsigned int) (((int64_t) stats->totalBytes * 1000) / intervalMS),
-                (unsigned int) ((((int64_t) stats->totalBytes * 1000 * 8) / intervalMS + 100 - 1) / 100 * 100)); /* Round baud rate up to nearest 100 */
+                (stats->totalBytes * 1000) / intervalMS,
+                ((stats->totalBytes * 1000 * 8) / intervalMS + 100 - 1) / 100 * 100); /* Round baud rate up to nearest 100 */
     }
 }
 
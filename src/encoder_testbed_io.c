@@ -6,7 +6,7 @@
 
 #include "encoder_testbed_io.h"
 
-uint32_t blackboxWrittenBytes;
+uint64_t blackboxWrittenBytes;
 
 void blackboxWrite(uint8_t ch)
 {
@@ -54,4 +54,4 @@ void blackboxWriteS32EliasGamma(int32_t value);
 
 blackboxBufferReserveStatus_e blackboxDeviceReserveBufferSpace(uint32_t bytes);
 
-extern uint32_t blackboxWrittenBytes;
+extern uint64_t blackboxWrittenBytes;
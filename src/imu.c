@@ -30,35 +30,27 @@ typedef enum {
 
 //Settings that would normally be set by the user in MW config:
 static const uint16_t gyro_cmpf_factor = 600;
-static const float accz_lpf_cutoff = 5.0f;
 static const uint16_t gyro_cmpfm_factor = 250;
 static float magneticDeclination = 0.0f;
 
-//IMU fields:
-static float fc_acc;
-static float invGyroComplimentaryFilter_M_Factor;
-
-static t_fp_vector EstM;
-static t_fp_vector EstN;
-static uint32_t previousTime;
-
 /**
- * Call before any other routines in order to set up IMU constants and such.
+ * Call before any other routines in order to set up the IMU's state.
  */
-void imuInit(void)
+void imuInit(imuState_t *state)
 {
-    fc_acc = (float) (0.5f / (M_PI * accz_lpf_cutoff)); // calculate RC time constant used in the accZ lpf
-    invGyroComplimentaryFilter_M_Factor = (1.0f / (gyro_cmpfm_factor + 1.0f));
+    state->EstG.V.X = 0.0f;
+    state->EstG.V.Y = 0.0f;
+    state->EstG.V.Z = 0.0f;
 
-    EstM.V.X = 1.0f;
-    EstM.V.Y = 0.0f;
-    EstM.V.Z = 0.0f;
+    state->EstM.V.X = 1.0f;
+    state->EstM.V.Y = 0.0f;
+    state->EstM.V.Z = 0.0f;
 
-    EstN.V.X = 1.0f;
-    EstN.V.Y = 0.0f;
-    EstN.V.Z = 0.0f;
+    state->EstN.V.X = 1.0f;
+    state->EstN.V.Y = 0.0f;
+    state->EstN.V.Z = 0.0f;
 
-    previousTime = 0;
+    state->previousTime = 0;
 }
 
 /**
@@ -85,8 +77,7 @@ void imuSetMagneticDeclination(double declination)
 // **************************************************
 
 #define INV_GYR_CMPF_FACTOR   (1.0f / ((float)gyro_cmpf_factor + 1.0f))
-
-static t_fp_vector EstG;
+#define INV_GYR_CMPFM_FACTOR  (1.0f / ((float)gyro_cmpfm_factor + 1.0f))
 
 static void normalizeVector(struct fp_vector *src, struct fp_vector *dest)
 {
@@ -174,20 +165,20 @@ static float calculateHeading(t_fp_vector *vec, float angleradRoll, float angler
     return hd;
 }
 
-void updateEstimatedAttitude(int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude)
+void updateEstimatedAttitude(imuState_t *state, int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude)
 {
     int32_t accMag = 0;
     uint32_t deltaTime;
     float scale, deltaGyroAngle[3];
 
-    if (previousTime == 0) {
+    if (state->previousTime == 0) {
         deltaTime = 1;
     } else {
-        deltaTime = currentTime - previousTime;
+        deltaTime = currentTime - state->previousTime;
     }
 
     scale = deltaTime * gyroScale;
-    previousTime = currentTime;
+    state->previousTime = currentTime;
 
     // Initialization
     for (int axis = 0; axis < 3; axis++) {
@@ -197,30 +188,30 @@ void updateEstimatedAttitude(int16_t gyroADC[3], int16_t accSmooth[3], int16_t m
     }
     accMag = accMag * 100 / ((int32_t)acc_1G * acc_1G);
 
-    rotateVector(&EstG.V, deltaGyroAngle);
+    rotateVector(&state->EstG.V, deltaGyroAngle);
 
     // Apply complimentary filter (Gyro drift correction)
     // If accel magnitude >1.15G or <0.85G and  ACC vector outside of the limit range => we neutralize the effect of accelerometers in the angle estimation.
     // To do that, we just skip filter, as Est V already rotated by Gyro
     if (72 < (uint16_t)accMag && (uint16_t)accMag < 133) {
         for (int axis = 0; axis < 3; axis++)
-            EstG.A[axis] = (EstG.A[axis] * (float)gyro_cmpf_factor + accSmooth[axis]) * INV_GYR_CMPF_FACTOR;
+            state->EstG.A[axis] = (state->EstG.A[axis] * (float)gyro_cmpf_factor + accSmooth[axis]) * INV_GYR_CMPF_FACTOR;
     }
 
     // Attitude of the estimated vector
-    attitude->roll = atan2f(EstG.V.Y, EstG.V.Z);
-    attitude->pitch = atan2f(-EstG.V.X, sqrtf(EstG.V.Y * EstG.V.Y + EstG.V.Z * EstG.V.Z));
+    attitude->roll = atan2f(state->EstG.V.Y, state->EstG.V.Z);
+    attitude->pitch = atan2f(-state->EstG.V.X, sqrtf(state->EstG.V.Y * state->EstG.V.Y + state->EstG.V.Z * state->EstG.V.Z));
 
     if (magADC) {
-        rotateVector(&EstM.V, deltaGyroAngle);
+        rotateVector(&state->EstM.V, deltaGyroAngle);
         
         for (int axis = 0; axis < 3; axis++) {
-            EstM.A[axis] = (EstM.A[axis] * gyro_cmpfm_factor + magADC[axis]) * invGyroComplimentaryFilter_M_Factor;
+            state->EstM.A[axis] = (state->EstM.A[axis] * gyro_cmpfm_factor + magADC[axis]) * INV_GYR_CMPFM_FACTOR;
         }
-        attitude->heading = calculateHeading(&EstM, attitude->roll, attitude->pitch);
+        attitude->heading = calculateHeading(&state->EstM, attitude->roll, attitude->pitch);
     } else {
-        rotateVector(&EstN.V, deltaGyroAngle);
-        normalizeVector(&EstN.V, &EstN.V);
-        attitude->heading = calculateHeading(&EstN, attitude->roll, attitude->pitch);
+        rotateVector(&state->EstN.V, deltaGyroAngle);
+        normalizeVector(&state->EstN.V, &state->EstN.V);
+        attitude->heading = calculateHeading(&state->EstN, attitude->roll, attitude->pitch);
     }
 }
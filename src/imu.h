@@ -19,10 +19,16 @@ typedef struct attitude_t {
     float heading;
 } attitude_t;
 
-void imuInit(void);
+// The estimator's state, kept separately for each log that's being processed
+typedef struct imuState_t {
+    t_fp_vector EstG, EstM, EstN;
+    uint32_t previousTime;
+} imuState_t;
+
+void imuInit(imuState_t *state);
 void imuSetMagneticDeclination(double declination);
 
-void updateEstimatedAttitude(int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude);
+void updateEstimatedAttitude(imuState_t *state, int16_t gyroADC[3], int16_t accSmooth[3], int16_t magADC[3], uint32_t currentTime, uint16_t acc_1G, float gyroScale, attitude_t *attitude);
 t_fp_vector calculateAccelerationInEarthFrame(int16_t accSmooth[3], attitude_t *attitude, uint16_t acc_1G);
 
 #endif
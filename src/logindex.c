@@ -0,0 +1,557 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "logindex.h"
+
+/*
+ * Sidecar file format (all integers little-endian):
+ *
+ * "BBIX", u32 version, u64 log file size, u64 log file modification time, u64 fingerprint, u32 log count,
+ * u64 logBegin[log count + 1], then for each log:
+ *     u8 complete, u32 I-frame count, u32 GPS home frame count, u32 slow frame count,
+ *     each I-frame as u64 offset, u32 iteration, u64 time,
+ *     u64 offset of each GPS home frame, u64 offset of each slow frame
+ */
+#define FLIGHT_LOG_INDEX_MAGIC "BBIX"
+#define FLIGHT_LOG_INDEX_VERSION 2
+
+// How many bytes from the beginning of each log (its headers and first frames) go into the index's fingerprint
+#define FLIGHT_LOG_INDEX_FINGERPRINT_LENGTH (64 * 1024)
+
+#define FLIGHT_LOG_INDEX_EXTENSION ".idx"
+
+/**
+ * Get the name of the index file that belongs to the given log file. The caller must free the result.
+ */
+char* flightLogIndexFilename(const char *logFilename)
+{
+    size_t length = strlen(logFilename) + strlen(FLIGHT_LOG_INDEX_EXTENSION) + 1;
+    char *result = malloc(length);
+
+    snprintf(result, length, "%s%s", logFilename, FLIGHT_LOG_INDEX_EXTENSION);
+
+    return result;
+}
+
+/**
+ * Make room in the array for one more element, growing it if necessary.
+ */
+static void* growArray(void *array, int count, int *capacity, size_t elementSize)
+{
+    if (count < *capacity) {
+        return array;
+    }
+
+    *capacity = *capacity ? *capacity * 2 : 256;
+    array = realloc(array, *capacity * elementSize);
+
+    if (!array) {
+        fprintf(stderr, "Failed to allocate memory for the log index\n");
+        exit(-1);
+    }
+
+    return array;
+}
+
+/**
+ * Hash the beginning of each log in the file (64-bit FNV-1a), so that an index isn't mistaken for one that belongs to a
+ * different file whose logs begin at the same places (like two flash dumps of the same size holding one log each).
+ *
+ * This moves the log's stream around, so it mustn't be called while a log is being parsed.
+ */
+static uint64_t flightLogIndexFingerprint(flightLog_t *log)
+{
+    mmapStream_t *stream = log->private->stream;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    streamSetRange(stream, 0, log->logBegin[log->logCount]);
+
+    for (int i = 0; i < log->logCount; i++) {
+        int64_t offset = log->logBegin[i], end = log->logBegin[i + 1];
+
+        if (end - offset > FLIGHT_LOG_INDEX_FINGERPRINT_LENGTH) {
+            end = offset + FLIGHT_LOG_INDEX_FINGERPRINT_LENGTH;
+        }
+
+        // A file that's mapped a window at a time might need the next window mapped part way through
+        while (offset < end && streamSeek(stream, offset)) {
+            const char *pos = stream->pos;
+            const char *chunkEnd = stream->end - pos < end - offset ? stream->end : pos + (end - offset);
+
+            for (; pos < chunkEnd; pos++) {
+                hash = (hash ^ (uint8_t) *pos) * 0x100000001b3ULL;
+            }
+
+            offset = streamOffset(stream, chunkEnd);
+        }
+    }
+
+    return hash;
+}
+
+/**
+ * Create an empty index for the logs in the given file.
+ */
+flightLogIndex_t* flightLogIndexCreate(flightLog_t *log)
+{
+    flightLogIndex_t *index = calloc(1, sizeof(*index));
+
+    index->fileSize = log->private->stream->mapping.stats.st_size;
+    index->modifiedTime = log->private->stream->mapping.stats.st_mtime;
+    index->fingerprint = flightLogIndexFingerprint(log);
+    index->logCount = log->logCount;
+    index->logBegin = malloc((log->logCount + 1) * sizeof(*index->logBegin));
+    index->logs = calloc(log->logCount ? log->logCount : 1, sizeof(*index->logs));
+
+    memcpy(index->logBegin, log->logBegin, (log->logCount + 1) * sizeof(*index->logBegin));
+
+    return index;
+}
+
+void flightLogIndexDestroy(flightLogIndex_t *index)
+{
+    if (!index)
+        return;
+
+    for (int i = 0; i < index->logCount; i++) {
+        free(index->logs[i].intraframes);
+        free(index->logs[i].gpsHomeOffsets);
+        free(index->logs[i].slowOffsets);
+    }
+
+    free(index->logBegin);
+    free(index->logs);
+    free(index);
+}
+
+/**
+ * Check if anything has been recorded since the index was loaded or last saved.
+ */
+bool flightLogIndexModified(const flightLogIndex_t *index)
+{
+    for (int i = 0; i < index->logCount; i++) {
+        if (index->logs[i].modified)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Forget anything recorded about the log so that a fresh decode of it can be recorded.
+ */
+void flightLogIndexBeginLog(flightLogIndex_t *index, int logIndex)
+{
+    flightLogIndexedLog_t *indexedLog = &index->logs[logIndex];
+
+    indexedLog->complete = false;
+    indexedLog->intraframeCount = 0;
+    indexedLog->gpsHomeCount = 0;
+    indexedLog->slowCount = 0;
+}
+
+void flightLogIndexAddIntraframe(flightLogIndex_t *index, int logIndex, int64_t offset, uint32_t iteration, int64_t time)
+{
+    flightLogIndexedLog_t *indexedLog = &index->logs[logIndex];
+    flightLogIndexEntry_t *entry;
+
+    indexedLog->intraframes = growArray(indexedLog->intraframes, indexedLog->intraframeCount, &indexedLog->intraframeCapacity, sizeof(*indexedLog->intraframes));
+
+    entry = &indexedLog->intraframes[indexedLog->intraframeCount++];
+
+    entry->offset = offset;
+    entry->iteration = iteration;
+    entry->time = time;
+}
+
+void flightLogIndexAddGPSHome(flightLogIndex_t *index, int logIndex, int64_t offset)
+{
+    flightLogIndexedLog_t *indexedLog = &index->logs[logIndex];
+
+    indexedLog->gpsHomeOffsets = growArray(indexedLog->gpsHomeOffsets, indexedLog->gpsHomeCount, &indexedLog->gpsHomeCapacity, sizeof(*indexedLog->gpsHomeOffsets));
+    indexedLog->gpsHomeOffsets[indexedLog->gpsHomeCount++] = offset;
+}
+
+void flightLogIndexAddSlow(flightLogIndex_t *index, int logIndex, int64_t offset)
+{
+    flightLogIndexedLog_t *indexedLog = &index->logs[logIndex];
+
+    indexedLog->slowOffsets = growArray(indexedLog->slowOffsets, indexedLog->slowCount, &indexedLog->slowCapacity, sizeof(*indexedLog->slowOffsets));
+    indexedLog->slowOffsets[indexedLog->slowCount++] = offset;
+}
+
+void flightLogIndexCompleteLog(flightLogIndex_t *index, int logIndex)
+{
+    index->logs[logIndex].complete = true;
+    index->logs[logIndex].modified = true;
+}
+
+/**
+ * Find the last of the offsets which is before `offset`, or -1 if there isn't one.
+ */
+static int64_t findOffsetBefore(const int64_t *offsets, int count, int64_t offset)
+{
+    int low = 0, high = count;
+
+    // Find the first offset which isn't before the given one
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+
+        if (offsets[mid] < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low > 0 ? offsets[low - 1] : -1;
+}
+
+static void fillSeekPoint(const flightLogIndexedLog_t *indexedLog, int entryIndex, flightLogSeekPoint_t *point)
+{
+    const flightLogIndexEntry_t *entry = &indexedLog->intraframes[entryIndex];
+
+    point->offset = entry->offset;
+    point->iteration = entry->iteration;
+    point->time = entry->time;
+
+    point->gpsHomeOffset = findOffsetBefore(indexedLog->gpsHomeOffsets, indexedLog->gpsHomeCount, entry->offset);
+    point->slowOffset = findOffsetBefore(indexedLog->slowOffsets, indexedLog->slowCount, entry->offset);
+}
+
+static const flightLogIndexedLog_t* findIndexedLog(const flightLogIndex_t *index, int logIndex)
+{
+    if (!index || logIndex < 0 || logIndex >= index->logCount || !index->logs[logIndex].complete)
+        return NULL;
+
+    return &index->logs[logIndex];
+}
+
+/**
+ * Count the I-frames in the log whose time is at or before the given time.
+ */
+static int countIntraframesAtOrBeforeTime(const flightLogIndexedLog_t *indexedLog, int64_t time)
+{
+    int low = 0, high = indexedLog->intraframeCount;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+
+        if (indexedLog->intraframes[mid].time <= time) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/**
+ * Find the last I-frame in the log whose time is at or before the given time, so that decoding from there will reach
+ * that time.
+ *
+ * Returns false if the log isn't indexed or the time is before its first I-frame (so decoding should begin at the
+ * start of the log instead).
+ */
+bool flightLogIndexFindTime(const flightLogIndex_t *index, int logIndex, int64_t time, flightLogSeekPoint_t *point)
+{
+    const flightLogIndexedLog_t *indexedLog = findIndexedLog(index, logIndex);
+    int count;
+
+    if (!indexedLog)
+        return false;
+
+    count = countIntraframesAtOrBeforeTime(indexedLog, time);
+
+    if (count == 0)
+        return false;
+
+    fillSeekPoint(indexedLog, count - 1, point);
+
+    return true;
+}
+
+/**
+ * Find the first I-frame in the log whose time is after the given time, which is where a decode that should stop at
+ * that time can end.
+ *
+ * Returns false if the log isn't indexed or there's no such I-frame (so decoding should run to the end of the log).
+ */
+bool flightLogIndexFindTimeAfter(const flightLogIndex_t *index, int logIndex, int64_t time, flightLogSeekPoint_t *point)
+{
+    const flightLogIndexedLog_t *indexedLog = findIndexedLog(index, logIndex);
+    int count;
+
+    if (!indexedLog)
+        return false;
+
+    count = countIntraframesAtOrBeforeTime(indexedLog, time);
+
+    if (count == indexedLog->intraframeCount)
+        return false;
+
+    fillSeekPoint(indexedLog, count, point);
+
+    return true;
+}
+
+/**
+ * Like flightLogIndexFindTime(), but find the last I-frame at or before the given loop iteration.
+ */
+bool flightLogIndexFindIteration(const flightLogIndex_t *index, int logIndex, uint32_t iteration, flightLogSeekPoint_t *point)
+{
+    const flightLogIndexedLog_t *indexedLog = findIndexedLog(index, logIndex);
+    int low = 0, high;
+
+    if (!indexedLog)
+        return false;
+
+    high = indexedLog->intraframeCount;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+
+        if (indexedLog->intraframes[mid].iteration <= iteration) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low == 0)
+        return false;
+
+    fillSeekPoint(indexedLog, low - 1, point);
+
+    return true;
+}
+
+static void writeU8(FILE *file, uint8_t value)
+{
+    fputc(value, file);
+}
+
+static void writeU32(FILE *file, uint32_t value)
+{
+    uint8_t bytes[4];
+
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (uint8_t) (value >> (i * 8));
+    }
+
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+static void writeU64(FILE *file, uint64_t value)
+{
+    writeU32(file, (uint32_t) value);
+    writeU32(file, (uint32_t) (value >> 32));
+}
+
+static bool readU8(FILE *file, uint8_t *value)
+{
+    int c = fgetc(file);
+
+    *value = (uint8_t) c;
+
+    return c != EOF;
+}
+
+static bool readU32(FILE *file, uint32_t *value)
+{
+    uint8_t bytes[4];
+
+    if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes))
+        return false;
+
+    *value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        *value |= (uint32_t) bytes[i] << (i * 8);
+    }
+
+    return true;
+}
+
+static bool readU64(FILE *file, uint64_t *value)
+{
+    uint32_t low, high;
+
+    if (!readU32(file, &low) || !readU32(file, &high))
+        return false;
+
+    *value = ((uint64_t) high << 32) | low;
+
+    return true;
+}
+
+static bool readOffsets(FILE *file, int64_t **offsets, int count, int *capacity)
+{
+    *offsets = malloc((count > 0 ? count : 1) * sizeof(**offsets));
+    *capacity = count;
+
+    for (int i = 0; i < count; i++) {
+        if (!readU64(file, (uint64_t *) &(*offsets)[i]))
+            return false;
+    }
+
+    return true;
+}
+
+static bool readIndexedLog(FILE *file, flightLogIndexedLog_t *indexedLog, int64_t logSize)
+{
+    uint8_t complete;
+    uint32_t intraframeCount, gpsHomeCount, slowCount;
+
+    if (!readU8(file, &complete) || !readU32(file, &intraframeCount) || !readU32(file, &gpsHomeCount) || !readU32(file, &slowCount))
+        return false;
+
+    // There can't be more frames than bytes, so anything else is a corrupt file that we shouldn't allocate for
+    if (intraframeCount > logSize || gpsHomeCount > logSize || slowCount > logSize)
+        return false;
+
+    indexedLog->complete = complete != 0;
+    indexedLog->intraframes = malloc((intraframeCount > 0 ? intraframeCount : 1) * sizeof(*indexedLog->intraframes));
+    indexedLog->intraframeCapacity = intraframeCount;
+
+    for (uint32_t i = 0; i < intraframeCount; i++) {
+        flightLogIndexEntry_t *entry = &indexedLog->intraframes[i];
+
+        if (!readU64(file, (uint64_t *) &entry->offset) || !readU32(file, &entry->iteration) || !readU64(file, (uint64_t *) &entry->time))
+            return false;
+
+        indexedLog->intraframeCount++;
+    }
+
+    if (!readOffsets(file, &indexedLog->gpsHomeOffsets, gpsHomeCount, &indexedLog->gpsHomeCapacity))
+        return false;
+    indexedLog->gpsHomeCount = gpsHomeCount;
+
+    if (!readOffsets(file, &indexedLog->slowOffsets, slowCount, &indexedLog->slowCapacity))
+        return false;
+    indexedLog->slowCount = slowCount;
+
+    return true;
+}
+
+/**
+ * Load the index for the given log file from the sidecar file with the given name.
+ *
+ * Returns NULL if there is no index, or if it doesn't match the log file (e.g. because the log has been modified since,
+ * or the index was made from a different file).
+ */
+flightLogIndex_t* flightLogIndexLoad(flightLog_t *log, const char *filename)
+{
+    flightLogIndex_t *index;
+    FILE *file;
+    char magic[4];
+    uint32_t version, logCount;
+    uint64_t fileSize, modifiedTime, fingerprint, logBegin;
+    bool valid = false;
+
+    // Only a log which is a regular file can be indexed
+    if ((log->private->stream->mapping.stats.st_mode & S_IFMT) != S_IFREG)
+        return NULL;
+
+    file = fopen(filename, "rb");
+
+    if (!file)
+        return NULL;
+
+    index = flightLogIndexCreate(log);
+
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, FLIGHT_LOG_INDEX_MAGIC, sizeof(magic)) != 0
+            || !readU32(file, &version) || version != FLIGHT_LOG_INDEX_VERSION
+            || !readU64(file, &fileSize) || (int64_t) fileSize != index->fileSize
+            || !readU64(file, &modifiedTime) || (int64_t) modifiedTime != index->modifiedTime
+            || !readU64(file, &fingerprint) || fingerprint != index->fingerprint
+            || !readU32(file, &logCount) || (int) logCount != index->logCount) {
+        goto done;
+    }
+
+    for (int i = 0; i <= index->logCount; i++) {
+        if (!readU64(file, &logBegin) || (int64_t) logBegin != index->logBegin[i])
+            goto done;
+    }
+
+    for (int i = 0; i < index->logCount; i++) {
+        if (!readIndexedLog(file, &index->logs[i], index->logBegin[i + 1] - index->logBegin[i]))
+            goto done;
+    }
+
+    valid = true;
+
+done:
+    fclose(file);
+
+    if (!valid) {
+        flightLogIndexDestroy(index);
+        return NULL;
+    }
+
+    return index;
+}
+
+/**
+ * Write the index to a sidecar file with the given name. Returns true on success.
+ */
+bool flightLogIndexSave(flightLogIndex_t *index, const char *filename)
+{
+    FILE *file = fopen(filename, "wb");
+    bool success;
+
+    if (!file)
+        return false;
+
+    fwrite(FLIGHT_LOG_INDEX_MAGIC, 1, strlen(FLIGHT_LOG_INDEX_MAGIC), file);
+    writeU32(file, FLIGHT_LOG_INDEX_VERSION);
+    writeU64(file, index->fileSize);
+    writeU64(file, index->modifiedTime);
+    writeU64(file, index->fingerprint);
+    writeU32(file, index->logCount);
+
+    for (int i = 0; i <= index->logCount; i++) {
+        writeU64(file, index->logBegin[i]);
+    }
+
+    for (int i = 0; i < index->logCount; i++) {
+        flightLogIndexedLog_t *indexedLog = &index->logs[i];
+
+        writeU8(file, indexedLog->complete);
+        writeU32(file, indexedLog->intraframeCount);
+        writeU32(file, indexedLog->gpsHomeCount);
+        writeU32(file, indexedLog->slowCount);
+
+        for (int j = 0; j < indexedLog->intraframeCount; j++) {
+            writeU64(file, indexedLog->intraframes[j].offset);
+            writeU32(file, indexedLog->intraframes[j].iteration);
+            writeU64(file, indexedLog->intraframes[j].time);
+        }
+
+        for (int j = 0; j < indexedLog->gpsHomeCount; j++) {
+            writeU64(file, indexedLog->gpsHomeOffsets[j]);
+        }
+
+        for (int j = 0; j < indexedLog->slowCount; j++) {
+            writeU64(file, indexedLog->slowOffsets[j]);
+        }
+    }
+
+    success = !ferror(file);
+
+    if (fclose(file) != 0)
+        success = false;
+
+    if (!success) {
+        // Don't leave a truncated index behind
+        remove(filename);
+    } else {
+        for (int i = 0; i < index->logCount; i++) {
+            index->logs[i].modified = false;
+        }
+    }
+
+    return success;
+}
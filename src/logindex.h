@@ -0,0 +1,69 @@
+#ifndef LOGINDEX_H_
+#define LOGINDEX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "parser.h"
+
+typedef struct flightLogIndexEntry_t {
+    int64_t offset; // Of the I-frame's marker byte from the start of the file
+    uint32_t iteration;
+    int64_t time; // After 32-bit timestamp rollovers have been applied
+} flightLogIndexEntry_t;
+
+typedef struct flightLogIndexedLog_t {
+    // Set once a whole decode of the log has been recorded
+    bool complete;
+
+    // Set when there's something new about this log to save (kept per log so that logs can be decoded concurrently)
+    bool modified;
+
+    // The I-frames that the parser accepted, in log order
+    flightLogIndexEntry_t *intraframes;
+    int intraframeCount, intraframeCapacity;
+
+    // Offsets of the marker bytes of the GPS home and slow frames that the parser delivered, in log order
+    int64_t *gpsHomeOffsets;
+    int gpsHomeCount, gpsHomeCapacity;
+
+    int64_t *slowOffsets;
+    int slowCount, slowCapacity;
+} flightLogIndexedLog_t;
+
+/**
+ * Records the places in a log file where decoding can begin, so that tools can jump to a point in time without
+ * decoding everything before it. The index is kept in a sidecar file next to the log (see flightLogIndexFilename()).
+ */
+typedef struct flightLogIndex_t {
+    int64_t fileSize;
+
+    // So that an index is only used with the log file it was made from, and not with a different one of the same size
+    int64_t modifiedTime;
+    uint64_t fingerprint;
+
+    int logCount;
+    int64_t *logBegin; // With an extra element for the end of the last log
+
+    flightLogIndexedLog_t *logs;
+} flightLogIndex_t;
+
+char* flightLogIndexFilename(const char *logFilename);
+
+flightLogIndex_t* flightLogIndexCreate(flightLog_t *log);
+flightLogIndex_t* flightLogIndexLoad(flightLog_t *log, const char *filename);
+bool flightLogIndexSave(flightLogIndex_t *index, const char *filename);
+void flightLogIndexDestroy(flightLogIndex_t *index);
+bool flightLogIndexModified(const flightLogIndex_t *index);
+
+void flightLogIndexBeginLog(flightLogIndex_t *index, int logIndex);
+void flightLogIndexAddIntraframe(flightLogIndex_t *index, int logIndex, int64_t offset, uint32_t iteration, int64_t time);
+void flightLogIndexAddGPSHome(flightLogIndex_t *index, int logIndex, int64_t offset);
+void flightLogIndexAddSlow(flightLogIndex_t *index, int logIndex, int64_t offset);
+void flightLogIndexCompleteLog(flightLogIndex_t *index, int logIndex);
+
+bool flightLogIndexFindTime(const flightLogIndex_t *index, int logIndex, int64_t time, flightLogSeekPoint_t *point);
+bool flightLogIndexFindTimeAfter(const flightLogIndex_t *index, int logIndex, int64_t time, flightLogSeekPoint_t *point);
+bool flightLogIndexFindIteration(const flightLogIndex_t *index, int logIndex, uint32_t iteration, flightLogSeekPoint_t *point);
+
+#endif
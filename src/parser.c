@@ -18,13 +18,24 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <assert.h>
+#include <limits.h>
+
+#ifndef WIN32
+    #include <unistd.h>
+#endif
 
 #include "parser.h"
 #include "tools.h"
 #include "decoders.h"
+#include "logindex.h"
+#include "serial.h"
+#include "decompress.h"
 
 #define LOG_START_MARKER "H Product:Blackbox flight data recorder by Nicholas Sherlock\n"
 
+// When a file is searched for logs by several threads, each one searches at least this much of it
+#define FLIGHT_LOG_SEARCH_MIN_CHUNK_SIZE (16 * 1024 * 1024)
+
 //Assume that even in the most woeful logging situation, we won't miss 10 seconds of frames
 #define MAXIMUM_TIME_JUMP_BETWEEN_FRAMES (10 * 1000000)
 
@@ -36,6 +47,25 @@ union {
     uint32_t u;
 } floatConvert;
 
+typedef enum ParserState {
+    PARSER_STATE_HEADER = 0,
+    PARSER_STATE_TRANSITION,
+    PARSER_STATE_DATA
+} ParserState;
+
+// A piece of a file to search for the beginnings of logs, and the offsets of the ones that were found in it
+typedef struct logSearchChunk_t {
+    // Markers which begin in [begin, end) belong to this chunk, limit is the end of the file
+    int64_t begin, end, limit;
+
+    // The file's data when it's all mapped into memory, otherwise the chunk maps it from fd a window at a time
+    const char *data;
+    int fd;
+
+    int64_t *found;
+    int count, capacity;
+} logSearchChunk_t;
+
 typedef void (*FlightLogFrameParse)(flightLog_t *log, mmapStream_t *stream, bool raw);
 typedef bool (*FlightLogFrameComplete)(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, const char *frameStart, const char *frameEnd, bool raw);
 
@@ -68,6 +98,64 @@ static const flightLogFrameType_t frameTypes[] = {
     {.marker = 'S', .parse = parseSlowFrame,    .complete = completeSlowFrame}
 };
 
+/**
+ * Make sure that the frame definition has room for at least `count` fields. New fields are unsigned 32-bit fields with
+ * no predictor or encoding.
+ */
+static void frameDefReserveFields(flightLogFrameDef_t *frameDef, int count)
+{
+    if (count <= frameDef->fieldCapacity) {
+        return;
+    }
+
+    frameDef->fieldName = realloc(frameDef->fieldName, count * sizeof(*frameDef->fieldName));
+    frameDef->fieldSigned = realloc(frameDef->fieldSigned, count * sizeof(*frameDef->fieldSigned));
+    frameDef->fieldWidth = realloc(frameDef->fieldWidth, count * sizeof(*frameDef->fieldWidth));
+    frameDef->predictor = realloc(frameDef->predictor, count * sizeof(*frameDef->predictor));
+    frameDef->encoding = realloc(frameDef->encoding, count * sizeof(*frameDef->encoding));
+
+    if (!frameDef->fieldName || !frameDef->fieldSigned || !frameDef->fieldWidth || !frameDef->predictor || !frameDef->encoding) {
+        fprintf(stderr, "Failed to allocate memory for field definitions\n");
+        exit(-1);
+    }
+
+    for (int i = frameDef->fieldCapacity; i < count; i++) {
+        frameDef->fieldName[i] = NULL;
+        frameDef->fieldSigned[i] = 0;
+        // Older logging code might omit the field width header
+        frameDef->fieldWidth[i] = 4;
+        frameDef->predictor[i] = 0;
+        frameDef->encoding[i] = 0;
+    }
+
+    frameDef->fieldCapacity = count;
+}
+
+static void frameDefDestroyFields(flightLogFrameDef_t *frameDef)
+{
+    free(frameDef->namesLine);
+    free(frameDef->fieldName);
+    free(frameDef->fieldSigned);
+    free(frameDef->fieldWidth);
+    free(frameDef->predictor);
+    free(frameDef->encoding);
+
+    memset(frameDef, 0, sizeof(*frameDef));
+}
+
+static int countCommaSeparatedValues(const char *line)
+{
+    int count = 1;
+
+    for (; *line; line++) {
+        if (*line == ',') {
+            count++;
+        }
+    }
+
+    return count;
+}
+
 /**
  * Parse a comma-separated list of field names into the given frame definition. Sets the fieldCount field based on the
  * number of names parsed.
@@ -78,9 +166,12 @@ static void parseFieldNames(const char *line, flightLogFrameDef_t *frameDef)
     bool done = false;
 
     //Make a copy of the line so we can manage its lifetime (and write to it to null terminate the fields)
+    free(frameDef->namesLine);
     frameDef->namesLine = strdup(line);
     frameDef->fieldCount = 0;
 
+    frameDefReserveFields(frameDef, countCommaSeparatedValues(line));
+
     start = frameDef->namesLine;
 
     while (!done && *start) {
@@ -129,6 +220,19 @@ static void parseCommaSeparatedIntegers(char *line, int *target, int maxCount)
     }
 }
 
+/**
+ * Parse a comma-separated list of integers from the header of the frame definition into `target` (which is one of its
+ * per-field arrays, making room for them first).
+ */
+static void parseFieldIntegers(char *line, flightLogFrameDef_t *frameDef, int **target)
+{
+    int count = countCommaSeparatedValues(line);
+
+    frameDefReserveFields(frameDef, count);
+
+    parseCommaSeparatedIntegers(line, *target, count);
+}
+
 static void identifyMainFields(flightLog_t *log, flightLogFrameDef_t *frameDef)
 {
     int fieldIndex;
@@ -289,6 +393,10 @@ static void identifyFields(flightLog_t * log, uint8_t frameType, flightLogFrameD
     }
 }
 
+/**
+ * Parse the header line that begins at the stream's position, which can be any length (newer firmware logs so many
+ * fields that their "Field I name" lines run to several kilobytes). Returns the number of bytes consumed.
+ */
 static size_t parseHeaderLine(flightLog_t *log, mmapStream_t *stream, ParserState *parserState) {
 
     if (streamReadByte(stream) != 'H') {
@@ -299,42 +407,64 @@ static size_t parseHeaderLine(flightLog_t *log, mmapStream_t *stream, ParserStat
         return 1;
     }
 
-    const char *lineStart = stream->pos;
-    char valueBuffer[FLIGHT_LOG_MAX_FRAME_HEADER_LENGTH];
-    const char *separatorPos = 0;
+    // Held by index rather than by pointer into the stream, since a windowed stream can slide along as we read the line
+    char *valueBuffer = log->private->headerLine;
+    size_t capacity = log->private->headerLineCapacity;
+    size_t separatorIndex = 0;
+    bool haveSeparator = false;
     size_t i = 0;
-    for ( ; i < FLIGHT_LOG_MAX_FRAME_HEADER_LENGTH; ++i) {
-        char c = streamReadChar(stream);
-
-        if (c == ':' && !separatorPos) {
-            separatorPos = stream->pos - 1;
+    for ( ; ; ++i) {
+        if (stream->windowed && stream->pos == stream->end) {
+            streamFillWindow(stream);
         }
 
+        char c = streamReadChar(stream);
+
         if (c == '\n') {
-            i++;//size includes the newline.
             break;
         }
 
         if (c == EOF || c == '\0') {
             // Line ended before we saw a newline or it has binary stuff in there that shouldn't be there
-            return i;
+            if (i > 0) {
+                fprintf(log->messages, "Warning: Ignoring a header line that was cut short after %zu bytes\n", i + 2);
+            }
+            return i + 2;
+        }
+
+        if (c == ':' && !haveSeparator) {
+            separatorIndex = i;
+            haveSeparator = true;
         }
+
+        // Leave room for the terminator
+        if (i + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : FLIGHT_LOG_MAX_FRAME_HEADER_LENGTH;
+            valueBuffer = realloc(valueBuffer, capacity);
+
+            if (!valueBuffer) {
+                fprintf(stderr, "Failed to allocate memory for the log's headers\n");
+                exit(-1);
+            }
+
+            log->private->headerLine = valueBuffer;
+            log->private->headerLineCapacity = capacity;
+        }
+
         valueBuffer[i] = c;
     }
-    size_t frameSize = i+2; //We have read two bytes previously.
-    if (!separatorPos) {
+    size_t frameSize = i + 3; //We have read two bytes previously, and the size includes the newline.
+    if (!haveSeparator) {
         return frameSize;
     }
 
-    const char *lineEnd = stream->pos;
-
     char *fieldName = valueBuffer;
-    valueBuffer[separatorPos - lineStart] = '\0';
+    valueBuffer[separatorIndex] = '\0';
     if (strstr(fieldName,"features")) { // This is the last field in the header.
         *parserState = PARSER_STATE_TRANSITION;
     }
-    char *fieldValue = valueBuffer + (separatorPos - lineStart) + 1;
-    valueBuffer[lineEnd - lineStart - 1] = '\0';
+    char *fieldValue = valueBuffer + separatorIndex + 1;
+    valueBuffer[i] = '\0';
 
     if (startsWith(fieldName, "Field ")) {
         uint8_t frameType = (uint8_t) fieldName[strlen("Field ")];
@@ -346,19 +476,21 @@ static size_t parseHeaderLine(flightLog_t *log, mmapStream_t *stream, ParserStat
 
             if (frameType == 'I') {
                 // P frames are derived from I frames so copy common data over to the P frame:
-                memcpy(log->frameDefs['P'].fieldName, frameDef->fieldName, sizeof(frameDef->fieldName));
+                frameDefReserveFields(&log->frameDefs['P'], frameDef->fieldCapacity);
+                memcpy(log->frameDefs['P'].fieldName, frameDef->fieldName, frameDef->fieldCapacity * sizeof(*frameDef->fieldName));
                 log->frameDefs['P'].fieldCount = frameDef->fieldCount;
             }
         } else if (endsWith(fieldName, " signed")) {
-            parseCommaSeparatedIntegers(fieldValue, frameDef->fieldSigned, FLIGHT_LOG_MAX_FIELDS);
+            parseFieldIntegers(fieldValue, frameDef, &frameDef->fieldSigned);
 
             if (frameType == 'I') {
-                memcpy(log->frameDefs['P'].fieldSigned, frameDef->fieldSigned, sizeof(frameDef->fieldSigned));
+                frameDefReserveFields(&log->frameDefs['P'], frameDef->fieldCapacity);
+                memcpy(log->frameDefs['P'].fieldSigned, frameDef->fieldSigned, frameDef->fieldCapacity * sizeof(*frameDef->fieldSigned));
             }
         } else if (endsWith(fieldName, " predictor")) {
-            parseCommaSeparatedIntegers(fieldValue, frameDef->predictor, FLIGHT_LOG_MAX_FIELDS);
+            parseFieldIntegers(fieldValue, frameDef, &frameDef->predictor);
         } else if (endsWith(fieldName, " encoding")) {
-            parseCommaSeparatedIntegers(fieldValue, frameDef->encoding, FLIGHT_LOG_MAX_FIELDS);
+            parseFieldIntegers(fieldValue, frameDef, &frameDef->encoding);
         }
     } else if (strcmp(fieldName, "I interval") == 0) {
         log->frameIntervalI = atoi(fieldValue);
@@ -515,135 +647,535 @@ static int64_t applyPrediction(flightLog_t *log, int fieldIndex, int predictor,
     return value;
 }
 
-/**
- * Attempt to parse the frame of the given `frameType` into the supplied `frame` buffer using the encoding/predictor
- * definitions from log->frameDefs[`frameType`].
+/*
+ * Decode programs
  *
- * raw - Set to true to disable predictions (and so store raw values)
- * skippedFrames - Set to the number of field iterations that were skipped over by rate settings since the last frame.
+ * Frame definitions can't change once the headers have been read, so before we decode any data frames we compile each
+ * of them into a list of ops. Each op reads one field, or a group of fields whose size has already been worked out,
+ * then applies the predictions for those fields, which have been resolved into a form that's cheap to apply.
+ */
+
+typedef enum {
+    FLIGHT_LOG_OP_INCREMENT = 0,
+    FLIGHT_LOG_OP_VB, // A run of variable-byte fields
+    FLIGHT_LOG_OP_TAG8_4S16_V1,
+    FLIGHT_LOG_OP_TAG8_4S16_V2,
+    FLIGHT_LOG_OP_TAG2_3S32,
+    FLIGHT_LOG_OP_TAG8_8SVB,
+    FLIGHT_LOG_OP_ELIAS_DELTA_U32,
+    FLIGHT_LOG_OP_ELIAS_DELTA_S32,
+    FLIGHT_LOG_OP_ELIAS_GAMMA_U32,
+    FLIGHT_LOG_OP_ELIAS_GAMMA_S32,
+    FLIGHT_LOG_OP_NULL,
+    FLIGHT_LOG_OP_UNSUPPORTED
+} flightLogOpCode_e;
+
+typedef enum {
+    FLIGHT_LOG_PREDICT_CONSTANT = 0, // Add the step's constant (zero for PREDICTOR_0 and in raw mode)
+    FLIGHT_LOG_PREDICT_CURRENT, // Add the field `source` of the frame being decoded
+    FLIGHT_LOG_PREDICT_PREVIOUS,
+    FLIGHT_LOG_PREDICT_STRAIGHT_LINE,
+    FLIGHT_LOG_PREDICT_AVERAGE_2,
+    FLIGHT_LOG_PREDICT_HOME_COORD, // Add the field `source` of the last GPS home frame
+    FLIGHT_LOG_PREDICT_LAST_MAIN_FRAME_TIME,
+    FLIGHT_LOG_PREDICT_GENERIC // Leave it to applyPrediction(), which reports the predictors we can't apply
+} flightLogPrediction_e;
+
+typedef enum {
+    FLIGHT_LOG_TRUNCATE_NONE = 0,
+    FLIGHT_LOG_TRUNCATE_SIGNED_32,
+    FLIGHT_LOG_TRUNCATE_UNSIGNED_32
+} flightLogTruncation_e;
+
+typedef struct flightLogFieldStep_t {
+    uint8_t prediction, truncation;
+
+    // For fields decoded by FLIGHT_LOG_OP_VB, what they're encoded as
+    uint8_t encoding;
+
+    int predictor; // The field's original predictor (or PREDICTOR_0 in raw mode)
+    int source;
+    int64_t constant;
+} flightLogFieldStep_t;
+
+typedef struct flightLogOp_t {
+    uint8_t opcode;
+    uint16_t fieldIndex, fieldCount;
+
+    int encoding; // For FLIGHT_LOG_OP_UNSUPPORTED
+} flightLogOp_t;
+
+typedef struct flightLogFrameProgram_t {
+    int opCount;
+    flightLogOp_t *ops;
+
+    // Tag groups always decode all of their 3 or 4 fields, even when the frame definition ends partway through one
+    flightLogFieldStep_t *fields;
+} flightLogFrameProgram_t;
+
+// The longest encoding of a 32-bit variable-byte field
+#define FLIGHT_LOG_MAX_VB_LENGTH 5
+
+// How many values past the end of a frame's definition a tag group can decode
+#define FLIGHT_LOG_FIELD_SPILL 3
+
+// Runs of variable-byte fields are read this many at a time
+#define FLIGHT_LOG_MAX_VB_RUN 32
+
+/**
+ * Is the field one that's stored as a single variable-byte integer (so that a run of them can be read together)?
+ */
+static bool isVariableByteField(flightLogFrameDef_t *frameDef, int fieldIndex)
+{
+    if (frameDef->predictor[fieldIndex] == FLIGHT_LOG_FIELD_PREDICTOR_INC)
+        return false;
+
+    switch (frameDef->encoding[fieldIndex]) {
+        case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
+        case FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB:
+        case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Work out how to apply the prediction for the field, and whether its value should then be truncated to its width
+ * (which the group encodings don't do).
  */
-static void parseFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, int64_t *frame, int64_t *previous, int64_t *previous2, int skippedFrames, bool raw)
+static void compileFieldStep(flightLog_t *log, flightLogFrameDef_t *frameDef, int fieldIndex, bool truncate, bool raw, flightLogFieldStep_t *step)
+{
+    // The fields past the end of the definition that a tag group can spill into are unpredicted
+    bool defined = fieldIndex < frameDef->fieldCount;
+
+    step->predictor = raw || !defined ? FLIGHT_LOG_FIELD_PREDICTOR_0 : frameDef->predictor[fieldIndex];
+    step->encoding = defined ? frameDef->encoding[fieldIndex] : FLIGHT_LOG_FIELD_ENCODING_NULL;
+    step->prediction = FLIGHT_LOG_PREDICT_CONSTANT;
+    step->source = 0;
+    step->constant = 0;
+
+    switch (step->predictor) {
+        case FLIGHT_LOG_FIELD_PREDICTOR_0:
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_MINTHROTTLE:
+            step->constant = log->sysConfig.minthrottle;
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_1500:
+            step->constant = 1500;
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_VBATREF:
+            step->constant = log->sysConfig.vbatref;
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_MINMOTOR:
+            step->constant = log->sysConfig.motorOutputLow;
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_MOTOR_0:
+            step->prediction = FLIGHT_LOG_PREDICT_CURRENT;
+            step->source = log->mainFieldIndexes.motor[0];
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+            step->prediction = FLIGHT_LOG_PREDICT_PREVIOUS;
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+            step->prediction = FLIGHT_LOG_PREDICT_STRAIGHT_LINE;
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+            step->prediction = FLIGHT_LOG_PREDICT_AVERAGE_2;
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD:
+            step->prediction = FLIGHT_LOG_PREDICT_HOME_COORD;
+            step->source = log->gpsHomeFieldIndexes.GPS_home[0];
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD_1:
+            step->prediction = FLIGHT_LOG_PREDICT_HOME_COORD;
+            step->source = log->gpsHomeFieldIndexes.GPS_home[1] < 1 ? -1 : log->gpsHomeFieldIndexes.GPS_home[1];
+        break;
+        case FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME:
+            step->prediction = FLIGHT_LOG_PREDICT_LAST_MAIN_FRAME_TIME;
+        break;
+        default:
+            step->prediction = FLIGHT_LOG_PREDICT_GENERIC;
+    }
+
+    // Predictions based on fields that don't exist produce an error when the frame is decoded
+    if ((step->prediction == FLIGHT_LOG_PREDICT_CURRENT || step->prediction == FLIGHT_LOG_PREDICT_HOME_COORD) && step->source < 0) {
+        step->prediction = FLIGHT_LOG_PREDICT_GENERIC;
+    }
+
+    if (!truncate || !defined || frameDef->fieldWidth[fieldIndex] == 8) {
+        step->truncation = FLIGHT_LOG_TRUNCATE_NONE;
+    } else {
+        // Assume 32-bit...
+        step->truncation = frameDef->fieldSigned[fieldIndex] ? FLIGHT_LOG_TRUNCATE_SIGNED_32 : FLIGHT_LOG_TRUNCATE_UNSIGNED_32;
+    }
+}
+
+static flightLogFrameProgram_t* compileFrameProgram(flightLog_t *log, uint8_t frameType, bool raw)
 {
     flightLogFrameDef_t *frameDef = &log->frameDefs[frameType];
+    flightLogFrameProgram_t *program = calloc(1, sizeof(*program));
+    int i = 0, j;
 
-    int *predictor = frameDef->predictor;
-    int *encoding = frameDef->encoding;
-    int *fieldSigned = frameDef->fieldSigned;
-    int *fieldWidth = frameDef->fieldWidth;
+    if (program) {
+        program->ops = calloc(frameDef->fieldCount, sizeof(*program->ops));
+        program->fields = calloc(frameDef->fieldCount + FLIGHT_LOG_FIELD_SPILL, sizeof(*program->fields));
+    }
 
-    int i, j, groupCount;
+    if (!program || !program->ops || !program->fields) {
+        fprintf(stderr, "Failed to allocate memory for the decoder\n");
+        exit(-1);
+    }
 
-    i = 0;
     while (i < frameDef->fieldCount) {
-        int64_t value;
-        int64_t values[8];
-
-        if (predictor[i] == FLIGHT_LOG_FIELD_PREDICTOR_INC) {
-            frame[i] = skippedFrames + 1;
+        flightLogOp_t *op = &program->ops[program->opCount++];
+        bool truncate = true;
 
-            if (previous)
-                frame[i] += previous[i];
+        op->fieldIndex = i;
+        op->fieldCount = 1;
 
+        if (frameDef->predictor[i] == FLIGHT_LOG_FIELD_PREDICTOR_INC) {
+            // Applied even in raw mode
+            op->opcode = FLIGHT_LOG_OP_INCREMENT;
             i++;
-        } else {
-            switch (encoding[i]) {
-                case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
-                    streamByteAlign(stream);
+            continue;
+        }
 
-                    value = streamReadSignedVB(stream);
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB:
-                    streamByteAlign(stream);
+        switch (frameDef->encoding[i]) {
+            case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
+            case FLIGHT_LOG_FIELD_ENCODING_UNSIGNED_VB:
+            case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
+                op->opcode = FLIGHT_LOG_OP_VB;
 
-                    value = streamReadUnsignedVB(stream);
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
-                    streamByteAlign(stream);
+                for (j = i + 1; j < frameDef->fieldCount && j < i + FLIGHT_LOG_MAX_VB_RUN && isVariableByteField(frameDef, j); j++)
+                    ;
 
-                    value = -signExtend14Bit(streamReadUnsignedVB(stream));
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16:
-                    streamByteAlign(stream);
+                op->fieldCount = j - i;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG8_4S16:
+                op->opcode = log->private->dataVersion < 2 ? FLIGHT_LOG_OP_TAG8_4S16_V1 : FLIGHT_LOG_OP_TAG8_4S16_V2;
+                op->fieldCount = 4;
+                truncate = false;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
+                op->opcode = FLIGHT_LOG_OP_TAG2_3S32;
+                op->fieldCount = 3;
+                truncate = false;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB:
+                op->opcode = FLIGHT_LOG_OP_TAG8_8SVB;
+
+                //How many fields are in this encoded group? Check the subsequent field encodings:
+                for (j = i + 1; j < i + 8 && j < frameDef->fieldCount; j++)
+                    if (frameDef->encoding[j] != FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB)
+                        break;
+
+                op->fieldCount = j - i;
+                truncate = false;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_U32:
+                op->opcode = FLIGHT_LOG_OP_ELIAS_DELTA_U32;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_S32:
+                op->opcode = FLIGHT_LOG_OP_ELIAS_DELTA_S32;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_U32:
+                op->opcode = FLIGHT_LOG_OP_ELIAS_GAMMA_U32;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_S32:
+                op->opcode = FLIGHT_LOG_OP_ELIAS_GAMMA_S32;
+            break;
+            case FLIGHT_LOG_FIELD_ENCODING_NULL:
+                op->opcode = FLIGHT_LOG_OP_NULL;
+            break;
+            default:
+                // Only an error if we actually come to decode one of these frames
+                op->opcode = FLIGHT_LOG_OP_UNSUPPORTED;
+                op->encoding = frameDef->encoding[i];
+        }
 
-                    if (log->private->dataVersion < 2)
-                        streamReadTag8_4S16_v1(stream, values);
-                    else
-                        streamReadTag8_4S16_v2(stream, values);
+        for (j = 0; j < op->fieldCount; j++, i++) {
+            compileFieldStep(log, frameDef, i, truncate, raw, &program->fields[i]);
+        }
+    }
 
-                    //Apply the predictors for the fields:
-                    for (j = 0; j < 4; j++, i++)
-                        frame[i] = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], values[j], frame, previous, previous2);
+    return program;
+}
 
-                    continue;
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_TAG2_3S32:
-                    streamByteAlign(stream);
+static void flightLogFreeFramePrograms(flightLog_t *log)
+{
+    for (int i = 0; i < 256; i++) {
+        if (log->private->frameProgram[i]) {
+            free(log->private->frameProgram[i]->ops);
+            free(log->private->frameProgram[i]->fields);
+            free(log->private->frameProgram[i]);
+            log->private->frameProgram[i] = NULL;
+        }
+    }
+}
 
-                    streamReadTag2_3S32(stream, values);
+/**
+ * Compile the decode programs for every frame type that the log's headers defined. The `raw` setting of the decode is
+ * built into them.
+ */
+static void flightLogCompileFramePrograms(flightLog_t *log, bool raw)
+{
+    flightLogFreeFramePrograms(log);
 
-                    //Apply the predictors for the fields:
-                    for (j = 0; j < 3; j++, i++)
-                        frame[i] = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], values[j], frame, previous, previous2);
+    for (int i = 0; i < 256; i++) {
+        if (log->frameDefs[i].fieldCount > 0) {
+            log->private->frameProgram[i] = compileFrameProgram(log, i, raw);
+        }
+    }
+}
 
-                    continue;
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB:
-                    streamByteAlign(stream);
+/**
+ * Point the frame buffers into the block of values at `frameBuffers`, which is laid out by flightLogAllocateFrameBuffers().
+ */
+static void flightLogPointFrameBuffers(flightLogPrivate_t *private, int gpsFrameStride)
+{
+    private->blackboxHistoryRing = private->frameBuffers;
+    private->gpsHomeHistory[0] = private->blackboxHistoryRing + 3 * private->mainFrameStride;
+    private->gpsHomeHistory[1] = private->gpsHomeHistory[0] + private->gpsHomeFrameStride;
+    private->lastGPS = private->gpsHomeHistory[1] + private->gpsHomeFrameStride;
+    private->lastSlow = private->lastGPS + gpsFrameStride;
+}
 
-                    //How many fields are in this encoded group? Check the subsequent field encodings:
-                    for (j = i + 1; j < i + 8 && j < frameDef->fieldCount; j++)
-                        if (encoding[j] != FLIGHT_LOG_FIELD_ENCODING_TAG8_8SVB)
-                            break;
+static void flightLogFreeFrameBlock(flightLogFrameBlock_t *block)
+{
+    free(block->values);
+    free(block->time);
+    free(block->frameType);
+    free(block->flags);
+    free(block->frameOffset);
+    free(block->frameSize);
+
+    memset(block, 0, sizeof(*block));
+}
 
-                    groupCount = j - i;
+/**
+ * Size the block that main frames are gathered into for the caller's onFrameBlock handler to hold frames of
+ * `fieldCount` fields.
+ */
+static void flightLogAllocateFrameBlock(flightLog_t *log, int fieldCount)
+{
+    flightLogPrivate_t *private = log->private;
+    flightLogFrameBlock_t *block = &private->frameBlock;
+    int length = private->frameBlockLength;
 
-                    streamReadTag8_8SVB(stream, values, groupCount);
+    flightLogFreeFrameBlock(block);
 
-                    for (j = 0; j < groupCount; j++, i++)
-                        frame[i] = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], values[j], frame, previous, previous2);
+    block->fieldCount = fieldCount;
+    block->fieldStride = length;
 
-                    continue;
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_U32:
-                    value = streamReadEliasDeltaU32(stream);
+    block->values = malloc((size_t) fieldCount * length * sizeof(*block->values));
+    block->time = malloc(length * sizeof(*block->time));
+    block->frameType = malloc(length * sizeof(*block->frameType));
+    block->flags = malloc(length * sizeof(*block->flags));
+    block->frameOffset = malloc(length * sizeof(*block->frameOffset));
+    block->frameSize = malloc(length * sizeof(*block->frameSize));
 
-                    /*
-                     * Reading this bitvalue may cause the stream's bit pointer to no longer lie on a byte boundary, so be sure to call
-                     * streamByteAlign() if you want to read a byte from the stream later.
-                     */
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_ELIAS_DELTA_S32:
-                    value = streamReadEliasDeltaS32(stream);
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_U32:
-                    value = streamReadEliasGammaU32(stream);
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_ELIAS_GAMMA_S32:
-                    value = streamReadEliasGammaS32(stream);
-                break;
-                case FLIGHT_LOG_FIELD_ENCODING_NULL:
-                    //Nothing to read
-                    value = 0;
-                break;
-                default:
-                    fprintf(stderr, "Unsupported field encoding %d\n", encoding[i]);
-                    exit(-1);
-            }
+    if (!block->values || !block->time || !block->frameType || !block->flags || !block->frameOffset || !block->frameSize) {
+        fprintf(stderr, "Failed to allocate memory for the decoder\n");
+        exit(-1);
+    }
+
+    private->frameBlockGapPending = false;
+}
+
+/**
+ * Size the parser's frame buffers to fit the frames that the log's headers defined (and clear them), so that decoding
+ * touches no more memory than the frames need.
+ */
+static void flightLogAllocateFrameBuffers(flightLog_t *log)
+{
+    flightLogPrivate_t *private = log->private;
+    int mainFieldCount = log->frameDefs['I'].fieldCount > log->frameDefs['P'].fieldCount ? log->frameDefs['I'].fieldCount : log->frameDefs['P'].fieldCount;
+    int gpsFrameStride = log->frameDefs['G'].fieldCount + FLIGHT_LOG_FIELD_SPILL;
+    int slowFrameStride = log->frameDefs['S'].fieldCount + FLIGHT_LOG_FIELD_SPILL;
+    int maxFieldCount = 0;
+
+    if (private->onFrameBlock) {
+        flightLogAllocateFrameBlock(log, mainFieldCount);
+    }
+
+    // The iteration and time fields are looked at even if the log doesn't define them
+    if (mainFieldCount <= FLIGHT_LOG_FIELD_INDEX_TIME) {
+        mainFieldCount = FLIGHT_LOG_FIELD_INDEX_TIME + 1;
+    }
+
+    private->mainFrameStride = mainFieldCount + FLIGHT_LOG_FIELD_SPILL;
+    private->gpsHomeFrameStride = log->frameDefs['H'].fieldCount + FLIGHT_LOG_FIELD_SPILL;
+    private->frameBuffersLength = 3 * private->mainFrameStride + 2 * private->gpsHomeFrameStride + gpsFrameStride + slowFrameStride;
+
+    for (int i = 0; i < 256; i++) {
+        if (log->frameDefs[i].fieldCount > maxFieldCount) {
+            maxFieldCount = log->frameDefs[i].fieldCount;
+        }
+    }
+
+    // Leave room for every field to take the longest variable-byte encoding
+    private->maxFrameLength = maxFieldCount * FLIGHT_LOG_MAX_VB_LENGTH > FLIGHT_LOG_MAX_FRAME_LENGTH
+        ? maxFieldCount * FLIGHT_LOG_MAX_VB_LENGTH : FLIGHT_LOG_MAX_FRAME_LENGTH;
+
+    free(private->frameBuffers);
+    free(log->stats.field);
+
+    private->frameBuffers = calloc(private->frameBuffersLength, sizeof(*private->frameBuffers));
+    log->stats.field = calloc(mainFieldCount, sizeof(*log->stats.field));
+
+    if (!private->frameBuffers || !log->stats.field) {
+        fprintf(stderr, "Failed to allocate memory for the decoder\n");
+        exit(-1);
+    }
 
-            value = applyPrediction(log, i, raw ? FLIGHT_LOG_FIELD_PREDICTOR_0 : predictor[i], value, frame, previous, previous2);
+    flightLogPointFrameBuffers(private, gpsFrameStride);
 
-            if (fieldWidth[i] != 8) {
-                // Assume 32-bit...
-                if (fieldSigned[i]) {
-                    value = (int32_t) value; // Sign extend the lower 32-bits
-                } else {
-                    value = (uint32_t) value;
+    private->mainHistory[0] = private->blackboxHistoryRing;
+    private->mainHistory[1] = NULL;
+    private->mainHistory[2] = NULL;
+}
+
+/**
+ * Apply the compiled prediction for a field to its decoded value.
+ */
+static int64_t applyFieldStep(flightLog_t *log, const flightLogFieldStep_t *step, int fieldIndex, int64_t value, int64_t *current, int64_t *previous, int64_t *previous2)
+{
+    switch (step->prediction) {
+        case FLIGHT_LOG_PREDICT_CONSTANT:
+            value += step->constant;
+        break;
+        case FLIGHT_LOG_PREDICT_CURRENT:
+            value += current[step->source];
+        break;
+        case FLIGHT_LOG_PREDICT_PREVIOUS:
+            if (previous)
+                value += previous[fieldIndex];
+        break;
+        case FLIGHT_LOG_PREDICT_STRAIGHT_LINE:
+            if (previous)
+                value += 2 * previous[fieldIndex] - previous2[fieldIndex];
+        break;
+        case FLIGHT_LOG_PREDICT_AVERAGE_2:
+            if (previous)
+                value += (previous[fieldIndex] + previous2[fieldIndex]) / 2;
+        break;
+        case FLIGHT_LOG_PREDICT_HOME_COORD:
+            value += log->private->gpsHomeHistory[1][step->source];
+        break;
+        case FLIGHT_LOG_PREDICT_LAST_MAIN_FRAME_TIME:
+            if (log->private->mainHistory[1])
+                value += log->private->mainHistory[1][FLIGHT_LOG_FIELD_INDEX_TIME];
+        break;
+        default:
+            value = applyPrediction(log, fieldIndex, step->predictor, value, current, previous, previous2);
+    }
+
+    switch (step->truncation) {
+        case FLIGHT_LOG_TRUNCATE_SIGNED_32:
+            value = (int32_t) value; // Sign extend the lower 32-bits
+        break;
+        case FLIGHT_LOG_TRUNCATE_UNSIGNED_32:
+            value = (uint32_t) value;
+        break;
+    }
+
+    return value;
+}
+
+/**
+ * Attempt to parse the frame of the given `frameType` into the supplied `frame` buffer by running the decode program
+ * that was compiled from log->frameDefs[`frameType`].
+ *
+ * skippedFrames - Set to the number of field iterations that were skipped over by rate settings since the last frame.
+ */
+static void parseFrame(flightLog_t *log, mmapStream_t *stream, uint8_t frameType, int64_t *frame, int64_t *previous, int64_t *previous2, int skippedFrames)
+{
+    const flightLogFrameProgram_t *program = log->private->frameProgram[frameType];
+    uint32_t encoded[FLIGHT_LOG_MAX_VB_RUN];
+    int64_t values[8];
+
+    if (!program) {
+        // No fields
+        streamByteAlign(stream);
+        return;
+    }
+
+    for (const flightLogOp_t *op = program->ops; op < program->ops + program->opCount; op++) {
+        int i = op->fieldIndex;
+
+        switch (op->opcode) {
+            case FLIGHT_LOG_OP_INCREMENT:
+                frame[i] = skippedFrames + 1;
+
+                if (previous)
+                    frame[i] += previous[i];
+
+                continue;
+            case FLIGHT_LOG_OP_VB:
+                streamByteAlign(stream);
+                streamReadUnsignedVBs(stream, encoded, op->fieldCount);
+
+                for (int j = 0; j < op->fieldCount; j++) {
+                    switch (program->fields[i + j].encoding) {
+                        case FLIGHT_LOG_FIELD_ENCODING_SIGNED_VB:
+                            values[0] = zigzagDecode(encoded[j]);
+                        break;
+                        case FLIGHT_LOG_FIELD_ENCODING_NEG_14BIT:
+                            values[0] = -signExtend14Bit(encoded[j]);
+                        break;
+                        default:
+                            values[0] = encoded[j];
+                    }
+
+                    frame[i + j] = applyFieldStep(log, &program->fields[i + j], i + j, values[0], frame, previous, previous2);
                 }
-            }
 
-            frame[i] = value;
+                continue;
+            case FLIGHT_LOG_OP_TAG8_4S16_V1:
+                streamByteAlign(stream);
+                streamReadTag8_4S16_v1(stream, values);
+            break;
+            case FLIGHT_LOG_OP_TAG8_4S16_V2:
+                streamByteAlign(stream);
+                streamReadTag8_4S16_v2(stream, values);
+            break;
+            case FLIGHT_LOG_OP_TAG2_3S32:
+                streamByteAlign(stream);
+                streamReadTag2_3S32(stream, values);
+            break;
+            case FLIGHT_LOG_OP_TAG8_8SVB:
+                streamByteAlign(stream);
+                streamReadTag8_8SVB(stream, values, op->fieldCount);
+            break;
+            case FLIGHT_LOG_OP_ELIAS_DELTA_U32:
+                values[0] = streamReadEliasDeltaU32(stream);
 
-            i++;
+                /*
+                 * Reading this bitvalue may cause the stream's bit pointer to no longer lie on a byte boundary, so be sure to call
+                 * streamByteAlign() if you want to read a byte from the stream later.
+                 */
+            break;
+            case FLIGHT_LOG_OP_ELIAS_DELTA_S32:
+                values[0] = streamReadEliasDeltaS32(stream);
+            break;
+            case FLIGHT_LOG_OP_ELIAS_GAMMA_U32:
+                values[0] = streamReadEliasGammaU32(stream);
+            break;
+            case FLIGHT_LOG_OP_ELIAS_GAMMA_S32:
+                values[0] = streamReadEliasGammaS32(stream);
+            break;
+            case FLIGHT_LOG_OP_NULL:
+                //Nothing to read
+                values[0] = 0;
+            break;
+            default:
+                fprintf(stderr, "Unsupported field encoding %d\n", op->encoding);
+                exit(-1);
+        }
+
+        for (int j = 0; j < op->fieldCount; j++) {
+            frame[i + j] = applyFieldStep(log, &program->fields[i + j], i + j, values[j], frame, previous, previous2);
         }
     }
 
@@ -704,7 +1236,9 @@ static void parseIntraframe(flightLog_t *log, mmapStream_t *stream, bool raw)
     int64_t *current = private->mainHistory[0];
     int64_t *previous = private->mainHistory[1];
 
-    parseFrame(log, stream, 'I', current, previous, NULL, 0, raw);
+    (void) raw;
+
+    parseFrame(log, stream, 'I', current, previous, NULL, 0);
 }
 
 /**
@@ -718,24 +1252,32 @@ static void parseInterframe(flightLog_t *log, mmapStream_t *stream, bool raw)
     int64_t *previous = log->private->mainHistory[1];
     int64_t *previous2 = log->private->mainHistory[2];
 
+    (void) raw;
+
     private->lastSkippedFrames = countIntentionallySkippedFrames(log);
 
-    parseFrame(log, stream, 'P', current, previous, previous2, log->private->lastSkippedFrames, raw);
+    parseFrame(log, stream, 'P', current, previous, previous2, log->private->lastSkippedFrames);
 }
 
 static void parseGPSFrame(flightLog_t *log, mmapStream_t *stream, bool raw)
 {
-    parseFrame(log, stream, 'G', log->private->lastGPS, NULL, NULL, 0, raw);
+    (void) raw;
+
+    parseFrame(log, stream, 'G', log->private->lastGPS, NULL, NULL, 0);
 }
 
 static void parseGPSHomeFrame(flightLog_t *log, mmapStream_t *stream, bool raw)
 {
-    parseFrame(log, stream, 'H', log->private->gpsHomeHistory[0], NULL, NULL, 0, raw);
+    (void) raw;
+
+    parseFrame(log, stream, 'H', log->private->gpsHomeHistory[0], NULL, NULL, 0);
 }
 
 static void parseSlowFrame(flightLog_t *log, mmapStream_t *stream, bool raw)
 {
-    parseFrame(log, stream, 'S', log->private->lastSlow, NULL, NULL, 0, raw);
+    (void) raw;
+
+    parseFrame(log, stream, 'S', log->private->lastSlow, NULL, NULL, 0);
 }
 
 /**
@@ -931,11 +1473,153 @@ void flightlogFailsafePhaseToString(uint8_t failsafePhase, char *dest, int destL
     flightlogDecodeEnumToString(failsafePhase, FLIGHT_LOG_FAILSAFE_PHASE_COUNT, FLIGHT_LOG_FAILSAFE_PHASE_NAME, dest, destLen);
 }
 
-flightLog_t * flightLogCreate(int fd)
+/**
+ * Add the places where logs begin between the offsets `from` and `to` to the chunk's list. `data` holds the bytes of the
+ * file from `dataOffset` up to `dataEnd`.
+ */
+static void flightLogFindLogsInRange(logSearchChunk_t *chunk, const char *data, int64_t dataOffset, int64_t dataEnd, int64_t from, int64_t to)
+{
+    size_t markerLength = strlen(LOG_START_MARKER);
+    const char *pos = data + (from - dataOffset);
+    const char *end = data + (to - dataOffset);
+
+    // A marker that begins in our range can end after it
+    const char *searchEnd = (size_t) (dataEnd - to) > markerLength - 1 ? end + markerLength - 1 : data + (dataEnd - dataOffset);
+
+    while (pos < end) {
+        const char *marker = memmem(pos, searchEnd - pos, LOG_START_MARKER, markerLength);
+
+        if (!marker)
+            break;
+
+        if (chunk->count == chunk->capacity) {
+            chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+            chunk->found = realloc(chunk->found, chunk->capacity * sizeof(*chunk->found));
+
+            if (!chunk->found) {
+                fprintf(stderr, "Failed to allocate memory for the list of logs\n");
+                exit(-1);
+            }
+        }
+
+        chunk->found[chunk->count++] = dataOffset + (marker - data);
+
+        //Search for the next log after this header ends
+        pos = marker + markerLength;
+    }
+}
+
+/**
+ * Add the places where logs begin in the chunk's range to its list. Called on a worker thread when a file is searched
+ * in several chunks at once.
+ */
+static void flightLogFindLogsInChunk(void *workerData, void *job)
+{
+    logSearchChunk_t *chunk = (logSearchChunk_t *) job;
+    size_t markerLength = strlen(LOG_START_MARKER);
+
+    (void) workerData;
+
+    if (chunk->data) {
+        flightLogFindLogsInRange(chunk, chunk->data, 0, chunk->limit, chunk->begin, chunk->end);
+        return;
+    }
+
+    // Each window overlaps the next by enough to hold the beginning of a marker which the next one completes
+    for (int64_t from = chunk->begin; from < chunk->end; ) {
+        int64_t offset = from - from % MMAP_RANGE_ALIGNMENT;
+        size_t length = chunk->limit - offset < STREAM_MAPPED_WINDOW_SIZE ? (size_t) (chunk->limit - offset) : STREAM_MAPPED_WINDOW_SIZE;
+        int64_t to = offset + (int64_t) length == chunk->limit ? chunk->end : offset + (int64_t) (length - (markerLength - 1));
+        fileMapping_t mapping;
+
+        if (to > chunk->end) {
+            to = chunk->end;
+        }
+
+        if (!mmap_file_range(&mapping, chunk->fd, offset, length)) {
+            fprintf(stderr, "Error: Failed to map the log into memory at offset %" PRId64 "\n", offset);
+            break;
+        }
+
+        flightLogFindLogsInRange(chunk, mapping.data, offset, offset + length, from, to);
+
+        munmap_file(&mapping);
+
+        from = to;
+    }
+}
+
+/**
+ * Find where each log in the stream's file begins, filling in the log's logBegin and logCount. Big files are searched
+ * in chunks by up to `threads` threads at once, and files that are mapped a window at a time are searched a window at a
+ * time.
+ */
+static void flightLogFindLogs(flightLog_t *log, mmapStream_t *stream, int64_t size, int threads)
 {
-    const char *logSearchStart;
-    int logIndex;
+    int chunkCount = threads;
+    logSearchChunk_t *chunks;
+
+    if (chunkCount > size / FLIGHT_LOG_SEARCH_MIN_CHUNK_SIZE) {
+        chunkCount = (int) (size / FLIGHT_LOG_SEARCH_MIN_CHUNK_SIZE);
+    }
+
+    if (chunkCount < 1) {
+        chunkCount = 1;
+    }
+
+    chunks = calloc(chunkCount, sizeof(*chunks));
+
+    for (int i = 0; i < chunkCount; i++) {
+        chunks[i].begin = size * i / chunkCount;
+        chunks[i].end = size * (i + 1) / chunkCount;
+        chunks[i].limit = size;
+        chunks[i].data = stream->windowed ? NULL : stream->data;
+        chunks[i].fd = stream->mapping.fd;
+    }
+
+    if (chunkCount == 1) {
+        flightLogFindLogsInChunk(NULL, &chunks[0]);
+    } else {
+        workerPool_t *pool = workerpool_create(chunkCount, flightLogFindLogsInChunk, NULL);
+
+        for (int i = 0; i < chunkCount; i++) {
+            workerpool_submit(pool, &chunks[i]);
+        }
+
+        workerpool_destroy(pool);
+    }
+
+    log->logCount = 0;
+
+    for (int i = 0; i < chunkCount; i++) {
+        log->logCount += chunks[i].count;
+    }
+
+    /*
+     * Stick the end of the file as the beginning of the "one past end" log, so we can easily compute each log size.
+     */
+    log->logBegin = malloc((log->logCount + 1) * sizeof(*log->logBegin));
+    log->logCount = 0;
+
+    for (int i = 0; i < chunkCount; i++) {
+        memcpy(log->logBegin + log->logCount, chunks[i].found, chunks[i].count * sizeof(*chunks[i].found));
+        log->logCount += chunks[i].count;
+
+        free(chunks[i].found);
+    }
+
+    log->logBegin[log->logCount] = size;
+
+    free(chunks);
+}
 
+/**
+ * Create a log which decodes the given stream (which it takes ownership of, and whose bytes are read from a source)
+ * from start to finish. Since we can't look ahead to find where each log in the input begins, the log begins with just
+ * one log, and each log after it is found with flightLogBeginNextLog() once the one before it has been parsed.
+ */
+static flightLog_t* flightLogCreateFromStream(mmapStream_t *stream)
+{
     flightLog_t *log;
     flightLogPrivate_t *private;
 
@@ -945,59 +1629,177 @@ flightLog_t * flightLogCreate(int fd)
     memset(log, 0, sizeof(*log));
     memset(private, 0, sizeof(*private));
 
-    private->stream = streamCreate(fd);
+    private->stream = stream;
+    private->indexingLog = -1;
+
+    // We won't know where the log ends until we've read it
+    log->logCount = 1;
+    log->logBegin = malloc(2 * sizeof(*log->logBegin));
+    log->logBegin[0] = 0;
+    log->logBegin[1] = 0;
 
-    if (!private->stream) {
-        free(log);
-        free(private);
+    log->messages = stderr;
+    log->private = private;
+
+    return log;
+}
 
+/**
+ * Create a log which decodes the bytes supplied by `source` as they arrive (which it takes ownership of).
+ */
+flightLog_t* flightLogCreateFromSource(streamSource_t *source)
+{
+    if (!source) {
         return 0;
     }
 
-    if (private->stream->size == 0 && (private->stream->mapping.stats.st_mode & S_IFREG) ==  S_IFREG) {
-        fprintf(stderr, "Error: This log is zero-bytes long!\n");
+    return flightLogCreateFromStream(streamCreateFromSource(source));
+}
+
+flightLog_t * flightLogCreate(int fd)
+{
+    return flightLogCreateWithThreads(fd, 1);
+}
+
+/**
+ * Like flightLogCreate(), but compressed logs which can be decompressed in parallel (zstd files made of several frames)
+ * are decompressed by `threads` threads.
+ */
+flightLog_t * flightLogCreateWithThreads(int fd, int threads)
+{
+    struct stat stats;
 
-        streamDestroy(private->stream);
+    flightLog_t *log;
+    flightLogPrivate_t *private;
 
-        free(log);
-        free(private);
+    mmapStream_t *stream;
+    bool windowed;
 
+    if (fd < 0 || fstat(fd, &stats) != 0) {
         return 0;
     }
 
-    if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFREG) {
-    //First check how many logs are in this one file (each time the FC is rearmed, a new log is appended)
-    logSearchStart = private->stream->data;
+    // Serial ports, pipes and sockets can't be mapped into memory, so read from them as their bytes arrive instead
+    if ((stats.st_mode & S_IFMT) != S_IFREG) {
+        if ((stats.st_mode & S_IFMT) == S_IFCHR) {
+            serialInput_t *input = serialInputCreate(fd, 0, NULL);
 
-    for (logIndex = 0; logIndex < FLIGHT_LOG_MAX_LOGS_IN_FILE && logSearchStart < private->stream->data + private->stream->size; logIndex++) {
-        log->logBegin[logIndex] = memmem(logSearchStart, (private->stream->data + private->stream->size) - logSearchStart, LOG_START_MARKER, strlen(LOG_START_MARKER));
+            return input ? flightLogCreateFromSource(serialInputSource(input)) : 0;
+        }
 
-        if (!log->logBegin[logIndex])
-            break; //No more logs found in the file
+        // Decompresses the input if it turns out to be compressed, otherwise passes it straight through
+        return flightLogCreateFromSource(decompressSourceCreate(streamSourceCreateFromFile(fd), threads));
+    }
 
-        //Search for the next log after this header ends
-        logSearchStart = log->logBegin[logIndex] + strlen(LOG_START_MARKER);
+    if (stats.st_size == 0) {
+        fprintf(stderr, "Error: This log is zero-bytes long!\n");
+
+        return 0;
     }
 
-    log->logCount = logIndex;
+    // Very large files are mapped a window at a time, so they don't fill the memory (or address space) as we read them
+    windowed = (uint64_t) stats.st_size > STREAM_MAX_WHOLE_MAPPING_SIZE || (uint64_t) stats.st_size > (uint64_t) SIZE_MAX / 2;
 
-    /*
-     * Stick the end of the file as the beginning of the "one past end" log, so we can easily compute each log size.
-     *
-     * We have room for this because the logBegin array has an extra element on the end for it.
-     */
-    log->logBegin[log->logCount] = private->stream->data + private->stream->size;
-    } else {
-    log->logCount = 1; //one stream 1 log.
-    log->logBegin[0] = private->stream->data;
-    log->logBegin[1] = private->stream->end;
+    stream = windowed ? streamCreateWindowed(fd) : streamCreate(fd);
+
+    if (!stream) {
+        return 0;
+    }
+
+    // Compressed logs have to be decompressed as we go, just like logs arriving through a pipe
+    if (compressionDetectFormat(stream->data, stream->end - stream->data) != COMPRESSION_NONE) {
+        streamDestroy(stream);
+
+        if (lseek(fd, 0, SEEK_SET) != 0) {
+            fprintf(stderr, "Error: Failed to rewind the compressed log\n");
+            return 0;
+        }
+
+        return flightLogCreateFromSource(decompressSourceCreate(streamSourceCreateFromFile(fd), threads));
     }
 
+    log = (flightLog_t *) malloc(sizeof(*log));
+    private = (flightLogPrivate_t *) malloc(sizeof(*private));
+
+    memset(log, 0, sizeof(*log));
+    memset(private, 0, sizeof(*private));
+
+    private->stream = stream;
+
+    //First check how many logs are in this one file (each time the FC is rearmed, a new log is appended)
+    flightLogFindLogs(log, private->stream, stats.st_size, threads);
+
+    private->indexingLog = -1;
+
+    log->messages = stderr;
     log->private = private;
 
     return log;
 }
 
+static bool streamIsAtLogStart(mmapStream_t *stream)
+{
+    size_t markerLength = strlen(LOG_START_MARKER);
+
+    return (size_t) (stream->end - stream->pos) >= markerLength && memcmp(stream->pos, LOG_START_MARKER, markerLength) == 0;
+}
+
+/**
+ * For a log that's read from a source: after a log has been parsed, look for the beginning of another log in the rest of
+ * the input. If one is found it becomes the log with index logCount, which can then be parsed.
+ *
+ * Returns false if the input ended without another log beginning.
+ */
+bool flightLogBeginNextLog(flightLog_t *log)
+{
+    mmapStream_t *stream = log->private->stream;
+    size_t markerLength = strlen(LOG_START_MARKER);
+
+    // (A file has all of its logs found when it's opened)
+    if (!stream->source) {
+        return false;
+    }
+
+    // The end of the last log (if it had an end of log event) might have cut the stream short
+    stream->end = stream->windowEnd;
+
+    while (1) {
+        const char *marker;
+
+        streamFillWindow(stream);
+
+        marker = memmem(stream->pos, stream->end - stream->pos, LOG_START_MARKER, markerLength);
+
+        if (marker) {
+            stream->pos = marker;
+            break;
+        }
+
+        if (stream->sourceEnded) {
+            stream->pos = stream->end;
+            return false;
+        }
+
+        // Keep the end of what we searched, since it could be the start of a marker that the next read completes
+        if ((size_t) (stream->end - stream->pos) >= markerLength) {
+            stream->pos = stream->end - (markerLength - 1);
+        }
+    }
+
+    log->logBegin = realloc(log->logBegin, (log->logCount + 2) * sizeof(*log->logBegin));
+
+    if (!log->logBegin) {
+        fprintf(stderr, "Failed to allocate memory for the list of logs\n");
+        exit(-1);
+    }
+
+    log->logBegin[log->logCount] = streamOffset(stream, stream->pos);
+    log->logCount++;
+    log->logBegin[log->logCount] = log->logBegin[log->logCount - 1];
+
+    return true;
+}
+
 static const flightLogFrameType_t* getFrameType(uint8_t c)
 {
     for (int i = 0; i < (int) ARRAY_LENGTH(frameTypes); i++)
@@ -1007,6 +1809,21 @@ static const flightLogFrameType_t* getFrameType(uint8_t c)
     return 0;
 }
 
+/**
+ * Check that a main frame with the given iteration and time could plausibly follow the last main frame we accepted.
+ */
+static bool flightLogIsPlausibleNextMainFrame(flightLog_t *log, uint32_t iteration, int64_t time)
+{
+    flightLogPrivate_t *private = log->private;
+
+    // Check that iteration count and time didn't move backwards, and didn't move forward too much.
+    return
+        iteration >= private->lastMainFrameIteration
+        && iteration < private->lastMainFrameIteration + MAXIMUM_ITERATION_JUMP_BETWEEN_FRAMES
+        && time >= private->lastMainFrameTime
+        && time < private->lastMainFrameTime + MAXIMUM_TIME_JUMP_BETWEEN_FRAMES;
+}
+
 /**
  * Check that the values in the currently-decoded main frame (mainHistory[0]) don't look corrupted.
  *
@@ -1015,12 +1832,8 @@ static bool flightLogValidateMainFrameValues(flightLog_t *log)
 {
     flightLogPrivate_t *private = log->private;
 
-    // Check that iteration count and time didn't move backwards, and didn't move forward too much.
-    return
-        (uint32_t) private->mainHistory[0][FLIGHT_LOG_FIELD_INDEX_ITERATION] >= private->lastMainFrameIteration
-        && (uint32_t) private->mainHistory[0][FLIGHT_LOG_FIELD_INDEX_ITERATION] < private->lastMainFrameIteration + MAXIMUM_ITERATION_JUMP_BETWEEN_FRAMES
-        && private->mainHistory[0][FLIGHT_LOG_FIELD_INDEX_TIME] >= private->lastMainFrameTime
-        && private->mainHistory[0][FLIGHT_LOG_FIELD_INDEX_TIME] < private->lastMainFrameTime + MAXIMUM_TIME_JUMP_BETWEEN_FRAMES;
+    return flightLogIsPlausibleNextMainFrame(log, (uint32_t) private->mainHistory[0][FLIGHT_LOG_FIELD_INDEX_ITERATION],
+        private->mainHistory[0][FLIGHT_LOG_FIELD_INDEX_TIME]);
 }
 
 static void flightLogInvalidateStream(flightLog_t *log)
@@ -1090,7 +1903,7 @@ static bool completeIntraframe(flightLog_t *log, mmapStream_t *stream, uint8_t f
     }
 
     if (private->onFrameReady) {
-        private->onFrameReady(log, private->mainStreamIsValid, private->mainHistory[0], frameType, log->frameDefs[(int) frameType].fieldCount, frameStart - stream->data, frameEnd - frameStart);
+        private->onFrameReady(log, private->mainStreamIsValid, private->mainHistory[0], frameType, log->frameDefs[(int) frameType].fieldCount, streamOffset(stream, frameStart), frameEnd - frameStart);
     }
 
     if (private->mainStreamIsValid) {
@@ -1101,9 +1914,9 @@ static bool completeIntraframe(flightLog_t *log, mmapStream_t *stream, uint8_t f
         private->mainHistory[2] = private->mainHistory[0];
 
         // And advance the current frame into an empty space ready to be filled
-        private->mainHistory[0] += FLIGHT_LOG_MAX_FIELDS;
-        if (private->mainHistory[0] >= &private->blackboxHistoryRing[3][0]) {
-            private->mainHistory[0] = &private->blackboxHistoryRing[0][0];
+        private->mainHistory[0] += private->mainFrameStride;
+        if (private->mainHistory[0] >= private->blackboxHistoryRing + 3 * private->mainFrameStride) {
+            private->mainHistory[0] = private->blackboxHistoryRing;
         }
     }
 
@@ -1135,7 +1948,7 @@ static bool completeInterframe(flightLog_t *log, mmapStream_t *stream, uint8_t f
     //Receiving a P frame can't resynchronise the stream so it doesn't set mainStreamIsValid to true
 
     if (private->onFrameReady) {
-        private->onFrameReady(log, private->mainStreamIsValid, private->mainHistory[0], frameType, log->frameDefs['I'].fieldCount, frameStart - stream->data, frameEnd - frameStart);
+        private->onFrameReady(log, private->mainStreamIsValid, private->mainHistory[0], frameType, log->frameDefs['I'].fieldCount, streamOffset(stream, frameStart), frameEnd - frameStart);
     }
 
     if (private->mainStreamIsValid) {
@@ -1144,9 +1957,9 @@ static bool completeInterframe(flightLog_t *log, mmapStream_t *stream, uint8_t f
         private->mainHistory[1] = private->mainHistory[0];
 
         // And advance the current frame into an empty space ready to be filled
-        private->mainHistory[0] += FLIGHT_LOG_MAX_FIELDS;
-        if (private->mainHistory[0] >= &private->blackboxHistoryRing[3][0])
-            private->mainHistory[0] = &private->blackboxHistoryRing[0][0];
+        private->mainHistory[0] += private->mainFrameStride;
+        if (private->mainHistory[0] >= private->blackboxHistoryRing + 3 * private->mainFrameStride)
+            private->mainHistory[0] = private->blackboxHistoryRing;
     }
 
     return private->mainStreamIsValid;
@@ -1195,11 +2008,11 @@ static bool completeGPSHomeFrame(flightLog_t *log, mmapStream_t *stream, uint8_t
     (void) raw;
 
     //Copy the decoded frame into the "last state" entry of gpsHomeHistory to publish it:
-    memcpy(&log->private->gpsHomeHistory[1], &log->private->gpsHomeHistory[0], sizeof(*log->private->gpsHomeHistory));
+    memcpy(log->private->gpsHomeHistory[1], log->private->gpsHomeHistory[0], log->private->gpsHomeFrameStride * sizeof(*log->private->gpsHomeHistory[0]));
     log->private->gpsHomeIsValid = true;
 
     if (log->private->onFrameReady) {
-        log->private->onFrameReady(log, true, log->private->gpsHomeHistory[1], frameType, log->frameDefs[frameType].fieldCount, frameStart - stream->data, frameEnd - frameStart);
+        log->private->onFrameReady(log, true, log->private->gpsHomeHistory[1], frameType, log->frameDefs[frameType].fieldCount, streamOffset(stream, frameStart), frameEnd - frameStart);
     }
 
     return true;
@@ -1215,7 +2028,7 @@ static bool completeGPSFrame(flightLog_t *log, mmapStream_t *stream, uint8_t fra
 	flightLogApplyGPSFrameTimeRollover(log);
 
     if (log->private->onFrameReady) {
-        log->private->onFrameReady(log, log->private->gpsHomeIsValid, log->private->lastGPS, frameType, log->frameDefs[frameType].fieldCount, frameStart - stream->data, frameEnd - frameStart);
+        log->private->onFrameReady(log, log->private->gpsHomeIsValid, log->private->lastGPS, frameType, log->frameDefs[frameType].fieldCount, streamOffset(stream, frameStart), frameEnd - frameStart);
     }
 
     return true;
@@ -1229,7 +2042,7 @@ static bool completeSlowFrame(flightLog_t *log, mmapStream_t *stream, uint8_t fr
     (void) raw;
 
     if (log->private->onFrameReady) {
-        log->private->onFrameReady(log, true, log->private->lastSlow, frameType, log->frameDefs[frameType].fieldCount, frameStart - stream->data, frameEnd - frameStart);
+        log->private->onFrameReady(log, true, log->private->lastSlow, frameType, log->frameDefs[frameType].fieldCount, streamOffset(stream, frameStart), frameEnd - frameStart);
     }
 
     return true;
@@ -1261,195 +2074,1890 @@ static void resetSysConfigToDefaults(flightLogSysConfig_t *config)
     config->firmwareType = FIRMWARE_TYPE_UNKNOWN;
 }
 
-bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw) {
-    ParserState parserState = PARSER_STATE_HEADER;
-    const flightLogFrameType_t *frameType = 0;
+static void flightLogResynchronise(flightLog_t *log, const char *lostAt, bool raw);
 
+/**
+ * Parse the data frame which begins with the marker `command` at the current stream position, pass it to its frame
+ * type's completion routine and update the statistics.
+ */
+static void flightLogParseDataFrame(flightLog_t *log, char command, bool raw)
+{
     flightLogPrivate_t *private = log->private;
+    const flightLogFrameType_t *frameType = getFrameType((uint8_t) command);
 
-    if (logIndex < 0 || logIndex >= log->logCount)
-        return false;
+    // A frame should begin here, so if this byte can't begin one then we've lost track of where the frames are
+    if (!frameType) {
+        flightLogResynchronise(log, private->stream->pos, raw);
+        return;
+    }
 
-    //Reset any parsed information from previous parses
-    memset(&log->stats, 0, sizeof(log->stats));
+    streamReadByte(private->stream);//Skip over initial frame letter
+    size_t frameSize = 0;
 
-    for (int frameC = 0; frameC < 256; frameC++) {
-        free(log->frameDefs[frameC].namesLine);
+    const char *frameStart = private->stream->pos;
+    frameType->parse(log, private->stream, raw);
+    frameSize = private->stream->pos - frameStart;
+
+    //We shouldn't read an EOF during reading a frame (that'd imply the frame was truncated)
+    bool prematureEof = false;
+    if (private->stream->eof) {
+        prematureEof = true;
     }
 
-    memset(log->frameDefs, 0, sizeof(log->frameDefs));
+    if (frameType) {
+        // Is this the beginning of a new frame?
+        frameType = command == EOF ? 0 : getFrameType((uint8_t) command);
+        bool looksLikeFrameCompleted = frameType || (!prematureEof && command == EOF);
 
-    // Apply default field widths (for older logging code that might omit the field width header)
-    for (int i = 0; i < 256; i++) {
-        for (int j = 0; j < FLIGHT_LOG_MAX_FIELDS; j++) {
-            log->frameDefs[i].fieldWidth[j] = 4;
+        // If we see what looks like the beginning of a new frame, assume that the previous frame was valid:
+        if (frameSize <= (size_t) private->maxFrameLength && looksLikeFrameCompleted) {
+            bool frameAccepted = true;
+
+            if (frameType->complete) {
+                frameAccepted = frameType->complete(log, log->private->stream, frameType->marker, private->stream->pos - frameSize, private->stream->pos, raw);
+            }
+
+            if (frameAccepted) {
+                //Update statistics for this frame type
+                log->stats.frame[frameType->marker].bytes += frameSize;
+                log->stats.frame[frameType->marker].sizeCount[frameSize < FLIGHT_LOG_MAX_FRAME_LENGTH ? frameSize : FLIGHT_LOG_MAX_FRAME_LENGTH]++;
+                log->stats.frame[frameType->marker].validCount++;
+            } else {
+                log->stats.frame[frameType->marker].desyncCount++;
+            }
+        } else {
+            //The previous frame was corrupt
+
+            //We need to resynchronise before we can deliver another main frame:
+            private->mainStreamIsValid = false;
+            log->stats.frame[frameType->marker].corruptCount++;
+            log->stats.totalCorruptFrames++;
+
+            //Let the caller know there was a corrupt frame (don't give them a pointer to the frame data because it is totally worthless)
+            if (private->onFrameReady) {
+                private->onFrameReady(log, false, 0, frameType->marker, 0, streamOffset(private->stream, private->stream->pos - frameSize), frameSize);
+            }
+
+            /*
+            * Start the search for a frame beginning after the first byte of the previous corrupt frame.
+            * This way we can find the start of the next frame after the corrupt frame if the corrupt frame
+            * was truncated.
+            */
+            flightLogResynchronise(log, frameStart - 1, raw);
         }
     }
+}
 
-    private->gpsHomeIsValid = false;
-    flightLogInvalidateStream(log);
+/**
+ * Parse data frames until the next frame would begin at or after `limit`, or until the log ends.
+ *
+ * Returns true if the log ended.
+ */
+static bool flightLogParseDataFrames(flightLog_t *log, const char *limit, bool raw)
+{
+    mmapStream_t *stream = log->private->stream;
 
-    private->mainHistory[0] = private->blackboxHistoryRing[0];
-    private->mainHistory[1] = NULL;
-    private->mainHistory[2] = NULL;
+    while (stream->pos < limit) {
+        char command = streamPeekChar(stream);
 
-    resetSysConfigToDefaults(&log->sysConfig);
+        // (A 0xFF byte reads as EOF too, but that's just a byte that can't begin a frame)
+        if (command == EOF && stream->pos >= stream->end) {
+            return true;
+        }
 
-    log->frameIntervalI = 32;
-    log->frameIntervalPNum = 1;
-    log->frameIntervalPDenom = 1;
+        flightLogParseDataFrame(log, command, raw);
+    }
 
-    private->lastEvent.event = -1;
+    return streamPeekChar(stream) == EOF && stream->pos >= stream->end;
+}
 
-    clearFieldIdents(log);
+/*
+ * Parallel decoding
+ *
+ * I-frames don't depend on the main frames that came before them, so they're natural points to split a log into
+ * segments which worker threads can decode independently, each with its own history ring and time rollover
+ * accumulator. The workers record the frames and events that they would have delivered, and the calling thread
+ * replays those to the callbacks in log order.
+ *
+ * Before a segment is replayed, we check that the serial parser would have arrived at the same position and accepted
+ * the I-frame that begins it. From there on the serial parser's state only differs from the worker's by a whole number
+ * of timestamp rollovers and by the GPS home position, which we fix up during the replay. If the check fails (e.g.
+ * because the segment began inside a corrupt region) the calling thread decodes that segment itself instead, so the
+ * result is always identical to a serial decode.
+ */
 
-    private->timeRolloverAccumulator = 0;
-    private->lastSkippedFrames = 0;
-    private->lastMainFrameIteration = (uint32_t) -1;
-    private->lastMainFrameTime = -1;
+// Roughly how much of the log each worker decodes at a time
+#define FLIGHT_LOG_PARALLEL_SEGMENT_LENGTH (128 * 1024)
 
-    private->onMetadataReady = onMetadataReady;
-    private->onFrameReady = onFrameReady;
-    private->onEvent = onEvent;
+typedef enum {
+    FLIGHT_LOG_RECORD_FRAME = 0,
+    FLIGHT_LOG_RECORD_EVENT
+} flightLogRecordType_e;
 
-    //Set parsing ranges up for the log the caller selected
-    private->stream->start = log->logBegin[logIndex];
-    private->stream->pos = private->stream->start;
-    private->stream->end = log->logBegin[logIndex + 1];
-    private->stream->eof = false;
+/**
+ * A callback that a worker recorded. Records are packed one after the other into the segment's records buffer, each
+ * followed by its frame values (when haveFrame is set) or its flightLogEvent_t.
+ */
+typedef struct flightLogRecord_t {
+    size_t length; // Of the record, including the data that follows it
 
-    while (1) {
-        char command = streamPeekChar(private->stream);
-        
-            if (command == 'H' && parserState == PARSER_STATE_HEADER) {
-                size_t frameSize = parseHeaderLine(log, private->stream, &parserState);
-                if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFCHR) { //Move on if in stream.
-                    fillSerialBuffer(private->stream, frameSize, &parserState);
-                }
-            } else if (command == EOF) {
-                fprintf(stderr, "Data file contained no events\n");
-                break;
-            } 
-            if (parserState == PARSER_STATE_TRANSITION) {
-                frameType = getFrameType(command);
+    uint8_t type;
+    uint8_t frameType;
+    bool frameValid, haveFrame;
 
-                if (frameType) {
+    // Set for G frames decoded before the segment's first H frame, which need the home position from earlier segments
+    bool beforeGPSHome;
 
-                    if (log->frameDefs['I'].fieldCount == 0) {
-                        fprintf(stderr, "Data file is missing field name definitions\n");
-                        return false;
-                    }
+    int fieldCount, frameSize;
+    int64_t frameOffset;
+} flightLogRecord_t;
 
-                    /* Home coord predictors appear in pairs (lat/lon), but the predictor ID is the same for both. It's easier to
-                        * apply the right predictor during parsing if we rewrite the predictor ID for the second half of the pair here:
-                        */
-                    for (int i = 1; i < log->frameDefs['G'].fieldCount; i++) {
-                        if (log->frameDefs['G'].predictor[i - 1] == FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD &&
-                            log->frameDefs['G'].predictor[i] == FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD) {
-                            log->frameDefs['G'].predictor[i] = FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD_1;
-                        }
-                    }
+typedef struct flightLogSegment_t {
+    // The range where frames that belong to this segment begin:
+    const char *begin, *limit;
 
-                    parserState = PARSER_STATE_DATA;
-                    frameType = NULL;
+    // Details of the I-frame at the beginning of the segment, if the worker accepted it:
+    bool startValid;
+    uint32_t startIteration;
+    int64_t startTime;
 
-                    if (onMetadataReady) {
-                        onMetadataReady(log);
-                    }
-                } // else skip garbage which apparently precedes the first data frame
-            } else if (parserState == PARSER_STATE_DATA) {
-            if (command == EOF) {
-                goto done;
-            }
+    // Where the first frame after the segment begins, and where the stream ends (a log end event can move that):
+    const char *finish, *end;
+    bool logEnded;
 
-            frameType = getFrameType((uint8_t) command);
-            streamReadByte(private->stream);//Skip over initial frame letter
-            size_t frameSize = 0;
+    // The parser state and statistics at the end of the segment:
+    flightLogPrivate_t state;
+    flightLogStatistics_t stats;
 
-            if (frameType) {
-                const char *frameStart = private->stream->pos;
-                frameType->parse(log, private->stream, raw);
-                frameSize = private->stream->pos - frameStart;
-            } else {
-                private->mainStreamIsValid = false;
-            }
+    uint8_t *records;
+    size_t recordsLength, recordsCapacity;
+} flightLogSegment_t;
 
-            //We shouldn't read an EOF during reading a frame (that'd imply the frame was truncated)
-            bool prematureEof = false;
-            if (private->stream->eof) {
-                prematureEof = true;
-            }
+struct flightLogParallelParse_t;
 
-            if (frameType) {
-                // Is this the beginning of a new frame?
-                frameType = command == EOF ? 0 : getFrameType((uint8_t) command);
-                bool looksLikeFrameCompleted = frameType || (!prematureEof && command == EOF);
+typedef struct flightLogWorker_t {
+    // This comes first so that the recording callbacks can find their worker from the log they're passed
+    flightLog_t log;
+    flightLogPrivate_t private;
+    mmapStream_t stream;
 
-                // If we see what looks like the beginning of a new frame, assume that the previous frame was valid:
-                if (frameSize <= FLIGHT_LOG_MAX_FRAME_LENGTH && looksLikeFrameCompleted) {
-                    bool frameAccepted = true;
+    struct flightLogParallelParse_t *parse;
+    int index;
 
-                    if (frameType->complete) {
-                        frameAccepted = frameType->complete(log, log->private->stream, frameType->marker, private->stream->pos - frameSize, private->stream->pos, raw);
-                    }
+    // Consecutive segments alternate between these slots, so one can be decoded while the other is being replayed
+    flightLogSegment_t slot[2];
+    semaphore_t slotFree, slotReady;
 
-                    if (frameAccepted) {
-                        //Update statistics for this frame type
-                        log->stats.frame[frameType->marker].bytes += frameSize;
-                        log->stats.frame[frameType->marker].sizeCount[frameSize]++;
-                        log->stats.frame[frameType->marker].validCount++;
-                        if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFCHR) { //fill data buffer with data
-                            fillSerialBuffer(private->stream, frameSize+1, &parserState); //+1 as size includes the header letter.
-                        }
-                    } else {
-                        log->stats.frame[frameType->marker].desyncCount++;
-                    }
-                } else {
-                    //The previous frame was corrupt
+    flightLogSegment_t *segment; // The slot being decoded into
+} flightLogWorker_t;
 
-                    //We need to resynchronise before we can deliver another main frame:
-                    private->mainStreamIsValid = false;
-                    log->stats.frame[frameType->marker].corruptCount++;
-                    log->stats.totalCorruptFrames++;
+typedef struct flightLogParallelParse_t {
+    bool raw;
+    int threads;
 
-                    //Let the caller know there was a corrupt frame (don't give them a pointer to the frame data because it is totally worthless)
-                    if (onFrameReady) {
-                        onFrameReady(log, false, 0, frameType->marker, 0, (private->stream->pos - frameSize) - private->stream->data, frameSize);
-                    }
+    // Segment i covers frames which begin in [segmentBegin[i], segmentBegin[i + 1])
+    const char **segmentBegin;
+    int segmentCount;
 
-                    /*
-                    * Start the search for a frame beginning after the first byte of the previous corrupt frame.
-                    * This way we can find the start of the next frame after the corrupt frame if the corrupt frame
-                    * was truncated.
-                    */
-                    streamReadByte(private->stream);//Move on from corrupt frame.
-                    if ((private->stream->mapping.stats.st_mode & S_IFMT) == S_IFCHR) { //fill data buffer with data
-                        fillSerialBuffer(private->stream, 1, &parserState);
-                    }
-                    frameType = NULL;
-                    prematureEof = false;
-                    private->stream->eof = false;
-                    continue;
-                }
-            }
-        }
+    // The end of the stream when the segments were chosen
+    const char *end;
 
-    }
+    volatile bool cancelled;
+    semaphore_t workerExited;
 
-    done:
-    log->stats.totalBytes = private->stream->end - private->stream->start;
+    flightLogWorker_t *workers;
+} flightLogParallelParse_t;
 
-    return true;
+/**
+ * Can an I-frame be decoded without knowing anything about the main frames before it, and can we jump around the log
+ * to find one?
+ */
+static bool flightLogIntraframesAreIndependent(flightLog_t *log, bool raw)
+{
+    flightLogFrameDef_t *intraframeDef = &log->frameDefs['I'];
+
+    // We can only look ahead in the log if it's a file, rather than arriving from a source as we read it
+    if (log->private->stream->source || (log->private->stream->mapping.stats.st_mode & S_IFMT) != S_IFREG) {
+        return false;
+    }
+
+    for (int i = 0; i < intraframeDef->fieldCount; i++) {
+        switch (intraframeDef->predictor[i]) {
+            case FLIGHT_LOG_FIELD_PREDICTOR_INC:
+                // This one is applied even in raw mode
+                return false;
+            case FLIGHT_LOG_FIELD_PREDICTOR_PREVIOUS:
+            case FLIGHT_LOG_FIELD_PREDICTOR_STRAIGHT_LINE:
+            case FLIGHT_LOG_FIELD_PREDICTOR_AVERAGE_2:
+            case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD:
+            case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD_1:
+            case FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME:
+                if (!raw) {
+                    return false;
+                }
+            break;
+            default:
+                ;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Can segments of the log which begin with an I-frame be decoded without knowing anything about the frames before
+ * them (apart from the things that flightLogMergeSegment() fixes up)?
+ */
+static bool flightLogCanParseInParallel(flightLog_t *log, bool raw)
+{
+    if (!flightLogIntraframesAreIndependent(log, raw)) {
+        return false;
+    }
+
+    if (raw) {
+        return true;
+    }
+
+    for (int frameType = 0; frameType < 256; frameType++) {
+        flightLogFrameDef_t *frameDef = &log->frameDefs[frameType];
+
+        for (int i = 0; i < frameDef->fieldCount; i++) {
+            switch (frameDef->predictor[i]) {
+                case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD:
+                case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD_1:
+                    // We only know how to fix up the home position in GPS frames
+                    if (frameType != 'G') {
+                        return false;
+                    }
+                break;
+                case FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME:
+                    /*
+                     * A 64-bit field predicted from the main frame time would carry the worker's rollover accumulator
+                     * along with it, which we only fix up in the timestamp fields.
+                     */
+                    if (frameDef->fieldWidth[i] == 8
+                            && !((frameType == 'I' || frameType == 'P') && i == FLIGHT_LOG_FIELD_INDEX_TIME)
+                            && !(frameType == 'G' && i == log->gpsFieldIndexes.time)) {
+                        return false;
+                    }
+                break;
+                default:
+                    ;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Allocate space to decode a main frame into outside of the parser's history, which the caller must free().
+ */
+static int64_t* flightLogAllocateMainFrame(flightLog_t *log)
+{
+    int64_t *frame = malloc(log->private->mainFrameStride * sizeof(*frame));
+
+    if (!frame) {
+        fprintf(stderr, "Failed to allocate memory for the decoder\n");
+        exit(-1);
+    }
+
+    return frame;
+}
+
+/**
+ * Does what looks like a genuine I-frame begin at the 'I' marker at `pos`, ending before `end`? The I-frame is decoded
+ * into `frame`.
+ */
+static bool flightLogIsIntraframe(flightLog_t *log, const char *pos, const char *end, int64_t *frame)
+{
+    mmapStream_t stream = *log->private->stream;
+
+    stream.pos = pos + 1;
+    stream.end = end;
+    stream.bitPos = CHAR_BIT - 1;
+    stream.eof = false;
+
+    parseFrame(log, &stream, 'I', frame, NULL, NULL, 0);
+
+    // It should have decoded to a sensible length, be followed by another frame, and land on the I-frame interval
+    return !stream.eof && stream.pos - (pos + 1) <= log->private->maxFrameLength && stream.pos < end && getFrameType(*stream.pos)
+        && (log->frameIntervalI <= 1 || (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] % log->frameIntervalI == 0);
+}
+
+/**
+ * Find the first position at or after `pos` where what looks like a genuine I-frame begins, or NULL if there isn't one.
+ * The I-frame is decoded into `frame`.
+ */
+static const char* flightLogFindIntraframe(flightLog_t *log, const char *pos, const char *end, int64_t *frame)
+{
+    while (pos < end && (pos = memchr(pos, 'I', end - pos)) != NULL) {
+        if (flightLogIsIntraframe(log, pos, end, frame)) {
+            return pos;
+        }
+
+        pos++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Resynchronisation
+ *
+ * When a frame should begin at a byte which isn't a frame marker, or a frame turns out to be far too long to be
+ * genuine, we've lost track of where the frames are. Instead of trying to decode a frame at each of the following bytes
+ * which happens to look like a frame marker, we search ahead for an I-frame that we can carry on decoding from and skip
+ * straight to it.
+ */
+
+/**
+ * Does the I-frame `next` carry on sensibly from the I-frame `previous`?
+ */
+static bool flightLogIntraframeFollows(const int64_t *previous, const int64_t *next)
+{
+    uint32_t iterationJump = (uint32_t) (next[FLIGHT_LOG_FIELD_INDEX_ITERATION] - previous[FLIGHT_LOG_FIELD_INDEX_ITERATION]);
+    uint32_t timeJump = (uint32_t) (next[FLIGHT_LOG_FIELD_INDEX_TIME] - previous[FLIGHT_LOG_FIELD_INDEX_TIME]);
+
+    return iterationJump > 0 && iterationJump < MAXIMUM_ITERATION_JUMP_BETWEEN_FRAMES
+        && timeJump > 0 && timeJump < MAXIMUM_TIME_JUMP_BETWEEN_FRAMES;
+}
+
+/**
+ * Search for the beginning of another log in a stream read from a source, from a little before `lostAt` (far enough
+ * back to catch one that a frame we thought we were decoding ran into) up to `end`, but never before the current log's
+ * frames began.
+ *
+ * Returns the start of the log, or NULL if there isn't one.
+ */
+static const char* flightLogFindLogStart(flightLog_t *log, const char *lostAt, const char *end)
+{
+    mmapStream_t *stream = log->private->stream;
+    size_t markerLength = strlen(LOG_START_MARKER);
+    int64_t searchFrom = streamOffset(stream, lostAt) - (log->private->maxFrameLength + (int64_t) markerLength);
+    const char *from;
+
+    if (searchFrom < log->private->dataBegin) {
+        searchFrom = log->private->dataBegin;
+    }
+    if (searchFrom < (int64_t) stream->windowOffset) {
+        searchFrom = (int64_t) stream->windowOffset;
+    }
+
+    from = stream->data + (searchFrom - (int64_t) stream->windowOffset);
+
+    if (from >= end) {
+        return NULL;
+    }
+
+    return memmem(from, end - from, LOG_START_MARKER, markerLength);
+}
+
+/**
+ * We lost track of the frames at `lostAt`, so move the stream on to the next I-frame after it which carries on from the
+ * last main frame we accepted, or which the I-frame after it carries on from.
+ */
+static void flightLogResynchronise(flightLog_t *log, const char *lostAt, bool raw)
+{
+    flightLogPrivate_t *private = log->private;
+    mmapStream_t *stream = private->stream;
+    int64_t *frame = flightLogAllocateMainFrame(log), *nextFrame = flightLogAllocateMainFrame(log), *swap;
+    const char *candidate, *next, *resume;
+
+    candidate = flightLogFindIntraframe(log, lostAt + 1, stream->end, frame);
+
+    while (candidate) {
+        // The candidate only has to be checked against the last main frame, its frame was already found to decode sensibly
+        if (raw || private->lastMainFrameIteration == (uint32_t) -1
+                || ((uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] - private->lastMainFrameIteration < MAXIMUM_ITERATION_JUMP_BETWEEN_FRAMES
+                    && (uint32_t) ((uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_TIME] - (uint32_t) private->lastMainFrameTime) < MAXIMUM_TIME_JUMP_BETWEEN_FRAMES)) {
+            break;
+        }
+
+        next = flightLogFindIntraframe(log, candidate + 1, stream->end, nextFrame);
+
+        /*
+         * Two I-frames in a row which agree with each other are more trustworthy than the last main frame, which might
+         * have been corrupt data that happened to look plausible, so start afresh from them.
+         */
+        if (next && flightLogIntraframeFollows(frame, nextFrame)) {
+            private->lastMainFrameIteration = (uint32_t) -1;
+            private->lastMainFrameTime = -1;
+            break;
+        }
+
+        log->stats.resyncRejectedCandidates++;
+
+        candidate = next;
+        swap = frame;
+        frame = nextFrame;
+        nextFrame = swap;
+    }
+
+    if (candidate) {
+        resume = candidate;
+    } else if (stream->end - lostAt > private->maxFrameLength + 1) {
+        // The last few bytes might begin a frame that hasn't been completely read yet
+        resume = stream->end - (private->maxFrameLength + 1);
+    } else {
+        resume = lostAt + 1;
+    }
+
+    /*
+     * When a log was cut short and the next one follows straight on from it (as happens in a pipe), the frames we lost
+     * track of may have run into the next log's headers, and the candidate we found may be one of its frames. Stop at
+     * its start instead, so that the parser ends this log there.
+     */
+    if (stream->source) {
+        const char *logStart = flightLogFindLogStart(log, lostAt, candidate ? candidate : stream->end);
+
+        if (logStart) {
+            resume = logStart;
+        }
+    }
+
+    log->stats.resyncCount++;
+    if (resume > lostAt) {
+        log->stats.resyncSkippedBytes += resume - lostAt;
+    }
+
+    flightLogInvalidateStream(log);
+
+    stream->pos = resume;
+    stream->bitPos = CHAR_BIT - 1;
+    stream->eof = false;
+
+    free(frame);
+    free(nextFrame);
+}
+
+/**
+ * Split the log from the stream position up to `limit` into segments which begin with I-frames.
+ */
+static void flightLogFindSegments(flightLog_t *log, flightLogParallelParse_t *parse, const char *limit)
+{
+    mmapStream_t *stream = log->private->stream;
+    const char *segmentBegin = stream->pos;
+    int64_t *frame = flightLogAllocateMainFrame(log);
+
+    parse->segmentBegin = malloc(((limit - stream->pos) / FLIGHT_LOG_PARALLEL_SEGMENT_LENGTH + 2) * sizeof(*parse->segmentBegin));
+    parse->segmentBegin[0] = segmentBegin;
+    parse->segmentCount = 1;
+    parse->end = stream->end;
+
+    while (limit - segmentBegin > FLIGHT_LOG_PARALLEL_SEGMENT_LENGTH) {
+        segmentBegin = flightLogFindIntraframe(log, segmentBegin + FLIGHT_LOG_PARALLEL_SEGMENT_LENGTH, stream->end, frame);
+
+        if (!segmentBegin || segmentBegin >= limit) {
+            break;
+        }
+
+        parse->segmentBegin[parse->segmentCount++] = segmentBegin;
+    }
+
+    parse->segmentBegin[parse->segmentCount] = limit;
+
+    free(frame);
+}
+
+static void* flightLogSegmentAppendRecord(flightLogSegment_t *segment, size_t length)
+{
+    flightLogRecord_t *record;
+
+    if (segment->recordsLength + length > segment->recordsCapacity) {
+        segment->recordsCapacity = (segment->recordsLength + length) * 2;
+        segment->records = realloc(segment->records, segment->recordsCapacity);
+
+        if (!segment->records) {
+            fprintf(stderr, "Failed to allocate memory for decoded frames\n");
+            exit(-1);
+        }
+    }
+
+    record = (flightLogRecord_t *) (segment->records + segment->recordsLength);
+    record->length = length;
+
+    segment->recordsLength += length;
+
+    return record;
+}
+
+static void flightLogRecordFrame(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+    flightLogWorker_t *worker = (flightLogWorker_t *) log;
+    size_t valuesLength = frame ? fieldCount * sizeof(*frame) : 0;
+    flightLogRecord_t *record = flightLogSegmentAppendRecord(worker->segment, sizeof(*record) + valuesLength);
+
+    record->type = FLIGHT_LOG_RECORD_FRAME;
+    record->frameType = frameType;
+    record->frameValid = frameValid;
+    record->haveFrame = frame != NULL;
+    record->beforeGPSHome = frameType == 'G' && !worker->private.gpsHomeIsValid;
+    record->fieldCount = fieldCount;
+    record->frameOffset = frameOffset;
+    record->frameSize = frameSize;
+
+    if (frame) {
+        memcpy(record + 1, frame, valuesLength);
+    }
+}
+
+static void flightLogRecordEvent(flightLog_t *log, flightLogEvent_t *event)
+{
+    flightLogWorker_t *worker = (flightLogWorker_t *) log;
+    flightLogRecord_t *record = flightLogSegmentAppendRecord(worker->segment, sizeof(*record) + sizeof(*event));
+
+    record->type = FLIGHT_LOG_RECORD_EVENT;
+
+    memcpy(record + 1, event, sizeof(*event));
+}
+
+/**
+ * Copy the main frame history from `src` to `dest` (which has frame buffers of the same size), pointing dest's
+ * mainHistory at its own copy of the ring.
+ */
+static void flightLogCopyMainHistory(flightLogPrivate_t *dest, const flightLogPrivate_t *src)
+{
+    memcpy(dest->blackboxHistoryRing, src->blackboxHistoryRing, 3 * src->mainFrameStride * sizeof(*src->blackboxHistoryRing));
+
+    for (int i = 0; i < 3; i++) {
+        dest->mainHistory[i] = src->mainHistory[i] ? dest->blackboxHistoryRing + (src->mainHistory[i] - src->blackboxHistoryRing) : NULL;
+    }
+}
+
+/**
+ * Copy the whole of the parser state in `src` to `dest`, giving dest its own copy of the frame buffers (dest's own
+ * buffers are reused if it has some, they must be the same size as src's).
+ */
+static void flightLogCopyState(flightLogPrivate_t *dest, const flightLogPrivate_t *src)
+{
+    int64_t *frameBuffers = dest->frameBuffers && dest->frameBuffers != src->frameBuffers ? dest->frameBuffers : NULL;
+
+    *dest = *src;
+
+    dest->frameBuffers = frameBuffers ? frameBuffers : malloc(src->frameBuffersLength * sizeof(*src->frameBuffers));
+
+    if (!dest->frameBuffers) {
+        fprintf(stderr, "Failed to allocate memory for decoding threads\n");
+        exit(-1);
+    }
+
+    memcpy(dest->frameBuffers, src->frameBuffers, src->frameBuffersLength * sizeof(*src->frameBuffers));
+
+    flightLogPointFrameBuffers(dest, (int) (src->lastSlow - src->lastGPS));
+    flightLogCopyMainHistory(dest, src);
+}
+
+/**
+ * Clear the statistics, but keep the memory for the main field statistics.
+ */
+static void flightLogResetStatistics(flightLogStatistics_t *stats)
+{
+    flightLogFieldStatistics_t *field = stats->field;
+
+    memset(stats, 0, sizeof(*stats));
+
+    stats->field = field;
+}
+
+/**
+ * Copy the statistics from `src` to `dest`, which has its own memory for the main field statistics.
+ */
+static void flightLogCopyStatistics(flightLogStatistics_t *dest, const flightLogStatistics_t *src, int fieldCount)
+{
+    flightLogFieldStatistics_t *field = dest->field;
+
+    *dest = *src;
+
+    dest->field = field;
+    memcpy(dest->field, src->field, fieldCount * sizeof(*dest->field));
+}
+
+static void flightLogDecodeSegment(flightLogWorker_t *worker, const char *begin, const char *limit)
+{
+    flightLog_t *log = &worker->log;
+    flightLogPrivate_t *private = &worker->private;
+    flightLogSegment_t *segment = worker->segment;
+
+    segment->begin = begin;
+    segment->limit = limit;
+    segment->recordsLength = 0;
+
+    // The I-frame that begins the segment doesn't depend on anything before it, so start from scratch
+    flightLogResetStatistics(&log->stats);
+
+    flightLogInvalidateStream(log);
+    private->mainHistory[0] = private->blackboxHistoryRing;
+
+    private->timeRolloverAccumulator = 0;
+    private->lastSkippedFrames = 0;
+    private->lastMainFrameIteration = (uint32_t) -1;
+    private->lastMainFrameTime = -1;
+
+    memset(private->gpsHomeHistory[0], 0, 2 * private->gpsHomeFrameStride * sizeof(*private->gpsHomeHistory[0]));
+    private->gpsHomeIsValid = false;
+
+    worker->stream.pos = begin;
+    worker->stream.end = worker->parse->end;
+    worker->stream.bitPos = CHAR_BIT - 1;
+    worker->stream.eof = false;
+
+    flightLogParseDataFrame(log, streamPeekChar(&worker->stream), worker->parse->raw);
+
+    segment->startValid = private->mainStreamIsValid;
+    segment->startIteration = private->lastMainFrameIteration;
+    segment->startTime = private->lastMainFrameTime;
+
+    segment->logEnded = flightLogParseDataFrames(log, limit, worker->parse->raw);
+
+    segment->finish = worker->stream.pos;
+    segment->end = worker->stream.end;
+
+    flightLogCopyStatistics(&segment->stats, &log->stats, log->frameDefs['I'].fieldCount);
+    flightLogCopyState(&segment->state, private);
+}
+
+static void* flightLogWorkerRun(void *data)
+{
+    flightLogWorker_t *worker = (flightLogWorker_t *) data;
+    flightLogParallelParse_t *parse = worker->parse;
+    int round = 0;
+
+    // Segment 0 is decoded by the calling thread
+    for (int segmentIndex = 1 + worker->index; segmentIndex < parse->segmentCount; segmentIndex += parse->threads, round++) {
+        semaphore_wait(&worker->slotFree);
+
+        if (parse->cancelled) {
+            break;
+        }
+
+        worker->segment = &worker->slot[round % 2];
+
+        flightLogDecodeSegment(worker, parse->segmentBegin[segmentIndex], parse->segmentBegin[segmentIndex + 1]);
+
+        semaphore_signal(&worker->slotReady);
+    }
+
+    semaphore_signal(&parse->workerExited);
+
+    return NULL;
+}
+
+static void flightLogMergeStatistics(flightLogStatistics_t *dest, const flightLogStatistics_t *src, int fieldCount, int64_t timeOffset)
+{
+    dest->totalCorruptFrames += src->totalCorruptFrames;
+    dest->intentionallyAbsentIterations += src->intentionallyAbsentIterations;
+    dest->resyncCount += src->resyncCount;
+    dest->resyncSkippedBytes += src->resyncSkippedBytes;
+    dest->resyncRejectedCandidates += src->resyncRejectedCandidates;
+
+    for (int frameType = 0; frameType < 256; frameType++) {
+        const flightLogFrameStatistics_t *srcFrame = &src->frame[frameType];
+        flightLogFrameStatistics_t *destFrame = &dest->frame[frameType];
+
+        if (srcFrame->validCount == 0 && srcFrame->desyncCount == 0 && srcFrame->corruptCount == 0) {
+            continue;
+        }
+
+        destFrame->bytes += srcFrame->bytes;
+        destFrame->validCount += srcFrame->validCount;
+        destFrame->desyncCount += srcFrame->desyncCount;
+        destFrame->corruptCount += srcFrame->corruptCount;
+
+        for (int i = 0; i <= FLIGHT_LOG_MAX_FRAME_LENGTH; i++) {
+            destFrame->sizeCount[i] += srcFrame->sizeCount[i];
+        }
+    }
+
+    if (src->haveFieldStats) {
+        for (int i = 0; i < fieldCount; i++) {
+            int64_t offset = i == FLIGHT_LOG_FIELD_INDEX_TIME ? timeOffset : 0;
+
+            if (!dest->haveFieldStats || src->field[i].min + offset < dest->field[i].min) {
+                dest->field[i].min = src->field[i].min + offset;
+            }
+            if (!dest->haveFieldStats || src->field[i].max + offset > dest->field[i].max) {
+                dest->field[i].max = src->field[i].max + offset;
+            }
+        }
+
+        dest->haveFieldStats = true;
+    }
+}
+
+/**
+ * Give a GPS frame that a worker decoded before it saw a GPS home frame the home position that the serial parser
+ * would have had at that point.
+ */
+static void flightLogFixUpGPSFrameHome(flightLog_t *log, int64_t *frame, bool raw)
+{
+    flightLogFrameDef_t *frameDef = &log->frameDefs['G'];
+
+    if (raw) {
+        return;
+    }
+
+    for (int i = 0; i < frameDef->fieldCount; i++) {
+        int64_t value;
+
+        switch (frameDef->predictor[i]) {
+            case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD:
+                value = frame[i] + log->private->gpsHomeHistory[1][log->gpsHomeFieldIndexes.GPS_home[0]];
+            break;
+            case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD_1:
+                value = frame[i] + log->private->gpsHomeHistory[1][log->gpsHomeFieldIndexes.GPS_home[1]];
+            break;
+            default:
+                continue;
+        }
+
+        if (frameDef->fieldWidth[i] != 8) {
+            if (frameDef->fieldSigned[i]) {
+                value = (int32_t) value;
+            } else {
+                value = (uint32_t) value;
+            }
+        }
+
+        frame[i] = value;
+    }
+}
+
+/**
+ * Deliver the frames and events that a worker recorded to the caller's callbacks, moving the timestamps onto our
+ * timeline by adding `timeOffset`.
+ */
+static void flightLogReplaySegment(flightLog_t *log, flightLogSegment_t *segment, int64_t timeOffset, bool raw)
+{
+    flightLogPrivate_t *private = log->private;
+    uint8_t *pos = segment->records, *end = segment->records + segment->recordsLength;
+
+    while (pos < end) {
+        flightLogRecord_t *record = (flightLogRecord_t *) pos;
+
+        pos += record->length;
+
+        if (record->type == FLIGHT_LOG_RECORD_EVENT) {
+            flightLogEvent_t *event = (flightLogEvent_t *) (record + 1);
+
+            switch (event->event) {
+                case FLIGHT_LOG_EVENT_SYNC_BEEP:
+                    event->data.syncBeep.time += timeOffset;
+                break;
+                case FLIGHT_LOG_EVENT_LOGGING_RESUME:
+                    event->data.loggingResume.currentTime += timeOffset;
+                break;
+                default:
+                    ;
+            }
+
+            private->onEvent(log, event);
+        } else {
+            int64_t *frame = record->haveFrame ? (int64_t *) (record + 1) : NULL;
+            bool frameValid = record->frameValid;
+
+            if (frame) {
+                switch (record->frameType) {
+                    case 'I':
+                    case 'P':
+                        frame[FLIGHT_LOG_FIELD_INDEX_TIME] += timeOffset;
+                    break;
+                    case 'G':
+                        if (log->gpsFieldIndexes.time != -1) {
+                            frame[log->gpsFieldIndexes.time] += timeOffset;
+                        }
+
+                        if (record->beforeGPSHome) {
+                            flightLogFixUpGPSFrameHome(log, frame, raw);
+                            frameValid = private->gpsHomeIsValid;
+                        }
+                    break;
+                }
+            }
+
+            private->onFrameReady(log, frameValid, frame, record->frameType, record->fieldCount, record->frameOffset, record->frameSize);
+        }
+    }
+}
+
+/**
+ * If the serial parser would have begun the given worker-decoded segment in a state that makes its decode identical
+ * to the worker's, deliver the segment's frames and adopt the worker's state at the end of it.
+ *
+ * Returns false (leaving the parser state as it was) if the segment has to be decoded serially instead.
+ */
+static bool flightLogMergeSegment(flightLog_t *log, flightLogSegment_t *segment, bool raw)
+{
+    flightLogPrivate_t *private = log->private;
+    int64_t savedTimeRolloverAccumulator = private->timeRolloverAccumulator;
+    int64_t timeOffset;
+
+    if (private->stream->pos != segment->begin || !segment->startValid) {
+        return false;
+    }
+
+    // The worker started without any rollovers, so this is the whole number of rollovers that it is behind by
+    timeOffset = flightLogDetectAndApplyTimestampRollover(log, segment->startTime) - segment->startTime;
+
+    // The serial parser would need to agree that the I-frame was valid
+    if (!raw && private->lastMainFrameIteration != (uint32_t) -1
+            && !flightLogIsPlausibleNextMainFrame(log, segment->startIteration, segment->startTime + timeOffset)) {
+        private->timeRolloverAccumulator = savedTimeRolloverAccumulator;
+        return false;
+    }
+
+    // The worker had no earlier frame to count skipped iterations from
+    log->stats.intentionallyAbsentIterations += countIntentionallySkippedFramesTo(log, segment->startIteration);
+
+    flightLogReplaySegment(log, segment, timeOffset, raw);
+
+    flightLogMergeStatistics(&log->stats, &segment->stats, log->frameDefs['I'].fieldCount, timeOffset);
+
+    flightLogCopyMainHistory(private, &segment->state);
+
+    for (int i = 0; i < 3; i++) {
+        private->blackboxHistoryRing[i * private->mainFrameStride + FLIGHT_LOG_FIELD_INDEX_TIME] += timeOffset;
+    }
+
+    private->mainStreamIsValid = segment->state.mainStreamIsValid;
+    private->timeRolloverAccumulator = segment->state.timeRolloverAccumulator + timeOffset;
+    private->lastSkippedFrames = segment->state.lastSkippedFrames;
+    private->lastMainFrameIteration = segment->state.lastMainFrameIteration;
+    private->lastMainFrameTime = segment->state.lastMainFrameTime + timeOffset;
+
+    if (segment->state.gpsHomeIsValid) {
+        memcpy(private->gpsHomeHistory[0], segment->state.gpsHomeHistory[0], 2 * private->gpsHomeFrameStride * sizeof(*private->gpsHomeHistory[0]));
+        private->gpsHomeIsValid = true;
+    }
+
+    private->stream->pos = segment->finish;
+    private->stream->end = segment->end;
+
+    return true;
+}
+
+/**
+ * Decode the data frames of the log which begin between the current stream position and `limit` using the given
+ * number of worker threads, delivering the results to the callbacks in order just like flightLogParseDataFrames()
+ * would.
+ *
+ * Returns true if the log ended.
+ */
+static bool flightLogParseRangeInParallel(flightLog_t *log, int threads, const char *limit, bool raw)
+{
+    flightLogPrivate_t *private = log->private;
+    flightLogParallelParse_t parse;
+    size_t fieldStatsLength = log->frameDefs['I'].fieldCount * sizeof(*log->stats.field);
+    bool logEnded;
+
+    memset(&parse, 0, sizeof(parse));
+    parse.raw = raw;
+
+    flightLogFindSegments(log, &parse, limit);
+
+    if (parse.segmentCount < 2) {
+        // Not enough log to be worth splitting up
+        free(parse.segmentBegin);
+        return flightLogParseDataFrames(log, limit, raw);
+    }
+
+    parse.threads = threads < parse.segmentCount - 1 ? threads : parse.segmentCount - 1;
+    parse.workers = calloc(parse.threads, sizeof(*parse.workers));
+
+    if (!parse.workers) {
+        fprintf(stderr, "Failed to allocate memory for decoding threads\n");
+        exit(-1);
+    }
+
+    semaphore_create(&parse.workerExited, 0);
+
+    for (int i = 0; i < parse.threads; i++) {
+        flightLogWorker_t *worker = &parse.workers[i];
+
+        worker->log = *log;
+        flightLogCopyState(&worker->private, private);
+        worker->stream = *private->stream;
+
+        worker->log.stats.field = malloc(fieldStatsLength);
+        worker->slot[0].stats.field = malloc(fieldStatsLength);
+        worker->slot[1].stats.field = malloc(fieldStatsLength);
+
+        if (!worker->log.stats.field || !worker->slot[0].stats.field || !worker->slot[1].stats.field) {
+            fprintf(stderr, "Failed to allocate memory for decoding threads\n");
+            exit(-1);
+        }
+
+        worker->log.private = &worker->private;
+        worker->private.stream = &worker->stream;
+
+        worker->private.onMetadataReady = NULL;
+        worker->private.onFrameReady = private->onFrameReady ? flightLogRecordFrame : NULL;
+        worker->private.onEvent = private->onEvent ? flightLogRecordEvent : NULL;
+
+        worker->parse = &parse;
+        worker->index = i;
+
+        semaphore_create(&worker->slotFree, 2);
+        semaphore_create(&worker->slotReady, 0);
+
+        thread_create_detached(flightLogWorkerRun, worker);
+    }
+
+    // The log before the first boundary we found is ours to decode while the workers get going
+    logEnded = flightLogParseDataFrames(log, parse.segmentBegin[1], raw);
+
+    for (int segmentIndex = 1; segmentIndex < parse.segmentCount && !logEnded; segmentIndex++) {
+        flightLogWorker_t *worker = &parse.workers[(segmentIndex - 1) % parse.threads];
+        flightLogSegment_t *segment = &worker->slot[((segmentIndex - 1) / parse.threads) % 2];
+
+        semaphore_wait(&worker->slotReady);
+
+        if (flightLogMergeSegment(log, segment, raw)) {
+            logEnded = segment->logEnded;
+        } else {
+            logEnded = flightLogParseDataFrames(log, segment->limit, raw);
+        }
+
+        semaphore_signal(&worker->slotFree);
+    }
+
+    // If the log ended early, the workers might still be waiting to decode segments we no longer need
+    parse.cancelled = true;
+
+    for (int i = 0; i < parse.threads; i++) {
+        semaphore_signal(&parse.workers[i].slotFree);
+    }
+
+    for (int i = 0; i < parse.threads; i++) {
+        semaphore_wait(&parse.workerExited);
+    }
+
+    for (int i = 0; i < parse.threads; i++) {
+        semaphore_destroy(&parse.workers[i].slotFree);
+        semaphore_destroy(&parse.workers[i].slotReady);
+
+        for (int j = 0; j < 2; j++) {
+            free(parse.workers[i].slot[j].records);
+            free(parse.workers[i].slot[j].stats.field);
+            free(parse.workers[i].slot[j].state.frameBuffers);
+        }
+
+        free(parse.workers[i].log.stats.field);
+        free(parse.workers[i].private.frameBuffers);
+    }
+
+    semaphore_destroy(&parse.workerExited);
+
+    free(parse.workers);
+    free(parse.segmentBegin);
+
+    return logEnded;
+}
+
+/**
+ * Decode the data frames of the log (starting from the current stream position) using the given number of worker
+ * threads, delivering the results to the callbacks in order just like flightLogParseDataFrames() would.
+ *
+ * A file that's mapped a window at a time is decoded a window at a time. The frames which begin in the window are
+ * shared out, apart from the ones in its last STREAM_WINDOW_LOOKAHEAD bytes which might not end inside it, and then the
+ * next window is mapped from where we got to.
+ */
+static void flightLogParseDataInParallel(flightLog_t *log, int threads, bool raw)
+{
+    mmapStream_t *stream = log->private->stream;
+
+    while (1) {
+        bool lastWindow = !stream->windowed || stream->sourceEnded || stream->end != stream->windowEnd;
+        const char *limit = lastWindow ? stream->end : stream->end - STREAM_WINDOW_LOOKAHEAD;
+
+        if (flightLogParseRangeInParallel(log, threads, limit, raw) || lastWindow) {
+            break;
+        }
+
+        if (!streamSeek(stream, streamOffset(stream, stream->pos))) {
+            break;
+        }
+    }
+}
+
+/*
+ * Seeking
+ *
+ * A complete decode of a log can record the I-frames that the parser accepted (along with the GPS home and slow frames)
+ * into an index. Since an I-frame doesn't depend on the main frames before it, decoding can later begin at one of those
+ * I-frames instead of at the start of the log, once the GPS home and slow frames in effect there have been decoded and
+ * the time rollover accumulator has been recovered from the I-frame's 64-bit time.
+ */
+
+/**
+ * Record the frames that are delivered during a decode into the index, then pass them on to the caller's callback.
+ */
+static void flightLogIndexFrame(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+    flightLogPrivate_t *private = log->private;
+
+    if (frameValid && frame) {
+        // The offsets we're given are of the frame's data, which begins after its marker byte
+        switch (frameType) {
+            case 'I':
+                flightLogIndexAddIntraframe(private->index, private->indexingLog, frameOffset - 1,
+                    (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION], frame[FLIGHT_LOG_FIELD_INDEX_TIME]);
+            break;
+            case 'H':
+                flightLogIndexAddGPSHome(private->index, private->indexingLog, frameOffset - 1);
+            break;
+            case 'S':
+                flightLogIndexAddSlow(private->index, private->indexingLog, frameOffset - 1);
+            break;
+        }
+    }
+
+    if (private->callerOnFrameReady) {
+        private->callerOnFrameReady(log, frameValid, frame, frameType, fieldCount, frameOffset, frameSize);
+    }
+}
+
+/**
+ * Record seek points into the given index whenever a log that it doesn't cover yet is decoded from start to finish.
+ * Pass NULL to stop recording.
+ */
+void flightLogAttachIndex(flightLog_t *log, flightLogIndex_t *index)
+{
+    log->private->index = index;
+}
+
+/**
+ * Get a pointer to the offset `end` in the stream's window, or to the end of the window if it lies beyond it.
+ */
+static const char* flightLogWindowLimit(mmapStream_t *stream, int64_t end)
+{
+    const char *windowEnd = stream->windowed ? stream->windowEnd : stream->data + stream->size;
+
+    return end - (int64_t) stream->windowOffset < windowEnd - stream->data ? stream->data + (end - (int64_t) stream->windowOffset) : windowEnd;
+}
+
+/**
+ * Check that what looks like a genuine I-frame lies at the seek point (before the offset `end`), with the loop iteration
+ * and time that the seek point says it has. That won't be the case if the index it came from belongs to some other log.
+ *
+ * This moves the stream to the seek point if it can.
+ */
+static bool flightLogIntraframeIsAt(flightLog_t *log, const flightLogSeekPoint_t *point, int64_t end)
+{
+    mmapStream_t *stream = log->private->stream;
+    const char *limit;
+    int64_t *frame;
+    bool matches;
+
+    if (point->offset < 0 || point->offset >= end || !streamSeek(stream, point->offset) || *stream->pos != 'I') {
+        return false;
+    }
+
+    limit = flightLogWindowLimit(stream, end);
+    frame = flightLogAllocateMainFrame(log);
+
+    matches = flightLogIsIntraframe(log, stream->pos, limit, frame)
+        && (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] == point->iteration
+        && (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_TIME] == (uint32_t) point->time;
+
+    free(frame);
+
+    return matches;
+}
+
+/**
+ * Check that the seek point makes sense for the log we're decoding, and that restoring the state it records is enough
+ * to decode identically from there on.
+ *
+ * The stream is left where it was (at the beginning of the log's data).
+ */
+static bool flightLogCanSeekTo(flightLog_t *log, int logIndex, const flightLogSeekPoint_t *point, bool raw)
+{
+    mmapStream_t *stream = log->private->stream;
+    const int64_t offsets[] = {point->offset, point->gpsHomeOffset, point->slowOffset};
+    const char markers[] = {'I', 'H', 'S'};
+    int64_t dataStart = streamOffset(stream, stream->pos), logEnd = log->logBegin[logIndex + 1];
+    bool canSeek = true;
+
+    if (!flightLogIntraframesAreIndependent(log, raw)) {
+        return false;
+    }
+
+    for (int i = 0; canSeek && i < (int) ARRAY_LENGTH(offsets); i++) {
+        flightLogFrameDef_t *frameDef = &log->frameDefs[(uint8_t) markers[i]];
+
+        if (offsets[i] == -1 && markers[i] != 'I') {
+            continue;
+        }
+
+        // The frame must lie in the log after its headers
+        if (offsets[i] < dataStart || offsets[i] >= logEnd || !streamSeek(stream, offsets[i]) || *stream->pos != markers[i]) {
+            canSeek = false;
+            break;
+        }
+
+        // And GPS home and slow frames are decoded without the main frames that came before them
+        for (int j = 0; markers[i] != 'I' && !raw && j < frameDef->fieldCount; j++) {
+            switch (frameDef->predictor[j]) {
+                case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD:
+                case FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD_1:
+                case FLIGHT_LOG_FIELD_PREDICTOR_LAST_MAIN_FRAME_TIME:
+                    canSeek = false;
+                break;
+                default:
+                    ;
+            }
+        }
+    }
+
+    canSeek = canSeek && flightLogIntraframeIsAt(log, point, logEnd);
+
+    streamSeek(stream, dataStart);
+
+    return canSeek;
+}
+
+/**
+ * Decode the frame whose marker byte is at the given offset and deliver it.
+ */
+static void flightLogParseFrameAt(flightLog_t *log, int64_t offset, bool raw)
+{
+    mmapStream_t *stream = log->private->stream;
+    const flightLogFrameType_t *frameType;
+    const char *frameStart;
+
+    if (!streamSeek(stream, offset)) {
+        return;
+    }
+
+    frameType = getFrameType((uint8_t) *stream->pos);
+    frameStart = stream->pos + 1;
+
+    stream->pos = frameStart;
+
+    frameType->parse(log, stream, raw);
+    frameType->complete(log, stream, frameType->marker, frameStart, stream->pos, raw);
+}
+
+/**
+ * Put the parser into the state that a decode from the start of the log would have had on reaching the seek point's
+ * I-frame, and move the stream there.
+ */
+static void flightLogSeek(flightLog_t *log, const flightLogSeekPoint_t *point, bool raw)
+{
+    flightLogPrivate_t *private = log->private;
+
+    if (point->gpsHomeOffset != -1) {
+        flightLogParseFrameAt(log, point->gpsHomeOffset, raw);
+    }
+
+    if (point->slowOffset != -1) {
+        flightLogParseFrameAt(log, point->slowOffset, raw);
+    }
+
+    // Since there's no previous main frame, the I-frame will be accepted just like the serial parser accepted it
+    private->timeRolloverAccumulator = point->time - (uint32_t) point->time;
+
+    streamSeek(private->stream, point->offset);
+}
+
+/*
+ * Decoding a window of time
+ *
+ * Without an index covering the log, we find I-frames near the ends of the window with a binary search over the bytes
+ * of the log. Candidate I-frames are checked by walking the frames that follow them to the next I-frame, since frame
+ * lengths don't depend on the history that we don't have yet. The GPS home and slow frames in effect at the start of
+ * the window are found by walking backwards through the log one run of frames at a time until we've seen both.
+ */
+
+// The binary search stops once it has narrowed the I-frame down to this many bytes, then we walk forward to it
+#define FLIGHT_LOG_SEEK_SCAN_LENGTH (16 * 1024)
+
+// How far back to look for an I-frame to walk the frames before a seek point from (this doubles as we go)
+#define FLIGHT_LOG_SEEK_STATE_SCAN_LENGTH (4 * 1024)
+
+/**
+ * Work out where the frame that begins at `pos` ends without delivering it, or return NULL if it doesn't look like a
+ * complete frame. Returns `end` if the frame ends the log.
+ *
+ * Main frames are decoded into `frame` without any history, but other frame types are decoded into the parser's own
+ * buffers for them, so this must only be used before the data frames are decoded.
+ */
+static const char* flightLogSkipFrame(flightLog_t *log, const char *pos, const char *end, int64_t *frame, bool raw)
+{
+    mmapStream_t stream = *log->private->stream;
+    const flightLogFrameType_t *frameType = getFrameType((uint8_t) *pos);
+
+    if (!frameType) {
+        return NULL;
+    }
+
+    stream.pos = pos + 1;
+    stream.end = end;
+    stream.bitPos = CHAR_BIT - 1;
+    stream.eof = false;
+
+    if (frameType->marker == 'I' || frameType->marker == 'P') {
+        parseFrame(log, &stream, frameType->marker, frame, NULL, NULL, 0);
+    } else {
+        frameType->parse(log, &stream, raw);
+    }
+
+    if (stream.eof || stream.pos - (pos + 1) > log->private->maxFrameLength) {
+        return NULL;
+    }
+
+    // A log end event moves the end of the stream up to meet it
+    if (stream.end != end || stream.pos == end) {
+        return end;
+    }
+
+    return getFrameType((uint8_t) *stream.pos) ? stream.pos : NULL;
+}
+
+/**
+ * Check that the I-frame found at `pos` (and decoded into `intraframe`) is genuine by walking the frames which follow
+ * it. The next I-frame should carry on from this one, or the log should end cleanly.
+ */
+static bool flightLogVerifyIntraframe(flightLog_t *log, const char *pos, const char *end, const int64_t *intraframe, bool raw)
+{
+    int64_t *frame = flightLogAllocateMainFrame(log);
+    int maxFrames = 4 * log->frameIntervalI + 64;
+    bool verified = false;
+
+    for (int i = 0; i < maxFrames; i++) {
+        pos = flightLogSkipFrame(log, pos, end, frame, raw);
+
+        if (!pos) {
+            break;
+        }
+
+        if (pos == end) {
+            verified = true;
+            break;
+        }
+
+        if (*pos == 'I') {
+            uint32_t iterationJump, timeJump;
+
+            if (!flightLogSkipFrame(log, pos, end, frame, raw)) {
+                break;
+            }
+
+            iterationJump = (uint32_t) (frame[FLIGHT_LOG_FIELD_INDEX_ITERATION] - intraframe[FLIGHT_LOG_FIELD_INDEX_ITERATION]);
+            timeJump = (uint32_t) (frame[FLIGHT_LOG_FIELD_INDEX_TIME] - intraframe[FLIGHT_LOG_FIELD_INDEX_TIME]);
+
+            verified = iterationJump > 0 && iterationJump < MAXIMUM_ITERATION_JUMP_BETWEEN_FRAMES
+                && timeJump > 0 && timeJump < MAXIMUM_TIME_JUMP_BETWEEN_FRAMES;
+            break;
+        }
+    }
+
+    free(frame);
+
+    return verified;
+}
+
+/**
+ * Find the first genuine I-frame at or after `pos` and decode it into `frame`, or return NULL if there isn't one.
+ */
+static const char* flightLogFindVerifiedIntraframe(flightLog_t *log, const char *pos, const char *end, int64_t *frame, bool raw)
+{
+    while ((pos = flightLogFindIntraframe(log, pos, end, frame)) != NULL) {
+        if (flightLogVerifyIntraframe(log, pos, end, frame, raw)) {
+            return pos;
+        }
+
+        pos++;
+    }
+
+    return NULL;
+}
+
+/**
+ * Recover the 64-bit time of a frame which we decoded without knowing the number of timestamp rollovers before it,
+ * given the time of the first I-frame in the log. This assumes that it's less than 2^32 microseconds (71 minutes) later.
+ */
+static int64_t flightLogScannedFrameTime(int64_t baseTime, const int64_t *frame)
+{
+    return baseTime + (uint32_t) ((uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_TIME] - (uint32_t) baseTime);
+}
+
+static void flightLogSetScannedSeekPoint(flightLog_t *log, flightLogSeekPoint_t *point, const char *pos, int64_t baseTime, const int64_t *frame)
+{
+    point->offset = streamOffset(log->private->stream, pos);
+    point->iteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+    point->time = flightLogScannedFrameTime(baseTime, frame);
+    point->gpsHomeOffset = -1;
+    point->slowOffset = -1;
+}
+
+/**
+ * Starting from the genuine I-frame at `first` (which must be at or before `time`), find the last I-frame in the log
+ * whose time is at or before `time` and store it in `before`. If there's an I-frame after that one, store it in `after`
+ * and return true.
+ */
+static bool flightLogScanForTime(flightLog_t *log, const char *first, const char *end, int64_t baseTime, int64_t time,
+    flightLogSeekPoint_t *before, flightLogSeekPoint_t *after, bool raw)
+{
+    int64_t *frame = flightLogAllocateMainFrame(log);
+    const char *low = first, *high = end, *found;
+
+    /*
+     * The I-frame at `low` is at or before the time, and all the I-frames which begin at or after `high` are after it.
+     */
+    while (high - low > FLIGHT_LOG_SEEK_SCAN_LENGTH) {
+        const char *mid = low + (high - low) / 2;
+
+        found = flightLogFindVerifiedIntraframe(log, mid, end, frame, raw);
+
+        if (!found || found >= high || flightLogScannedFrameTime(baseTime, frame) > time) {
+            high = mid;
+        } else {
+            low = found;
+        }
+    }
+
+    // Now walk forward through the I-frames that are left
+    while ((found = flightLogFindVerifiedIntraframe(log, low + 1, end, frame, raw)) != NULL
+            && flightLogScannedFrameTime(baseTime, frame) <= time) {
+        low = found;
+    }
+
+    if (found) {
+        flightLogSetScannedSeekPoint(log, after, found, baseTime, frame);
+    }
+
+    flightLogSkipFrame(log, low, end, frame, raw);
+    flightLogSetScannedSeekPoint(log, before, low, baseTime, frame);
+
+    free(frame);
+
+    return found != NULL;
+}
+
+/**
+ * Find the last GPS home and slow frames before the seek point by walking the frames before it, beginning with the
+ * ones just before it and working backwards to `dataStart` (where the log's first data frame begins).
+ */
+static void flightLogScanForState(flightLog_t *log, const char *dataStart, const char *end, flightLogSeekPoint_t *point, bool raw)
+{
+    const char *data = log->private->stream->data;
+    bool needHome = log->frameDefs['H'].fieldCount > 0, needSlow = log->frameDefs['S'].fieldCount > 0;
+    const char *walkEnd = data + point->offset;
+    int64_t searchLength = FLIGHT_LOG_SEEK_STATE_SCAN_LENGTH;
+    int64_t *frame = flightLogAllocateMainFrame(log);
+
+    // All the frames that begin before walkEnd are still to be walked
+    while ((needHome || needSlow) && walkEnd > dataStart) {
+        const char *walkStart, *pos, *lastHome = NULL, *lastSlow = NULL;
+
+        if (walkEnd - dataStart <= searchLength) {
+            walkStart = dataStart;
+        } else {
+            walkStart = flightLogFindVerifiedIntraframe(log, walkEnd - searchLength, end, frame, raw);
+
+            if (!walkStart || walkStart >= walkEnd) {
+                // There's no I-frame that close to walk from, so look further back
+                searchLength *= 2;
+                continue;
+            }
+        }
+
+        for (pos = walkStart; pos && pos < walkEnd; ) {
+            const char *next = flightLogSkipFrame(log, pos, end, frame, raw);
+
+            if (!next) {
+                // Corrupt data, so pick the walk up again at the next I-frame
+                pos = flightLogFindVerifiedIntraframe(log, pos + 1, walkEnd, frame, raw);
+                continue;
+            }
+
+            if (*pos == 'H') {
+                lastHome = pos;
+            } else if (*pos == 'S') {
+                lastSlow = pos;
+            }
+
+            pos = next;
+        }
+
+        if (needHome && lastHome) {
+            point->gpsHomeOffset = lastHome - data;
+            needHome = false;
+        }
+
+        if (needSlow && lastSlow) {
+            point->slowOffset = lastSlow - data;
+            needSlow = false;
+        }
+
+        walkEnd = walkStart;
+    }
+
+    free(frame);
+}
+
+/**
+ * Find where the decode of the window of times should begin and end, then seek to the beginning. If we can't, the
+ * decode will begin at the start of the log and the window will be applied as the frames are delivered.
+ *
+ * A file that's mapped a window at a time can only be searched with the index, since the scan needs the whole log.
+ */
+static void flightLogSeekToWindow(flightLog_t *log, int logIndex, bool raw)
+{
+    flightLogPrivate_t *private = log->private;
+    flightLogWindow_t *window = private->window;
+    mmapStream_t *stream = private->stream;
+    const char *dataStart = stream->pos, *end = stream->end;
+    int64_t dataStartOffset = streamOffset(stream, dataStart), logEnd = log->logBegin[logIndex + 1];
+    flightLogSeekPoint_t start, stop;
+    bool haveStart = false, haveStop = false;
+    bool useIndex = private->index && private->index->logs[logIndex].complete;
+
+    if (!flightLogIntraframesAreIndependent(log, raw)) {
+        return;
+    }
+
+    if (useIndex) {
+        const flightLogIndexedLog_t *indexedLog = &private->index->logs[logIndex];
+        flightLogSeekPoint_t firstPoint;
+
+        if (indexedLog->intraframeCount == 0) {
+            return;
+        }
+
+        firstPoint.offset = indexedLog->intraframes[0].offset;
+        firstPoint.iteration = indexedLog->intraframes[0].iteration;
+        firstPoint.time = indexedLog->intraframes[0].time;
+
+        window->base = firstPoint.time;
+
+        if (window->start > 0) {
+            haveStart = flightLogIndexFindTime(private->index, logIndex, window->base + window->start, &start);
+        }
+
+        if (window->end != -1) {
+            haveStop = flightLogIndexFindTimeAfter(private->index, logIndex, window->base + window->end, &stop);
+        }
+
+        // If the index doesn't describe this log after all, find the window with a scan instead
+        if (!flightLogIntraframeIsAt(log, &firstPoint, logEnd) || (haveStart && !flightLogIntraframeIsAt(log, &start, logEnd))
+                || (haveStop && !flightLogIntraframeIsAt(log, &stop, logEnd))) {
+            window->base = -1;
+            haveStart = haveStop = false;
+            useIndex = false;
+        }
+
+        // Checking the seek points moved the stream
+        streamSeek(stream, dataStartOffset);
+    }
+
+    if (!useIndex) {
+        int64_t *frame;
+        const char *first;
+        flightLogSeekPoint_t before;
+
+        if (stream->windowed) {
+            return;
+        }
+
+        frame = flightLogAllocateMainFrame(log);
+        first = flightLogFindVerifiedIntraframe(log, dataStart, end, frame, raw);
+
+        if (first) {
+            window->base = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+        }
+
+        free(frame);
+
+        if (!first) {
+            return;
+        }
+
+        if (window->start > 0) {
+            flightLogScanForTime(log, first, end, window->base, window->base + window->start, &start, &stop, raw);
+            flightLogScanForState(log, dataStart, end, &start, raw);
+
+            haveStart = true;
+            first = stream->data + start.offset;
+        }
+
+        if (window->end != -1) {
+            haveStop = flightLogScanForTime(log, first, end, window->base, window->base + window->end, &before, &stop, raw);
+        }
+    }
+
+    // Stop decoding when we reach the first I-frame after the window
+    haveStop = haveStop && stop.offset > dataStartOffset && stop.offset < logEnd && streamSeek(stream, stop.offset) && *stream->pos == 'I';
+
+    streamSeek(stream, dataStartOffset);
+
+    if (haveStart && flightLogCanSeekTo(log, logIndex, &start, raw)) {
+        flightLogSeek(log, &start, raw);
+    }
+
+    if (haveStop) {
+        streamSetEnd(stream, stop.offset);
+    }
+}
+
+/**
+ * Deliver the frames which lie in the window of times (along with all of the GPS home and slow frames) to the caller.
+ */
+static void flightLogWindowFrame(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+    flightLogPrivate_t *private = log->private;
+    flightLogWindow_t *window = private->window;
+
+    // Raw P-frames only carry time deltas, so we can only go by the I-frames then
+    if (frameValid && frame && (frameType == 'I' || (frameType == 'P' && !window->raw))) {
+        int64_t time = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+
+        if (window->base == -1) {
+            // We're decoding from the beginning of the log, so this is the first main frame
+            window->base = time;
+        }
+
+        window->inside = time >= window->base + window->start && (window->end == -1 || time <= window->base + window->end);
+    }
+
+    if (private->callerOnFrameReady && (window->inside || frameType == 'H' || frameType == 'S')) {
+        private->callerOnFrameReady(log, frameValid, frame, frameType, fieldCount, frameOffset, frameSize);
+    }
+}
+
+static void flightLogWindowEvent(flightLog_t *log, flightLogEvent_t *event)
+{
+    if (log->private->window->inside) {
+        log->private->callerOnEvent(log, event);
+    }
+}
+
+/**
+ * Deliver the main frames gathered so far to the caller's onFrameBlock handler.
+ */
+static void flightLogFlushFrameBlock(flightLog_t *log)
+{
+    flightLogPrivate_t *private = log->private;
+
+    if (private->frameBlock.frameCount > 0) {
+        private->onFrameBlock(log, &private->frameBlock);
+        private->frameBlock.frameCount = 0;
+    }
+}
+
+/**
+ * Add main frames to the block being gathered for the caller's onFrameBlock handler, and pass other frames on to their
+ * usual handler (after the main frames that came before them).
+ */
+static void flightLogBlockFrame(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+    flightLogPrivate_t *private = log->private;
+    flightLogFrameBlock_t *block = &private->frameBlock;
+    int64_t *value;
+    int frameIndex, i;
+
+    if (frameType != 'I' && frameType != 'P') {
+        flightLogFlushFrameBlock(log);
+
+        if (private->blockOnFrameReady) {
+            private->blockOnFrameReady(log, frameValid, frame, frameType, fieldCount, frameOffset, frameSize);
+        }
+        return;
+    }
+
+    // A corrupt frame has no values to store, so just mark the gap it leaves before the next frame
+    if (!frame) {
+        private->frameBlockGapPending = true;
+        return;
+    }
+
+    frameIndex = block->frameCount;
+    value = block->values + frameIndex;
+
+    for (i = 0; i < fieldCount; i++, value += block->fieldStride) {
+        *value = frame[i];
+    }
+    for (; i < block->fieldCount; i++, value += block->fieldStride) {
+        *value = 0;
+    }
+
+    block->time[frameIndex] = frame[FLIGHT_LOG_FIELD_INDEX_TIME];
+    block->frameType[frameIndex] = frameType;
+    block->flags[frameIndex] = (frameValid ? FLIGHT_LOG_FRAME_BLOCK_VALID : 0) | (private->frameBlockGapPending ? FLIGHT_LOG_FRAME_BLOCK_GAP : 0);
+    block->frameOffset[frameIndex] = frameOffset;
+    block->frameSize[frameIndex] = frameSize;
+
+    private->frameBlockGapPending = false;
+
+    if (++block->frameCount == block->fieldStride) {
+        flightLogFlushFrameBlock(log);
+    }
+}
+
+static void flightLogBlockEvent(flightLog_t *log, flightLogEvent_t *event)
+{
+    flightLogFlushFrameBlock(log);
+
+    log->private->blockOnEvent(log, event);
+}
+
+/**
+ * Have main frames delivered to the given handler during decodes in blocks of up to `blockLength` frames (e.g.
+ * FLIGHT_LOG_FRAME_BLOCK_LENGTH), stored one field at a time so that they can be processed a column at a time, instead
+ * of one by one to the decode's onFrameReady handler. Other frame types still go to onFrameReady. A block is delivered
+ * early whenever another frame type or an event arrives, so the caller sees everything in the order it was logged.
+ * Pass NULL to stop.
+ */
+void flightLogSetFrameBlockHandler(flightLog_t *log, int blockLength, FlightLogFrameBlockReady onFrameBlock)
+{
+    log->private->onFrameBlock = onFrameBlock;
+    log->private->frameBlockLength = blockLength > 0 ? blockLength : FLIGHT_LOG_FRAME_BLOCK_LENGTH;
+}
+
+static bool flightLogParseLog(flightLog_t *log, int logIndex, const flightLogSeekPoint_t *start, flightLogWindow_t *window, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads);
+
+bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw)
+{
+    return flightLogParseFrom(log, logIndex, NULL, onMetadataReady, onFrameReady, onEvent, raw, 1);
+}
+
+bool flightLogParseParallel(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads)
+{
+    return flightLogParseFrom(log, logIndex, NULL, onMetadataReady, onFrameReady, onEvent, raw, threads);
+}
+
+/**
+ * Decode the log, beginning at the given seek point (e.g. from flightLogIndexFindTime()) rather than at the start of
+ * the log if `start` is non-NULL. The log's headers are always parsed.
+ *
+ * If the seek point can't be used for this log, the decode begins at the start of the log instead, so the caller should
+ * be prepared to skip frames which come before the point it was looking for.
+ */
+bool flightLogParseFrom(flightLog_t *log, int logIndex, const flightLogSeekPoint_t *start, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads)
+{
+    return flightLogParseLog(log, logIndex, start, NULL, onMetadataReady, onFrameReady, onEvent, raw, threads);
+}
+
+/**
+ * Decode the log, but only deliver the main frames with times between `startTime` and `endTime` (in microseconds from
+ * the first main frame of the log, use -1 for `endTime` to carry on to the end of the log), and the GPS frames and
+ * events in between them. GPS home and slow frames are always delivered so that the caller has their state when the
+ * window begins.
+ *
+ * Decoding begins at the last I-frame before the window and stops at the first I-frame after it, found using the
+ * attached index if it covers the log, or by a scan of the log's bytes otherwise.
+ */
+bool flightLogParseTimeRange(flightLog_t *log, int logIndex, int64_t startTime, int64_t endTime, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads)
+{
+    flightLogWindow_t window;
+
+    window.start = startTime;
+    window.end = endTime;
+    window.base = -1;
+    window.inside = false;
+    window.raw = raw;
+
+    return flightLogParseLog(log, logIndex, NULL, &window, onMetadataReady, onFrameReady, onEvent, raw, threads);
+}
+
+static bool flightLogParseLog(flightLog_t *log, int logIndex, const flightLogSeekPoint_t *start, flightLogWindow_t *window, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads)
+{
+    ParserState parserState = PARSER_STATE_HEADER;
+    const flightLogFrameType_t *frameType = 0;
+    int64_t sourceStart;
+
+    flightLogPrivate_t *private = log->private;
+
+    if (logIndex < 0 || logIndex >= log->logCount)
+        return false;
+
+    //Set parsing ranges up for the log the caller selected (a log read from a source carries on from where it is)
+    if (!private->stream->source && !streamSetRange(private->stream, log->logBegin[logIndex], log->logBegin[logIndex + 1]))
+        return false;
+
+    //Reset any parsed information from previous parses
+    flightLogResetStatistics(&log->stats);
+
+    for (int frameC = 0; frameC < 256; frameC++) {
+        frameDefDestroyFields(&log->frameDefs[frameC]);
+    }
+
+    flightLogFreeFramePrograms(log);
+
+    private->gpsHomeIsValid = false;
+    flightLogInvalidateStream(log);
+
+    resetSysConfigToDefaults(&log->sysConfig);
+
+    log->frameIntervalI = 32;
+    log->frameIntervalPNum = 1;
+    log->frameIntervalPDenom = 1;
+
+    private->lastEvent.event = -1;
+
+    clearFieldIdents(log);
+
+    private->timeRolloverAccumulator = 0;
+    private->lastSkippedFrames = 0;
+    private->lastMainFrameIteration = (uint32_t) -1;
+    private->lastMainFrameTime = -1;
+
+    if (private->onFrameBlock) {
+        private->blockOnFrameReady = onFrameReady;
+        private->blockOnEvent = onEvent;
+        onFrameReady = flightLogBlockFrame;
+        onEvent = onEvent ? flightLogBlockEvent : NULL;
+    }
+
+    private->onMetadataReady = onMetadataReady;
+    private->onFrameReady = onFrameReady;
+    private->onEvent = onEvent;
+
+    private->callerOnFrameReady = onFrameReady;
+    private->callerOnEvent = onEvent;
+    private->indexingLog = -1;
+    private->window = window;
+
+    if (window) {
+        private->onFrameReady = flightLogWindowFrame;
+        private->onEvent = onEvent ? flightLogWindowEvent : NULL;
+    } else if (private->index && !start && !raw && !private->index->logs[logIndex].complete) {
+        // Record a complete decode of the log since the index doesn't have one yet
+        private->indexingLog = logIndex;
+        private->onFrameReady = flightLogIndexFrame;
+
+        flightLogIndexBeginLog(private->index, logIndex);
+    }
+
+    private->stream->eof = false;
+
+    sourceStart = streamOffset(private->stream, private->stream->pos);
+
+    while (1) {
+        char command;
+
+        if (private->stream->windowed) {
+            streamFillWindow(private->stream);
+
+            // The flight controller begins a new log each time it is rearmed, which is the end of this one
+            if (private->stream->source && parserState != PARSER_STATE_HEADER && streamIsAtLogStart(private->stream)) {
+                fprintf(log->messages, "Data file contained no events\n");
+                break;
+            }
+        }
+
+        command = streamPeekChar(private->stream);
+        
+            if (command == 'H' && parserState == PARSER_STATE_HEADER) {
+                parseHeaderLine(log, private->stream, &parserState);
+            } else if (command == EOF && private->stream->pos >= private->stream->end) {
+                fprintf(log->messages, "Data file contained no events\n");
+                break;
+            } else if (parserState == PARSER_STATE_HEADER) {
+                // Skip whatever arrived before the headers (e.g. the end of a log that was already being sent)
+                streamReadByte(private->stream);
+            }
+            if (parserState == PARSER_STATE_TRANSITION) {
+                frameType = getFrameType(command);
+
+                if (frameType) {
+
+                    if (log->frameDefs['I'].fieldCount == 0) {
+                        fprintf(log->messages, "Data file is missing field name definitions\n");
+
+                        private->onFrameReady = onFrameReady;
+                        private->onEvent = onEvent;
+                        private->window = NULL;
+                        private->indexingLog = -1;
+
+                        return false;
+                    }
+
+                    /* Home coord predictors appear in pairs (lat/lon), but the predictor ID is the same for both. It's easier to
+                        * apply the right predictor during parsing if we rewrite the predictor ID for the second half of the pair here:
+                        */
+                    for (int i = 1; i < log->frameDefs['G'].fieldCount; i++) {
+                        if (log->frameDefs['G'].predictor[i - 1] == FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD &&
+                            log->frameDefs['G'].predictor[i] == FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD) {
+                            log->frameDefs['G'].predictor[i] = FLIGHT_LOG_FIELD_PREDICTOR_HOME_COORD_1;
+                        }
+                    }
+
+                    flightLogCompileFramePrograms(log, raw);
+                    flightLogAllocateFrameBuffers(log);
+
+                    parserState = PARSER_STATE_DATA;
+                    frameType = NULL;
+                    private->dataBegin = streamOffset(private->stream, private->stream->pos);
+
+                    if (onMetadataReady) {
+                        onMetadataReady(log);
+                    }
+
+                    if (start && flightLogCanSeekTo(log, logIndex, start, raw)) {
+                        flightLogSeek(log, start, raw);
+                    } else if (window) {
+                        flightLogSeekToWindow(log, logIndex, raw);
+                    }
+
+                    if (threads > 1 && flightLogCanParseInParallel(log, raw)) {
+                        flightLogParseDataInParallel(log, threads, raw);
+
+                        fprintf(log->messages, "Data file contained no events\n");
+                        break;
+                    }
+                } // else skip garbage which apparently precedes the first data frame
+            } else if (parserState == PARSER_STATE_DATA) {
+                flightLogParseDataFrame(log, command, raw);
+            }
+
+    }
+
+    // A log that ended before its data began still needs (empty) statistics for the fields its headers defined
+    if (parserState != PARSER_STATE_DATA) {
+        flightLogAllocateFrameBuffers(log);
+    }
+
+    if (private->stream->source) {
+        log->stats.totalBytes = streamOffset(private->stream, private->stream->pos) - sourceStart;
+    } else {
+        log->stats.totalBytes = streamOffset(private->stream, private->stream->end) - log->logBegin[logIndex];
+    }
+
+    if (private->onFrameBlock) {
+        flightLogFlushFrameBlock(log);
+    }
+
+    if (private->indexingLog != -1) {
+        flightLogIndexCompleteLog(private->index, logIndex);
+        private->indexingLog = -1;
+    }
+
+    private->onFrameReady = onFrameReady;
+    private->onEvent = onEvent;
+    private->window = NULL;
+
+    return true;
 }
 
 void flightLogDestroy(flightLog_t *log)
 {
     streamDestroy(log->private->stream);
 
+    free(log->logBegin);
+
     for (int i = 0; i < 256; i++) {
-        free(log->frameDefs[i].namesLine);
+        frameDefDestroyFields(&log->frameDefs[i]);
     }
 
+    flightLogFreeFramePrograms(log);
+
+    free(log->stats.field);
+    free(log->private->frameBuffers);
+    free(log->private->headerLine);
+    flightLogFreeFrameBlock(&log->private->frameBlock);
     free(log->private);
     free(log);
 }
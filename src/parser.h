@@ -9,9 +9,6 @@
 
 #include "blackbox_fielddefs.h"
 
-#define FLIGHT_LOG_MAX_LOGS_IN_FILE 31
-#define FLIGHT_LOG_MAX_FIELDS 128
-
 #define FLIGHT_LOG_FIELD_INDEX_ITERATION 0
 #define FLIGHT_LOG_FIELD_INDEX_TIME 1
 
@@ -26,7 +23,7 @@ typedef enum FirmwareType {
 } FirmwareType;
 
 typedef struct flightLogFrameStatistics_t {
-    uint32_t bytes;
+    uint64_t bytes;
     // Frames decoded to the right length and had reasonable data in them:
     uint32_t validCount;
 
@@ -36,6 +33,7 @@ typedef struct flightLogFrameStatistics_t {
     // Frames didn't decode to the right length at all
     uint32_t corruptCount;
 
+    // How many frames there were of each length (the last element also counts all the frames that were longer)
     uint32_t sizeCount[FLIGHT_LOG_MAX_FRAME_LENGTH + 1];
 } flightLogFrameStatistics_t;
 
@@ -44,7 +42,7 @@ typedef struct flightLogFieldStatistics_t {
 } flightLogFieldStatistics_t;
 
 typedef struct flightLogStatistics_t {
-    uint32_t totalBytes;
+    uint64_t totalBytes;
 
     // Number of frames that failed to decode:
     uint32_t totalCorruptFrames;
@@ -52,8 +50,17 @@ typedef struct flightLogStatistics_t {
     //If our sampling rate is less than 1, we won't log every loop iteration, and that is accounted for here:
     uint32_t intentionallyAbsentIterations;
 
+    /*
+     * Number of times we lost track of where the frames began and searched ahead for an I-frame to carry on from, the
+     * bytes we skipped to reach them, and the candidate I-frames we rejected along the way:
+     */
+    uint32_t resyncCount;
+    uint64_t resyncSkippedBytes;
+    uint32_t resyncRejectedCandidates;
+
+    // For each of the fields of the main frames (the parser owns this memory):
     bool haveFieldStats;
-    flightLogFieldStatistics_t field[FLIGHT_LOG_MAX_FIELDS];
+    flightLogFieldStatistics_t *field;
     flightLogFrameStatistics_t frame[256];
 } flightLogStatistics_t;
 
@@ -133,12 +140,15 @@ typedef struct flightLogFrameDef_t {
 
     int fieldCount;
 
-    char *fieldName[FLIGHT_LOG_MAX_FIELDS];
-    
-    int fieldSigned[FLIGHT_LOG_MAX_FIELDS];
-    int fieldWidth[FLIGHT_LOG_MAX_FIELDS];
-    int predictor[FLIGHT_LOG_MAX_FIELDS];
-    int encoding[FLIGHT_LOG_MAX_FIELDS];
+    // These have room for fieldCapacity fields (at least fieldCount), and the parser owns their memory too
+    char **fieldName;
+
+    int *fieldSigned;
+    int *fieldWidth;
+    int *predictor;
+    int *encoding;
+
+    int fieldCapacity;
 } flightLogFrameDef_t;
 
 struct flightLogPrivate_t;
@@ -151,8 +161,11 @@ typedef struct flightLog_t {
 
     flightLogSysConfig_t sysConfig;
 
-    //Information about log sections:
-    const char *logBegin[FLIGHT_LOG_MAX_LOGS_IN_FILE + 1];
+    /*
+     * Information about log sections: the offset where each log begins, with an extra element on the end with the end of
+     * the last log (which for a log read from a source is only known once the log after it has been found).
+     */
+    int64_t *logBegin;
     int logCount;
 
     unsigned int frameIntervalI;
@@ -163,21 +176,103 @@ typedef struct flightLog_t {
     gpsHFieldIndexes_t gpsHomeFieldIndexes;
     slowFieldIndexes_t slowFieldIndexes;
 
+    // Where the parser prints warnings about the log it's decoding, stderr by default
+    FILE *messages;
+
+    // For the application's own use (e.g. to find its decoding state from inside the callbacks), NULL by default
+    void *userData;
+
     struct flightLogPrivate_t *private;
 } flightLog_t;
 
 
 
+/*
+ * A place where decoding can begin: an I-frame that the parser accepted, along with the most recent GPS home and slow
+ * frames before it, which are decoded first to restore their state. Offsets are those of the frames' marker bytes from
+ * the start of the file, or -1 if there was no such frame.
+ */
+typedef struct flightLogSeekPoint_t {
+    int64_t offset;
+    uint32_t iteration;
+    int64_t time;
+
+    int64_t gpsHomeOffset, slowOffset;
+} flightLogSeekPoint_t;
+
+/*
+ * The span of main frame times that a decode should deliver (see flightLogParseTimeRange()).
+ */
+typedef struct flightLogWindow_t {
+    // Microseconds from the beginning of the log, end is -1 for the end of the log
+    int64_t start, end;
+
+    // The time of the first main frame in the log, or -1 if that isn't known yet
+    int64_t base;
+
+    bool inside, raw;
+} flightLogWindow_t;
+
 typedef void (*FlightLogMetadataReady)(flightLog_t *log);
-typedef void (*FlightLogFrameReady)(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int frameOffset, int frameSize);
+typedef void (*FlightLogFrameReady)(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize);
 typedef void (*FlightLogEventReady)(flightLog_t *log, flightLogEvent_t *event);
 
+// Main frames are delivered in blocks of this many frames by default (see flightLogSetFrameBlockHandler())
+#define FLIGHT_LOG_FRAME_BLOCK_LENGTH 4096
+
+// The frame was decoded from valid history, so its values can be trusted
+#define FLIGHT_LOG_FRAME_BLOCK_VALID 0x01
+// Frames were lost (corrupt) between the previous frame and this one
+#define FLIGHT_LOG_FRAME_BLOCK_GAP   0x02
+
+/*
+ * A run of consecutive main frames, stored one field at a time so that each field's values are contiguous. The value of
+ * field f for frame n is values[f * fieldStride + n].
+ */
+typedef struct flightLogFrameBlock_t {
+    int frameCount, fieldCount;
+
+    int64_t *values;
+    int fieldStride;
+
+    // For each frame: its time in microseconds, its frame type ('I' or 'P') and its FLIGHT_LOG_FRAME_BLOCK_* flags
+    int64_t *time;
+    uint8_t *frameType;
+    uint8_t *flags;
+
+    // Where each frame's data begins in the log file, and its length
+    int64_t *frameOffset;
+    int *frameSize;
+} flightLogFrameBlock_t;
+
+typedef void (*FlightLogFrameBlockReady)(flightLog_t *log, const flightLogFrameBlock_t *block);
+
+struct flightLogFrameProgram_t;
+
 typedef struct flightLogPrivate_t
 {
     int dataVersion;
 
-    // Blackbox state:
-    int64_t blackboxHistoryRing[3][FLIGHT_LOG_MAX_FIELDS];
+    // The decode program for each frame type, compiled from its definition once the headers have been read (NULL if undefined)
+    struct flightLogFrameProgram_t *frameProgram[256];
+
+    /*
+     * Blackbox state. The frame buffers below all point into frameBuffers, which is sized to fit the frames that the
+     * log's headers define once they've been read. Each buffer leaves room past the end of its frame's fields for the
+     * values that a tag group can decode beyond the end of the definition.
+     */
+    int64_t *frameBuffers;
+    int frameBuffersLength;
+
+    /*
+     * The longest a frame can be before we decide that it's corrupt. That's FLIGHT_LOG_MAX_FRAME_LENGTH, unless the log
+     * has so many fields that a genuine frame could be longer.
+     */
+    int maxFrameLength;
+
+    // Three main frames of mainFrameStride values each:
+    int64_t *blackboxHistoryRing;
+    int mainFrameStride;
 
     /* Points into blackboxHistoryRing to give us a circular buffer.
      *
@@ -190,13 +285,14 @@ typedef struct flightLogPrivate_t
     // When 32-bit time values roll over to zero, we add 2^32 to this accumulator so it can be added to the time:
     int64_t timeRolloverAccumulator;
 
-    int64_t gpsHomeHistory[2][FLIGHT_LOG_MAX_FIELDS]; // 0 - space to decode new frames into, 1 - previous frame
+    int64_t *gpsHomeHistory[2]; // 0 - space to decode new frames into, 1 - previous frame
+    int gpsHomeFrameStride;
     bool gpsHomeIsValid;
 
     //Because these events don't depend on previous events, we don't keep copies of the old state, just the current one:
     flightLogEvent_t lastEvent;
-    int64_t lastGPS[FLIGHT_LOG_MAX_FIELDS];
-    int64_t lastSlow[FLIGHT_LOG_MAX_FIELDS];
+    int64_t *lastGPS;
+    int64_t *lastSlow;
 
     // How many intentionally un-logged frames did we skip over before we decoded the current frame?
     uint32_t lastSkippedFrames;
@@ -205,15 +301,44 @@ typedef struct flightLogPrivate_t
     uint32_t lastMainFrameIteration;
     int64_t lastMainFrameTime;
 
+    // Where the current log's frames begin in the stream, so a search for the log after it can't find its own start
+    int64_t dataBegin;
+
     // Event handlers:
     FlightLogMetadataReady onMetadataReady;
     FlightLogFrameReady onFrameReady;
     FlightLogEventReady onEvent;
 
+    // The index that seek points are recorded into during a complete decode of a log (see flightLogAttachIndex())
+    struct flightLogIndex_t *index;
+    int indexingLog; // -1 when not recording
+
+    // The window of times to deliver frames from, or NULL to deliver everything
+    flightLogWindow_t *window;
+
+    // The caller's callbacks, when the ones above are intercepting them for the index or the window
+    FlightLogFrameReady callerOnFrameReady;
+    FlightLogEventReady callerOnEvent;
+
+    // Space to read the log's header lines into, which grows to fit the longest line
+    char *headerLine;
+    size_t headerLineCapacity;
+
+    // The handler for blocks of main frames, the block being filled, and the handlers for everything else
+    FlightLogFrameBlockReady onFrameBlock;
+    flightLogFrameBlock_t frameBlock;
+    int frameBlockLength;
+    bool frameBlockGapPending;
+    FlightLogFrameReady blockOnFrameReady;
+    FlightLogEventReady blockOnEvent;
+
     mmapStream_t *stream;
 } flightLogPrivate_t;
 
 flightLog_t* flightLogCreate(int fd);
+flightLog_t* flightLogCreateWithThreads(int fd, int threads);
+flightLog_t* flightLogCreateFromSource(streamSource_t *source);
+bool flightLogBeginNextLog(flightLog_t *log);
 
 int flightLogEstimateNumCells(flightLog_t *log);
 
@@ -226,6 +351,11 @@ void flightlogFlightStateToString(uint32_t flightState, char *dest, int destLen)
 void flightlogFailsafePhaseToString(uint8_t failsafePhase, char *dest, int destLen);
 
 bool flightLogParse(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw);
+bool flightLogParseParallel(flightLog_t *log, int logIndex, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads);
+bool flightLogParseFrom(flightLog_t *log, int logIndex, const flightLogSeekPoint_t *start, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads);
+bool flightLogParseTimeRange(flightLog_t *log, int logIndex, int64_t startTime, int64_t endTime, FlightLogMetadataReady onMetadataReady, FlightLogFrameReady onFrameReady, FlightLogEventReady onEvent, bool raw, int threads);
+void flightLogAttachIndex(flightLog_t *log, struct flightLogIndex_t *index);
+void flightLogSetFrameBlockHandler(flightLog_t *log, int blockLength, FlightLogFrameBlockReady onFrameBlock);
 void flightLogDestroy(flightLog_t *log);
 
 #endif
@@ -1,10 +1,12 @@
 #include "platform.h"
 
+#include <stdlib.h>
+
 #ifdef WIN32
     #include <direct.h>
+    #include <limits.h>
 #else
     #include <sys/stat.h>
-    #include <stdlib.h>
     #include <stdint.h>
 #endif
 
@@ -60,6 +62,125 @@ void thread_create_detached(threadRoutine_t threadFunc, void *data)
 #endif
 }
 
+struct workerPool_t {
+    workerRoutine_t routine;
+    int numWorkers;
+
+    // Jobs waiting for a worker to pick them up. A NULL job asks the worker that receives it to exit.
+    void **queue;
+    int queueCapacity, queueHead, queueTail;
+
+    // queueLock is a binary semaphore which protects the queue indexes
+    semaphore_t queueLock, queueSpace, queueJobs, workerExited;
+};
+
+typedef struct workerPoolThread_t {
+    workerPool_t *pool;
+    void *workerData;
+} workerPoolThread_t;
+
+static void* workerPoolThreadRun(void *data)
+{
+    workerPoolThread_t *thread = (workerPoolThread_t *) data;
+    workerPool_t *pool = thread->pool;
+    void *job;
+
+    do {
+        semaphore_wait(&pool->queueJobs);
+
+        semaphore_wait(&pool->queueLock);
+        job = pool->queue[pool->queueHead];
+        pool->queueHead = (pool->queueHead + 1) % pool->queueCapacity;
+        semaphore_signal(&pool->queueLock);
+
+        semaphore_signal(&pool->queueSpace);
+
+        if (job) {
+            pool->routine(thread->workerData, job);
+        }
+    } while (job);
+
+    free(thread);
+
+    semaphore_signal(&pool->workerExited);
+
+    return 0;
+}
+
+/**
+ * Start a pool of numWorkers threads which stay alive to run jobs until the pool is destroyed. workerData (which may
+ * be NULL) supplies a pointer for each worker to be passed to every job that worker runs, for example to hold buffers
+ * that the worker reuses from one job to the next.
+ */
+workerPool_t* workerpool_create(int numWorkers, workerRoutine_t routine, void **workerData)
+{
+    workerPool_t *pool = malloc(sizeof(*pool));
+
+    pool->routine = routine;
+    pool->numWorkers = numWorkers;
+
+    pool->queueCapacity = numWorkers;
+    pool->queue = malloc(pool->queueCapacity * sizeof(*pool->queue));
+    pool->queueHead = 0;
+    pool->queueTail = 0;
+
+    semaphore_create(&pool->queueLock, 1);
+    semaphore_create(&pool->queueSpace, pool->queueCapacity);
+    semaphore_create(&pool->queueJobs, 0);
+    semaphore_create(&pool->workerExited, 0);
+
+    for (int i = 0; i < numWorkers; i++) {
+        workerPoolThread_t *thread = malloc(sizeof(*thread));
+
+        thread->pool = pool;
+        thread->workerData = workerData ? workerData[i] : NULL;
+
+        thread_create_detached(workerPoolThreadRun, thread);
+    }
+
+    return pool;
+}
+
+/**
+ * Queue up a job for the next free worker. If the queue is full this waits for a worker to take a job from it.
+ */
+void workerpool_submit(workerPool_t *pool, void *job)
+{
+    semaphore_wait(&pool->queueSpace);
+
+    semaphore_wait(&pool->queueLock);
+    pool->queue[pool->queueTail] = job;
+    pool->queueTail = (pool->queueTail + 1) % pool->queueCapacity;
+    semaphore_signal(&pool->queueLock);
+
+    semaphore_signal(&pool->queueJobs);
+}
+
+/**
+ * Wait for all the jobs submitted so far to be finished, then stop the worker threads and free the pool.
+ */
+void workerpool_destroy(workerPool_t *pool)
+{
+    if (!pool)
+        return;
+
+    for (int i = 0; i < pool->numWorkers; i++) {
+        workerpool_submit(pool, NULL);
+    }
+
+    for (int i = 0; i < pool->numWorkers; i++) {
+        semaphore_wait(&pool->workerExited);
+    }
+
+    semaphore_destroy(&pool->queueLock);
+    semaphore_destroy(&pool->queueSpace);
+    semaphore_destroy(&pool->queueJobs);
+    semaphore_destroy(&pool->workerExited);
+
+    free(pool->queue);
+    free(pool);
+}
+
 void semaphore_signal(semaphore_t *sem)
 {
 #if defined(__APPLE__)
@@ -87,7 +208,7 @@ void semaphore_create(semaphore_t *sem, int initialCount)
 #if defined(__APPLE__)
     *sem = dispatch_semaphore_create(initialCount);
 #elif defined(WIN32)
-    *sem = CreateSemaphore(NULL, initialCount, initialCount, NULL);
+    *sem = CreateSemaphore(NULL, initialCount, LONG_MAX, NULL);
 #else
     sem_init(sem, 0, initialCount);
 #endif
@@ -152,22 +273,56 @@ bool mmap_file(fileMapping_t *mapping, int fd)
             }
         #endif
     } else {
-        #ifndef WIN32
-        if ((mapping->stats.st_mode & S_IFMT) == S_IFCHR) {
-            mapping->data = malloc(FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH * sizeof(uint8_t));//A buffer for serial tty data. This will hold one or one frame.
-            mapping->size = FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH;
-            mapping->data[mapping->size-1] = '\0';
-        } else {
         mapping->data = 0;
-        }
-        #else
-        mapping->data = 0;
-        #endif
     }
 
     return true;
 }
 
+/**
+ * Map `length` bytes of the open file with the given file handle `fd`, beginning at `offset` (which must be a multiple
+ * of MMAP_RANGE_ALIGNMENT), into memory. The system is told that the range will be read through in order, so it can
+ * begin reading it in ahead of us and drop pages once we've passed them. Release it with munmap_file().
+ *
+ * Returns true on success
+ */
+bool mmap_file_range(fileMapping_t *mapping, int fd, uint64_t offset, size_t length)
+{
+    if (fd < 0 || length == 0 || fstat(fd, &mapping->stats) < 0) {
+        return false;
+    }
+
+    mapping->fd = fd;
+    mapping->size = length;
+
+    #ifdef WIN32
+        intptr_t fileHandle = _get_osfhandle(fd);
+        mapping->mapping = CreateFileMapping((HANDLE) fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (mapping->mapping == NULL) {
+            return false;
+        }
+
+        mapping->data = MapViewOfFile(mapping->mapping, FILE_MAP_READ, (DWORD) (offset >> 32), (DWORD) offset, length);
+
+        if (mapping->data == NULL) {
+            CloseHandle(mapping->mapping);
+            return false;
+        }
+    #else
+        mapping->data = mmap(0, length, PROT_READ, MAP_PRIVATE, fd, (off_t) offset);
+
+        if (mapping->data == MAP_FAILED) {
+            return false;
+        }
+
+        madvise(mapping->data, length, MADV_SEQUENTIAL);
+        madvise(mapping->data, length, MADV_WILLNEED);
+    #endif
+
+    return true;
+}
+
 void munmap_file(fileMapping_t *mapping)
 {
     if (mapping->data) {
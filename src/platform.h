@@ -2,8 +2,8 @@
 #define PLATFORM_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
-#define FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH 1024
 #define FLIGHT_LOG_MAX_FRAME_LENGTH 256
 #define FLIGHT_LOG_MAX_FRAME_HEADER_LENGTH 1024
 
@@ -45,6 +45,9 @@
     #define snprintf _snprintf
 #endif
 
+// The offset of a mapping of part of a file must be a multiple of this (the allocation granularity on Windows)
+#define MMAP_RANGE_ALIGNMENT (64 * 1024)
+
 typedef struct fileMapping_t {
 #if defined(WIN32)
     HANDLE mapping;
@@ -58,9 +61,22 @@ typedef struct fileMapping_t {
 
 typedef void*(*threadRoutine_t)(void *data);
 
+/*
+ * A worker pool calls this routine on one of its threads for each job submitted to it. workerData is the pointer that
+ * was supplied for that particular worker when the pool was created.
+ */
+typedef void (*workerRoutine_t)(void *workerData, void *job);
+
+typedef struct workerPool_t workerPool_t;
+
 void thread_create_detached(threadRoutine_t threadFunc, void *data);
 
+workerPool_t* workerpool_create(int numWorkers, workerRoutine_t routine, void **workerData);
+void workerpool_submit(workerPool_t *pool, void *job);
+void workerpool_destroy(workerPool_t *pool);
+
 bool mmap_file(fileMapping_t *mapping, int fd);
+bool mmap_file_range(fileMapping_t *mapping, int fd, uint64_t offset, size_t length);
 void munmap_file(fileMapping_t *mapping);
 
 void semaphore_create(semaphore_t *sem, int initialCount);
@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef WIN32
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <termios.h>
+#endif
+
+#include "platform.h"
+#include "serial.h"
+
+// How long the reader thread waits for data before checking whether it has been asked to stop
+#define SERIAL_POLL_TIMEOUT_MS 100
+
+/**
+ * Drains a serial port on a thread of its own, so that bytes keep being collected at full speed while the decoder is
+ * busy writing out the frames it has decoded. The bytes are queued in a ring buffer for the parser to take in bulk.
+ */
+struct serialInput_t {
+    // This comes first so that the source callbacks can find the input they belong to
+    streamSource_t source;
+
+    int fd;
+    FILE *tee;
+
+    char *buffer;
+    size_t capacity;
+
+    // Bytes are added at (head + count) and taken from head. All of these fields are protected by `lock`.
+    size_t head, count;
+    bool ended, stopping;
+    bool readerWaiting, parserWaiting;
+
+    serialInputStats_t stats;
+
+    // A binary semaphore which protects the ring buffer state
+    semaphore_t lock;
+    semaphore_t spaceFreed, dataArrived, readerExited;
+};
+
+#ifndef WIN32
+
+static speed_t baudToSpeed(int baud)
+{
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+#ifdef B460800
+        case 460800: return B460800;
+#endif
+#ifdef B500000
+        case 500000: return B500000;
+#endif
+#ifdef B921600
+        case 921600: return B921600;
+#endif
+#ifdef B1000000
+        case 1000000: return B1000000;
+#endif
+#ifdef B1500000
+        case 1500000: return B1500000;
+#endif
+#ifdef B2000000
+        case 2000000: return B2000000;
+#endif
+        default:
+            return B0;
+    }
+}
+
+/**
+ * Put the terminal into raw mode so that the log's bytes come through untouched, and set its baud rate (unless `baud`
+ * is zero, in which case it is left alone).
+ *
+ * Returns false if the terminal couldn't be configured.
+ */
+bool serialPortConfigure(int fd, int baud)
+{
+    struct termios settings;
+
+    if (tcgetattr(fd, &settings) != 0) {
+        return false;
+    }
+
+    cfmakeraw(&settings);
+
+    settings.c_cflag |= CLOCAL | CREAD;
+    settings.c_cc[VMIN] = 1;
+    settings.c_cc[VTIME] = 0;
+
+    if (baud > 0) {
+        speed_t speed = baudToSpeed(baud);
+
+        if (speed == B0) {
+            fprintf(stderr, "Unsupported baud rate %d\n", baud);
+            return false;
+        }
+
+        cfsetispeed(&settings, speed);
+        cfsetospeed(&settings, speed);
+    }
+
+    return tcsetattr(fd, TCSANOW, &settings) == 0;
+}
+
+static void serialInputLock(serialInput_t *input)
+{
+    semaphore_wait(&input->lock);
+}
+
+static void serialInputUnlock(serialInput_t *input)
+{
+    semaphore_signal(&input->lock);
+}
+
+/**
+ * Wait for the ring buffer to have some free space, then return the length of the run of free bytes which begins at
+ * `*offset` (or zero if we've been asked to stop).
+ */
+static size_t serialInputWaitForSpace(serialInput_t *input, size_t *offset)
+{
+    size_t tail, length;
+
+    serialInputLock(input);
+
+    while (input->count == input->capacity && !input->stopping) {
+        input->stats.overflows++;
+        input->readerWaiting = true;
+
+        serialInputUnlock(input);
+        semaphore_wait(&input->spaceFreed);
+        serialInputLock(input);
+    }
+
+    if (input->stopping) {
+        length = 0;
+    } else {
+        tail = (input->head + input->count) % input->capacity;
+
+        // Only up to the end of the buffer, the next read can carry on from the beginning
+        length = tail < input->head ? input->head - tail : input->capacity - tail;
+
+        *offset = tail;
+    }
+
+    serialInputUnlock(input);
+
+    return length;
+}
+
+static void serialInputAdded(serialInput_t *input, size_t length, bool ended)
+{
+    serialInputLock(input);
+
+    input->count += length;
+    input->stats.bytesRead += length;
+
+    if (input->count > input->stats.peakBuffered) {
+        input->stats.peakBuffered = input->count;
+    }
+
+    if (ended) {
+        input->ended = true;
+    }
+
+    if (input->parserWaiting) {
+        input->parserWaiting = false;
+        semaphore_signal(&input->dataArrived);
+    }
+
+    serialInputUnlock(input);
+}
+
+static void* serialInputReaderThread(void *data)
+{
+    serialInput_t *input = (serialInput_t *) data;
+    struct pollfd pollFd;
+
+    pollFd.fd = input->fd;
+    pollFd.events = POLLIN;
+
+    while (1) {
+        size_t offset, space = serialInputWaitForSpace(input, &offset);
+        ssize_t bytesRead;
+
+        if (space == 0) {
+            break;
+        }
+
+        if (poll(&pollFd, 1, SERIAL_POLL_TIMEOUT_MS) < 0 && errno != EINTR) {
+            serialInputAdded(input, 0, true);
+            break;
+        }
+
+        // Take everything the port has for us in one go, straight into the ring buffer
+        bytesRead = read(input->fd, input->buffer + offset, space);
+
+        if (bytesRead > 0) {
+            if (input->tee) {
+                fwrite(input->buffer + offset, 1, bytesRead, input->tee);
+            }
+
+            serialInputAdded(input, bytesRead, false);
+        } else if (bytesRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            // The port was closed or the device went away (e.g. a USB adapter was unplugged)
+            serialInputAdded(input, 0, true);
+            break;
+        } else {
+            bool stopping;
+
+            serialInputLock(input);
+            stopping = input->stopping;
+            serialInputUnlock(input);
+
+            if (stopping) {
+                break;
+            }
+        }
+    }
+
+    if (input->tee) {
+        fflush(input->tee);
+    }
+
+    semaphore_signal(&input->readerExited);
+
+    return NULL;
+}
+
+static size_t serialInputRead(streamSource_t *source, char *buffer, size_t minimum, size_t length)
+{
+    serialInput_t *input = (serialInput_t *) source;
+    size_t result, firstPart;
+
+    serialInputLock(input);
+
+    while (input->count < minimum && !input->ended) {
+        input->parserWaiting = true;
+
+        serialInputUnlock(input);
+        semaphore_wait(&input->dataArrived);
+        serialInputLock(input);
+    }
+
+    result = input->count < length ? input->count : length;
+    firstPart = input->capacity - input->head < result ? input->capacity - input->head : result;
+
+    memcpy(buffer, input->buffer + input->head, firstPart);
+    memcpy(buffer + firstPart, input->buffer, result - firstPart);
+
+    input->head = (input->head + result) % input->capacity;
+    input->count -= result;
+
+    if (input->readerWaiting && result > 0) {
+        input->readerWaiting = false;
+        semaphore_signal(&input->spaceFreed);
+    }
+
+    serialInputUnlock(input);
+
+    return result;
+}
+
+static void serialInputDestroy(streamSource_t *source)
+{
+    serialInput_t *input = (serialInput_t *) source;
+
+    serialInputLock(input);
+
+    input->stopping = true;
+
+    if (input->readerWaiting) {
+        input->readerWaiting = false;
+        semaphore_signal(&input->spaceFreed);
+    }
+
+    serialInputUnlock(input);
+
+    semaphore_wait(&input->readerExited);
+
+    semaphore_destroy(&input->lock);
+    semaphore_destroy(&input->spaceFreed);
+    semaphore_destroy(&input->dataArrived);
+    semaphore_destroy(&input->readerExited);
+
+    free(input->buffer);
+    free(input);
+}
+
+/**
+ * Begin reading from the serial port (or other character device) `fd`. If it is a terminal, it's switched to raw mode
+ * and to the given baud rate (if `baud` isn't zero). If `tee` is supplied, every byte that arrives is also written to
+ * it, so the log can be saved while it's being decoded.
+ *
+ * Returns NULL if the port couldn't be set up.
+ */
+serialInput_t* serialInputCreate(int fd, int baud, FILE *tee)
+{
+    serialInput_t *input;
+    int flags;
+
+    if (isatty(fd) && !serialPortConfigure(fd, baud)) {
+        return NULL;
+    }
+
+    // We wait in poll() instead, so that we can stop the reader when we're done
+    flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        return NULL;
+    }
+
+    input = calloc(1, sizeof(*input));
+
+    input->source.read = serialInputRead;
+    input->source.destroy = serialInputDestroy;
+
+    input->fd = fd;
+    input->tee = tee;
+    input->capacity = SERIAL_INPUT_BUFFER_SIZE;
+    input->buffer = malloc(input->capacity);
+
+    semaphore_create(&input->lock, 1);
+    semaphore_create(&input->spaceFreed, 0);
+    semaphore_create(&input->dataArrived, 0);
+    semaphore_create(&input->readerExited, 0);
+
+    thread_create_detached(serialInputReaderThread, input);
+
+    return input;
+}
+
+#else
+
+bool serialPortConfigure(int fd, int baud)
+{
+    (void) fd;
+    (void) baud;
+
+    return false;
+}
+
+serialInput_t* serialInputCreate(int fd, int baud, FILE *tee)
+{
+    (void) fd;
+    (void) baud;
+    (void) tee;
+
+    fprintf(stderr, "Reading from serial ports isn't supported on this platform\n");
+
+    return NULL;
+}
+
+#endif
+
+streamSource_t* serialInputSource(serialInput_t *input)
+{
+    return &input->source;
+}
+
+void serialInputGetStats(serialInput_t *input, serialInputStats_t *stats)
+{
+    semaphore_wait(&input->lock);
+    *stats = input->stats;
+    semaphore_signal(&input->lock);
+}
@@ -0,0 +1,31 @@
+#ifndef SERIAL_H_
+#define SERIAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "stream.h"
+
+// Enough to hold over 30 seconds of a 2 Mbaud log while the decoder is busy with something else
+#define SERIAL_INPUT_BUFFER_SIZE (8 * 1024 * 1024)
+
+typedef struct serialInputStats_t {
+    uint64_t bytesRead;
+
+    // The most bytes that were ever waiting in the ring buffer for the parser to catch up
+    size_t peakBuffered;
+
+    // How many times the ring buffer filled up so that we had to stop reading from the port for a while
+    uint32_t overflows;
+} serialInputStats_t;
+
+typedef struct serialInput_t serialInput_t;
+
+bool serialPortConfigure(int fd, int baud);
+
+serialInput_t* serialInputCreate(int fd, int baud, FILE *tee);
+streamSource_t* serialInputSource(serialInput_t *input);
+void serialInputGetStats(serialInput_t *input, serialInputStats_t *stats);
+
+#endif
@@ -6,45 +6,26 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#ifdef __linux__
+    #include <poll.h>
+    #include <sys/inotify.h>
+#endif
+
+#if defined(__SSSE3__)
+    #include <tmmintrin.h>
+#endif
 
 #include "platform.h"
 #include "tools.h"
 
 #include "stream.h"
 
-void fillSerialBuffer(mmapStream_t *stream,size_t bytesParsedDataSize, ParserState *parserState) {
-    size_t bytes_read = 0;
-
-    if (strstr( stream->mapping.data ,"H Data") && *parserState == PARSER_STATE_DATA) { // Always searching for header in stream.
-        *parserState = PARSER_STATE_HEADER;
-        bytesParsedDataSize = strstr(stream->mapping.data, "H Data") - stream->mapping.data; //Jump to start of headder
-    }
-
-    bytes_read = bytesParsedDataSize;
-
-    if (bytesParsedDataSize >= FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH) { // First fill
-        for (size_t i = 0;i < FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH; ++i) { //fill the rest of the buffer
-            int byte = 0;
-            read(stream->mapping.fd, &byte, 1);
-            stream->mapping.data[i] = byte;
-        }
-    } else {
-        while (bytes_read < FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH) { //move data down to beginning of buffer.
-            stream->mapping.data[bytes_read - bytesParsedDataSize] = stream->mapping.data[bytes_read];
-            bytes_read++;
-        }
-        size_t topup = bytes_read - bytesParsedDataSize;
-        while (topup < FLIGHT_LOG_MAX_FRAME_SERIAL_BUFFER_LENGTH) { //fill the rest of the buffer
-            int byte = 0;
-            read(stream->mapping.fd, &byte, 1 );
-            stream->mapping.data[topup] = byte;
-            topup++;
-        }
-    }
-
-    stream->pos = stream->mapping.data;
-
-}
+// How often a followed file is checked for growth while we wait for it (so the longest we'd wait without inotify)
+#define FOLLOW_POLL_INTERVAL_MS 100
 
 uint32_t streamReadUnsignedVB(mmapStream_t *stream)
 {
@@ -73,6 +54,166 @@ uint32_t streamReadUnsignedVB(mmapStream_t *stream)
     return 0;
 }
 
+/**
+ * Decode the variable-byte field at the start of the 8 bytes loaded from `bytes`, returning the number of bytes that it
+ * takes up. The value matches what streamReadUnsignedVB() would give, including for fields that are too long.
+ */
+static int decodeUnsignedVBWord(const uint8_t *bytes, uint32_t *value)
+{
+    uint64_t word = (uint64_t) bytes[0] | ((uint64_t) bytes[1] << 8) | ((uint64_t) bytes[2] << 16) | ((uint64_t) bytes[3] << 24)
+        | ((uint64_t) bytes[4] << 32) | ((uint64_t) bytes[5] << 40) | ((uint64_t) bytes[6] << 48) | ((uint64_t) bytes[7] << 56);
+
+    // The high bit is clear in the final byte of the field, which can be one of the first 5
+    uint64_t finalBytes = ~word & 0x0000008080808080ULL;
+    int length;
+
+    if (!finalBytes) {
+        *value = 0;
+        return 5;
+    }
+
+    length = countTrailingZeros64(finalBytes) / 8 + 1;
+
+    word &= 0x0000007F7F7F7F7FULL & (((uint64_t) 1 << (length * 8)) - 1);
+
+    // Squeeze out the continuation bits by merging neighbouring groups of 7 bits, then 14, then 28
+    word = ((word & 0x7F007F007F007F00ULL) >> 1) | (word & 0x007F007F007F007FULL);
+    word = ((word & 0x3FFF00003FFF0000ULL) >> 2) | (word & 0x00003FFF00003FFFULL);
+    word = ((word & 0x0FFFFFFF00000000ULL) >> 4) | (word & 0x000000000FFFFFFFULL);
+
+    *value = (uint32_t) word;
+
+    return length;
+}
+
+#if defined(__SSSE3__)
+
+/*
+ * With SSSE3, runs of fields are decoded up to 4 at a time by shuffling their bytes into 32-bit lanes. Where the fields
+ * start is looked up from the continuation bits of the next 8 bytes, in a table that's built by the preprocessor in the
+ * same way as the layout tables in decoders.c.
+ */
+typedef struct unsignedVBLayout_t {
+    /*
+     * Offset of the first byte of each of the first 4 fields, then the offset just past the fourth (padded out so that
+     * they can be loaded as one 8-byte word)
+     */
+    uint8_t start[8];
+
+    // The number of those fields that this layout decodes, which stops before any that's too long for a lane
+    uint8_t count;
+} unsignedVBLayout_t;
+
+#define VB_FINAL(mask, n) (!(((mask) >> (n)) & 1))
+
+// The index of the field that byte n belongs to, which is the number of fields that end before it
+#define VB_FIELD_OF(mask, n) VB_FIELD_OF_##n(mask)
+#define VB_FIELD_OF_0(mask) 0
+#define VB_FIELD_OF_1(mask) VB_FINAL(mask, 0)
+#define VB_FIELD_OF_2(mask) (VB_FIELD_OF_1(mask) + VB_FINAL(mask, 1))
+#define VB_FIELD_OF_3(mask) (VB_FIELD_OF_2(mask) + VB_FINAL(mask, 2))
+#define VB_FIELD_OF_4(mask) (VB_FIELD_OF_3(mask) + VB_FINAL(mask, 3))
+#define VB_FIELD_OF_5(mask) (VB_FIELD_OF_4(mask) + VB_FINAL(mask, 4))
+#define VB_FIELD_OF_6(mask) (VB_FIELD_OF_5(mask) + VB_FINAL(mask, 5))
+#define VB_FIELD_OF_7(mask) (VB_FIELD_OF_6(mask) + VB_FINAL(mask, 6))
+
+// Fields before `field` take up each of the bytes that belong to them
+#define VB_START(mask, field) ((VB_FIELD_OF(mask, 0) < (field)) + (VB_FIELD_OF(mask, 1) < (field)) \
+    + (VB_FIELD_OF(mask, 2) < (field)) + (VB_FIELD_OF(mask, 3) < (field)) + (VB_FIELD_OF(mask, 4) < (field)) \
+    + (VB_FIELD_OF(mask, 5) < (field)) + (VB_FIELD_OF(mask, 6) < (field)) + (VB_FIELD_OF(mask, 7) < (field)))
+
+/*
+ * A field that's too long for a lane has 4 continuation bits in a row, so the fields that fit are the ones that end
+ * before the first such run.
+ */
+#define VB_RUN_OF_4_AT(mask, n) ((((mask) >> (n)) & 0x0F) == 0x0F)
+#define VB_FIRST_RUN_OF_4(mask) (VB_RUN_OF_4_AT(mask, 0) ? 0 : VB_RUN_OF_4_AT(mask, 1) ? 1 \
+    : VB_RUN_OF_4_AT(mask, 2) ? 2 : VB_RUN_OF_4_AT(mask, 3) ? 3 : VB_RUN_OF_4_AT(mask, 4) ? 4 : 8)
+
+#define VB_DECODES_FIELD_ENDING_AT(mask, n) \
+    (VB_FINAL(mask, n) && (n) < VB_FIRST_RUN_OF_4(mask) && VB_FIELD_OF(mask, n) < 4)
+
+#define VB_COUNT(mask) (VB_DECODES_FIELD_ENDING_AT(mask, 0) + VB_DECODES_FIELD_ENDING_AT(mask, 1) \
+    + VB_DECODES_FIELD_ENDING_AT(mask, 2) + VB_DECODES_FIELD_ENDING_AT(mask, 3) + VB_DECODES_FIELD_ENDING_AT(mask, 4) \
+    + VB_DECODES_FIELD_ENDING_AT(mask, 5) + VB_DECODES_FIELD_ENDING_AT(mask, 6) + VB_DECODES_FIELD_ENDING_AT(mask, 7))
+
+#define VB_LAYOUT(mask) { \
+    {0, VB_START(mask, 1), VB_START(mask, 2), VB_START(mask, 3), VB_START(mask, 4)}, \
+    VB_COUNT(mask) \
+},
+
+static const unsignedVBLayout_t unsignedVBLayouts[256] = {
+    REPEAT_256(VB_LAYOUT)
+};
+
+/**
+ * Decode the fields at the start of the 8 bytes loaded from `bytes` into 4 values, of which only the first
+ * `layout->count` are meaningful.
+ */
+static void decodeUnsignedVBLanes(const uint8_t *bytes, const unsignedVBLayout_t *layout, uint32_t *values)
+{
+    __m128i starts = _mm_loadl_epi64((const __m128i*) layout->start);
+
+    // Lane i takes the bytes of field i, from its start up to the start of the next field, and is zero-filled after that
+    __m128i source = _mm_add_epi8(_mm_shuffle_epi8(starts, _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3)),
+        _mm_setr_epi8(0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3));
+    __m128i next = _mm_shuffle_epi8(starts, _mm_setr_epi8(1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4));
+    __m128i shuffle = _mm_or_si128(source, _mm_andnot_si128(_mm_cmplt_epi8(source, next), _mm_set1_epi8((char) 0x80)));
+
+    __m128i lanes = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i*) bytes), shuffle);
+
+    // Drop the continuation bits by moving each group of 7 bits down into place
+    __m128i result = _mm_or_si128(
+        _mm_or_si128(
+            _mm_and_si128(lanes, _mm_set1_epi32(0x7F)),
+            _mm_and_si128(_mm_srli_epi32(lanes, 1), _mm_set1_epi32(0x7F << 7))
+        ),
+        _mm_or_si128(
+            _mm_and_si128(_mm_srli_epi32(lanes, 2), _mm_set1_epi32(0x7F << 14)),
+            _mm_and_si128(_mm_srli_epi32(lanes, 3), _mm_set1_epi32(0x7F << 21))
+        )
+    );
+
+    _mm_storeu_si128((__m128i*) values, result);
+}
+
+#endif
+
+/**
+ * Read `count` consecutive unsigned variable-byte fields, with the same results as calling streamReadUnsignedVB() that
+ * many times. Fields that are far enough from the end of the stream are each decoded from a single 8-byte load instead
+ * of a byte at a time, and with SSSE3 up to 4 of them are decoded from each load.
+ */
+void streamReadUnsignedVBs(mmapStream_t *stream, uint32_t *values, int count)
+{
+    int i = 0;
+
+#if defined(__SSSE3__)
+    while (count - i >= 4 && stream->end - stream->pos >= 8) {
+        const uint8_t *bytes = (const uint8_t *) stream->pos;
+        const unsignedVBLayout_t *layout = &unsignedVBLayouts[_mm_movemask_epi8(_mm_loadl_epi64((const __m128i*) bytes))];
+
+        if (layout->count > 0) {
+            decodeUnsignedVBLanes(bytes, layout, values + i);
+
+            i += layout->count;
+            stream->pos += layout->start[layout->count];
+        } else {
+            stream->pos += decodeUnsignedVBWord(bytes, &values[i]);
+            i++;
+        }
+    }
+#endif
+
+    for (; i < count && stream->end - stream->pos >= 8; i++) {
+        stream->pos += decodeUnsignedVBWord((const uint8_t *) stream->pos, &values[i]);
+    }
+
+    for (; i < count; i++) {
+        values[i] = streamReadUnsignedVB(stream);
+    }
+}
+
 int32_t streamReadSignedVB(mmapStream_t *stream)
 {
     uint32_t i = streamReadUnsignedVB(stream);
@@ -143,6 +284,63 @@ void streamRead(mmapStream_t *stream, void *buf, int len)
     }
 }
 
+/**
+ * Load the bits at the current bit index into a 64-bit accumulator without consuming them, so that callers can decode
+ * several bit-packed fields at once. The first bit in the stream becomes the highest bit of the result, and any bits
+ * past the end of the stream read as zero.
+ *
+ * The number of genuine stream bits held by the accumulator is stored into `numBits`. This is at least 57 unless we're
+ * within 8 bytes of the end of the stream. Consume the bits you decode with streamSkipBits().
+ */
+uint64_t streamPeekBits64(mmapStream_t *stream, int *numBits)
+{
+    int usedBits = CHAR_BIT - 1 - stream->bitPos;
+    uint64_t result = 0;
+
+    if (stream->end - stream->pos >= (ptrdiff_t) sizeof(result)) {
+        const uint8_t *bytes = (const uint8_t *) stream->pos;
+
+        result = ((uint64_t) bytes[0] << 56) | ((uint64_t) bytes[1] << 48) | ((uint64_t) bytes[2] << 40) | ((uint64_t) bytes[3] << 32)
+            | ((uint64_t) bytes[4] << 24) | ((uint64_t) bytes[5] << 16) | ((uint64_t) bytes[6] << 8) | bytes[7];
+
+        *numBits = sizeof(result) * CHAR_BIT - usedBits;
+    } else if (stream->pos < stream->end) {
+        int numBytes = stream->end - stream->pos;
+
+        for (int i = 0; i < numBytes; i++) {
+            result |= (uint64_t) (uint8_t) stream->pos[i] << (56 - i * CHAR_BIT);
+        }
+
+        *numBits = numBytes * CHAR_BIT - usedBits;
+    } else {
+        *numBits = 0;
+        return 0;
+    }
+
+    return result << usedBits;
+}
+
+/**
+ * Advance the bit pointer by `numBits` bits, which may be more than 32.
+ *
+ * If that would take us past the end of the stream, the `pos` is set to the end of the stream, the EOF flag is set,
+ * and the bit pointer is properly aligned (just like streamReadBits).
+ */
+void streamSkipBits(mmapStream_t *stream, int numBits)
+{
+    // Count from the high bit of the current byte so we can work in whole bytes
+    int64_t bitIndex = (int64_t) (CHAR_BIT - 1 - stream->bitPos) + numBits;
+
+    if (bitIndex <= (int64_t) (stream->end - stream->pos) * CHAR_BIT) {
+        stream->pos += bitIndex / CHAR_BIT;
+        stream->bitPos = CHAR_BIT - 1 - bitIndex % CHAR_BIT;
+    } else {
+        stream->pos = stream->end;
+        stream->eof = true;
+        stream->bitPos = CHAR_BIT - 1;
+    }
+}
+
 /**
  * Read `numBits` (at most 32) at the current bit index and advance the bit pointer. The first bit in the stream becomes
  * the highest bit set in the result, and the last bit in the stream will be the least significant bit in the result.
@@ -154,27 +352,21 @@ void streamRead(mmapStream_t *stream, void *buf, int len)
  */
 uint32_t streamReadBits(mmapStream_t *stream, int numBits)
 {
-    // Round up the bit count to get the byte count
-    int numBytes = (numBits + CHAR_BIT - 1) / CHAR_BIT;
+    int bitsAvailable;
+    uint64_t bits;
 
     assert(numBits <= 32);
 
-    if (stream->pos + numBytes <= stream->end) {
-        uint32_t result = 0;
+    if (numBits <= 0) {
+        return 0;
+    }
 
-        while (numBits > 0) {
-            result |= ((((uint8_t)*stream->pos) >> stream->bitPos) & 0x01) << (numBits - 1);
+    bits = streamPeekBits64(stream, &bitsAvailable);
 
-            if (stream->bitPos == 0) {
-                stream->pos++;
-                stream->bitPos = CHAR_BIT - 1;
-            } else {
-                stream->bitPos--;
-            }
-            numBits--;
-        }
+    if (numBits <= bitsAvailable) {
+        streamSkipBits(stream, numBits);
 
-        return result;
+        return (uint32_t) (bits >> (64 - numBits));
     } else {
         stream->pos = stream->end;
         stream->eof = true;
@@ -211,7 +403,7 @@ void streamByteAlign(mmapStream_t *stream)
 
 mmapStream_t* streamCreate(int fd)
 {
-    mmapStream_t *result = malloc(sizeof(*result));
+    mmapStream_t *result = calloc(1, sizeof(*result));
 
     if (!mmap_file(&result->mapping, fd)) {
         free(result);
@@ -225,12 +417,479 @@ mmapStream_t* streamCreate(int fd)
     result->bitPos = CHAR_BIT - 1;
     result->end    = result->mapping.data + result->mapping.size;
     result->eof    = false;
+    result->source = NULL;
 
     return result;
 }
 
-void streamDestroy(mmapStream_t *stream)
+/**
+ * Create a stream for a file which is too large to map into memory all at once, which maps the file a window of
+ * STREAM_MAPPED_WINDOW_SIZE bytes at a time as it's read instead. It begins with the start of the file in its window,
+ * call streamFillWindow() to slide the window along.
+ */
+mmapStream_t* streamCreateWindowed(int fd)
+{
+    mmapStream_t *result = calloc(1, sizeof(*result));
+    struct stat stats;
+    size_t length;
+
+    if (fd < 0 || fstat(fd, &stats) < 0 || stats.st_size == 0) {
+        free(result);
+        return 0;
+    }
+
+    length = (uint64_t) stats.st_size < STREAM_MAPPED_WINDOW_SIZE ? (size_t) stats.st_size : STREAM_MAPPED_WINDOW_SIZE;
+
+    if (!mmap_file_range(&result->mapping, fd, 0, length)) {
+        free(result);
+        return 0;
+    }
+
+    result->data   = result->mapping.data;
+    result->size   = length;
+    result->start  = result->mapping.data;
+    result->pos    = result->mapping.data;
+    result->bitPos = CHAR_BIT - 1;
+    result->end    = result->mapping.data + length;
+    result->eof    = false;
+    result->windowed = true;
+    result->sourceEnded = length == (uint64_t) stats.st_size;
+    result->windowEnd = result->end;
+    result->rangeEnd = (uint64_t) stats.st_size;
+
+    return result;
+}
+
+/**
+ * Create a stream which reads its bytes from the given source, which it takes ownership of. The stream's data is a
+ * window of STREAM_WINDOW_SIZE bytes which begins empty, call streamFillWindow() to read into it.
+ */
+mmapStream_t* streamCreateFromSource(streamSource_t *source)
+{
+    mmapStream_t *result = calloc(1, sizeof(*result));
+    char *window = malloc(STREAM_WINDOW_SIZE);
+
+    result->data   = window;
+    result->size   = STREAM_WINDOW_SIZE;
+    result->start  = window;
+    result->pos    = window;
+    result->bitPos = CHAR_BIT - 1;
+    result->end    = window;
+    result->eof    = false;
+    result->windowed = true;
+    result->source = source;
+    result->windowEnd = window;
+
+    return result;
+}
+
+/**
+ * Replace the window of a stream that maps its file a window at a time with one that begins at most
+ * STREAM_WINDOW_LOOKBEHIND bytes before `posOffset`, which becomes the read position. The stream's start is the
+ * beginning of its range (or of the window, if the range begins before it), and its end is the end of the window.
+ *
+ * Returns false if the window couldn't be mapped, leaving the stream as it was.
+ */
+static bool streamMapWindow(mmapStream_t *stream, uint64_t posOffset)
 {
+    uint64_t offset = posOffset > STREAM_WINDOW_LOOKBEHIND ? posOffset - STREAM_WINDOW_LOOKBEHIND : 0;
+    fileMapping_t mapping;
+    size_t length;
+
+    // There must be at least one byte to map, even when the position is the end of the range
+    if (offset >= stream->rangeEnd && stream->rangeEnd > 0) {
+        offset = stream->rangeEnd - 1;
+    }
+
+    offset -= offset % MMAP_RANGE_ALIGNMENT;
+    length = stream->rangeEnd - offset < STREAM_MAPPED_WINDOW_SIZE ? (size_t) (stream->rangeEnd - offset) : STREAM_MAPPED_WINDOW_SIZE;
+
+    if (!mmap_file_range(&mapping, stream->mapping.fd, offset, length)) {
+        fprintf(stderr, "Error: Failed to map the log into memory at offset %" PRIu64 "\n", offset);
+        return false;
+    }
+
     munmap_file(&stream->mapping);
+
+    stream->mapping = mapping;
+    stream->data = mapping.data;
+    stream->size = length;
+    stream->start = stream->rangeBegin > offset ? mapping.data + (stream->rangeBegin - offset) : mapping.data;
+    stream->pos = mapping.data + (posOffset - offset);
+    stream->end = mapping.data + length;
+    stream->windowEnd = stream->end;
+    stream->windowOffset = offset;
+    stream->sourceEnded = offset + length == stream->rangeEnd;
+
+    return true;
+}
+
+/**
+ * Slide the window of a stream that maps its file a window at a time along to the read position.
+ */
+static void streamSlideMappedWindow(mmapStream_t *stream)
+{
+    if (!streamMapWindow(stream, streamOffset(stream, stream->pos))) {
+        // Carry on with what we have until the parser runs out of it
+        stream->sourceEnded = true;
+    }
+}
+
+/**
+ * Make sure that the window of a windowed stream holds at least STREAM_WINDOW_LOOKAHEAD bytes past the read position.
+ *
+ * For a stream read from a source, this waits for the bytes to arrive if need be. Whatever else the source has ready is
+ * read too, in the same call, so this is cheap to call before every frame. When the window's free space runs out, the
+ * bytes more than STREAM_WINDOW_LOOKBEHIND behind the read position are discarded and the rest slide down to the start
+ * of the window, moving the stream's pointers along with them.
+ *
+ * A stream that maps its file a window at a time maps the next window of the file instead (which overlaps this one).
+ *
+ * Nothing is read while the stream's end has been moved back from the end of the window (to stop reading at the end of
+ * a log), until the end is set back to windowEnd.
+ */
+void streamFillWindow(mmapStream_t *stream)
+{
+    char *window = (char*) stream->data;
+    size_t ahead = stream->end - stream->pos;
+    size_t wanted, space, bytesRead;
+
+    if (stream->sourceEnded || stream->end != stream->windowEnd || ahead >= STREAM_WINDOW_LOOKAHEAD) {
+        return;
+    }
+
+    if (!stream->source) {
+        streamSlideMappedWindow(stream);
+        return;
+    }
+
+    wanted = STREAM_WINDOW_LOOKAHEAD - ahead;
+    space = (window + stream->size) - stream->end;
+
+    if (space < wanted) {
+        size_t shift = stream->pos - window > STREAM_WINDOW_LOOKBEHIND ? (stream->pos - window) - STREAM_WINDOW_LOOKBEHIND : 0;
+
+        memmove(window, window + shift, (stream->end - window) - shift);
+
+        stream->start = stream->start - window > (ptrdiff_t) shift ? stream->start - shift : window;
+        stream->pos -= shift;
+        stream->end -= shift;
+        stream->windowEnd = stream->end;
+        stream->windowOffset += shift;
+
+        space += shift;
+    }
+
+    bytesRead = stream->source->read(stream->source, window + (stream->end - window), wanted, space);
+
+    if (bytesRead < wanted) {
+        stream->sourceEnded = true;
+    }
+
+    stream->end += bytesRead;
+    stream->windowEnd = stream->end;
+}
+
+typedef struct fileSource_t {
+    streamSource_t source;
+    int fd;
+} fileSource_t;
+
+static size_t fileSourceRead(streamSource_t *source, char *buffer, size_t minimum, size_t length)
+{
+    fileSource_t *file = (fileSource_t *) source;
+    size_t total = 0;
+
+    // Pipes hand over whatever the writer has written so far, so keep reading until we have enough
+    while (total < minimum) {
+        ssize_t bytesRead = read(file->fd, buffer + total, length - total);
+
+        if (bytesRead > 0) {
+            total += bytesRead;
+        } else if (bytesRead == 0 || errno != EINTR) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+static void fileSourceDestroy(streamSource_t *source)
+{
+    free(source);
+}
+
+/**
+ * Create a source which reads the file with the given handle from its current position to its end using plain reads,
+ * for files that can't be mapped into memory like pipes, sockets and standard input. The file is left open when the
+ * source is destroyed.
+ */
+streamSource_t* streamSourceCreateFromFile(int fd)
+{
+    fileSource_t *result = malloc(sizeof(*result));
+
+    result->source.read = fileSourceRead;
+    result->source.destroy = fileSourceDestroy;
+    result->source.onWait = NULL;
+    result->fd = fd;
+
+    return &result->source;
+}
+
+typedef struct followSource_t {
+    streamSource_t source;
+    int fd;
+
+    // An inotify instance watching the file so we can wake up as soon as it grows, or -1 to check it at intervals instead
+    int notifyFd;
+
+    int idleTimeoutMS;
+
+    // How much of the file we've read so far
+    uint64_t offset;
+} followSource_t;
+
+/**
+ * Wait until the followed file grows past the bytes we've read from it. Returns false if it doesn't grow for the
+ * source's idle timeout, or if it was truncated (e.g. because the recorder started again from scratch).
+ */
+static bool followSourceWaitForGrowth(followSource_t *follow)
+{
+    struct stat stats;
+    int idleMS = 0;
+
+    if (follow->source.onWait) {
+        follow->source.onWait(follow->source.onWaitData);
+    }
+
+    while (follow->idleTimeoutMS == 0 || idleMS < follow->idleTimeoutMS) {
+        if (fstat(follow->fd, &stats) != 0) {
+            return false;
+        }
+
+        if ((uint64_t) stats.st_size > follow->offset) {
+            return true;
+        }
+
+        if ((uint64_t) stats.st_size < follow->offset) {
+            fprintf(stderr, "The log file was truncated while it was being followed, so the rest of it was ignored\n");
+            return false;
+        }
+
+#ifdef __linux__
+        if (follow->notifyFd >= 0) {
+            struct pollfd pollFd = {.fd = follow->notifyFd, .events = POLLIN};
+            char events[1024];
+
+            if (poll(&pollFd, 1, FOLLOW_POLL_INTERVAL_MS) > 0) {
+                // We only need to be woken up, fstat() tells us what happened
+                while (read(follow->notifyFd, events, sizeof(events)) > 0) {
+                }
+            } else {
+                idleMS += FOLLOW_POLL_INTERVAL_MS;
+            }
+
+            continue;
+        }
+#endif
+
+        usleep(FOLLOW_POLL_INTERVAL_MS * 1000);
+        idleMS += FOLLOW_POLL_INTERVAL_MS;
+    }
+
+    return false;
+}
+
+static size_t followSourceRead(streamSource_t *source, char *buffer, size_t minimum, size_t length)
+{
+    followSource_t *follow = (followSource_t *) source;
+    size_t total = 0;
+
+    while (total < minimum) {
+        ssize_t bytesRead = read(follow->fd, buffer + total, length - total);
+
+        if (bytesRead > 0) {
+            total += bytesRead;
+            follow->offset += bytesRead;
+        } else if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        } else if (bytesRead < 0 || !followSourceWaitForGrowth(follow)) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+static void followSourceDestroy(streamSource_t *source)
+{
+    followSource_t *follow = (followSource_t *) source;
+
+    if (follow->notifyFd >= 0) {
+        close(follow->notifyFd);
+    }
+
+    free(follow);
+}
+
+/**
+ * Create a source which reads a file that's still being written (like a log being recorded over a serial bridge) from
+ * its current position. When it catches up with the writer it waits for the file to grow, so the parser picks up where
+ * it left off without decoding anything twice. The input ends once the file hasn't grown for `idleTimeoutMS` (or never
+ * if that's zero), or if the file is truncated.
+ *
+ * The file is left open when the source is destroyed.
+ */
+streamSource_t* streamSourceCreateFollowingFile(int fd, int idleTimeoutMS)
+{
+    followSource_t *result = malloc(sizeof(*result));
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+
+    result->source.read = followSourceRead;
+    result->source.destroy = followSourceDestroy;
+    result->source.onWait = NULL;
+    result->fd = fd;
+    result->notifyFd = -1;
+    result->idleTimeoutMS = idleTimeoutMS;
+    result->offset = offset > 0 ? (uint64_t) offset : 0;
+
+#ifdef __linux__
+    result->notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (result->notifyFd >= 0) {
+        char path[64];
+
+        // Watch the file we have open, even if it has been renamed since
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+
+        if (inotify_add_watch(result->notifyFd, path, IN_MODIFY) < 0) {
+            close(result->notifyFd);
+            result->notifyFd = -1;
+        }
+    }
+#endif
+
+    return &result->source;
+}
+
+/**
+ * Get the offset of the byte at `pos` in the stream's window from the start of the whole input, which for a stream
+ * read from a source can be far more than the window holds.
+ */
+int64_t streamOffset(const mmapStream_t *stream, const char *pos)
+{
+    return (int64_t) stream->windowOffset + (pos - stream->data);
+}
+
+/**
+ * Make the stream read its input from offset `begin` up to `end` (e.g. a single log of the file), beginning at `begin`.
+ * A file that's mapped a window at a time has its window mapped there, and the windows that follow stop at `end`.
+ *
+ * Returns false if the range doesn't lie in the input, or if the stream reads from a source (which can't go back).
+ */
+bool streamSetRange(mmapStream_t *stream, int64_t begin, int64_t end)
+{
+    if (stream->source || begin < 0 || begin > end) {
+        return false;
+    }
+
+    if (stream->windowed) {
+        if ((uint64_t) end > (uint64_t) stream->mapping.stats.st_size) {
+            return false;
+        }
+
+        stream->rangeBegin = begin;
+        stream->rangeEnd = end;
+
+        if (!streamMapWindow(stream, begin)) {
+            return false;
+        }
+    } else {
+        if ((uint64_t) end > stream->size) {
+            return false;
+        }
+
+        stream->pos = stream->data + begin;
+        stream->end = stream->data + end;
+    }
+
+    stream->start = stream->pos;
+    stream->bitPos = CHAR_BIT - 1;
+    stream->eof = false;
+
+    return true;
+}
+
+/**
+ * Move the end of the stream's range back to the offset `end`, so that reading stops there.
+ */
+void streamSetEnd(mmapStream_t *stream, int64_t end)
+{
+    if (stream->windowed && !stream->source) {
+        stream->rangeEnd = end;
+
+        // The windows after this one will stop at the new end, but this one has to be cut short if it reaches it
+        if ((uint64_t) end - stream->windowOffset <= (uint64_t) (stream->windowEnd - stream->data)) {
+            stream->windowEnd = stream->data + (end - stream->windowOffset);
+            stream->sourceEnded = true;
+        }
+
+        stream->end = stream->windowEnd;
+    } else {
+        stream->end = stream->data + (end - stream->windowOffset);
+    }
+}
+
+/**
+ * Move the read position to the offset `offset` of the stream's input. A file that's mapped a window at a time has the
+ * window around it mapped instead, unless the current one already holds more than STREAM_WINDOW_LOOKAHEAD bytes after
+ * it (or the rest of the range).
+ *
+ * Returns false if the offset lies outside of the stream's range, or the stream reads from a source.
+ */
+bool streamSeek(mmapStream_t *stream, int64_t offset)
+{
+    if (stream->source) {
+        return false;
+    }
+
+    if (stream->windowed) {
+        uint64_t windowLength = stream->windowEnd - stream->data;
+
+        if (offset < (int64_t) stream->rangeBegin || (uint64_t) offset > stream->rangeEnd) {
+            return false;
+        }
+
+        if ((uint64_t) offset < stream->windowOffset || (uint64_t) offset - stream->windowOffset > windowLength
+                || (!stream->sourceEnded && (uint64_t) offset - stream->windowOffset + STREAM_WINDOW_LOOKAHEAD >= windowLength)) {
+            if (!streamMapWindow(stream, offset)) {
+                return false;
+            }
+        } else {
+            stream->pos = stream->data + (offset - stream->windowOffset);
+        }
+    } else {
+        if (offset < stream->start - stream->data || offset > stream->end - stream->data) {
+            return false;
+        }
+
+        stream->pos = stream->data + offset;
+    }
+
+    stream->bitPos = CHAR_BIT - 1;
+    stream->eof = false;
+
+    return true;
+}
+
+void streamDestroy(mmapStream_t *stream)
+{
+    if (stream->source) {
+        stream->source->destroy(stream->source);
+        free((char*) stream->data);
+    } else {
+        munmap_file(&stream->mapping);
+    }
+
     free(stream);
 }
@@ -3,6 +3,26 @@
 
 #include "platform.h"
 
+/*
+ * Inputs that can't be memory-mapped (like serial ports) supply their bytes through a source instead. The stream reads
+ * them into a window that slides along the input as the parser advances.
+ */
+typedef struct streamSource_t {
+    /*
+     * Copy up to `length` of the next bytes of the input into `buffer`, waiting until at least `minimum` of them are
+     * available. Returns the number of bytes copied, which is less than `minimum` only if the input has ended.
+     */
+    size_t (*read)(struct streamSource_t *source, char *buffer, size_t minimum, size_t length);
+    void (*destroy)(struct streamSource_t *source);
+
+    /*
+     * Optional, for sources which may have to wait a while for more input: this is called with onWaitData before they
+     * start waiting, so that the reader can finish off what it has made of the input so far (e.g. by flushing its output).
+     */
+    void (*onWait)(void *data);
+    void *onWaitData;
+} streamSource_t;
+
 typedef struct mmapStream_t {
     fileMapping_t mapping;
 
@@ -20,18 +40,64 @@ typedef struct mmapStream_t {
 
     //Set to true if we attempt to read from the log when it is already exhausted
     bool eof;
+
+    /*
+     * Set when the data is a window that slides along the input, rather than the whole of it. That's the case for
+     * streams read from a source, and for very large files which are mapped into memory a window at a time.
+     */
+    bool windowed;
+
+    //For streams read from a source, where the bytes come from
+    streamSource_t *source;
+
+    //For windowed streams, the offset into the input of the window's first byte, and whether the window reaches its end
+    uint64_t windowOffset;
+    bool sourceEnded;
+
+    //The end of the bytes which have been read into the window so far (end is only different when it was moved back)
+    const char *windowEnd;
+
+    //For a file that's mapped a window at a time, the offsets where the stream's range begins and ends (see streamSetRange())
+    uint64_t rangeBegin, rangeEnd;
 } mmapStream_t;
 
-typedef enum ParserState {
-    PARSER_STATE_HEADER = 0,
-    PARSER_STATE_TRANSITION,
-    PARSER_STATE_DATA
-} ParserState;
+/*
+ * A stream read from a source keeps at least this many bytes ahead of the read position in its window (unless the input
+ * ends first), which is enough for the longest header line or frame to be read without refilling it.
+ */
+#define STREAM_WINDOW_LOOKAHEAD (2 * FLIGHT_LOG_MAX_FRAME_HEADER_LENGTH)
+
+//And it keeps this many bytes behind the read position when it slides the window along, so that frames can be re-read
+#define STREAM_WINDOW_LOOKBEHIND (2 * FLIGHT_LOG_MAX_FRAME_LENGTH)
+
+#define STREAM_WINDOW_SIZE (256 * 1024)
+
+/*
+ * Files larger than this are mapped into memory a window of STREAM_MAPPED_WINDOW_SIZE bytes at a time, so that the
+ * memory they take up doesn't grow with their size (at the cost of being decoded in order, like a pipe).
+ */
+#ifndef STREAM_MAX_WHOLE_MAPPING_SIZE
+    #define STREAM_MAX_WHOLE_MAPPING_SIZE (1024 * 1024 * 1024)
+#endif
+
+// (This must be a multiple of MMAP_RANGE_ALIGNMENT)
+#ifndef STREAM_MAPPED_WINDOW_SIZE
+    #define STREAM_MAPPED_WINDOW_SIZE (16 * 1024 * 1024)
+#endif
 
-void fillSerialBuffer(mmapStream_t *stream,size_t bytesParsedDataSize, ParserState *parserState);
 mmapStream_t* streamCreate(int fd);
+mmapStream_t* streamCreateWindowed(int fd);
+streamSource_t* streamSourceCreateFromFile(int fd);
+streamSource_t* streamSourceCreateFollowingFile(int fd, int idleTimeoutMS);
+mmapStream_t* streamCreateFromSource(streamSource_t *source);
+void streamFillWindow(mmapStream_t *stream);
 void streamDestroy(mmapStream_t *stream);
 
+int64_t streamOffset(const mmapStream_t *stream, const char *pos);
+bool streamSetRange(mmapStream_t *stream, int64_t begin, int64_t end);
+void streamSetEnd(mmapStream_t *stream, int64_t end);
+bool streamSeek(mmapStream_t *stream, int64_t offset);
+
 int streamPeekChar(mmapStream_t *stream);
 char streamReadChar(mmapStream_t *stream);
 int streamReadByte(mmapStream_t *stream);
@@ -39,11 +105,15 @@ void streamUnreadChar(mmapStream_t *stream);
 
 void streamRead(mmapStream_t *stream, void *buf, int len);
 
+uint64_t streamPeekBits64(mmapStream_t *stream, int *numBits);
+void streamSkipBits(mmapStream_t *stream, int numBits);
+
 uint32_t streamReadBits(mmapStream_t *stream, int numBits);
 int streamReadBit(mmapStream_t *stream);
 void streamByteAlign(mmapStream_t *stream);
 
 uint32_t streamReadUnsignedVB(mmapStream_t *stream);
+void streamReadUnsignedVBs(mmapStream_t *stream, uint32_t *values, int count);
 int32_t streamReadSignedVB(mmapStream_t *stream);
 
 #endif
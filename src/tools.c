@@ -1,4 +1,9 @@
 #include <string.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
 #include "tools.h"
 
 int32_t signExtend24Bit(uint32_t u)
@@ -31,6 +36,49 @@ int32_t signExtend2Bit(uint8_t byte)
     return (byte & 0x02) ? (int32_t) (int8_t) (byte | 0xFC) : byte;
 }
 
+/**
+ * Count the number of zero bits above the highest set bit of the given value (64 if the value is zero).
+ */
+int countLeadingZeros64(uint64_t value)
+{
+    if (value == 0) {
+        return 64;
+    }
+
+#if defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    int result = 0;
+
+    while (!(value & 0x8000000000000000ULL)) {
+        value <<= 1;
+        result++;
+    }
+
+    return result;
+#endif
+}
+
+int countTrailingZeros64(uint64_t value)
+{
+    if (value == 0) {
+        return 64;
+    }
+
+#if defined(__GNUC__)
+    return __builtin_ctzll(value);
+#else
+    int result = 0;
+
+    while (!(value & 1)) {
+        value >>= 1;
+        result++;
+    }
+
+    return result;
+#endif
+}
+
 bool startsWith(const char *string, const char *checkStartsWith)
 {
     return strncmp(string, checkStartsWith, strlen(checkStartsWith)) == 0;
@@ -116,18 +164,77 @@ int32_t zigzagDecode(uint32_t value)
 
 /**
  * Just like strstr, but for binary strings. Not available on all platforms, so reimplemented here.
+ *
+ * Positions are ruled out many at a time by comparing their first and last bytes with those of the needle (with SSE2
+ * where we have it, otherwise a word at a time), so the whole needle only has to be compared at the rare positions where
+ * both of those match.
  */
 void* memmem(const void *haystack, size_t haystackLen, const void *needle, size_t needleLen)
 {
-    if (needleLen <= haystackLen) {
-        const char* c_haystack = (char*)haystack;
-        const char* c_needle = (char*)needle;
+    const uint8_t *c_haystack = (const uint8_t*) haystack;
+    const uint8_t *c_needle = (const uint8_t*) needle;
+    size_t positions, pos = 0;
+
+    if (needleLen == 0) {
+        return (void*) haystack;
+    }
+
+    if (needleLen > haystackLen) {
+        return NULL;
+    }
+
+    positions = haystackLen - needleLen + 1;
+
+#if defined(__SSE2__)
+    {
+        const __m128i first = _mm_set1_epi8((char) c_needle[0]);
+        const __m128i last = _mm_set1_epi8((char) c_needle[needleLen - 1]);
+
+        for (; pos + 16 <= positions; pos += 16) {
+            __m128i firstMatches = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i*) (c_haystack + pos)));
+            __m128i lastMatches = _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i*) (c_haystack + pos + needleLen - 1)));
+            uint32_t candidates = (uint32_t) _mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches));
+
+            while (candidates) {
+                size_t candidate = pos + countTrailingZeros64(candidates);
+
+                if (memcmp(c_haystack + candidate, c_needle, needleLen) == 0)
+                    return (void*) (c_haystack + candidate);
 
-        for (const char *pos = c_haystack; pos <= c_haystack + haystackLen - needleLen; pos++) {
-            if (*pos == *c_needle && memcmp(pos, c_needle, needleLen) == 0)
-                return (void*)pos;
+                candidates &= candidates - 1;
+            }
         }
     }
+#else
+    {
+        const uint64_t ONES = 0x0101010101010101ULL, HIGH_BITS = 0x8080808080808080ULL;
+        const uint64_t first = c_needle[0] * ONES;
+        const uint64_t last = c_needle[needleLen - 1] * ONES;
+
+        for (; pos + 8 <= positions; pos += 8) {
+            uint64_t firstWord, lastWord, mismatches;
+
+            memcpy(&firstWord, c_haystack + pos, sizeof(firstWord));
+            memcpy(&lastWord, c_haystack + pos + needleLen - 1, sizeof(lastWord));
+
+            // Has a zero byte wherever both the first and last bytes match
+            mismatches = (firstWord ^ first) | (lastWord ^ last);
+
+            if (((mismatches - ONES) & ~mismatches & HIGH_BITS) == 0)
+                continue;
+
+            for (size_t candidate = pos; candidate < pos + 8; candidate++) {
+                if (c_haystack[candidate] == c_needle[0] && memcmp(c_haystack + candidate, c_needle, needleLen) == 0)
+                    return (void*) (c_haystack + candidate);
+            }
+        }
+    }
+#endif
+
+    for (; pos < positions; pos++) {
+        if (c_haystack[pos] == c_needle[0] && memcmp(c_haystack + pos, c_needle, needleLen) == 0)
+            return (void*) (c_haystack + pos);
+    }
 
     return NULL;
 }
@@ -10,6 +10,17 @@
 #define STR_HELPER(x) #x
 #define STR(x) STR_HELPER(x)
 
+/*
+ * Expand m(n) for every n from 0 to 255, for building lookup tables with the preprocessor. Each n is a single hex
+ * literal (0x00 to 0xFF) rather than a sum, which keeps big tables quick to compile.
+ */
+#define REPEAT_16(m, high) m(0x##high##0) m(0x##high##1) m(0x##high##2) m(0x##high##3) m(0x##high##4) m(0x##high##5) \
+    m(0x##high##6) m(0x##high##7) m(0x##high##8) m(0x##high##9) m(0x##high##A) m(0x##high##B) m(0x##high##C) \
+    m(0x##high##D) m(0x##high##E) m(0x##high##F)
+#define REPEAT_256(m) REPEAT_16(m, 0) REPEAT_16(m, 1) REPEAT_16(m, 2) REPEAT_16(m, 3) REPEAT_16(m, 4) REPEAT_16(m, 5) \
+    REPEAT_16(m, 6) REPEAT_16(m, 7) REPEAT_16(m, 8) REPEAT_16(m, 9) REPEAT_16(m, A) REPEAT_16(m, B) REPEAT_16(m, C) \
+    REPEAT_16(m, D) REPEAT_16(m, E) REPEAT_16(m, F)
+
 typedef union floatConvert_t {
     float f;
     uint32_t u;
@@ -30,6 +41,9 @@ int32_t signExtend2Bit(uint8_t byte);
 uint32_t zigzagEncode(int32_t value);
 int32_t zigzagDecode(uint32_t value);
 
+int countLeadingZeros64(uint64_t value);
+int countTrailingZeros64(uint64_t value);
+
 double doubleAbs(double a);
 double doubleMin(double a, double b);
 double doubleMax(double a, double b);
@@ -0,0 +1,301 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "videowriter.h"
+
+#define VIDEO_WRITER_BUFFER_SIZE (4 * 1024 * 1024)
+
+/*
+ * BT.601 studio-swing conversion from RGB in 8.8 fixed point. The chroma offset is folded into the constant so that the
+ * shifted value is never negative.
+ */
+#define RGB_TO_Y(r, g, b) ((uint8_t) (((66 * (r) + 129 * (g) + 25 * (b) + 128) >> 8) + 16))
+#define RGB_TO_U(r, g, b) ((uint8_t) ((-38 * (r) - 74 * (g) + 112 * (b) + (128 << 8) + 128) >> 8))
+#define RGB_TO_V(r, g, b) ((uint8_t) ((112 * (r) - 94 * (g) - 18 * (b) + (128 << 8) + 128) >> 8))
+
+/*
+ * Cairo's ARGB32 pixels are native-endian 32-bit words with premultiplied alpha. Since the renderer draws onto a
+ * transparent background, the premultiplied colour is already the frame composited over black.
+ */
+#define PIXEL_A(p) ((int) ((p) >> 24))
+#define PIXEL_R(p) ((int) (((p) >> 16) & 0xFF))
+#define PIXEL_G(p) ((int) (((p) >> 8) & 0xFF))
+#define PIXEL_B(p) ((int) ((p) & 0xFF))
+
+static const char Y4M_FRAME_HEADER[] = "FRAME\n";
+
+static const uint32_t* rowOfPixels(const uint8_t *argb, int stride, int y)
+{
+    return (const uint32_t*) (argb + (size_t) y * stride);
+}
+
+#if defined(__SSE2__)
+
+/**
+ * Split 8 pixels into one 16-bit lane per pixel for each of their red, green and blue channels.
+ */
+static void splitPixelsSSE2(const uint32_t *pixels, __m128i *r, __m128i *g, __m128i *b)
+{
+    const __m128i channelMask = _mm_set1_epi32(0xFF);
+    __m128i lo = _mm_loadu_si128((const __m128i*) pixels);
+    __m128i hi = _mm_loadu_si128((const __m128i*) (pixels + 4));
+
+    *r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), channelMask), _mm_and_si128(_mm_srli_epi32(hi, 16), channelMask));
+    *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), channelMask), _mm_and_si128(_mm_srli_epi32(hi, 8), channelMask));
+    *b = _mm_packs_epi32(_mm_and_si128(lo, channelMask), _mm_and_si128(hi, channelMask));
+}
+
+/**
+ * RGB_TO_Y() for 8 pixels at once. The sum before the shift never exceeds 16 bits, so 16-bit lanes give exactly the
+ * same result.
+ */
+static __m128i lumaOfPixelsSSE2(const uint32_t *pixels)
+{
+    __m128i r, g, b, sum;
+
+    splitPixelsSSE2(pixels, &r, &g, &b);
+
+    sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    sum = _mm_add_epi16(sum, _mm_set1_epi16(128));
+
+    return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+/**
+ * Compute the luma of a row 16 pixels at a time, returning the number of pixels done (the caller does the rest).
+ */
+static int convertLumaSSE2(const uint32_t *row, uint8_t *luma, int width)
+{
+    int x;
+
+    for (x = 0; x + 16 <= width; x += 16) {
+        _mm_storeu_si128((__m128i*) (luma + x), _mm_packus_epi16(lumaOfPixelsSSE2(row + x), lumaOfPixelsSSE2(row + x + 8)));
+    }
+
+    return x;
+}
+
+/**
+ * Add up each horizontal pair of 16-bit lanes from two vectors, giving the 8 sums in order.
+ */
+static __m128i sumPairsSSE2(__m128i lo, __m128i hi)
+{
+    const __m128i laneMask = _mm_set1_epi32(0xFFFF);
+
+    lo = _mm_add_epi32(_mm_and_si128(lo, laneMask), _mm_srli_epi32(lo, 16));
+    hi = _mm_add_epi32(_mm_and_si128(hi, laneMask), _mm_srli_epi32(hi, 16));
+
+    return _mm_packs_epi32(lo, hi);
+}
+
+/**
+ * Average one colour channel over 8 2x2 blocks, given that channel for 16 pixels of the top and bottom rows.
+ */
+static __m128i averageBlocksSSE2(__m128i topLo, __m128i topHi, __m128i bottomLo, __m128i bottomHi)
+{
+    __m128i sums = sumPairsSSE2(_mm_add_epi16(topLo, bottomLo), _mm_add_epi16(topHi, bottomHi));
+
+    return _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+}
+
+/**
+ * Compute the chroma of a pair of rows 8 blocks (16 pixels) at a time, with the same rounding as the RGB_TO_U() and
+ * RGB_TO_V() macros. Returns the number of chroma samples done, which only counts whole blocks.
+ */
+static int convertChromaSSE2(const uint32_t *top, const uint32_t *bottom, uint8_t *chromaU, uint8_t *chromaV, int width)
+{
+    const __m128i offset = _mm_set1_epi16((short) ((128 << 8) + 128));
+    int x;
+
+    for (x = 0; x * 2 + 16 <= width; x += 8) {
+        __m128i topR[2], topG[2], topB[2], bottomR[2], bottomG[2], bottomB[2];
+        __m128i r, g, b, u, v;
+
+        splitPixelsSSE2(top + x * 2, &topR[0], &topG[0], &topB[0]);
+        splitPixelsSSE2(top + x * 2 + 8, &topR[1], &topG[1], &topB[1]);
+        splitPixelsSSE2(bottom + x * 2, &bottomR[0], &bottomG[0], &bottomB[0]);
+        splitPixelsSSE2(bottom + x * 2 + 8, &bottomR[1], &bottomG[1], &bottomB[1]);
+
+        r = averageBlocksSSE2(topR[0], topR[1], bottomR[0], bottomR[1]);
+        g = averageBlocksSSE2(topG[0], topG[1], bottomG[0], bottomG[1]);
+        b = averageBlocksSSE2(topB[0], topB[1], bottomB[0], bottomB[1]);
+
+        // Both sums lie between 0 and 0xFFFF once the offset is added, so wrapping 16-bit arithmetic is exact
+        u = _mm_sub_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(112)), _mm_mullo_epi16(r, _mm_set1_epi16(38)));
+        u = _mm_sub_epi16(u, _mm_mullo_epi16(g, _mm_set1_epi16(74)));
+        u = _mm_srli_epi16(_mm_add_epi16(u, offset), 8);
+
+        v = _mm_sub_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(112)), _mm_mullo_epi16(g, _mm_set1_epi16(94)));
+        v = _mm_sub_epi16(v, _mm_mullo_epi16(b, _mm_set1_epi16(18)));
+        v = _mm_srli_epi16(_mm_add_epi16(v, offset), 8);
+
+        _mm_storel_epi64((__m128i*) (chromaU + x), _mm_packus_epi16(u, u));
+        _mm_storel_epi64((__m128i*) (chromaV + x), _mm_packus_epi16(v, v));
+    }
+
+    return x;
+}
+
+#endif
+
+/**
+ * Convert to planar 4:2:0 YCbCr. Chroma is computed from the average colour of each 2x2 block (blocks at an odd right
+ * or bottom edge reuse the last pixel).
+ *
+ * With SSE2 the bulk of each row is converted 16 pixels at a time, and the loops here finish off whatever is left.
+ */
+static void convertToI420(const videoWriter_t *writer, const uint8_t *argb, int stride, uint8_t *frame)
+{
+    int width = writer->width, height = writer->height;
+    int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    uint8_t *planeY = frame;
+    uint8_t *planeU = planeY + (size_t) width * height;
+    uint8_t *planeV = planeU + (size_t) chromaWidth * chromaHeight;
+
+    for (int y = 0; y < height; y++) {
+        const uint32_t *row = rowOfPixels(argb, stride, y);
+        uint8_t *luma = planeY + (size_t) y * width;
+        int x = 0;
+
+#if defined(__SSE2__)
+        x = convertLumaSSE2(row, luma, width);
+#endif
+
+        for (; x < width; x++) {
+            uint32_t pixel = row[x];
+
+            luma[x] = RGB_TO_Y(PIXEL_R(pixel), PIXEL_G(pixel), PIXEL_B(pixel));
+        }
+    }
+
+    for (int y = 0; y < chromaHeight; y++) {
+        const uint32_t *top = rowOfPixels(argb, stride, y * 2);
+        const uint32_t *bottom = rowOfPixels(argb, stride, y * 2 + 1 < height ? y * 2 + 1 : y * 2);
+        uint8_t *chromaU = planeU + (size_t) y * chromaWidth;
+        uint8_t *chromaV = planeV + (size_t) y * chromaWidth;
+        int x = 0;
+
+#if defined(__SSE2__)
+        x = convertChromaSSE2(top, bottom, chromaU, chromaV, width);
+#endif
+
+        for (; x < chromaWidth; x++) {
+            int left = x * 2, right = x * 2 + 1 < width ? x * 2 + 1 : x * 2;
+            int r = (PIXEL_R(top[left]) + PIXEL_R(top[right]) + PIXEL_R(bottom[left]) + PIXEL_R(bottom[right]) + 2) >> 2;
+            int g = (PIXEL_G(top[left]) + PIXEL_G(top[right]) + PIXEL_G(bottom[left]) + PIXEL_G(bottom[right]) + 2) >> 2;
+            int b = (PIXEL_B(top[left]) + PIXEL_B(top[right]) + PIXEL_B(bottom[left]) + PIXEL_B(bottom[right]) + 2) >> 2;
+
+            chromaU[x] = RGB_TO_U(r, g, b);
+            chromaV[x] = RGB_TO_V(r, g, b);
+        }
+    }
+}
+
+/**
+ * Convert to bytes in R, G, B, A order with the alpha divided back out of the colour channels, which is what
+ * ffmpeg's "rgba" pixel format expects.
+ */
+static void convertToRGBA(const videoWriter_t *writer, const uint8_t *argb, int stride, uint8_t *frame)
+{
+    for (int y = 0; y < writer->height; y++) {
+        const uint32_t *row = rowOfPixels(argb, stride, y);
+        uint8_t *dest = frame + (size_t) y * writer->width * 4;
+
+        for (int x = 0; x < writer->width; x++, dest += 4) {
+            uint32_t pixel = row[x];
+            int alpha = PIXEL_A(pixel);
+
+            if (alpha == 0xFF || alpha == 0) {
+                dest[0] = PIXEL_R(pixel);
+                dest[1] = PIXEL_G(pixel);
+                dest[2] = PIXEL_B(pixel);
+            } else {
+                dest[0] = (PIXEL_R(pixel) * 255 + alpha / 2) / alpha;
+                dest[1] = (PIXEL_G(pixel) * 255 + alpha / 2) / alpha;
+                dest[2] = (PIXEL_B(pixel) * 255 + alpha / 2) / alpha;
+            }
+
+            dest[3] = alpha;
+        }
+    }
+}
+
+/**
+ * Convert a frame from Cairo's ARGB32 format into the writer's output format. `frame` must have room for
+ * writer->frameSize bytes.
+ */
+void videoWriterConvertFrame(const videoWriter_t *writer, const uint8_t *argb, int stride, uint8_t *frame)
+{
+    switch (writer->format) {
+        case VIDEO_FORMAT_Y4M:
+            convertToI420(writer, argb, stride, frame);
+        break;
+        case VIDEO_FORMAT_RGBA:
+            convertToRGBA(writer, argb, stride, frame);
+        break;
+        default:
+            ;
+    }
+}
+
+/**
+ * Write the next frame of the video (which must have been converted by videoWriterConvertFrame()).
+ *
+ * Returns false if the output couldn't be written (e.g. the encoder reading from our pipe has gone away).
+ */
+bool videoWriterWriteFrame(videoWriter_t *writer, const uint8_t *frame)
+{
+    if (writer->format == VIDEO_FORMAT_Y4M && fwrite(Y4M_FRAME_HEADER, 1, strlen(Y4M_FRAME_HEADER), writer->file) != strlen(Y4M_FRAME_HEADER))
+        return false;
+
+    return fwrite(frame, 1, writer->frameSize, writer->file) == writer->frameSize;
+}
+
+videoWriter_t* videoWriterCreate(FILE *file, VideoFormat format, int width, int height, int fps)
+{
+    videoWriter_t *result = malloc(sizeof(*result));
+
+    result->format = format;
+    result->file = file;
+    result->width = width;
+    result->height = height;
+
+    switch (format) {
+        case VIDEO_FORMAT_Y4M:
+            result->frameSize = (size_t) width * height + (size_t) 2 * ((width + 1) / 2) * ((height + 1) / 2);
+        break;
+        case VIDEO_FORMAT_RGBA:
+            result->frameSize = (size_t) width * height * 4;
+        break;
+        default:
+            result->frameSize = 0;
+    }
+
+    // Frames are large, so write them out in big chunks
+    setvbuf(file, NULL, _IOFBF, VIDEO_WRITER_BUFFER_SIZE);
+
+    if (format == VIDEO_FORMAT_Y4M) {
+        // Square pixels, progressive, with chroma sited in the center of each 2x2 block
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+
+    return result;
+}
+
+/**
+ * Flush anything that's still buffered and free the writer. The file is left open.
+ */
+void videoWriterDestroy(videoWriter_t *writer)
+{
+    if (!writer)
+        return;
+
+    fflush(writer->file);
+
+    free(writer);
+}
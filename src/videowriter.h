@@ -0,0 +1,36 @@
+#ifndef VIDEOWRITER_H_
+#define VIDEOWRITER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum VideoFormat {
+    VIDEO_FORMAT_PNG = 0, // One PNG file per frame (not handled by the video writer)
+    VIDEO_FORMAT_Y4M = 1, // YUV4MPEG2 stream with 4:2:0 chroma, frames composited over black
+    VIDEO_FORMAT_RGBA = 2 // Headerless stream of straight (non-premultiplied) RGBA frames
+} VideoFormat;
+
+/**
+ * Writes rendered frames to a single stream (such as stdout or a FIFO) that a video encoder can read directly.
+ *
+ * Converting a frame doesn't touch the writer's state, so frames can be converted on several threads at once, but they
+ * must be written in order.
+ */
+typedef struct videoWriter_t {
+    VideoFormat format;
+    FILE *file;
+
+    int width, height;
+
+    // Size in bytes of a converted frame
+    size_t frameSize;
+} videoWriter_t;
+
+videoWriter_t* videoWriterCreate(FILE *file, VideoFormat format, int width, int height, int fps);
+void videoWriterDestroy(videoWriter_t *writer);
+
+void videoWriterConvertFrame(const videoWriter_t *writer, const uint8_t *argb, int stride, uint8_t *frame);
+bool videoWriterWriteFrame(videoWriter_t *writer, const uint8_t *frame);
+
+#endif
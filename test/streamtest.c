@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+#include "streamtest.h"
+
+// Fuzzed streams are short so that most reads run into the end of the stream sooner or later
+#define FUZZ_STREAM_MAX_LENGTH 64
+
+typedef struct memorySource_t {
+	streamSource_t source;
+
+	const uint8_t *data;
+	size_t length, pos;
+
+	size_t maxChunk;
+	uint32_t seed;
+} memorySource_t;
+
+/*
+ * Point the stream at a buffer that is already entirely in memory.
+ */
+void initStream(mmapStream_t *stream, const uint8_t *buffer, int length)
+{
+	memset(stream, 0, sizeof(*stream));
+
+	stream->data = stream->start = stream->pos = (const char *) buffer;
+	stream->end = stream->data + length;
+	stream->size = length;
+	stream->bitPos = CHAR_BIT - 1;
+	stream->eof = false;
+}
+
+/*
+ * Read random streams with the reference and fast decoders side by side, checking after every step that the two
+ * streams are in the same state. Reading carries on for a few steps after the end of the stream to check the behaviour
+ * at EOF too.
+ */
+void fuzzStreams(int streamCount, FuzzFillFunc fill, FuzzStepFunc step)
+{
+	uint8_t buffer[FUZZ_STREAM_MAX_LENGTH];
+
+	for (int i = 0; i < streamCount; i++) {
+		int length = rand() % (sizeof(buffer) + 1);
+		mmapStream_t reference, stream;
+
+		fill(buffer, length);
+
+		initStream(&reference, buffer, length);
+		initStream(&stream, buffer, length);
+
+		for (int steps = 0; !reference.eof || steps % 4 != 0; steps++) {
+			step(&reference, &stream);
+
+			assert(reference.pos == stream.pos);
+			assert(reference.bitPos == stream.bitPos);
+			assert(reference.eof == stream.eof);
+		}
+	}
+}
+
+double secondsSince(clock_t start)
+{
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+void printBenchmark(const char *task, const char *referenceName, double referenceTime, const char *name, double time)
+{
+	printf("%s: %s %.3fs, %s %.3fs (%.1fx)\n", task, referenceName, referenceTime, name, time,
+		time > 0 ? referenceTime / time : 0);
+}
+
+// Supplies between `minimum` and a random number of bytes up to the source's maxChunk each time, like a pipe would
+static size_t memorySourceRead(streamSource_t *streamSource, char *buffer, size_t minimum, size_t length)
+{
+	memorySource_t *source = (memorySource_t *) streamSource;
+	size_t count;
+
+	source->seed = source->seed * 1103515245 + 12345;
+	count = 1 + (source->seed >> 16) % source->maxChunk;
+
+	if (count < minimum)
+		count = minimum;
+	if (count > length)
+		count = length;
+	if (count > source->length - source->pos)
+		count = source->length - source->pos;
+
+	memcpy(buffer, source->data + source->pos, count);
+	source->pos += count;
+
+	return count;
+}
+
+static void memorySourceDestroy(streamSource_t *source)
+{
+	free(source);
+}
+
+/*
+ * Make a stream source that reads from the given buffer. A maxChunk of 1 hands over only as many bytes as the reader
+ * asks for at a time, so that everything it reads arrives in pieces.
+ */
+streamSource_t* memorySourceCreate(const uint8_t *data, size_t length, size_t maxChunk)
+{
+	memorySource_t *source = calloc(1, sizeof(*source));
+
+	assert(source);
+
+	source->source.read = memorySourceRead;
+	source->source.destroy = memorySourceDestroy;
+	source->data = data;
+	source->length = length;
+	source->maxChunk = maxChunk;
+	source->seed = 1;
+
+	return &source->source;
+}
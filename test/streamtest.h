@@ -0,0 +1,29 @@
+#ifndef STREAMTEST_H_
+#define STREAMTEST_H_
+
+/*
+ * Scaffolding shared by the tests of stream decoding: checking a fast stream decoder against a simple reference version
+ * of it, and feeding a buffer to the parser through a stream source.
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "../src/stream.h"
+
+// Fill the buffer for one fuzzed stream
+typedef void (*FuzzFillFunc)(uint8_t *buffer, int length);
+
+// Make the same random read from both streams, asserting that they gave the same values
+typedef void (*FuzzStepFunc)(mmapStream_t *reference, mmapStream_t *stream);
+
+void initStream(mmapStream_t *stream, const uint8_t *buffer, int length);
+
+void fuzzStreams(int streamCount, FuzzFillFunc fill, FuzzStepFunc step);
+
+double secondsSince(clock_t start);
+void printBenchmark(const char *task, const char *referenceName, double referenceTime, const char *name, double time);
+
+streamSource_t* memorySourceCreate(const uint8_t *data, size_t length, size_t maxChunk);
+
+#endif
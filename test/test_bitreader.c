@@ -0,0 +1,340 @@
+/*
+ * Checks that the word-at-a-time bit reader and the count-leading-zeros Elias decoders produce exactly the same values
+ * and stream state as the original bit-by-bit implementation (kept below as a reference), then benchmarks the two.
+ *
+ * The reference pins down the shifts that the original left undefined for corrupt codes, the same way the decoders do.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/stream.h"
+#include "../src/decoders.h"
+#include "../src/tools.h"
+
+#include "streamtest.h"
+
+#define BIT(n) ((uint32_t) 1 << ((n) & 31))
+
+#define NUM_FUZZ_STREAMS 20000
+#define BENCHMARK_VALUES 4000000
+
+static uint32_t refReadBits(mmapStream_t *stream, int numBits)
+{
+	uint32_t result = 0;
+
+	if (numBits > (stream->end - stream->pos) * CHAR_BIT - (CHAR_BIT - 1 - stream->bitPos)) {
+		stream->pos = stream->end;
+		stream->eof = true;
+		stream->bitPos = CHAR_BIT - 1;
+		return EOF;
+	}
+
+	while (numBits > 0) {
+		result |= ((((uint8_t)*stream->pos) >> stream->bitPos) & 0x01) << (numBits - 1);
+
+		if (stream->bitPos == 0) {
+			stream->pos++;
+			stream->bitPos = CHAR_BIT - 1;
+		} else {
+			stream->bitPos--;
+		}
+		numBits--;
+	}
+
+	return result;
+}
+
+static int refReadBit(mmapStream_t *stream)
+{
+	return refReadBits(stream, 1);
+}
+
+static uint32_t refReadEliasDeltaU32(mmapStream_t *stream)
+{
+	const int MAX_BIT_READ_SIZE = 32;
+
+	int lengthValBits = 0;
+	uint8_t length;
+	uint32_t lengthLowBits, resultLowBits;
+	uint32_t result;
+
+	while (lengthValBits <= MAX_BIT_READ_SIZE && refReadBit(stream) == 0) {
+		lengthValBits++;
+	}
+
+	if (stream->eof || lengthValBits > MAX_BIT_READ_SIZE) {
+		return 0;
+	}
+
+	lengthLowBits = refReadBits(stream, lengthValBits);
+
+	if (stream->eof) {
+		return 0;
+	}
+
+	length = (BIT(lengthValBits) | lengthLowBits) - 1;
+
+	if (length > MAX_BIT_READ_SIZE) {
+		return 0;
+	}
+
+	resultLowBits = refReadBits(stream, length);
+
+	if (stream->eof) {
+		return 0;
+	}
+
+	result = BIT(length) | resultLowBits;
+
+	if (result == 0xFFFFFFFF) {
+		int escapeVal = refReadBit(stream);
+
+		if (escapeVal == 0) {
+			return 0xFFFFFFFF - 1;
+		} else if (escapeVal == 1) {
+			return 0xFFFFFFFF;
+		} else {
+			return 0;
+		}
+	}
+
+	return result - 1;
+}
+
+static uint32_t refReadEliasGammaU32(mmapStream_t *stream)
+{
+	const int MAX_BIT_READ_SIZE = 32;
+
+	int valBits = 0;
+	uint32_t valueLowBits;
+	uint32_t result;
+
+	while (valBits <= MAX_BIT_READ_SIZE && refReadBit(stream) == 0) {
+		valBits++;
+	}
+
+	if (stream->eof || valBits > MAX_BIT_READ_SIZE) {
+		return 0;
+	}
+
+	valueLowBits = refReadBits(stream, valBits - 1);
+
+	if (stream->eof) {
+		return 0;
+	}
+
+	result = BIT(valBits - 1) | valueLowBits;
+
+	if (result == 0xFFFFFFFF) {
+		int escapeVal = refReadBit(stream);
+
+		if (escapeVal == 0) {
+			return 0xFFFFFFFF - 1;
+		} else if (escapeVal == 1) {
+			return 0xFFFFFFFF;
+		} else {
+			return 0;
+		}
+	}
+
+	return result - 1;
+}
+
+/* A tiny bit writer so we can produce streams that are mostly valid Elias codes */
+typedef struct bitWriter_t {
+	uint8_t *buffer;
+	int capacity, bitCount;
+} bitWriter_t;
+
+static void writeBits(bitWriter_t *writer, uint32_t value, int numBits)
+{
+	for (int i = numBits - 1; i >= 0 && writer->bitCount < writer->capacity * CHAR_BIT; i--, writer->bitCount++) {
+		if ((value >> i) & 1) {
+			writer->buffer[writer->bitCount / CHAR_BIT] |= 0x80 >> (writer->bitCount % CHAR_BIT);
+		}
+	}
+}
+
+static int numBitsToStore(uint32_t value)
+{
+	return 64 - countLeadingZeros64(value);
+}
+
+static void writeEliasDelta(bitWriter_t *writer, uint32_t value)
+{
+	int valueLen, lengthOfValueLen;
+
+	if (value == 0xFFFFFFFF) {
+		writeEliasDelta(writer, 0xFFFFFFFF - 1);
+		writeBits(writer, 1, 1);
+		return;
+	}
+
+	value++;
+	valueLen = numBitsToStore(value);
+	lengthOfValueLen = numBitsToStore(valueLen);
+
+	writeBits(writer, 0, lengthOfValueLen - 1);
+	writeBits(writer, valueLen, lengthOfValueLen);
+	writeBits(writer, value, valueLen - 1);
+
+	if (value == 0xFFFFFFFF) {
+		writeBits(writer, 0, 1);
+	}
+}
+
+static void writeEliasGamma(bitWriter_t *writer, uint32_t value)
+{
+	int valueLen;
+
+	if (value == 0xFFFFFFFF) {
+		writeEliasGamma(writer, 0xFFFFFFFF - 1);
+		writeBits(writer, 1, 1);
+		return;
+	}
+
+	value++;
+	valueLen = numBitsToStore(value);
+
+	writeBits(writer, 0, valueLen);
+	writeBits(writer, value, valueLen);
+
+	if (value == 0xFFFFFFFF) {
+		writeBits(writer, 0, 1);
+	}
+}
+
+static uint32_t randomValue(void)
+{
+	uint32_t value = ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+
+	switch (rand() % 4) {
+		case 0:
+			return value & 0x0F;
+		case 1:
+			return value & 0x3FF;
+		case 2:
+			return rand() % 2 ? 0xFFFFFFFF : 0xFFFFFFFE;
+		default:
+			return value >> (rand() % 32);
+	}
+}
+
+static void fillStream(uint8_t *buffer, int length)
+{
+	bitWriter_t writer = {buffer, length, 0};
+
+	memset(buffer, 0, length);
+
+	while (writer.bitCount < length * CHAR_BIT) {
+		switch (rand() % 8) {
+			case 0:
+				// Garbage, including long runs of zeros
+				writeBits(&writer, rand() % 4 ? 0 : (uint32_t) rand(), rand() % 33);
+			break;
+			case 1:
+			case 2:
+			case 3:
+				writeEliasDelta(&writer, randomValue());
+			break;
+			default:
+				writeEliasGamma(&writer, randomValue());
+		}
+	}
+}
+
+static void fuzzStep(mmapStream_t *reference, mmapStream_t *stream)
+{
+	uint32_t expected, actual;
+	int numBits;
+
+	switch (rand() % 8) {
+		case 0:
+			numBits = rand() % 33;
+			expected = refReadBits(reference, numBits);
+			actual = streamReadBits(stream, numBits);
+		break;
+		case 1:
+			streamByteAlign(reference);
+			streamByteAlign(stream);
+			expected = actual = 0;
+		break;
+		case 2:
+		case 3:
+		case 4:
+			expected = refReadEliasDeltaU32(reference);
+			actual = streamReadEliasDeltaU32(stream);
+		break;
+		default:
+			expected = refReadEliasGammaU32(reference);
+			actual = streamReadEliasGammaU32(stream);
+	}
+
+	assert(expected == actual);
+
+	if (reference->pos >= reference->end) {
+		// Make sure that reading at EOF gives matching results too
+		assert(refReadEliasDeltaU32(reference) == streamReadEliasDeltaU32(stream));
+		assert(refReadEliasGammaU32(reference) == streamReadEliasGammaU32(stream));
+		assert(reference->eof && stream->eof && stream->pos == stream->end && stream->bitPos == CHAR_BIT - 1);
+	}
+}
+
+static void benchmark(void)
+{
+	int length = BENCHMARK_VALUES * 4;
+	uint8_t *buffer = calloc(length, 1);
+	bitWriter_t writer = {buffer, length, 0};
+	mmapStream_t stream;
+	uint32_t referenceSum = 0, sum = 0;
+	double referenceTime, time;
+	clock_t start;
+
+	// Small values dominate real logs, since P-frame fields are deltas
+	for (int i = 0; i < BENCHMARK_VALUES; i++) {
+		uint32_t value = zigzagEncode((rand() % 200) - 100);
+
+		if (i % 2) {
+			writeEliasDelta(&writer, value);
+		} else {
+			writeEliasGamma(&writer, value);
+		}
+	}
+
+	initStream(&stream, buffer, (writer.bitCount + CHAR_BIT - 1) / CHAR_BIT);
+	start = clock();
+	for (int i = 0; i < BENCHMARK_VALUES; i++) {
+		referenceSum += i % 2 ? refReadEliasDeltaU32(&stream) : refReadEliasGammaU32(&stream);
+	}
+	referenceTime = secondsSince(start);
+
+	initStream(&stream, buffer, (writer.bitCount + CHAR_BIT - 1) / CHAR_BIT);
+	start = clock();
+	for (int i = 0; i < BENCHMARK_VALUES; i++) {
+		sum += i % 2 ? streamReadEliasDeltaU32(&stream) : streamReadEliasGammaU32(&stream);
+	}
+	time = secondsSince(start);
+
+	assert(sum == referenceSum);
+
+	printBenchmark("Elias decoding of " STR(BENCHMARK_VALUES) " values", "bit-by-bit", referenceTime, "word-at-a-time", time);
+
+	free(buffer);
+}
+
+int main(void)
+{
+	srand(42);
+
+	fuzzStreams(NUM_FUZZ_STREAMS, fillStream, fuzzStep);
+	benchmark();
+
+	printf("Done");
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Checks that the CSV writer's hand-rolled number formatting produces exactly the same text as the printf formats that
+ * blackbox_decode used to use, including across buffer flushes.
+ */
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/csvwriter.h"
+
+#define NUM_RANDOM_VALUES 2000000
+
+static int64_t randomValue(void)
+{
+	uint64_t value = ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^ (uint64_t) rand();
+
+	switch (rand() % 6) {
+		case 0:
+			return (int64_t) (value & 0x0F) - 8;
+		case 1:
+			return (int64_t) (value & 0xFFFF) - 0x8000;
+		case 2:
+			return (int32_t) value;
+		case 3:
+			return rand() % 2 ? INT64_MIN : INT64_MAX;
+		default:
+			return (int64_t) value >> (rand() % 64);
+	}
+}
+
+int main(void)
+{
+	char *expected = malloc((size_t) NUM_RANDOM_VALUES * 48), *actual;
+	size_t expectedLength = 0, actualLength;
+	FILE *file;
+	csvWriter_t *writer;
+
+	srand(42);
+
+	file = open_memstream(&actual, &actualLength);
+	writer = csvWriterCreate(file);
+
+	for (int i = 0; i < NUM_RANDOM_VALUES; i++) {
+		int64_t value = randomValue();
+		int width = rand() % 5;
+		int decimals = 1 + rand() % 6;
+		uint32_t divisor = 1;
+
+		for (int j = 0; j < decimals; j++) {
+			divisor *= 10;
+		}
+
+		switch (rand() % 6) {
+			case 0:
+				expectedLength += sprintf(expected + expectedLength, "%*" PRId64, width, value);
+				csvWriterWriteInt(writer, value, width);
+			break;
+			case 1:
+				expectedLength += sprintf(expected + expectedLength, "%*" PRIu64, width, (uint64_t) value);
+				csvWriterWriteUnsigned(writer, (uint64_t) value, width);
+			break;
+			case 2:
+				expectedLength += sprintf(expected + expectedLength, "%0*u", decimals, (uint32_t) value % divisor);
+				csvWriterWriteZeroPadded(writer, (uint32_t) value % divisor, decimals);
+			break;
+			case 3:
+				expectedLength += sprintf(expected + expectedLength, "%.*f", decimals, (double) value / divisor);
+				csvWriterWriteFixedPoint(writer, value, decimals);
+			break;
+			case 4:
+				expectedLength += sprintf(expected + expectedLength, "%.*f", decimals, (double) (int32_t) value / 7);
+				csvWriterWriteDouble(writer, (double) (int32_t) value / 7, decimals);
+			break;
+			default:
+				expectedLength += sprintf(expected + expectedLength, "%c, %s", (char) ('a' + i % 26), "text");
+				csvWriterPrintf(writer, "%c, %s", (char) ('a' + i % 26), "text");
+		}
+
+		expected[expectedLength++] = '\n';
+		csvWriterWriteChar(writer, '\n');
+	}
+
+	csvWriterDestroy(writer);
+	fclose(file);
+
+	assert(actualLength == expectedLength);
+	assert(memcmp(actual, expected, expectedLength) == 0);
+
+	free(actual);
+	free(expected);
+
+	printf("Done");
+
+	return 0;
+}
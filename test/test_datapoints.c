@@ -1,6 +1,8 @@
 #include <stdint.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "../src/datapoints.h"
 
@@ -10,7 +12,7 @@
 int main(void)
 {
 	char *fieldNames[] = {"Test"};
-	int32_t val;
+	int64_t val;
 
 	//First some basic tests about locating frames
 	{
@@ -83,6 +85,173 @@ int main(void)
 		datapointsDestroy(points);
 	}
 
+	//Columns start narrow and are widened to fit values that arrive later
+	{
+		datapoints_t *points;
+		char *twoFieldNames[] = {"Narrow", "Wide"};
+		int64_t frame[2], frameTime;
+
+		int64_t exampleVals[NUM_EXAMPLE_VALS] = {3, -7, 30000, -40000, 5000000000LL, INT64_MIN, INT64_MAX, 13};
+
+		points = datapointsCreate(2, twoFieldNames, NUM_EXAMPLE_VALS);
+
+		assert(datapointsSetFieldRange(points, 0, -100, 100));
+		assert(points->fields[0].width == sizeof(int16_t));
+		assert(datapointsSetFieldRange(points, 1, 0, 100000));
+		assert(points->fields[1].width == sizeof(int32_t));
+
+		for (int i = 0; i < NUM_EXAMPLE_VALS; i++) {
+			frame[0] = i;
+			frame[1] = exampleVals[i];
+			datapointsAddFrame(points, i, frame);
+		}
+
+		assert(!datapointsSetFieldRange(points, 0, 0, 1));
+		assert(points->fields[0].width == sizeof(int16_t));
+		assert(points->fields[1].width == sizeof(int64_t));
+
+		for (int i = 0; i < NUM_EXAMPLE_VALS; i++) {
+			assert(datapointsGetFrameAtIndex(points, i, &frameTime, frame));
+			assert(frameTime == i && frame[0] == i && frame[1] == exampleVals[i]);
+		}
+
+		assert(datapointsSetFieldAtIndex(points, 2, 0, 70000));
+		assert(points->fields[0].width == sizeof(int32_t));
+
+		for (int i = 0; i < NUM_EXAMPLE_VALS; i++) {
+			assert(datapointsGetFieldAtIndex(points, i, 0, &val));
+			assert(val == (i == 2 ? 70000 : i));
+		}
+
+		datapointsDestroy(points);
+	}
+
+	//Runs of frames given a field at a time are stored the same as frames added one by one
+	{
+		datapoints_t *points;
+		char *threeFieldNames[] = {"A", "B", "Extra"};
+		const int stride = 12, capacity = 10;
+		int64_t values[2 * 12], frameTimes[12], frame[3], frameTime;
+
+		for (int i = 0; i < stride; i++) {
+			frameTimes[i] = i * 10;
+			values[i] = i - 4;
+			values[stride + i] = i == 5 ? 5000000000LL : i * 1000;
+		}
+
+		points = datapointsCreate(3, threeFieldNames, capacity);
+
+		assert(datapointsAddFrames(points, 2, frameTimes, 2, values, stride));
+		datapointsAddGap(points);
+		assert(points->fields[1].width == sizeof(int16_t));
+
+		//Only the frames which fit are added
+		assert(!datapointsAddFrames(points, stride - 2, frameTimes + 2, 2, values + 2, stride));
+		assert(points->frameCount == capacity);
+		assert(points->fields[1].width == sizeof(int64_t));
+
+		for (int i = 0; i < capacity; i++) {
+			assert(datapointsGetFrameAtIndex(points, i, &frameTime, frame));
+			assert(frameTime == frameTimes[i] && frame[0] == values[i] && frame[1] == values[stride + i] && frame[2] == 0);
+			assert(datapointsGetGapStartsAtIndex(points, i) == (i == 1));
+		}
+
+		datapointsDestroy(points);
+	}
+
+	//Storage grows a chunk at a time, and widening a column keeps the values in every chunk
+	{
+		datapoints_t *points;
+		char *twoFieldNames[] = {"Index", "Wide"};
+		const int frameCount = DATAPOINTS_CHUNK_FRAMES * 2 + 100;
+		int64_t values[2 * 1000], frameTimes[1000], frame[2], frameTime;
+		int added = 0;
+
+		points = datapointsCreate(2, twoFieldNames, INT_MAX);
+
+		// Add frames in runs that straddle the chunk boundaries, with one wide value partway through
+		while (added < frameCount) {
+			int count = frameCount - added < 1000 ? frameCount - added : 1000;
+
+			for (int i = 0; i < count; i++) {
+				frameTimes[i] = (added + i) * 10;
+				values[i] = added + i;
+				values[1000 + i] = added + i == DATAPOINTS_CHUNK_FRAMES + 5 ? 5000000000LL : -(added + i) % 30000;
+			}
+
+			assert(datapointsAddFrames(points, count, frameTimes, 2, values, 1000));
+			added += count;
+		}
+
+		frame[0] = frameCount;
+		frame[1] = 70000;
+		assert(datapointsAddFrame(points, frameCount * 10, frame));
+		datapointsAddGap(points);
+
+		assert(points->frameCount == frameCount + 1 && points->chunkCount == 3);
+		assert(points->fields[0].width == sizeof(int32_t) && points->fields[1].width == sizeof(int64_t));
+
+		for (int i = 0; i <= frameCount; i++) {
+			assert(datapointsGetFrameAtIndex(points, i, &frameTime, frame));
+			assert(frameTime == i * 10 && frame[0] == i);
+			assert(frame[1] == (i == frameCount ? 70000 : i == DATAPOINTS_CHUNK_FRAMES + 5 ? 5000000000LL : -i % 30000));
+		}
+
+		assert(!datapointsHasGapInRange(points, 0, frameCount));
+		assert(datapointsHasGapInRange(points, DATAPOINTS_CHUNK_FRAMES - 1, frameCount + 1));
+		assert(datapointsFindFrameAtTime(points, DATAPOINTS_CHUNK_FRAMES * 10 + 5) == DATAPOINTS_CHUNK_FRAMES);
+
+		datapointsDestroy(points);
+	}
+
+	//The min/max summary must give the same answers as looking at every frame
+	{
+		datapoints_t *points;
+		const int frameCount = 1000;
+		int minFrame, maxFrame;
+
+		points = datapointsCreate(1, fieldNames, frameCount);
+
+		srand(42);
+
+		for (int i = 0; i < frameCount; i++) {
+			val = rand() % 50;
+			datapointsAddFrame(points, i, &val);
+		}
+
+		datapointsBuildFieldSummary(points, 0);
+		assert(datapointsHasFieldSummary(points, 0));
+
+		for (int first = 0; first < frameCount; first += 7) {
+			for (int last = first; last < frameCount; last += 13) {
+				int64_t minValue = INT64_MAX, maxValue = INT64_MIN;
+				int expectedMin = -1, expectedMax = -1;
+
+				for (int i = first; i <= last; i++) {
+					datapointsGetFieldAtIndex(points, i, 0, &val);
+
+					if (val < minValue) {
+						minValue = val;
+						expectedMin = i;
+					}
+					if (val > maxValue) {
+						maxValue = val;
+						expectedMax = i;
+					}
+				}
+
+				assert(datapointsGetFieldExtremesInRange(points, 0, first, last, &minFrame, &maxFrame));
+				assert(minFrame == expectedMin && maxFrame == expectedMax);
+			}
+		}
+
+		//Changing a value discards the summary
+		datapointsSetFieldAtIndex(points, 0, 0, 100);
+		assert(!datapointsHasFieldSummary(points, 0));
+
+		datapointsDestroy(points);
+	}
+
 	printf("Done\n");
 
 	return 0;
@@ -0,0 +1,111 @@
+/*
+ * Decompresses a gzip file made of several members, delivered to the decompressor a few bytes at a time, and checks
+ * that the original bytes come out (and that uncompressed input is passed through unchanged).
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <zlib.h>
+
+#include "../src/stream.h"
+#include "../src/decompress.h"
+
+#include "streamtest.h"
+
+#define TOTAL_BYTES (4 * 1024 * 1024)
+#define MEMBERS 3
+
+static uint8_t patternByte(uint32_t index)
+{
+	uint32_t x = index * 2654435761u;
+
+	// Keep it compressible, but not too compressible
+	return (uint8_t) ((x >> 28) + (index >> 10));
+}
+
+static size_t gzipMembers(const uint8_t *data, size_t length, uint8_t *output, size_t outputCapacity)
+{
+	size_t outputLength = 0;
+
+	for (int i = 0; i < MEMBERS; i++) {
+		size_t begin = length * i / MEMBERS, end = length * (i + 1) / MEMBERS;
+		z_stream zlib;
+
+		memset(&zlib, 0, sizeof(zlib));
+		assert(deflateInit2(&zlib, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+
+		zlib.next_in = (Bytef *) data + begin;
+		zlib.avail_in = end - begin;
+		zlib.next_out = output + outputLength;
+		zlib.avail_out = outputCapacity - outputLength;
+
+		assert(deflate(&zlib, Z_FINISH) == Z_STREAM_END);
+
+		outputLength = outputCapacity - zlib.avail_out;
+
+		deflateEnd(&zlib);
+	}
+
+	return outputLength;
+}
+
+// Read everything from the source through a stream window and return how many bytes matched the pattern
+static uint32_t readPattern(streamSource_t *source)
+{
+	mmapStream_t *stream = streamCreateFromSource(source);
+	uint32_t received = 0;
+
+	while (1) {
+		streamFillWindow(stream);
+
+		if (stream->pos == stream->end) {
+			break;
+		}
+
+		while (stream->pos < stream->end) {
+			assert((uint8_t) *stream->pos == patternByte(received));
+
+			stream->pos++;
+			received++;
+		}
+	}
+
+	streamDestroy(stream);
+
+	return received;
+}
+
+int main(void)
+{
+	uint8_t *original = malloc(TOTAL_BYTES);
+	size_t compressedCapacity = TOTAL_BYTES + TOTAL_BYTES / 10 + 1024;
+	uint8_t *compressed = malloc(compressedCapacity);
+	size_t compressedLength;
+	uint32_t received;
+
+	for (uint32_t i = 0; i < TOTAL_BYTES; i++) {
+		original[i] = patternByte(i);
+	}
+
+	assert(compressionDetectFormat((char *) original, TOTAL_BYTES) == COMPRESSION_NONE);
+	assert(readPattern(decompressSourceCreate(memorySourceCreate(original, TOTAL_BYTES, 5000), 1)) == TOTAL_BYTES);
+
+	compressedLength = gzipMembers(original, TOTAL_BYTES, compressed, compressedCapacity);
+
+	assert(compressionDetectFormat((char *) compressed, compressedLength) == COMPRESSION_GZIP);
+	assert(readPattern(decompressSourceCreate(memorySourceCreate(compressed, compressedLength, 5000), 1)) == TOTAL_BYTES);
+
+	// A truncated file gives us what could be decompressed before it ended
+	received = readPattern(decompressSourceCreate(memorySourceCreate(compressed, compressedLength / 2, 5000), 1));
+	assert(received > 0 && received < TOTAL_BYTES);
+
+	free(compressed);
+	free(original);
+
+	printf("Done");
+
+	return 0;
+}
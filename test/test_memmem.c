@@ -0,0 +1,69 @@
+/*
+ * Checks memmem() against a simple search, for needles of many lengths at every alignment, including matches that
+ * straddle the blocks that the fast search works on and haystacks full of near misses.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "../src/tools.h"
+
+#define HAYSTACK_LENGTH 300
+
+static uint32_t seed = 1;
+
+static uint8_t randomByte(void)
+{
+	seed = seed * 1103515245 + 12345;
+
+	return (uint8_t) (seed >> 16);
+}
+
+static const uint8_t* simpleSearch(const uint8_t *haystack, size_t haystackLen, const uint8_t *needle, size_t needleLen)
+{
+	for (size_t pos = 0; pos + needleLen <= haystackLen; pos++) {
+		if (memcmp(haystack + pos, needle, needleLen) == 0)
+			return haystack + pos;
+	}
+
+	return NULL;
+}
+
+int main(void)
+{
+	uint8_t haystack[HAYSTACK_LENGTH], needle[64];
+
+	for (size_t needleLen = 1; needleLen <= sizeof(needle); needleLen++) {
+		for (int trial = 0; trial < 200; trial++) {
+			// Use a tiny alphabet so that there are lots of partial matches
+			int alphabet = 2 + trial % 3;
+			size_t haystackLen = randomByte() % HAYSTACK_LENGTH;
+
+			for (size_t i = 0; i < haystackLen; i++) {
+				haystack[i] = 'a' + randomByte() % alphabet;
+			}
+
+			for (size_t i = 0; i < needleLen; i++) {
+				needle[i] = 'a' + randomByte() % alphabet;
+			}
+
+			// Plant the needle sometimes, so long needles are found too
+			if (trial % 2 && needleLen <= haystackLen) {
+				memcpy(haystack + randomByte() % (haystackLen - needleLen + 1), needle, needleLen);
+			}
+
+			for (size_t start = 0; start < 17 && start <= haystackLen; start++) {
+				assert(memmem(haystack + start, haystackLen - start, needle, needleLen) == simpleSearch(haystack + start, haystackLen - start, needle, needleLen));
+			}
+		}
+	}
+
+	assert(memmem(haystack, 10, needle, 0) == haystack);
+	assert(memmem(haystack, 3, needle, 4) == NULL);
+
+	printf("Done");
+
+	return 0;
+}
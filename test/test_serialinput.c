@@ -0,0 +1,153 @@
+/*
+ * Pushes a pseudo-random byte pattern through a pseudo-terminal as fast as it'll go and checks that the serial input
+ * delivers every byte in order (both to the stream and to the tee file), then that closing the other end of the
+ * terminal ends the input.
+ */
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <assert.h>
+
+#include "../src/platform.h"
+#include "../src/stream.h"
+#include "../src/serial.h"
+
+#define TOTAL_BYTES (32 * 1024 * 1024)
+#define WRITE_CHUNK 4096
+
+static int master;
+static serialInput_t *input;
+
+static uint8_t patternByte(uint32_t index)
+{
+	uint32_t x = index * 2654435761u;
+
+	return (uint8_t) (x >> 24 ^ x >> 11);
+}
+
+static void* writerThread(void *data)
+{
+	uint8_t chunk[WRITE_CHUNK];
+	uint32_t written = 0;
+
+	(void) data;
+
+	while (written < TOTAL_BYTES) {
+		ssize_t result;
+
+		for (int i = 0; i < WRITE_CHUNK; i++) {
+			chunk[i] = patternByte(written + i);
+		}
+
+		for (int offset = 0; offset < WRITE_CHUNK; offset += result) {
+			result = write(master, chunk + offset, WRITE_CHUNK - offset);
+			assert(result > 0);
+		}
+
+		written += WRITE_CHUNK;
+	}
+
+	// Hanging up throws away anything that's still in the terminal, so wait for it all to be collected first
+	do {
+		serialInputStats_t stats;
+
+		serialInputGetStats(input, &stats);
+
+		if (stats.bytesRead == TOTAL_BYTES)
+			break;
+
+		usleep(1000);
+	} while (1);
+
+	close(master);
+
+	return NULL;
+}
+
+static double now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+	serialInputStats_t stats;
+	mmapStream_t *stream;
+	FILE *tee;
+	char *teeData;
+	size_t teeLength;
+	uint32_t received = 0;
+	int slave;
+	double begin;
+
+	platform_init();
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	assert(master >= 0);
+	assert(grantpt(master) == 0 && unlockpt(master) == 0);
+
+	slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+	assert(slave >= 0);
+
+	tee = open_memstream(&teeData, &teeLength);
+
+	input = serialInputCreate(slave, 115200, tee);
+	assert(input);
+
+	stream = streamCreateFromSource(serialInputSource(input));
+
+	begin = now();
+	thread_create_detached(writerThread, NULL);
+
+	while (1) {
+		streamFillWindow(stream);
+
+		if (stream->pos == stream->end) {
+			break;
+		}
+
+		while (stream->pos < stream->end) {
+			assert((uint8_t) *stream->pos == patternByte(received));
+
+			stream->pos++;
+			received++;
+		}
+	}
+
+	printf("%.1f MB/s sustained\n", TOTAL_BYTES / (now() - begin) / (1024 * 1024));
+
+	assert(received == TOTAL_BYTES);
+	assert(stream->sourceEnded);
+	assert(stream->windowOffset + (stream->end - stream->data) == TOTAL_BYTES);
+
+	serialInputGetStats(input, &stats);
+	assert(stats.bytesRead == TOTAL_BYTES);
+	assert(stats.peakBuffered <= SERIAL_INPUT_BUFFER_SIZE);
+
+	// Destroys the input too
+	streamDestroy(stream);
+
+	fclose(tee);
+	assert(teeLength == TOTAL_BYTES);
+
+	for (uint32_t i = 0; i < TOTAL_BYTES; i++) {
+		assert((uint8_t) teeData[i] == patternByte(i));
+	}
+
+	free(teeData);
+	close(slave);
+
+	printf("Done");
+
+	return 0;
+}
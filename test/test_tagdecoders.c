@@ -0,0 +1,298 @@
+/*
+ * Checks that the table-driven Tag2_3S32 and Tag8_4S16 (v2) group decoders produce exactly the same values and stream
+ * state as the original byte-at-a-time implementations (kept below as a reference), including for groups that run off
+ * the end of the stream, then benchmarks the two.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/stream.h"
+#include "../src/decoders.h"
+#include "../src/tools.h"
+
+#include "streamtest.h"
+
+#define NUM_FUZZ_STREAMS 200000
+#define BENCHMARK_GROUPS 4000000
+
+// Long enough for the biggest group of either kind
+#define MAX_GROUP_LENGTH 13
+
+static void refReadTag2_3S32(mmapStream_t *stream, int64_t *values)
+{
+	uint8_t leadByte;
+	uint8_t byte1, byte2, byte3, byte4;
+	int i;
+
+	leadByte = streamReadByte(stream);
+
+	// Check the selector in the top two bits to determine the field layout
+	switch (leadByte >> 6) {
+		case 0:
+			// 2-bit fields
+			values[0] = signExtend2Bit((leadByte >> 4) & 0x03);
+			values[1] = signExtend2Bit((leadByte >> 2) & 0x03);
+			values[2] = signExtend2Bit(leadByte & 0x03);
+		break;
+		case 1:
+			// 4-bit fields
+			values[0] = signExtend4Bit(leadByte & 0x0F);
+
+			leadByte = streamReadByte(stream);
+
+			values[1] = signExtend4Bit(leadByte >> 4);
+			values[2] = signExtend4Bit(leadByte & 0x0F);
+		break;
+		case 2:
+			// 6-bit fields
+			values[0] = signExtend6Bit(leadByte & 0x3F);
+
+			leadByte = streamReadByte(stream);
+			values[1] = signExtend6Bit(leadByte & 0x3F);
+
+			leadByte = streamReadByte(stream);
+			values[2] = signExtend6Bit(leadByte & 0x3F);
+		break;
+		case 3:
+			// Fields are 8, 16 or 24 bits, read selector to figure out which field is which size
+
+			for (i = 0; i < 3; i++) {
+				switch (leadByte & 0x03) {
+					case 0: // 8-bit
+						byte1 = streamReadByte(stream);
+
+						// Sign extend to 32 bits
+						values[i] = (int8_t) (byte1);
+					break;
+					case 1: // 16-bit
+						byte1 = streamReadByte(stream);
+						byte2 = streamReadByte(stream);
+
+						// Sign extend to 32 bits
+						values[i] = (int16_t) (byte1 | (byte2 << 8));
+					break;
+					case 2: // 24-bit
+						byte1 = streamReadByte(stream);
+						byte2 = streamReadByte(stream);
+						byte3 = streamReadByte(stream);
+
+						values[i] = signExtend24Bit(byte1 | (byte2 << 8) | (byte3 << 16));
+					break;
+					case 3: // 32-bit
+						byte1 = streamReadByte(stream);
+						byte2 = streamReadByte(stream);
+						byte3 = streamReadByte(stream);
+						byte4 = streamReadByte(stream);
+
+						// Sign-extend
+						values[i] = (int32_t) (byte1 | (byte2 << 8) | (byte3 << 16) | (byte4 << 24));
+					break;
+				}
+
+				leadByte >>= 2;
+			}
+		break;
+	}
+}
+
+
+static void refReadTag8_4S16_v2(mmapStream_t *stream, int64_t *values)
+{
+	uint8_t selector;
+	uint8_t char1, char2;
+	uint8_t buffer;
+	int nibbleIndex;
+
+	int i;
+
+	enum {
+		FIELD_ZERO  = 0,
+		FIELD_4BIT  = 1,
+		FIELD_8BIT  = 2,
+		FIELD_16BIT = 3
+	};
+
+	selector = streamReadByte(stream);
+
+	//Read the 4 values from the stream
+	nibbleIndex = 0;
+	for (i = 0; i < 4; i++) {
+		switch (selector & 0x03) {
+			case FIELD_ZERO:
+				values[i] = 0;
+			break;
+			case FIELD_4BIT:
+				if (nibbleIndex == 0) {
+					buffer = (uint8_t) streamReadByte(stream);
+					values[i] = signExtend4Bit(buffer >> 4);
+					nibbleIndex = 1;
+				} else {
+					values[i] = signExtend4Bit(buffer & 0x0F);
+					nibbleIndex = 0;
+				}
+			break;
+			case FIELD_8BIT:
+				if (nibbleIndex == 0) {
+					//Sign extend...
+					values[i] = (int8_t) streamReadByte(stream);
+				} else {
+					char1 = buffer << 4;
+					buffer = (uint8_t) streamReadByte(stream);
+
+					char1 |= buffer >> 4;
+					values[i] = (int8_t) char1;
+				}
+			break;
+			case FIELD_16BIT:
+				if (nibbleIndex == 0) {
+					char1 = (uint8_t) streamReadByte(stream);
+					char2 = (uint8_t) streamReadByte(stream);
+
+					//Sign extend...
+					values[i] = (int16_t) (uint16_t) ((char1 << 8) | char2);
+				} else {
+					/*
+					 * We're in the low 4 bits of the current buffer, then one byte, then the high 4 bits of the next
+					 * buffer.
+					 */
+					char1 = (uint8_t) streamReadByte(stream);
+					char2 = (uint8_t) streamReadByte(stream);
+
+					values[i] = (int16_t) (uint16_t) ((buffer << 12) | (char1 << 4) | (char2 >> 4));
+
+					buffer = char2;
+				}
+			break;
+		}
+
+		selector >>= 2;
+	}
+}
+
+static void readGroup(mmapStream_t *stream, bool tag8, bool reference, int64_t *values)
+{
+	if (tag8) {
+		if (reference) {
+			refReadTag8_4S16_v2(stream, values);
+		} else {
+			streamReadTag8_4S16_v2(stream, values);
+		}
+	} else {
+		if (reference) {
+			refReadTag2_3S32(stream, values);
+		} else {
+			streamReadTag2_3S32(stream, values);
+		}
+	}
+}
+
+static void fillRandom(uint8_t *buffer, int length)
+{
+	for (int i = 0; i < length; i++) {
+		buffer[i] = rand();
+	}
+}
+
+static void fuzzStep(mmapStream_t *reference, mmapStream_t *stream)
+{
+	bool tag8 = rand() % 2;
+	int64_t expected[4] = {0}, actual[4] = {0};
+
+	readGroup(reference, tag8, true, expected);
+	readGroup(stream, tag8, false, actual);
+
+	assert(memcmp(expected, actual, sizeof(expected)) == 0);
+}
+
+/**
+ * Choose a selector for a group whose fields are mostly small, like the deltas in real P-frames.
+ */
+static uint8_t randomSelector(bool tag8)
+{
+	uint8_t selector = 0;
+
+	if (tag8) {
+		for (int i = 0; i < 4; i++) {
+			int size = rand() % 8;
+
+			selector |= (size < 2 ? 0 : size < 5 ? 1 : size < 7 ? 2 : 3) << (i * 2);
+		}
+	} else {
+		int layout = rand() % 8;
+
+		selector = rand();
+
+		if (layout < 7) {
+			selector = (selector & 0x3F) | (layout / 3) << 6;
+		}
+	}
+
+	return selector;
+}
+
+static void benchmarkDecoder(bool tag8)
+{
+	int capacity = BENCHMARK_GROUPS * MAX_GROUP_LENGTH;
+	uint8_t *buffer = malloc(capacity);
+	int length = 0;
+	mmapStream_t stream;
+	int64_t values[4], referenceSum = 0, sum = 0;
+	double referenceTime, time;
+	clock_t start;
+
+	// Use the reference decoder to find out how long each random group is
+	for (int i = 0; i < BENCHMARK_GROUPS; i++) {
+		buffer[length] = randomSelector(tag8);
+
+		for (int j = 1; j < MAX_GROUP_LENGTH; j++) {
+			buffer[length + j] = rand();
+		}
+
+		initStream(&stream, buffer + length, MAX_GROUP_LENGTH);
+		readGroup(&stream, tag8, true, values);
+
+		length += stream.pos - stream.data;
+	}
+
+	initStream(&stream, buffer, length);
+	start = clock();
+	for (int i = 0; i < BENCHMARK_GROUPS; i++) {
+		readGroup(&stream, tag8, true, values);
+		referenceSum += values[0] + values[1] + values[2] + (tag8 ? values[3] : 0);
+	}
+	referenceTime = secondsSince(start);
+
+	initStream(&stream, buffer, length);
+	start = clock();
+	for (int i = 0; i < BENCHMARK_GROUPS; i++) {
+		readGroup(&stream, tag8, false, values);
+		sum += values[0] + values[1] + values[2] + (tag8 ? values[3] : 0);
+	}
+	time = secondsSince(start);
+
+	assert(sum == referenceSum);
+	assert(stream.pos == stream.end && !stream.eof);
+
+	printBenchmark(tag8 ? "Tag8_4S16 decoding of " STR(BENCHMARK_GROUPS) " groups" : "Tag2_3S32 decoding of " STR(BENCHMARK_GROUPS) " groups",
+		"byte-at-a-time", referenceTime, "table-driven", time);
+
+	free(buffer);
+}
+
+int main(void)
+{
+	srand(42);
+
+	fuzzStreams(NUM_FUZZ_STREAMS, fillRandom, fuzzStep);
+
+	benchmarkDecoder(false);
+	benchmarkDecoder(true);
+
+	printf("Done");
+
+	return 0;
+}
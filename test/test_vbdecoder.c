@@ -0,0 +1,103 @@
+/*
+ * Checks that reading a run of variable-byte fields with streamReadUnsignedVBs() gives exactly the same values and
+ * stream state as reading them one at a time with streamReadUnsignedVB(), including for overlong fields and runs that
+ * go off the end of the stream, then benchmarks the two.
+ *
+ * The Makefile builds this a second time as test_vbdecoder_ssse3 on x86, to check the SSSE3 version of the runs too.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+
+#include "../src/stream.h"
+#include "../src/tools.h"
+
+#include "streamtest.h"
+
+#define NUM_FUZZ_STREAMS 200000
+#define BENCHMARK_FIELDS 16000000
+#define BENCHMARK_RUN_LENGTH 16
+
+static void fillFields(uint8_t *buffer, int length)
+{
+	// Vary how likely the continuation bit is so that we get plenty of both short and overlong fields
+	int continuationPercent = rand() % 101;
+
+	for (int i = 0; i < length; i++) {
+		buffer[i] = (rand() & 0x7F) | (rand() % 100 < continuationPercent ? 0x80 : 0);
+	}
+}
+
+static void fuzzStep(mmapStream_t *reference, mmapStream_t *stream)
+{
+	int count = rand() % 20;
+	uint32_t expected[20], actual[20];
+
+	for (int i = 0; i < count; i++) {
+		expected[i] = streamReadUnsignedVB(reference);
+	}
+	streamReadUnsignedVBs(stream, actual, count);
+
+	assert(memcmp(expected, actual, count * sizeof(expected[0])) == 0);
+}
+
+static void benchmark(void)
+{
+	uint8_t *buffer = malloc(BENCHMARK_FIELDS * 5);
+	int length = 0;
+	mmapStream_t stream;
+	uint32_t values[BENCHMARK_RUN_LENGTH], referenceSum = 0, sum = 0;
+	double referenceTime, time;
+	clock_t start;
+
+	// Mostly small values, like the deltas in real P-frames
+	for (int i = 0; i < BENCHMARK_FIELDS; i++) {
+		uint32_t value = rand() % 8 == 0 ? (uint32_t) rand() : (uint32_t) rand() % 300;
+
+		while (value >= 0x80) {
+			buffer[length++] = (value & 0x7F) | 0x80;
+			value >>= 7;
+		}
+		buffer[length++] = value;
+	}
+
+	initStream(&stream, buffer, length);
+	start = clock();
+	for (int i = 0; i < BENCHMARK_FIELDS; i++) {
+		referenceSum += streamReadUnsignedVB(&stream);
+	}
+	referenceTime = secondsSince(start);
+
+	initStream(&stream, buffer, length);
+	start = clock();
+	for (int i = 0; i < BENCHMARK_FIELDS; i += BENCHMARK_RUN_LENGTH) {
+		streamReadUnsignedVBs(&stream, values, BENCHMARK_RUN_LENGTH);
+
+		for (int j = 0; j < BENCHMARK_RUN_LENGTH; j++) {
+			sum += values[j];
+		}
+	}
+	time = secondsSince(start);
+
+	assert(sum == referenceSum);
+	assert(stream.pos == stream.end && !stream.eof);
+
+	printBenchmark("Variable-byte decoding of " STR(BENCHMARK_FIELDS) " fields", "byte-at-a-time", referenceTime, "in runs", time);
+
+	free(buffer);
+}
+
+int main(void)
+{
+	srand(42);
+
+	fuzzStreams(NUM_FUZZ_STREAMS, fillFields, fuzzStep);
+	benchmark();
+
+	printf("Done");
+
+	return 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * Checks the video writer's conversions from Cairo's premultiplied ARGB32 pixels against straightforward floating point
+ * versions, using an odd frame size so that the edge handling of the chroma planes is exercised.
+ *
+ * The YUV conversion is also compared byte for byte against a plain integer version over a range of frame widths, so
+ * that rows converted partly or wholly by the SIMD path must match the ones done entirely by the scalar loops.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "../src/videowriter.h"
+
+#define WIDTH 37
+#define HEIGHT 21
+
+static uint32_t pixels[WIDTH * HEIGHT];
+
+static int channel(uint32_t pixel, int shift)
+{
+	return (pixel >> shift) & 0xFF;
+}
+
+/*
+ * Average a colour channel over the 2x2 block of pixels that covers the chroma sample at (x, y).
+ */
+static double blockAverage(int x, int y, int shift)
+{
+	int right = x * 2 + 1 < WIDTH ? x * 2 + 1 : x * 2;
+	int bottom = y * 2 + 1 < HEIGHT ? y * 2 + 1 : y * 2;
+
+	return (channel(pixels[y * 2 * WIDTH + x * 2], shift) + channel(pixels[y * 2 * WIDTH + right], shift)
+		+ channel(pixels[bottom * WIDTH + x * 2], shift) + channel(pixels[bottom * WIDTH + right], shift)) / 4.0;
+}
+
+static void checkClose(int actual, double expected)
+{
+	assert(fabs(actual - expected) <= 1.0);
+}
+
+static int pixelOf(const uint32_t *image, int width, int height, int x, int y)
+{
+	return image[(y < height ? y : height - 1) * width + (x < width ? x : width - 1)];
+}
+
+/*
+ * The writer's integer BT.601 formulas, one sample at a time.
+ */
+static void referenceI420(const uint32_t *image, int width, int height, uint8_t *frame)
+{
+	int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+	uint8_t *planeU = frame + width * height;
+	uint8_t *planeV = planeU + chromaWidth * chromaHeight;
+
+	for (int i = 0; i < width * height; i++) {
+		frame[i] = ((66 * channel(image[i], 16) + 129 * channel(image[i], 8) + 25 * channel(image[i], 0) + 128) >> 8) + 16;
+	}
+
+	for (int y = 0; y < chromaHeight; y++) {
+		for (int x = 0; x < chromaWidth; x++) {
+			int sums[3] = {2, 2, 2};
+
+			for (int c = 0; c < 3; c++) {
+				for (int corner = 0; corner < 4; corner++) {
+					sums[c] += channel(pixelOf(image, width, height, x * 2 + corner % 2, y * 2 + corner / 2), 16 - c * 8);
+				}
+				sums[c] >>= 2;
+			}
+
+			planeU[y * chromaWidth + x] = (-38 * sums[0] - 74 * sums[1] + 112 * sums[2] + (128 << 8) + 128) >> 8;
+			planeV[y * chromaWidth + x] = (112 * sums[0] - 94 * sums[1] - 18 * sums[2] + (128 << 8) + 128) >> 8;
+		}
+	}
+}
+
+static void checkI420MatchesReference(int width, int height)
+{
+	// Rows of the image we convert are padded out to a wider stride, to check that the conversion doesn't assume packed rows
+	int stride = width + 3;
+	uint32_t *image = malloc(sizeof(*image) * width * height), *padded = calloc(stride * height, sizeof(*padded));
+	char *output;
+	size_t outputLength;
+	FILE *file = open_memstream(&output, &outputLength);
+	videoWriter_t *writer = videoWriterCreate(file, VIDEO_FORMAT_Y4M, width, height, 30);
+	uint8_t *frame = malloc(writer->frameSize), *expected = malloc(writer->frameSize);
+
+	for (int i = 0; i < width * height; i++) {
+		uint32_t alpha = rand() % 256;
+
+		image[i] = alpha << 24 | (rand() % (alpha + 1)) << 16 | (rand() % (alpha + 1)) << 8 | (rand() % (alpha + 1));
+		padded[i / width * stride + i % width] = image[i];
+	}
+
+	videoWriterConvertFrame(writer, (const uint8_t*) padded, stride * 4, frame);
+	referenceI420(image, width, height, expected);
+
+	assert(memcmp(frame, expected, writer->frameSize) == 0);
+
+	videoWriterDestroy(writer);
+	fclose(file);
+	free(output);
+	free(expected);
+	free(frame);
+	free(padded);
+	free(image);
+}
+
+int main(void)
+{
+	char *output;
+	size_t outputLength;
+	FILE *file;
+	videoWriter_t *writer;
+	uint8_t *frame;
+	char header[64];
+
+	srand(42);
+
+	for (int i = 0; i < WIDTH * HEIGHT; i++) {
+		uint32_t alpha = i % 7 == 0 ? 0 : i % 5 == 0 ? 0xFF : rand() % 256;
+
+		pixels[i] = alpha << 24 | (rand() % (alpha + 1)) << 16 | (rand() % (alpha + 1)) << 8 | (rand() % (alpha + 1));
+	}
+
+	//YUV4MPEG2
+	{
+		const uint8_t *planeY, *planeU, *planeV;
+		int chromaWidth = (WIDTH + 1) / 2, chromaHeight = (HEIGHT + 1) / 2;
+
+		file = open_memstream(&output, &outputLength);
+		writer = videoWriterCreate(file, VIDEO_FORMAT_Y4M, WIDTH, HEIGHT, 30);
+
+		assert(writer->frameSize == (size_t) WIDTH * HEIGHT + 2 * chromaWidth * chromaHeight);
+
+		frame = malloc(writer->frameSize);
+		videoWriterConvertFrame(writer, (const uint8_t*) pixels, WIDTH * 4, frame);
+
+		assert(videoWriterWriteFrame(writer, frame));
+		videoWriterDestroy(writer);
+		fclose(file);
+
+		snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F30:1 Ip A1:1 C420jpeg\nFRAME\n", WIDTH, HEIGHT);
+
+		assert(outputLength == strlen(header) + (size_t) WIDTH * HEIGHT + 2 * chromaWidth * chromaHeight);
+		assert(memcmp(output, header, strlen(header)) == 0);
+
+		planeY = (const uint8_t*) output + strlen(header);
+		planeU = planeY + WIDTH * HEIGHT;
+		planeV = planeU + chromaWidth * chromaHeight;
+
+		for (int i = 0; i < WIDTH * HEIGHT; i++) {
+			checkClose(planeY[i], 16 + (65.738 * channel(pixels[i], 16) + 129.057 * channel(pixels[i], 8) + 25.064 * channel(pixels[i], 0)) / 256);
+		}
+
+		for (int y = 0; y < chromaHeight; y++) {
+			for (int x = 0; x < chromaWidth; x++) {
+				double r = blockAverage(x, y, 16), g = blockAverage(x, y, 8), b = blockAverage(x, y, 0);
+
+				checkClose(planeU[y * chromaWidth + x], 128 + (-37.945 * r - 74.494 * g + 112.439 * b) / 256);
+				checkClose(planeV[y * chromaWidth + x], 128 + (112.439 * r - 94.154 * g - 18.285 * b) / 256);
+			}
+		}
+
+		free(frame);
+		free(output);
+	}
+
+	//YUV4MPEG2 at widths either side of the 16-pixel blocks that the SIMD path converts
+	for (int width = 1; width <= 50; width++) {
+		checkI420MatchesReference(width, 1);
+		checkI420MatchesReference(width, 4);
+		checkI420MatchesReference(width, 7);
+	}
+
+	//Raw RGBA with the alpha divided back out
+	{
+		file = open_memstream(&output, &outputLength);
+		writer = videoWriterCreate(file, VIDEO_FORMAT_RGBA, WIDTH, HEIGHT, 30);
+
+		frame = malloc(writer->frameSize);
+		videoWriterConvertFrame(writer, (const uint8_t*) pixels, WIDTH * 4, frame);
+
+		assert(videoWriterWriteFrame(writer, frame));
+		videoWriterDestroy(writer);
+		fclose(file);
+
+		assert(outputLength == (size_t) WIDTH * HEIGHT * 4);
+
+		for (int i = 0; i < WIDTH * HEIGHT; i++) {
+			int alpha = channel(pixels[i], 24);
+			const uint8_t *rgba = (const uint8_t*) output + i * 4;
+
+			assert(rgba[3] == alpha);
+
+			for (int c = 0; c < 3; c++) {
+				int premultiplied = channel(pixels[i], 16 - c * 8);
+
+				if (alpha == 0) {
+					assert(rgba[c] == 0);
+				} else {
+					checkClose(rgba[c], premultiplied * 255.0 / alpha);
+					//Multiplying by the alpha again must give back the colour we started with
+					assert((rgba[c] * alpha + 127) / 255 == premultiplied);
+				}
+			}
+		}
+
+		free(frame);
+		free(output);
+	}
+
+	printf("Done");
+
+	return 0;
+}
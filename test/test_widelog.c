@@ -0,0 +1,384 @@
+/*
+ * Decodes a log with more fields than the parser used to have room for, whose "Field I name" header line is longer
+ * than the stream's lookahead, both from a file and from a source that hands over a few bytes at a time. Every field of
+ * every frame should come out as it went in.
+ *
+ * Then reads a log that was cut off part way through a frame followed by complete ones, from a source and from a file.
+ * They should still be found as separate logs, with every frame of the complete ones intact. The logs in the file are
+ * also decoded with several threads, and a window of time is decoded from one of them with a seek index.
+ *
+ * test_widelog_windowed is built from this too, with files mapped into memory a small window at a time.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "../src/parser.h"
+#include "../src/logindex.h"
+
+#include "streamtest.h"
+
+#define DEBUG_FIELDS 198
+#define FIELD_COUNT (2 + DEBUG_FIELDS)
+#define FRAME_COUNT 500
+#define I_INTERVAL 4
+
+// The window of time decoded with the seek index, in microseconds from the first frame (iterations 200 to 300)
+#define WINDOW_START 200000
+#define WINDOW_END 300000
+
+typedef struct logBuffer_t {
+	uint8_t *data;
+	size_t length, capacity;
+} logBuffer_t;
+
+static int framesDecoded;
+static int badFrames;
+
+// The first and last iterations delivered from the window of time, and how many there were
+static uint32_t windowFirst, windowLast;
+static int windowFrames;
+
+// Where each frame of the log begins, so that we can cut it off in the middle of one
+static size_t frameOffsets[FRAME_COUNT];
+
+static void writeByte(logBuffer_t *buffer, uint8_t value)
+{
+	if (buffer->length == buffer->capacity) {
+		buffer->capacity = buffer->capacity ? buffer->capacity * 2 : 4096;
+		buffer->data = realloc(buffer->data, buffer->capacity);
+		assert(buffer->data);
+	}
+
+	buffer->data[buffer->length++] = value;
+}
+
+static void writeString(logBuffer_t *buffer, const char *s)
+{
+	while (*s) {
+		writeByte(buffer, (uint8_t) *s++);
+	}
+}
+
+static void writeUnsignedVB(logBuffer_t *buffer, uint32_t value)
+{
+	while (value > 127) {
+		writeByte(buffer, (uint8_t) (value | 0x80));
+		value >>= 7;
+	}
+	writeByte(buffer, (uint8_t) value);
+}
+
+static void writeSignedVB(logBuffer_t *buffer, int32_t value)
+{
+	writeUnsignedVB(buffer, (uint32_t) ((value << 1) ^ (value >> 31)));
+}
+
+static void writeHeaderList(logBuffer_t *buffer, const char *name, const char *first, const char *rest)
+{
+	writeString(buffer, name);
+	writeString(buffer, first);
+
+	for (int i = 0; i < DEBUG_FIELDS; i++) {
+		writeString(buffer, ",");
+		writeString(buffer, rest);
+	}
+
+	writeString(buffer, "\n");
+}
+
+static int64_t frameTime(uint32_t iteration)
+{
+	return 1000000 + (int64_t) iteration * 1000;
+}
+
+static int32_t debugValue(uint32_t iteration, int field)
+{
+	// Big enough that most values take several bytes to encode
+	return (int32_t) ((iteration * 7919 + field * 104729) % 200001) - 100000;
+}
+
+static void buildLog(logBuffer_t *buffer)
+{
+	char name[32];
+
+	writeString(buffer, "H Product:Blackbox flight data recorder by Nicholas Sherlock\n");
+	writeString(buffer, "H Data version:2\n");
+	writeString(buffer, "H I interval:4\n");
+	writeString(buffer, "H P interval:1/1\n");
+	writeString(buffer, "H Firmware type:Cleanflight\n");
+
+	writeString(buffer, "H Field I name:loopIteration,time");
+	for (int i = 0; i < DEBUG_FIELDS; i++) {
+		snprintf(name, sizeof(name), ",debug[%d]", i);
+		writeString(buffer, name);
+	}
+	writeString(buffer, "\n");
+
+	writeHeaderList(buffer, "H Field I signed:", "0,0", "1");
+	writeHeaderList(buffer, "H Field I predictor:", "0,0", "0");
+	writeHeaderList(buffer, "H Field I encoding:", "1,1", "0");
+	writeHeaderList(buffer, "H Field P predictor:", "6,1", "1");
+	writeHeaderList(buffer, "H Field P encoding:", "9,0", "0");
+	writeString(buffer, "H features:0\n");
+
+	for (uint32_t iteration = 0; iteration < FRAME_COUNT; iteration++) {
+		frameOffsets[iteration] = buffer->length;
+
+		if (iteration % I_INTERVAL == 0) {
+			writeByte(buffer, 'I');
+			writeUnsignedVB(buffer, iteration);
+			writeUnsignedVB(buffer, (uint32_t) frameTime(iteration));
+
+			for (int i = 0; i < DEBUG_FIELDS; i++) {
+				writeSignedVB(buffer, debugValue(iteration, i));
+			}
+		} else {
+			writeByte(buffer, 'P');
+			writeSignedVB(buffer, (int32_t) (frameTime(iteration) - frameTime(iteration - 1)));
+
+			for (int i = 0; i < DEBUG_FIELDS; i++) {
+				writeSignedVB(buffer, debugValue(iteration, i) - debugValue(iteration - 1, i));
+			}
+		}
+	}
+
+	writeByte(buffer, 'E');
+	writeByte(buffer, FLIGHT_LOG_EVENT_LOG_END);
+	writeString(buffer, "End of log");
+	writeByte(buffer, 0);
+}
+
+static void onMetadataReady(flightLog_t *log)
+{
+	assert(log->frameDefs['I'].fieldCount == FIELD_COUNT);
+	assert(log->frameDefs['P'].fieldCount == FIELD_COUNT);
+	assert(strcmp(log->frameDefs['I'].fieldName[FIELD_COUNT - 1], "debug[197]") == 0);
+}
+
+static void onFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+	uint32_t iteration;
+	bool matches;
+
+	(void) log;
+	(void) frameOffset;
+	(void) frameSize;
+
+	if (frameType != 'I' && frameType != 'P') {
+		return;
+	}
+
+	if (!frameValid || !frame || fieldCount != FIELD_COUNT) {
+		badFrames++;
+		return;
+	}
+
+	iteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+	matches = iteration == (uint32_t) framesDecoded && frame[FLIGHT_LOG_FIELD_INDEX_TIME] == frameTime(iteration);
+
+	for (int i = 0; i < DEBUG_FIELDS; i++) {
+		matches = matches && frame[2 + i] == debugValue(iteration, i);
+	}
+
+	if (matches) {
+		framesDecoded++;
+	} else {
+		badFrames++;
+	}
+}
+
+static void onWindowFrameReady(flightLog_t *log, bool frameValid, int64_t *frame, uint8_t frameType, int fieldCount, int64_t frameOffset, int frameSize)
+{
+	uint32_t iteration;
+
+	(void) log;
+	(void) fieldCount;
+	(void) frameOffset;
+	(void) frameSize;
+
+	if (frameType != 'I' && frameType != 'P') {
+		return;
+	}
+
+	if (!frameValid || !frame) {
+		badFrames++;
+		return;
+	}
+
+	iteration = (uint32_t) frame[FLIGHT_LOG_FIELD_INDEX_ITERATION];
+
+	if (windowFrames == 0) {
+		windowFirst = iteration;
+	} else if (iteration != windowLast + 1) {
+		badFrames++;
+	}
+
+	windowLast = iteration;
+	windowFrames++;
+}
+
+static void checkDecode(flightLog_t *log)
+{
+	assert(log && log->logCount >= 1);
+
+	framesDecoded = 0;
+	badFrames = 0;
+
+	assert(flightLogParse(log, 0, onMetadataReady, onFrameReady, NULL, false));
+
+	assert(badFrames == 0);
+	assert(framesDecoded == FRAME_COUNT);
+
+	flightLogDestroy(log);
+}
+
+/**
+ * Read a copy of the log that stops part way through one of its frames, then the whole log again, from a source that
+ * hands over maxChunk bytes at a time.
+ */
+static void checkTruncatedThenComplete(logBuffer_t *buffer, size_t maxChunk)
+{
+	logBuffer_t joined = {0};
+	size_t cut = frameOffsets[FRAME_COUNT / 2 + 1] + (frameOffsets[FRAME_COUNT / 2 + 2] - frameOffsets[FRAME_COUNT / 2 + 1]) / 2;
+	flightLog_t *log;
+
+	for (size_t i = 0; i < cut; i++) {
+		writeByte(&joined, buffer->data[i]);
+	}
+	for (size_t i = 0; i < buffer->length; i++) {
+		writeByte(&joined, buffer->data[i]);
+	}
+
+	log = flightLogCreateFromSource(memorySourceCreate(joined.data, joined.length, maxChunk));
+	assert(log);
+
+	framesDecoded = 0;
+	badFrames = 0;
+
+	flightLogParse(log, 0, NULL, onFrameReady, NULL, false);
+
+	// The frames before the cut are fine, and we mustn't have carried on into the next log's
+	assert(framesDecoded == FRAME_COUNT / 2 + 1);
+	assert(flightLogBeginNextLog(log));
+
+	framesDecoded = 0;
+	badFrames = 0;
+
+	assert(flightLogParse(log, log->logCount - 1, onMetadataReady, onFrameReady, NULL, false));
+
+	assert(badFrames == 0);
+	assert(framesDecoded == FRAME_COUNT);
+	assert(!flightLogBeginNextLog(log));
+
+	flightLogDestroy(log);
+	free(joined.data);
+}
+
+/**
+ * Write a copy of the log that stops part way through one of its frames, then the whole log twice, to a file. All
+ * three logs should be found when the file is opened.
+ */
+static void checkFileOfLogs(logBuffer_t *buffer)
+{
+	size_t cut = frameOffsets[FRAME_COUNT / 2 + 1] + (frameOffsets[FRAME_COUNT / 2 + 2] - frameOffsets[FRAME_COUNT / 2 + 1]) / 2;
+	FILE *file = tmpfile();
+	flightLog_t *log;
+	flightLogIndex_t *index;
+
+	assert(file);
+	assert(fwrite(buffer->data, 1, cut, file) == cut);
+	assert(fwrite(buffer->data, 1, buffer->length, file) == buffer->length);
+	assert(fwrite(buffer->data, 1, buffer->length, file) == buffer->length);
+	fflush(file);
+
+	log = flightLogCreateWithThreads(fileno(file), 2);
+
+	assert(log && log->logCount == 3);
+	assert(log->logBegin[0] == 0);
+	assert(log->logBegin[1] == (int64_t) cut);
+	assert(log->logBegin[2] == (int64_t) (cut + buffer->length));
+	assert(log->logBegin[3] == (int64_t) (cut + 2 * buffer->length));
+
+	// The log that was cut short ends where the next one begins
+	framesDecoded = 0;
+	badFrames = 0;
+
+	assert(flightLogParse(log, 0, NULL, onFrameReady, NULL, false));
+	assert(framesDecoded == FRAME_COUNT / 2 + 1);
+
+	for (int logIndex = 1; logIndex < 3; logIndex++) {
+		for (int threads = 1; threads <= 4; threads += 3) {
+			framesDecoded = 0;
+			badFrames = 0;
+
+			assert(flightLogParseParallel(log, logIndex, onMetadataReady, onFrameReady, NULL, false, threads));
+
+			assert(badFrames == 0);
+			assert(framesDecoded == FRAME_COUNT);
+		}
+	}
+
+	// Record where the last log's I-frames are, then decode a window of time from it
+	index = flightLogIndexCreate(log);
+	flightLogAttachIndex(log, index);
+
+	framesDecoded = 0;
+	badFrames = 0;
+
+	assert(flightLogParse(log, 2, NULL, onFrameReady, NULL, false));
+	assert(framesDecoded == FRAME_COUNT);
+	assert(index->logs[2].complete);
+
+	windowFrames = 0;
+	badFrames = 0;
+
+	assert(flightLogParseTimeRange(log, 2, WINDOW_START, WINDOW_END, NULL, onWindowFrameReady, NULL, false, 1));
+
+	assert(badFrames == 0);
+	assert(windowFirst == WINDOW_START / 1000 && windowLast == WINDOW_END / 1000);
+
+	// It should have skipped straight to the window rather than decoding the log from the start
+	assert(log->stats.frame['I'].validCount < FRAME_COUNT / I_INTERVAL / 2);
+
+	flightLogDestroy(log);
+	flightLogIndexDestroy(index);
+	fclose(file);
+}
+
+int main(void)
+{
+	logBuffer_t buffer = {0};
+	FILE *file;
+
+	buildLog(&buffer);
+
+	// Decode it from a file
+	file = tmpfile();
+	assert(file);
+	assert(fwrite(buffer.data, 1, buffer.length, file) == buffer.length);
+	fflush(file);
+
+	checkDecode(flightLogCreate(fileno(file)));
+
+	fclose(file);
+
+	// And from a source that hands over as few bytes as it can, so that the header lines arrive in pieces
+	checkDecode(flightLogCreateFromSource(memorySourceCreate(buffer.data, buffer.length, 1)));
+
+	// A log that was cut short, then a complete one, as a pipe would deliver them
+	checkTruncatedThenComplete(&buffer, 1);
+	checkTruncatedThenComplete(&buffer, 65536);
+
+	// And from a file
+	checkFileOfLogs(&buffer);
+
+	free(buffer.data);
+
+	printf("Done");
+
+	return 0;
+}